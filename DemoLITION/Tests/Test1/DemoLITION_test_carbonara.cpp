@@ -484,15 +484,47 @@ public:
 
         Model* pModel = m_pRenderingSystem->LoadModel("../Content/box.obj");
 
+        // The fireworks are spawned by the physics system. The scene objects are not
+        // bound to a particle - every frame the first ones follow the live fireworks.
         for (int i = 0; i < NumFireworks; i++) {
-            PhysicsSceneObject CObject;
-            CObject.pSceneObject = m_pScene->CreateSceneObject(pModel);
-            CObject.pSceneObject->SetScale(0.1f);
-            CObject.pParticle = m_physicsSystem.AllocFirework();
-            m_sceneObjects.push_back(CObject);
-            m_pScene->AddToRenderList(CObject.pSceneObject);
+            SceneObject* pSceneObject = m_pScene->CreateSceneObject(pModel);
+            pSceneObject->SetScale(0.1f);
+            m_fireworkObjects.push_back(pSceneObject);
         }
     }
+
+protected:
+
+    virtual void OnFrameChild(long long DeltaTimeMillis)
+    {
+        m_physicsSystem.FireworkUpdate((float)DeltaTimeMillis / 1000.0f);
+
+        // Launch a new rocket once the previous one and all its payloads are gone
+        if (m_physicsSystem.GetNumAliveFireworks() == 0) {
+            m_physicsSystem.SpawnFireworks(1, 1);
+        }
+
+        int NumVisible = std::min((int)m_physicsSystem.GetNumAliveFireworks(), (int)m_fireworkObjects.size());
+
+        for (int i = 0; i < NumVisible; i++) {
+            m_fireworkObjects[i]->SetPosition(m_physicsSystem.GetAliveFirework(i).GetPosition());
+        }
+
+        for (int i = m_numVisible; i < NumVisible; i++) {
+            m_pScene->AddToRenderList(m_fireworkObjects[i]);
+        }
+
+        for (int i = NumVisible; i < m_numVisible; i++) {
+            m_pScene->RemoveFromRenderList(m_fireworkObjects[i]);
+        }
+
+        m_numVisible = NumVisible;
+    }
+
+private:
+
+    std::vector<SceneObject*> m_fireworkObjects;
+    int m_numVisible = 0;
 };
 
 
@@ -820,6 +852,144 @@ private:
 };
 
 
+class ClothDemo : public Carbonara {
+
+public:
+
+#define CLOTH_SIZE 16
+#define CLOTH_SPACING 0.2f
+
+    ClothDemo()
+    {
+        m_physicsSystem.Init(NUM_PSOs, 1, 1);
+        m_xpbdSolver.Init(8);
+        m_xpbdSolver.SetDamping(0.9f);
+    }
+
+    void InitChild()
+    {
+        m_pScene->SetCamera(Vector3f(0.0f, 2.0f, -6.0f), Vector3f(0.0, -0.2f, 1.0f));
+
+        m_pSphere = m_pRenderingSystem->LoadModel("../Content/demolition/sphere8.obj");
+
+        // The cloth particles are owned by the XPBD solver and not by the physics system
+        m_clothParticles.resize(CLOTH_SIZE * CLOTH_SIZE);
+
+        for (int z = 0; z < CLOTH_SIZE; z++) {
+            for (int x = 0; x < CLOTH_SIZE; x++) {
+                int Index = z * CLOTH_SIZE + x;
+                OgldevPhysics::Particle& p = m_clothParticles[Index];
+
+                // The top row is pinned
+                if (z == CLOTH_SIZE - 1) {
+                    p.SetReciprocalMass(0.0f);
+                } else {
+                    p.SetMass(0.1f);
+                    p.SetAcceleration(OgldevPhysics::GRAVITY);
+                }
+
+                PhysicsSceneObject PSObject = AddPhysicsSceneObject(m_pSphere, false, 0.02f);
+                PSObject.pParticle = &p;
+                m_sceneObjects.back().pParticle = &p;
+                PSObject.InitPosition(Vector3f((x - CLOTH_SIZE / 2) * CLOTH_SPACING, 1.0f + z * CLOTH_SPACING, 0.0f));
+
+                m_xpbdSolver.AddParticle(&p);
+            }
+        }
+
+        InitClothConstraints(m_xpbdSolver, CLOTH_SIZE, 0.0f, 0.0001f);
+
+        m_xpbdSolver.AddPlaneConstraint(Vector3f(0.0f, 1.0f, 0.0f), 0.0f, 0.5f);
+    }
+
+
+    static void InitClothConstraints(OgldevPhysics::XPBDSolver& Solver, int Size, float StretchCompliance, float BendCompliance)
+    {
+        for (int z = 0; z < Size; z++) {
+            for (int x = 0; x < Size; x++) {
+                int Index = z * Size + x;
+
+                if (x + 1 < Size) {
+                    Solver.AddDistanceConstraint(Index, Index + 1, StretchCompliance);
+                }
+
+                if (z + 1 < Size) {
+                    Solver.AddDistanceConstraint(Index, Index + Size, StretchCompliance);
+                }
+
+                if (x + 2 < Size) {
+                    Solver.AddBendingConstraint(Index, Index + 1, Index + 2, BendCompliance);
+                }
+
+                if (z + 2 < Size) {
+                    Solver.AddBendingConstraint(Index, Index + Size, Index + 2 * Size, BendCompliance);
+                }
+            }
+        }
+    }
+
+protected:
+
+    virtual void OnFrameChild(long long DeltaTimeMillis)
+    {
+        m_xpbdSolver.Update((float)DeltaTimeMillis / 1000.0f);
+    }
+
+private:
+
+    std::vector<OgldevPhysics::Particle> m_clothParticles;
+    OgldevPhysics::XPBDSolver m_xpbdSolver;
+    Model* m_pSphere = NULL;
+};
+
+
+// Headless - runs the XPBD solver on a large cloth and prints the average time per step
+void cloth_benchmark()
+{
+    int Size = 256;
+    int NumSteps = 100;
+    float dt = 1.0f / 60.0f;
+
+    std::vector<OgldevPhysics::Particle> Particles(Size * Size);
+    OgldevPhysics::XPBDSolver Solver;
+    Solver.Init(4);
+
+    for (int z = 0; z < Size; z++) {
+        for (int x = 0; x < Size; x++) {
+            OgldevPhysics::Particle& p = Particles[z * Size + x];
+            p.SetPosition(x * 0.01f, 2.0f, z * 0.01f);
+
+            if (z == 0) {
+                p.SetReciprocalMass(0.0f);
+            } else {
+                p.SetMass(0.01f);
+                p.SetAcceleration(OgldevPhysics::GRAVITY);
+            }
+
+            Solver.AddParticle(&p);
+        }
+    }
+
+    ClothDemo::InitClothConstraints(Solver, Size, 0.0f, 0.0001f);
+    Solver.AddPlaneConstraint(Vector3f(0.0f, 1.0f, 0.0f), 0.0f, 0.5f);
+
+    // The first update builds the constraint colors
+    Solver.Update(dt);
+
+    long long StartTime = GetCurrentTimeMillis();
+
+    for (int i = 0; i < NumSteps; i++) {
+        Solver.Update(dt);
+    }
+
+    long long Duration = GetCurrentTimeMillis() - StartTime;
+
+    printf("XPBD cloth %dx%d: %d particles, %d constraints, %d colors - %.3f ms/step\n",
+           Size, Size, Solver.GetNumParticles(), Solver.GetNumConstraints(), Solver.GetNumColors(),
+           (float)Duration / (float)NumSteps);
+}
+
+
 class AmazonBistroDemo : public Carbonara {
 
 public:
@@ -855,6 +1025,7 @@ void carbonara()
    //FireworksDemo demo;
    // AnimationDemo demo;
   //  BridgeDemo demo;
+  //  ClothDemo demo;
     AmazonBistroDemo demo;
 
     demo.Start();
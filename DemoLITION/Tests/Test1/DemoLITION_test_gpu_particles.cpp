@@ -0,0 +1,147 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    DemoLITION - GPU particles vs. CPU reference
+
+    Runs the same particles through the CPU force generators + Particle::Integrate
+    and through the compute shader backend and compares the results.
+    Can be executed with a software implementation (e.g. LIBGL_ALWAYS_SOFTWARE=1).
+*/
+
+#include <math.h>
+#include <algorithm>
+
+#include "demolition.h"
+#include "ogldev_physics.h"
+#include "gpu_particle_system.h"
+
+
+#define WINDOW_WIDTH  320
+#define WINDOW_HEIGHT 240
+
+#define NUM_GPU_TEST_PARTICLES 10000
+#define NUM_GPU_TEST_STEPS     100
+#define GPU_TEST_TOLERANCE     0.001f
+
+
+static void InitTestParticles(std::vector<OgldevPhysics::Particle>& Particles)
+{
+    for (uint i = 0; i < Particles.size(); i++) {
+        OgldevPhysics::Particle& p = Particles[i];
+
+        Vector3f Pos;
+        Pos.InitRandom(Vector3f(-10.0f, 0.0f, -10.0f), Vector3f(10.0f, 10.0f, 10.0f));
+        p.SetPosition(Pos);
+
+        Vector3f Velocity;
+        Velocity.InitRandom(Vector3f(-1.0f, -1.0f, -1.0f), Vector3f(1.0f, 1.0f, 1.0f));
+        p.SetVelocity(Velocity);
+
+        // Every 16th particle is immovable
+        if ((i % 16) == 0) {
+            p.SetReciprocalMass(0.0f);
+        } else {
+            p.SetMass(RandomFloatRange(0.5f, 2.0f));
+        }
+
+        p.SetDamping(0.95f);
+        p.SetAcceleration(Vector3f(0.0f, 0.5f, 0.0f));
+    }
+}
+
+
+void test_gpu_particles()
+{
+    bool LoadBasicShapes = false;
+    RenderingSystem* pRenderingSystem = RenderingSystem::CreateRenderingSystem(RENDERING_SYSTEM_GL, NULL, LoadBasicShapes);
+    pRenderingSystem->CreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "GPU Particles Test");
+
+    float dt = 1.0f / 60.0f;
+    Vector3f Anchor(0.0f, 5.0f, 0.0f);
+
+    std::vector<OgldevPhysics::Particle> CPUParticles(NUM_GPU_TEST_PARTICLES);
+    InitTestParticles(CPUParticles);
+
+    std::vector<OgldevPhysics::Particle> GPUParticles = CPUParticles;
+
+    // CPU reference
+    OgldevPhysics::GravityForceGenerator Gravity(OgldevPhysics::GRAVITY);
+    OgldevPhysics::DragForceGenerator Drag(0.1f, 0.01f);
+    OgldevPhysics::AnchoredSpringForceGenerator Spring(&Anchor, 2.0f, 6.0f);
+    OgldevPhysics::ForceRegistry Registry;
+
+    for (uint i = 0; i < CPUParticles.size(); i++) {
+        Registry.Add(&CPUParticles[i], &Gravity);
+        Registry.Add(&CPUParticles[i], &Drag);
+        Registry.Add(&CPUParticles[i], &Spring);
+    }
+
+    long long StartTime = GetCurrentTimeMillis();
+
+    for (int Step = 0; Step < NUM_GPU_TEST_STEPS; Step++) {
+        Registry.Update(dt);
+
+        for (uint i = 0; i < CPUParticles.size(); i++) {
+            CPUParticles[i].Integrate(dt);
+        }
+    }
+
+    long long CPUTime = GetCurrentTimeMillis() - StartTime;
+
+    // GPU
+    OgldevPhysics::GPUParticleSystem GPUSystem;
+
+    if (!GPUSystem.Init(NUM_GPU_TEST_PARTICLES)) {
+        printf("GPU particles test: FAILED (init)\n");
+        exit(1);
+    }
+
+    GPUSystem.Upload(GPUParticles.data(), (uint)GPUParticles.size());
+    GPUSystem.SetGravity(OgldevPhysics::GRAVITY);
+    GPUSystem.SetDrag(0.1f, 0.01f);
+    GPUSystem.SetAnchoredSpring(Anchor, 2.0f, 6.0f);
+
+    StartTime = GetCurrentTimeMillis();
+
+    for (int Step = 0; Step < NUM_GPU_TEST_STEPS; Step++) {
+        GPUSystem.Update(dt);
+    }
+
+    glFinish();
+
+    long long GPUTime = GetCurrentTimeMillis() - StartTime;
+
+    GPUSystem.Download(GPUParticles.data(), (uint)GPUParticles.size());
+
+    float MaxError = 0.0f;
+
+    for (uint i = 0; i < CPUParticles.size(); i++) {
+        Vector3f Diff = CPUParticles[i].GetPosition() - GPUParticles[i].GetPosition();
+        float Error = Diff.Length() / std::max(1.0f, CPUParticles[i].GetPosition().Length());
+        MaxError = std::max(MaxError, Error);
+    }
+
+    printf("GPU particles test: %d particles, %d steps, CPU %lld ms, GPU %lld ms, max relative error %f\n",
+           NUM_GPU_TEST_PARTICLES, NUM_GPU_TEST_STEPS, CPUTime, GPUTime, MaxError);
+
+    if (MaxError > GPU_TEST_TOLERANCE) {
+        printf("GPU particles test: FAILED\n");
+        exit(1);
+    }
+
+    printf("GPU particles test: PASSED\n");
+}
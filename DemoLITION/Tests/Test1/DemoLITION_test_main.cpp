@@ -28,6 +28,8 @@ void test_normal_map();
 void test_parallax_map();
 void test_grid();
 void carbonara();
+void cloth_benchmark();
+void test_gpu_particles();
 
 
 int main(int argc, char* arg[])
@@ -43,4 +45,6 @@ int main(int argc, char* arg[])
    // test_parallax_map();
   // test_grid();
     carbonara();
+  //  cloth_benchmark();
+  //  test_gpu_particles();
 }
\ No newline at end of file
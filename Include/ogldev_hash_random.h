@@ -0,0 +1,62 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef OGLDEV_HASH_RANDOM_H
+#define OGLDEV_HASH_RANDOM_H
+
+#include "ogldev_types.h"
+
+//
+// Stateless (counter based) random numbers: the value is a hash of the seed
+// and a pair of counters, e.g. the coordinates of a height map point. Unlike
+// rand() the result doesn't depend on the order of the calls so it can be
+// used from several threads and still give the same result every time.
+//
+inline uint HashRandomMix(uint h)
+{
+    // murmur3 finalizer
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+
+inline uint HashRandom(uint Seed, uint a, uint b)
+{
+    uint h = HashRandomMix(Seed ^ (a * 0x9E3779B1u));
+    return HashRandomMix(h ^ (b * 0x85EBCA77u));
+}
+
+
+// [0, 1)
+inline float HashRandomFloat(uint Seed, uint a, uint b)
+{
+    return (float)(HashRandom(Seed, a, b) >> 8) * (1.0f / 16777216.0f);
+}
+
+
+inline float HashRandomFloatRange(uint Seed, uint a, uint b, float Start, float End)
+{
+    return Start + (End - Start) * HashRandomFloat(Seed, a, b);
+}
+
+#endif
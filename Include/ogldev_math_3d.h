@@ -894,6 +894,13 @@ public:
 };
 
 
+enum FRUSTUM_TEST_RESULT {
+    FRUSTUM_OUTSIDE,
+    FRUSTUM_INTERSECTS,
+    FRUSTUM_INSIDE
+};
+
+
 class FrustumCulling
 {
 public:
@@ -928,8 +935,54 @@ public:
         return Inside;
     }
 
+    // Returns the six planes in a form where a point p is inside the
+    // frustum when Plane.Dot(p, 1) >= 0 for all of them
+    void GetPlanes(Vector4f Planes[6]) const
+    {
+        Planes[0] = m_leftClipPlane;
+        Planes[1] = Negate(m_rightClipPlane);
+        Planes[2] = m_bottomClipPlane;
+        Planes[3] = Negate(m_topClipPlane);
+        Planes[4] = m_nearClipPlane;
+        Planes[5] = Negate(m_farClipPlane);
+    }
+
+    // Conservative - a box which is outside but close to a corner of the frustum may still be reported as intersecting
+    FRUSTUM_TEST_RESULT TestBox(const Vector3f& Min, const Vector3f& Max) const
+    {
+        Vector4f Planes[6];
+        GetPlanes(Planes);
+
+        FRUSTUM_TEST_RESULT Result = FRUSTUM_INSIDE;
+
+        for (int i = 0 ; i < 6 ; i++) {
+            const Vector4f& p = Planes[i];
+
+            // The corners of the box which are furthest along the plane normal and furthest against it
+            Vector4f Far((p.x >= 0.0f) ? Max.x : Min.x, (p.y >= 0.0f) ? Max.y : Min.y, (p.z >= 0.0f) ? Max.z : Min.z, 1.0f);
+            Vector4f Near((p.x >= 0.0f) ? Min.x : Max.x, (p.y >= 0.0f) ? Min.y : Max.y, (p.z >= 0.0f) ? Min.z : Max.z, 1.0f);
+
+            if (p.Dot(Far) < 0.0f) {
+                return FRUSTUM_OUTSIDE;
+            }
+
+            if (p.Dot(Near) < 0.0f) {
+                Result = FRUSTUM_INTERSECTS;
+            }
+        }
+
+        return Result;
+    }
+
+    bool IsBoxInsideViewFrustum(const Vector3f& Min, const Vector3f& Max) const
+    {
+        return TestBox(Min, Max) != FRUSTUM_OUTSIDE;
+    }
+
 private:
 
+    static Vector4f Negate(const Vector4f& v) { return Vector4f(-v.x, -v.y, -v.z, -v.w); }
+
     Vector4f m_leftClipPlane;
     Vector4f m_rightClipPlane;
     Vector4f m_bottomClipPlane;
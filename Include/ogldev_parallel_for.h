@@ -0,0 +1,75 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef OGLDEV_PARALLEL_FOR_H
+#define OGLDEV_PARALLEL_FOR_H
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// Zero means one thread per core
+inline int GetNumWorkerThreads(int NumThreads)
+{
+    if (NumThreads <= 0) {
+        NumThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+
+    return NumThreads;
+}
+
+
+//
+// Splits [0, NumItems) into contiguous ranges and calls Func(Start, End) for
+// each range on its own thread. Ranges smaller than MinItemsPerThread are not
+// worth the cost of a thread so small jobs run on the calling thread.
+//
+template<typename Func>
+void ParallelFor(int NumItems, int NumThreads, int MinItemsPerThread, Func&& f)
+{
+    NumThreads = GetNumWorkerThreads(NumThreads);
+    NumThreads = std::min(NumThreads, NumItems / std::max(1, MinItemsPerThread));
+
+    if (NumThreads <= 1) {
+        if (NumItems > 0) {
+            f(0, NumItems);
+        }
+        return;
+    }
+
+    std::vector<std::thread> Threads;
+    Threads.reserve(NumThreads - 1);
+
+    int ItemsPerThread = (NumItems + NumThreads - 1) / NumThreads;
+
+    for (int i = 1 ; i < NumThreads ; i++) {
+        int Start = std::min(i * ItemsPerThread, NumItems);
+        int End = std::min(Start + ItemsPerThread, NumItems);
+        Threads.push_back(std::thread([&f, Start, End]() { f(Start, End); }));
+    }
+
+    // The calling thread takes the first range
+    f(0, std::min(ItemsPerThread, NumItems));
+
+    for (size_t i = 0 ; i < Threads.size() ; i++) {
+        Threads[i].join();
+    }
+}
+
+#endif
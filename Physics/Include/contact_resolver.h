@@ -22,10 +22,13 @@
 
 #include "ogldev_math_3d.h"
 #include "particle.h"
+#include "physics_snapshot.h"
 
 namespace OgldevPhysics
 {
 
+class PhysicsSystem;
+
 class ParticleContact
 {
 public:
@@ -70,6 +73,8 @@ public:
 
     void SetIterations(int Iterations) { m_iterations = Iterations; }
 
+    int GetIterations() const { return m_iterations; }
+
     void ResolveContacts(std::vector<ParticleContact>& ContactArray, uint NumContacts, float dt);
 
 protected:
@@ -85,6 +90,22 @@ class ParticleContactGenerator {
 public:
 
     virtual int AddContact(std::vector<ParticleContact>& Contacts, int StartIndex) const = 0; // TODO: Contact should be an array of pointers
+
+    // The particles which are permanently connected by this generator (used for
+    // building the islands). Generators that work on a list of particles return zero.
+    virtual uint GetParticles(Particle* pParticles[2]) const { return 0; }
+
+    // Parameters for the physics snapshot (the particle pointers are not included)
+    virtual void SaveParams(SnapshotWriter& Writer) const {}
+    virtual bool LoadParams(SnapshotReader& Reader) { return true; }
+
+    // Set by PhysicsSystem::AddContactGenerator. Generators that work on a list
+    // of particles use it to skip the sleeping ones.
+    void SetPhysicsSystem(const PhysicsSystem* pSystem) { m_pSystem = pSystem; }
+
+protected:
+
+    const PhysicsSystem* m_pSystem = NULL;
 };
 
 
@@ -96,6 +117,8 @@ public:
 
     virtual int AddContact(std::vector<ParticleContact>& Contacts, int StartIndex) const = 0;
 
+    virtual uint GetParticles(Particle* pParticles[2]) const;
+
 protected:
 
     float GetLength() const;
@@ -108,6 +131,9 @@ public:
 
     virtual int AddContact(std::vector<ParticleContact>& Contacts, int StartIndex) const;
 
+    virtual void SaveParams(SnapshotWriter& Writer) const;
+    virtual bool LoadParams(SnapshotReader& Reader);
+
     float m_maxLength = 0.0f;
 
     float m_restituion = 0.0f;
@@ -121,6 +147,9 @@ public:
     float m_len = 0.0f;
 
     virtual int AddContact(std::vector<ParticleContact>& Contacts, int StartIndex) const;
+
+    virtual void SaveParams(SnapshotWriter& Writer) const;
+    virtual bool LoadParams(SnapshotReader& Reader);
 };
 
 
@@ -134,6 +163,8 @@ public:
 
     virtual int AddContact(std::vector<ParticleContact>& Contacts, int StartIndex) const = 0;
 
+    virtual uint GetParticles(Particle* pParticles[2]) const;
+
 protected:
 
     float GetCurLength() const;
@@ -149,6 +180,9 @@ public:
     float m_restitution = 0.0f;
 
     virtual int AddContact(std::vector<ParticleContact>& Contacts, int StartIndex) const;
+
+    virtual void SaveParams(SnapshotWriter& Writer) const;
+    virtual bool LoadParams(SnapshotReader& Reader);
 };
 
 
@@ -23,6 +23,7 @@
 
 #include "ogldev_math_3d.h"
 #include "particle.h"
+#include "physics_random.h"
 
 namespace OgldevPhysics
 {
@@ -32,7 +33,7 @@ class Firework : public Particle
 public:
     Firework() {}
 
-    ~Firework() {}
+    ~Firework() = default;
 
     bool Update(float dt);
 
@@ -85,7 +86,7 @@ struct FireworkConfig
         m_damping = Damping;
     }
 
-    void Create(Firework& firework, const Firework* pParent = NULL) const;
+    void Create(Firework& firework, PhysicsRandom& Random, const Firework* pParent = NULL) const;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,102 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "ogldev_types.h"
+#include "ogldev_math_3d.h"
+#include "particle.h"
+#include "gpu_particle_technique.h"
+
+namespace OgldevPhysics
+{
+
+//
+// Optional compute shader backend for large particle simulations.
+//
+// The particle state is mirrored into three SSBOs (position + reciprocal mass,
+// velocity + damping, constant acceleration) and integrated on the GPU using
+// the same math as Particle::Integrate. The position buffer can be used directly
+// as a vertex buffer (see Render) so there is no need to read it back to the CPU.
+//
+// Requires OpenGL 4.3.
+//
+class GPUParticleSystem {
+
+public:
+
+    GPUParticleSystem() {}
+
+    ~GPUParticleSystem();
+
+    bool Init(uint MaxParticles);
+
+    // Copies the state of the particles into the SSBOs
+    void Upload(const Particle* pParticles, uint NumParticles);
+
+    // Reads back the state from the GPU (slow - intended for tests and debugging)
+    void Download(Particle* pParticles, uint NumParticles);
+
+    void SetGravity(const Vector3f& Gravity) { m_gravityEnabled = true; m_gravity = Gravity; }
+
+    void SetDrag(float k1, float k2) { m_dragEnabled = true; m_dragK1 = k1; m_dragK2 = k2; }
+
+    void SetAnchoredSpring(const Vector3f& Anchor, float SpringConstant, float RestLength);
+
+    void Update(float dt);
+
+    // Draws the particles as points using the currently bound program (attribute 0 is vec4 position)
+    void Render();
+
+    GLuint GetPositionBuffer() const { return m_buffers[POSITION_BUFFER]; }
+
+    uint GetNumParticles() const { return m_numParticles; }
+
+private:
+
+    enum BUFFER_TYPE {
+        POSITION_BUFFER     = 0,
+        VELOCITY_BUFFER     = 1,
+        ACCELERATION_BUFFER = 2,
+        NUM_BUFFERS         = 3
+    };
+
+    GPUParticleTechnique m_technique;
+
+    GLuint m_buffers[NUM_BUFFERS] = { 0 };
+    GLuint m_vao = 0;
+
+    uint m_maxParticles = 0;
+    uint m_numParticles = 0;
+
+    bool m_gravityEnabled = false;
+    Vector3f m_gravity = Vector3f(0.0f, 0.0f, 0.0f);
+
+    bool m_dragEnabled = false;
+    float m_dragK1 = 0.0f;
+    float m_dragK2 = 0.0f;
+
+    bool m_springEnabled = false;
+    Vector3f m_springAnchor = Vector3f(0.0f, 0.0f, 0.0f);
+    float m_springConstant = 0.0f;
+    float m_springRestLength = 0.0f;
+};
+
+}
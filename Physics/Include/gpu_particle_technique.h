@@ -0,0 +1,60 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "technique.h"
+#include "ogldev_math_3d.h"
+
+namespace OgldevPhysics
+{
+
+class GPUParticleTechnique : public Technique
+{
+public:
+
+    GPUParticleTechnique();
+
+    virtual bool Init();
+
+    void SetNumParticles(uint NumParticles);
+
+    void SetDeltaTime(float dt);
+
+    void SetGravity(bool Enabled, const Vector3f& Gravity);
+
+    void SetDrag(bool Enabled, float k1, float k2);
+
+    void SetAnchoredSpring(bool Enabled, const Vector3f& Anchor, float SpringConstant, float RestLength);
+
+private:
+
+    GLuint m_numParticlesLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_dtLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_gravityEnabledLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_gravityLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_dragEnabledLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_dragK1Loc = INVALID_UNIFORM_LOCATION;
+    GLuint m_dragK2Loc = INVALID_UNIFORM_LOCATION;
+    GLuint m_springEnabledLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_springAnchorLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_springConstantLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_springRestLengthLoc = INVALID_UNIFORM_LOCATION;
+};
+
+}
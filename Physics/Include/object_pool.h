@@ -0,0 +1,214 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <assert.h>
+#include <vector>
+#include <algorithm>
+
+#include "ogldev_types.h"
+#include "physics_snapshot.h"
+
+#define INVALID_POOL_INDEX 0xFFFFFFFF
+
+namespace OgldevPhysics
+{
+
+//
+// Fixed capacity pool with an O(1) free list.
+//
+// The storage is allocated once in Init so pointers to the objects remain
+// valid for the lifetime of the pool. The indices of the live objects are
+// kept in a compact list (swap-remove on free) so that the update loops only
+// touch live objects.
+//
+template<typename T>
+class ObjectPool {
+
+public:
+
+    ObjectPool() {}
+
+    void Init(uint Capacity)
+    {
+        m_objects.clear();
+        m_objects.resize(Capacity);
+
+        m_freeList.resize(Capacity);
+
+        // Pop from the back so that the first allocations get the low indices
+        for (uint i = 0; i < Capacity; i++) {
+            m_freeList[i] = Capacity - 1 - i;
+        }
+
+        m_alive.clear();
+        m_alive.reserve(Capacity);
+        m_alivePos.assign(Capacity, INVALID_POOL_INDEX);
+    }
+
+    // Returns NULL if the pool is full
+    T* Alloc()
+    {
+        if (m_freeList.empty()) {
+            return NULL;
+        }
+
+        uint Index = m_freeList.back();
+        m_freeList.pop_back();
+
+        m_alivePos[Index] = (uint)m_alive.size();
+        m_alive.push_back(Index);
+
+        m_objects[Index] = T();
+
+        return &m_objects[Index];
+    }
+
+    void Free(T* pObject)
+    {
+        FreeIndex(GetIndex(pObject));
+    }
+
+    void FreeIndex(uint Index)
+    {
+        assert(Index < m_objects.size());
+        assert(m_alivePos[Index] != INVALID_POOL_INDEX);
+
+        // Move the last live index into the hole
+        uint Pos = m_alivePos[Index];
+        uint LastIndex = m_alive.back();
+        m_alive[Pos] = LastIndex;
+        m_alivePos[LastIndex] = Pos;
+        m_alive.pop_back();
+
+        m_alivePos[Index] = INVALID_POOL_INDEX;
+        m_freeList.push_back(Index);
+    }
+
+    bool Contains(const T* pObject) const
+    {
+        return (pObject >= m_objects.data()) && (pObject < m_objects.data() + m_objects.size());
+    }
+
+    uint GetIndex(const T* pObject) const
+    {
+        assert((pObject >= m_objects.data()) && (pObject < m_objects.data() + m_objects.size()));
+        return (uint)(pObject - m_objects.data());
+    }
+
+    bool IsAlive(uint Index) const { return m_alivePos[Index] != INVALID_POOL_INDEX; }
+
+    uint GetCapacity() const { return (uint)m_objects.size(); }
+
+    uint GetNumAlive() const { return (uint)m_alive.size(); }
+
+    uint GetNumFree() const { return (uint)m_freeList.size(); }
+
+    // Access by position in the live list (0 .. GetNumAlive() - 1)
+    T& GetAlive(uint Pos) { return m_objects[m_alive[Pos]]; }
+    const T& GetAlive(uint Pos) const { return m_objects[m_alive[Pos]]; }
+
+    uint GetAliveIndex(uint Pos) const { return m_alive[Pos]; }
+
+    // Access by slot index (0 .. GetCapacity() - 1)
+    T& operator[](uint Index) { return m_objects[Index]; }
+    const T& operator[](uint Index) const { return m_objects[Index]; }
+
+    // The objects are stored as raw bytes together with the free/live lists
+    // so that the iteration order is identical after a restore.
+    void Save(SnapshotWriter& Writer) const
+    {
+        Writer.WriteVector(m_objects);
+        Writer.WriteVector(m_freeList);
+        Writer.WriteVector(m_alive);
+        Writer.WriteVector(m_alivePos);
+    }
+
+    // Decodes a pool written by Save into this pool (the current state is replaced).
+    // Fails without changing the pool if the capacity of the snapshot is not
+    // Capacity or if the free/live lists are not consistent.
+    bool Load(SnapshotReader& Reader, uint Capacity)
+    {
+        std::vector<T> Objects;
+        std::vector<uint> FreeList;
+        std::vector<uint> Alive;
+        std::vector<uint> AlivePos;
+
+        if (!Reader.ReadVector(Objects) || !Reader.ReadVector(FreeList) ||
+            !Reader.ReadVector(Alive) || !Reader.ReadVector(AlivePos)) {
+            return false;
+        }
+
+        if ((Objects.size() != Capacity) || (AlivePos.size() != Capacity) ||
+            (FreeList.size() + Alive.size() != Capacity)) {
+            return false;
+        }
+
+        // Every slot must be either free or alive exactly once
+        std::vector<char> Seen(Capacity, 0);
+
+        for (uint i = 0; i < FreeList.size(); i++) {
+            uint Index = FreeList[i];
+
+            if ((Index >= Capacity) || Seen[Index] || (AlivePos[Index] != INVALID_POOL_INDEX)) {
+                return false;
+            }
+
+            Seen[Index] = 1;
+        }
+
+        for (uint i = 0; i < Alive.size(); i++) {
+            uint Index = Alive[i];
+
+            if ((Index >= Capacity) || Seen[Index] || (AlivePos[Index] != i)) {
+                return false;
+            }
+
+            Seen[Index] = 1;
+        }
+
+        m_objects.swap(Objects);
+        m_freeList.swap(FreeList);
+        m_alive.swap(Alive);
+        m_alivePos.swap(AlivePos);
+
+        return true;
+    }
+
+    // Copies the state of Other into the existing storage so that the pointers
+    // which the application holds remain valid. The capacities must be equal.
+    void CopyFrom(const ObjectPool& Other)
+    {
+        assert(Other.m_objects.size() == m_objects.size());
+
+        std::copy(Other.m_objects.begin(), Other.m_objects.end(), m_objects.begin());
+        m_freeList = Other.m_freeList;
+        m_alive = Other.m_alive;
+        m_alivePos = Other.m_alivePos;
+    }
+
+private:
+
+    std::vector<T> m_objects;
+    std::vector<uint> m_freeList;
+    std::vector<uint> m_alive;
+    std::vector<uint> m_alivePos;
+};
+
+}
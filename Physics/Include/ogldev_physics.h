@@ -23,6 +23,7 @@
 #include <vector>
 
 #include "ogldev_types.h"
+#include "object_pool.h"
 #include "particle.h"
 #include "firework.h"
 #include "gravity_force_generator.h"
@@ -33,12 +34,22 @@
 #include "buoyancy_force_generator.h"
 #include "fake_spring_force_generator.h"
 #include "contact_resolver.h"
+#include "physics_random.h"
+#include "physics_snapshot.h"
+#include "xpbd_solver.h"
 
 namespace OgldevPhysics
 {
 
 const static Vector3f GRAVITY = Vector3f(0.0f, -9.81f, 0.0f);
 
+struct PhysicsStats {
+    uint m_numAwakeParticles = 0;
+    uint m_numSleepingParticles = 0;
+    uint m_numIslands = 0;
+    uint m_numSleepingIslands = 0;
+};
+
 class PhysicsSystem {
 
 public:
@@ -48,10 +59,30 @@ public:
 
     void Init(uint NumParticles, uint MaxContacts, uint Iterations);
 
+    // Exits when the pool is exhausted
     Particle* AllocParticle();
 
+    void FreeParticle(Particle* pParticle);
+
+    // Exits when the pool is exhausted. The firework is not launched (type zero)
+    // and is ignored by FireworkUpdate - use SpawnFireworks to launch fireworks.
     Firework* AllocFirework();
 
+    void FreeFirework(Firework* pFirework);
+
+    // Spawns up to Count fireworks of the given type and returns the number actually spawned
+    uint SpawnFireworks(int Type, uint Count, const Firework* pParent = NULL);
+
+    // Moves the launched fireworks and replaces the expired ones with their payloads
+    void FireworkUpdate(float dt);
+
+    uint GetNumAliveParticles() const { return m_particles.GetNumAlive(); }
+
+    uint GetNumAliveFireworks() const { return m_fireworks.GetNumAlive(); }
+
+    // Pos is 0 .. GetNumAliveFireworks() - 1. The order changes when fireworks expire.
+    const Firework& GetAliveFirework(uint Pos) const { return m_fireworks.GetAlive(Pos); }
+
     void Update(long long DeltaTimeMillis);
 
     ForceRegistry& GetRegistry() { return m_forceRegistry; }    
@@ -62,29 +93,79 @@ public:
 
     void AddContactGenerator(ParticleContactGenerator* pContact);
 
+    // Must be called before Init for the initial fireworks to use it
+    void SetRandomSeed(uint Seed) { m_random.SetSeed(Seed); }
+
+    // Particles, fireworks, random state and contact generator parameters.
+    // The system must have been initialized with the same capacities and
+    // contact generators as the one which saved the snapshot.
+    void SaveSnapshot(std::vector<char>& Blob) const;
+
+    bool RestoreSnapshot(const std::vector<char>& Blob);
+
+    // Islands of particles connected by links/contacts whose velocities stay below
+    // the threshold for SleepTime seconds are put to sleep and skipped by Update.
+    // They are woken up when the application changes their position/velocity,
+    // applies a force or when an awake particle touches them.
+    void EnableSleeping(bool Enabled, float VelocityThreshold = 0.05f, float SleepTime = 0.5f);
+
+    void WakeParticle(Particle* pParticle);
+
+    bool IsSleeping(const Particle* pParticle) const;
+
+    // Overrides the velocity threshold of EnableSleeping for one particle (zero restores
+    // the default). An island uses the lowest threshold of its particles so a single
+    // sensitive particle keeps its whole island awake for longer.
+    void SetSleepThreshold(Particle* pParticle, float VelocityThreshold);
+
+    const PhysicsStats& GetStats() const { return m_stats; }
+
 private:
 
     void InitFireworksConfig();
 
-    void Create(int Type, uint Count, Firework* pFirework);
-
     void ParticleUpdate(float dt);
-    void FireworkUpdate(float dt);
 
     uint GenerateContacts();
 
-    std::vector<Particle> m_particles;
-    std::vector<Firework> m_fireworks;
+    void WakeIsland(uint Island);
+
+    void CheckExternalWakeUps();
+
+    uint FilterSleepingContacts(uint NumContacts);
+
+    uint FindIsland(uint Index);
+
+    void UnionIslands(const Particle* pParticle0, const Particle* pParticle1);
+
+    void UpdateIslands(float dt);
+
+    ObjectPool<Particle> m_particles;
+    ObjectPool<Firework> m_fireworks;
     std::vector<FireworkConfig> m_fireworkConfigs;
     std::vector<ParticleContactGenerator*> m_contactGenerators;
     std::vector<ParticleContact> m_contacts;
 
     ForceRegistry m_forceRegistry;
     ParticleContactResolver m_resolver;
-
-    uint m_numParticles = 0;
-    uint m_numFireworks = 0;
-    uint m_nextFirework = 0; 
+    PhysicsRandom m_random;
+
+    std::vector<Firework> m_expiredFireworks;
+
+    // Sleeping state - indexed by the particle pool slot
+    bool m_sleepingEnabled = false;
+    float m_sleepVelocityThreshold = 0.0f;
+    float m_sleepTime = 0.0f;
+    std::vector<char> m_sleeping;
+    std::vector<Vector3f> m_sleepPos;
+    std::vector<uint> m_islandParent;    // union-find
+    std::vector<float> m_sleepTimer;     // how long the particle has been below the velocity threshold
+    std::vector<float> m_sleepThreshold; // per particle override, zero means m_sleepVelocityThreshold
+    std::vector<uint> m_islandOffsets;   // members of island i are m_islandMembers[offsets[i]..offsets[i+1])
+    std::vector<uint> m_islandMembers;
+    std::vector<uint> m_islandOfParticle;
+    uint m_numUsedContacts = 0;
+    PhysicsStats m_stats;
     uint m_numContactGenerators = 0;
     bool m_calcIters = false;   
 };
@@ -51,11 +51,14 @@ public:
     void SetAcceleration(const Vector3f& Acceleration) { m_acceleration = Acceleration; }
 
     void SetDamping(float Damping) { m_damping = Damping; }
+    float GetDamping() const { return m_damping; }
 
     void Integrate(float dt);
 
     void AddForce(const Vector3f& Force) { m_forceAccum += Force; }
 
+    const Vector3f& GetForceAccum() const { return m_forceAccum; }
+
     bool HasFiniteMass() const { return (m_reciprocalMass >= 0.0f); }
 
     void ClearAccum();
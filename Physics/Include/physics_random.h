@@ -0,0 +1,67 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "ogldev_types.h"
+#include "ogldev_math_3d.h"
+
+namespace OgldevPhysics
+{
+
+//
+// Small xorshift generator owned by the physics system. Unlike the global
+// RandomFloatRange its state is part of the snapshot so replays are deterministic.
+//
+class PhysicsRandom {
+
+public:
+
+    void SetSeed(uint Seed) { m_state = (Seed == 0) ? 1 : Seed; }
+
+    uint GetState() const { return m_state; }
+    void SetState(uint State) { m_state = State; }
+
+    uint Next()
+    {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 17;
+        m_state ^= m_state << 5;
+        return m_state;
+    }
+
+    // [0, 1)
+    float NextFloat() { return (float)(Next() >> 8) * (1.0f / 16777216.0f); }
+
+    float NextFloatRange(float Start, float End) { return Start + (End - Start) * NextFloat(); }
+
+    Vector3f NextVector3f(const Vector3f& MinVal, const Vector3f& MaxVal)
+    {
+        Vector3f v;
+        v.x = NextFloatRange(MinVal.x, MaxVal.x);
+        v.y = NextFloatRange(MinVal.y, MaxVal.y);
+        v.z = NextFloatRange(MinVal.z, MaxVal.z);
+        return v;
+    }
+
+private:
+
+    uint m_state = 1;
+};
+
+}
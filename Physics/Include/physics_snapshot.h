@@ -0,0 +1,176 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string.h>
+#include <vector>
+#include <type_traits>
+
+#include "ogldev_types.h"
+
+namespace OgldevPhysics
+{
+
+// Appends raw bytes to a binary blob
+class SnapshotWriter {
+
+public:
+
+    SnapshotWriter(std::vector<char>& Blob) : m_blob(Blob) {}
+
+    void WriteBytes(const void* pData, size_t Size)
+    {
+        const char* p = (const char*)pData;
+        m_blob.insert(m_blob.end(), p, p + Size);
+    }
+
+    template<typename T>
+    void Write(const T& Val)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Snapshot types must be trivially copyable");
+        WriteBytes(&Val, sizeof(T));
+    }
+
+    template<typename T>
+    void WriteVector(const std::vector<T>& v)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Snapshot types must be trivially copyable");
+        Write((uint)v.size());
+        WriteBytes(v.data(), v.size() * sizeof(T));
+    }
+
+private:
+
+    std::vector<char>& m_blob;
+};
+
+
+// Reads back what SnapshotWriter wrote. Once a read goes past the end
+// all subsequent reads fail and IsOK() returns false.
+class SnapshotReader {
+
+public:
+
+    SnapshotReader(const char* pData, size_t Size) : m_pData(pData), m_size(Size) {}
+
+    bool ReadBytes(void* pData, size_t Size)
+    {
+        if (!m_ok || (m_pos + Size > m_size)) {
+            m_ok = false;
+            return false;
+        }
+
+        memcpy(pData, m_pData + m_pos, Size);
+        m_pos += Size;
+
+        return true;
+    }
+
+    template<typename T>
+    bool Read(T& Val)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Snapshot types must be trivially copyable");
+        return ReadBytes(&Val, sizeof(T));
+    }
+
+    template<typename T>
+    bool ReadVector(std::vector<T>& v)
+    {
+        uint Count = 0;
+
+        if (!Read(Count)) {
+            return false;
+        }
+
+        if (m_pos + (size_t)Count * sizeof(T) > m_size) {
+            m_ok = false;
+            return false;
+        }
+
+        v.resize(Count);
+
+        return ReadBytes(v.data(), Count * sizeof(T));
+    }
+
+    bool IsOK() const { return m_ok; }
+
+    bool IsAtEnd() const { return m_pos == m_size; }
+
+private:
+
+    const char* m_pData = NULL;
+    size_t m_size = 0;
+    size_t m_pos = 0;
+    bool m_ok = true;
+};
+
+
+class PhysicsSystem;
+
+//
+// Deterministic replay of the physics system.
+//
+// Recording starts from a snapshot of the system. Every frame the application
+// records the time step (and optionally its own input events) before calling
+// PhysicsSystem::Update. Playback restores the snapshot and feeds the exact same
+// steps and events back, so the results can be compared bit-for-bit using
+// SaveSnapshot on both runs.
+//
+class PhysicsReplay {
+
+public:
+
+    typedef void (*EventCallback)(uint Type, const std::vector<char>& Data, void* pUserData);
+
+    void StartRecording(const PhysicsSystem& System);
+
+    // Events are attached to the step which is recorded next
+    void RecordEvent(uint Type, const void* pData, uint Size);
+
+    // Records the step and runs it on the system
+    void RecordStep(PhysicsSystem& System, long long DeltaTimeMillis);
+
+    void StartPlayback(PhysicsSystem& System);
+
+    // Runs the next recorded step. Returns false when the replay is over.
+    bool PlaybackStep(PhysicsSystem& System, EventCallback pCallback = NULL, void* pUserData = NULL);
+
+    uint GetNumSteps() const { return (uint)m_steps.size(); }
+
+    bool SaveToFile(const char* pFilename) const;
+
+    bool LoadFromFile(const char* pFilename);
+
+private:
+
+    struct ReplayEvent {
+        uint m_step = 0;
+        uint m_type = 0;
+        std::vector<char> m_data;
+    };
+
+    std::vector<char> m_initialSnapshot;
+    std::vector<long long> m_steps;
+    std::vector<ReplayEvent> m_events;
+
+    uint m_playbackStep = 0;
+    uint m_playbackEvent = 0;
+};
+
+}
@@ -0,0 +1,134 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "ogldev_types.h"
+#include "ogldev_math_3d.h"
+#include "particle.h"
+
+namespace OgldevPhysics
+{
+
+//
+// Extended Position Based Dynamics (XPBD) solver for ropes, rods and cloth.
+//
+// The solver works on the same Particle objects as the rest of the system.
+// Positions/velocities are copied into local arrays at the start of Update
+// and written back at the end. The particles that are added here should not
+// also be integrated by PhysicsSystem::ParticleUpdate. Gravity is taken from
+// the acceleration of each particle, like Particle::Integrate does.
+//
+// Compliance is the inverse of stiffness (0 means infinitely stiff).
+//
+class XPBDSolver {
+
+public:
+
+    XPBDSolver() {}
+
+    ~XPBDSolver() {}
+
+    void Init(uint NumSubSteps, uint NumIterations = 1);
+
+    // Returns the index of the particle inside the solver
+    uint AddParticle(Particle* pParticle);
+
+    // The rest length is taken from the current distance between the particles
+    void AddDistanceConstraint(uint Index0, uint Index1, float Compliance);
+
+    // Triangle bending constraint (Kelager et al. 2010) on the Index0-Index1-Index2
+    // triplet. Keeps the distance between the middle particle (Index1) and the
+    // centroid of the three particles at its rest value, so it resists changes of
+    // the angle at Index1 without depending on the edge lengths.
+    void AddBendingConstraint(uint Index0, uint Index1, uint Index2, float Compliance);
+
+    // All particles are kept on the positive side of Dot(Normal, x) = Dist
+    void AddPlaneConstraint(const Vector3f& Normal, float Dist, float Friction = 0.0f);
+
+    void SetDamping(float Damping) { m_damping = Damping; }
+
+    void Update(float dt);
+
+    uint GetNumParticles() const { return (uint)m_particles.size(); }
+
+    uint GetNumConstraints() const { return (uint)m_constraints.size(); }
+
+    uint GetNumColors() const { return m_colorOffsets.empty() ? 0 : (uint)m_colorOffsets.size() - 1; }
+
+private:
+
+    enum CONSTRAINT_TYPE {
+        CONSTRAINT_TYPE_DISTANCE = 0,
+        CONSTRAINT_TYPE_BENDING = 1
+    };
+
+    struct Constraint {
+        uint m_index[3] = { 0, 0, 0 };    // the third index is only used by bending
+        float m_restLength = 0.0f;        // bending - distance of the middle particle from the centroid
+        float m_compliance = 0.0f;
+        int m_type = CONSTRAINT_TYPE_DISTANCE;
+    };
+
+    struct PlaneConstraint {
+        Vector3f m_normal = Vector3f(0.0f, 1.0f, 0.0f);
+        float m_dist = 0.0f;
+        float m_friction = 0.0f;
+    };
+
+    void BuildColors();
+
+    void LoadParticles();
+
+    void StoreParticles();
+
+    void SubStep(float dt);
+
+    void SolveConstraints(float dt);
+
+    void SolveDistance(const Constraint& c, float& Lambda, float Alpha);
+
+    void SolveBending(const Constraint& c, float& Lambda, float Alpha);
+
+    void SolvePlanes();
+
+    std::vector<Particle*> m_particles;
+
+    // Solver state in SoA layout
+    std::vector<Vector3f> m_pos;
+    std::vector<Vector3f> m_prevPos;
+    std::vector<Vector3f> m_vel;
+    std::vector<Vector3f> m_externalAccel;
+    std::vector<float> m_reciprocalMass;
+
+    // Sorted by color so that a color is a contiguous range of independent constraints
+    std::vector<Constraint> m_constraints;
+    std::vector<float> m_lambdas;
+    std::vector<uint> m_colorOffsets;
+    bool m_colorsDirty = true;
+
+    std::vector<PlaneConstraint> m_planes;
+
+    float m_damping = 1.0f;
+    uint m_numSubSteps = 1;
+    uint m_numIterations = 1;
+};
+
+}
@@ -0,0 +1,88 @@
+#version 430
+
+// GPU version of Particle::Integrate plus the gravity, drag and anchored
+// spring force generators. Must be kept in sync with the CPU code.
+
+layout (local_size_x = 256) in;
+
+uniform uint gNumParticles;
+uniform float gDeltaTime;
+
+uniform bool gGravityEnabled;
+uniform vec3 gGravity;
+
+uniform bool gDragEnabled;
+uniform float gDragK1;
+uniform float gDragK2;
+
+uniform bool gSpringEnabled;
+uniform vec3 gSpringAnchor;
+uniform float gSpringConstant;
+uniform float gSpringRestLength;
+
+// xyz - position, w - reciprocal mass
+layout(std430, binding=0) buffer Positions {
+    vec4 Position[];
+};
+
+// xyz - velocity, w - damping
+layout(std430, binding=1) buffer Velocities {
+    vec4 Velocity[];
+};
+
+// xyz - constant acceleration, w - unused
+layout(std430, binding=2) buffer Accelerations {
+    vec4 Acceleration[];
+};
+
+void main()
+{
+    uint idx = gl_GlobalInvocationID.x;
+
+    if (idx >= gNumParticles) {
+        return;
+    }
+
+    vec4 p = Position[idx];
+    vec4 v = Velocity[idx];
+
+    float ReciprocalMass = p.w;
+
+    if (ReciprocalMass <= 0.0) {
+        return;
+    }
+
+    vec3 Force = vec3(0.0);
+
+    if (gGravityEnabled) {
+        Force += gGravity / ReciprocalMass;
+    }
+
+    if (gDragEnabled) {
+        float Speed = length(v.xyz);
+
+        if (Speed > 0.0) {
+            float DragCoeff = gDragK1 * Speed + gDragK2 * Speed * Speed;
+            Force += (v.xyz / Speed) * (-DragCoeff);
+        }
+    }
+
+    if (gSpringEnabled) {
+        vec3 d = p.xyz - gSpringAnchor;
+        float Len = length(d);
+        float Magnitude = (gSpringRestLength - Len) * gSpringConstant;
+
+        if ((Magnitude > 0.0) && (Len > 0.0)) {
+            Force += (d / Len) * Magnitude;
+        }
+    }
+
+    p.xyz += v.xyz * gDeltaTime;
+
+    vec3 Acc = Acceleration[idx].xyz + Force * ReciprocalMass;
+    v.xyz += Acc * gDeltaTime;
+    v.xyz *= pow(v.w, gDeltaTime);
+
+    Position[idx] = p;
+    Velocity[idx] = v;
+}
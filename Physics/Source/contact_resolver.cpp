@@ -21,6 +21,7 @@
 #include <algorithm>
 
 #include "contact_resolver.h"
+#include "ogldev_physics.h"
 
 namespace OgldevPhysics
 {
@@ -208,6 +209,15 @@ float ParticleLink::GetLength() const
 }
 
 
+uint ParticleLink::GetParticles(Particle* pParticles[2]) const
+{
+    pParticles[0] = m_pParticles[0];
+    pParticles[1] = m_pParticles[1];
+
+    return 2;
+}
+
+
 int ParticleCable::AddContact(std::vector<ParticleContact>& Contacts, int StartIndex) const
 {
     float Length = GetLength();
@@ -265,6 +275,31 @@ int ParticleRod::AddContact(std::vector<ParticleContact>& Contacts, int StartInd
 }
 
 
+void ParticleCable::SaveParams(SnapshotWriter& Writer) const
+{
+    Writer.Write(m_maxLength);
+    Writer.Write(m_restituion);
+}
+
+
+bool ParticleCable::LoadParams(SnapshotReader& Reader)
+{
+    return Reader.Read(m_maxLength) && Reader.Read(m_restituion);
+}
+
+
+void ParticleRod::SaveParams(SnapshotWriter& Writer) const
+{
+    Writer.Write(m_len);
+}
+
+
+bool ParticleRod::LoadParams(SnapshotReader& Reader)
+{
+    return Reader.Read(m_len);
+}
+
+
 float ParticleConstraint::GetCurLength() const
 {
     Vector3f RelativePos = m_pParticle->GetPosition() - m_anchor;
@@ -272,6 +307,14 @@ float ParticleConstraint::GetCurLength() const
 }
 
 
+uint ParticleConstraint::GetParticles(Particle* pParticles[2]) const
+{
+    pParticles[0] = m_pParticle;
+
+    return 1;
+}
+
+
 int ParticleCableConstraint::AddContact(std::vector<ParticleContact>& Contacts, int StartIndex) const
 {
     float Len = GetCurLength();
@@ -294,6 +337,20 @@ int ParticleCableConstraint::AddContact(std::vector<ParticleContact>& Contacts,
 }
 
 
+void ParticleCableConstraint::SaveParams(SnapshotWriter& Writer) const
+{
+    Writer.Write(m_anchor);
+    Writer.Write(m_maxLength);
+    Writer.Write(m_restitution);
+}
+
+
+bool ParticleCableConstraint::LoadParams(SnapshotReader& Reader)
+{
+    return Reader.Read(m_anchor) && Reader.Read(m_maxLength) && Reader.Read(m_restitution);
+}
+
+
 void GroundContacts::Init(std::vector<Particle*>* pParticles)
 {
     m_pParticles = pParticles;
@@ -309,6 +366,11 @@ int GroundContacts::AddContact(std::vector<ParticleContact>& Contacts, int Start
 
     for (std::vector<Particle*>::iterator it = m_pParticles->begin(); it != m_pParticles->end(); it++) {
 
+        // Resting particles must not use up the contacts of the awake ones
+        if (m_pSystem && m_pSystem->IsSleeping(*it)) {
+            continue;
+        }
+
         float y = (*it)->GetPosition().y;
 
         if (y < 0.0f) {
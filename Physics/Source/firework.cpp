@@ -37,10 +37,10 @@ bool Firework::Update(float dt)
 }
 
 
-void FireworkConfig::Create(Firework& firework, const Firework* pParent) const
+void FireworkConfig::Create(Firework& firework, PhysicsRandom& Random, const Firework* pParent) const
 {    
     firework.SetType(m_type);
-    firework.SetAge(RandomFloatRange(m_minAge, m_maxAge));
+    firework.SetAge(Random.NextFloatRange(m_minAge, m_maxAge));
 
     Vector3f Velocity(0.0f, 0.0f, 0.0f);
 
@@ -56,9 +56,7 @@ void FireworkConfig::Create(Firework& firework, const Firework* pParent) const
         firework.SetPosition(Start);
     }
 
-    Vector3f RandomVelocity;
-    RandomVelocity.InitRandom(m_minVelocity, m_maxVelocity);
-    Velocity += RandomVelocity;
+    Velocity += Random.NextVector3f(m_minVelocity, m_maxVelocity);
     firework.SetVelocity(Velocity);
 
     // We use a mass of one in all cases (no point having fireworks
@@ -164,19 +162,30 @@ void PhysicsSystem::InitFireworksConfig()
         0.95f // damping
     );
 
-    Create(1, 1, NULL);
+    SpawnFireworks(1, 1, NULL);
 }
 
 
-void PhysicsSystem::Create(int Type, uint Count, OgldevPhysics::Firework* pFirework)
+uint PhysicsSystem::SpawnFireworks(int Type, uint Count, const Firework* pParent)
 {
-    for (uint i = 0; i < Count; i++) {
-        OgldevPhysics::FireworkConfig& Config = m_fireworkConfigs[Type - 1];
-        Config.Create(m_fireworks[m_nextFirework], pFirework);
-        m_nextFirework = (m_nextFirework + 1) % m_fireworks.size();
-    }
-}
+    assert((Type > 0) && (Type <= (int)m_fireworkConfigs.size()));
+
+    const FireworkConfig& Config = m_fireworkConfigs[Type - 1];
 
+    uint NumSpawned = 0;
 
+    for (; NumSpawned < Count; NumSpawned++) {
+        Firework* pFirework = m_fireworks.Alloc();
 
-}
\ No newline at end of file
+        // The pool is full - drop the rest of the burst
+        if (!pFirework) {
+            break;
+        }
+
+        Config.Create(*pFirework, m_random, pParent);
+    }
+
+    return NumSpawned;
+}
+
+}
@@ -0,0 +1,162 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gpu_particle_system.h"
+
+namespace OgldevPhysics
+{
+
+// Must match local_size_x in particles_integrate.cs
+#define GPU_PARTICLES_WORK_GROUP_SIZE 256
+
+
+GPUParticleSystem::~GPUParticleSystem()
+{
+    if (m_buffers[0] != 0) {
+        glDeleteBuffers(ARRAY_SIZE_IN_ELEMENTS(m_buffers), m_buffers);
+    }
+
+    if (m_vao != 0) {
+        glDeleteVertexArrays(1, &m_vao);
+    }
+}
+
+
+bool GPUParticleSystem::Init(uint MaxParticles)
+{
+    if (!m_technique.Init()) {
+        printf("%s:%d - error initializing the GPU particles technique\n", __FILE__, __LINE__);
+        return false;
+    }
+
+    m_maxParticles = MaxParticles;
+
+    GLsizeiptr BufSize = MaxParticles * sizeof(Vector4f);
+
+    glCreateBuffers(ARRAY_SIZE_IN_ELEMENTS(m_buffers), m_buffers);
+
+    for (int i = 0; i < NUM_BUFFERS; i++) {
+        glNamedBufferData(m_buffers[i], BufSize, NULL, GL_DYNAMIC_COPY);
+    }
+
+    // The position SSBO doubles as the vertex buffer for rendering
+    glGenVertexArrays(1, &m_vao);
+    glBindVertexArray(m_vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_buffers[POSITION_BUFFER]);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(0);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return true;
+}
+
+
+void GPUParticleSystem::SetAnchoredSpring(const Vector3f& Anchor, float SpringConstant, float RestLength)
+{
+    m_springEnabled = true;
+    m_springAnchor = Anchor;
+    m_springConstant = SpringConstant;
+    m_springRestLength = RestLength;
+}
+
+
+void GPUParticleSystem::Upload(const Particle* pParticles, uint NumParticles)
+{
+    if (NumParticles > m_maxParticles) {
+        printf("%s:%d - exceeded max number of GPU particles (%d > %d)\n", __FILE__, __LINE__, NumParticles, m_maxParticles);
+        exit(1);
+    }
+
+    std::vector<Vector4f> Positions(NumParticles);
+    std::vector<Vector4f> Velocities(NumParticles);
+    std::vector<Vector4f> Accelerations(NumParticles);
+
+    for (uint i = 0; i < NumParticles; i++) {
+        const Particle& p = pParticles[i];
+        Positions[i] = Vector4f(p.GetPosition(), p.GetReciprocalMass());
+        Velocities[i] = Vector4f(p.GetVelocity(), p.GetDamping());
+        Accelerations[i] = Vector4f(p.GetAcceleration(), 0.0f);
+    }
+
+    GLsizeiptr Size = NumParticles * sizeof(Vector4f);
+
+    glNamedBufferSubData(m_buffers[POSITION_BUFFER], 0, Size, Positions.data());
+    glNamedBufferSubData(m_buffers[VELOCITY_BUFFER], 0, Size, Velocities.data());
+    glNamedBufferSubData(m_buffers[ACCELERATION_BUFFER], 0, Size, Accelerations.data());
+
+    m_numParticles = NumParticles;
+}
+
+
+void GPUParticleSystem::Download(Particle* pParticles, uint NumParticles)
+{
+    assert(NumParticles <= m_numParticles);
+
+    std::vector<Vector4f> Positions(NumParticles);
+    std::vector<Vector4f> Velocities(NumParticles);
+
+    GLsizeiptr Size = NumParticles * sizeof(Vector4f);
+
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    glGetNamedBufferSubData(m_buffers[POSITION_BUFFER], 0, Size, Positions.data());
+    glGetNamedBufferSubData(m_buffers[VELOCITY_BUFFER], 0, Size, Velocities.data());
+
+    for (uint i = 0; i < NumParticles; i++) {
+        pParticles[i].SetPosition(Positions[i].x, Positions[i].y, Positions[i].z);
+        pParticles[i].SetVelocity(Vector3f(Velocities[i].x, Velocities[i].y, Velocities[i].z));
+    }
+}
+
+
+void GPUParticleSystem::Update(float dt)
+{
+    if (m_numParticles == 0) {
+        return;
+    }
+
+    m_technique.Enable();
+    m_technique.SetNumParticles(m_numParticles);
+    m_technique.SetDeltaTime(dt);
+    m_technique.SetGravity(m_gravityEnabled, m_gravity);
+    m_technique.SetDrag(m_dragEnabled, m_dragK1, m_dragK2);
+    m_technique.SetAnchoredSpring(m_springEnabled, m_springAnchor, m_springConstant, m_springRestLength);
+
+    for (int i = 0; i < NUM_BUFFERS; i++) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, m_buffers[i]);
+    }
+
+    uint NumGroups = (m_numParticles + GPU_PARTICLES_WORK_GROUP_SIZE - 1) / GPU_PARTICLES_WORK_GROUP_SIZE;
+
+    glDispatchCompute(NumGroups, 1, 1);
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+
+void GPUParticleSystem::Render()
+{
+    glBindVertexArray(m_vao);
+    glDrawArrays(GL_POINTS, 0, m_numParticles);
+    glBindVertexArray(0);
+}
+
+}
@@ -0,0 +1,94 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gpu_particle_technique.h"
+
+namespace OgldevPhysics
+{
+
+GPUParticleTechnique::GPUParticleTechnique()
+{
+}
+
+
+bool GPUParticleTechnique::Init()
+{
+    if (!Technique::Init()) {
+        return false;
+    }
+
+    if (!AddShader(GL_COMPUTE_SHADER, "../Physics/Shaders/particles_integrate.cs")) {
+        return false;
+    }
+
+    if (!Finalize()) {
+        return false;
+    }
+
+    GET_UNIFORM_AND_CHECK(m_numParticlesLoc, "gNumParticles");
+    GET_UNIFORM_AND_CHECK(m_dtLoc, "gDeltaTime");
+    GET_UNIFORM_AND_CHECK(m_gravityEnabledLoc, "gGravityEnabled");
+    GET_UNIFORM_AND_CHECK(m_gravityLoc, "gGravity");
+    GET_UNIFORM_AND_CHECK(m_dragEnabledLoc, "gDragEnabled");
+    GET_UNIFORM_AND_CHECK(m_dragK1Loc, "gDragK1");
+    GET_UNIFORM_AND_CHECK(m_dragK2Loc, "gDragK2");
+    GET_UNIFORM_AND_CHECK(m_springEnabledLoc, "gSpringEnabled");
+    GET_UNIFORM_AND_CHECK(m_springAnchorLoc, "gSpringAnchor");
+    GET_UNIFORM_AND_CHECK(m_springConstantLoc, "gSpringConstant");
+    GET_UNIFORM_AND_CHECK(m_springRestLengthLoc, "gSpringRestLength");
+
+    return true;
+}
+
+
+void GPUParticleTechnique::SetNumParticles(uint NumParticles)
+{
+    glUniform1ui(m_numParticlesLoc, NumParticles);
+}
+
+
+void GPUParticleTechnique::SetDeltaTime(float dt)
+{
+    glUniform1f(m_dtLoc, dt);
+}
+
+
+void GPUParticleTechnique::SetGravity(bool Enabled, const Vector3f& Gravity)
+{
+    glUniform1i(m_gravityEnabledLoc, Enabled);
+    glUniform3f(m_gravityLoc, Gravity.x, Gravity.y, Gravity.z);
+}
+
+
+void GPUParticleTechnique::SetDrag(bool Enabled, float k1, float k2)
+{
+    glUniform1i(m_dragEnabledLoc, Enabled);
+    glUniform1f(m_dragK1Loc, k1);
+    glUniform1f(m_dragK2Loc, k2);
+}
+
+
+void GPUParticleTechnique::SetAnchoredSpring(bool Enabled, const Vector3f& Anchor, float SpringConstant, float RestLength)
+{
+    glUniform1i(m_springEnabledLoc, Enabled);
+    glUniform3f(m_springAnchorLoc, Anchor.x, Anchor.y, Anchor.z);
+    glUniform1f(m_springConstantLoc, SpringConstant);
+    glUniform1f(m_springRestLengthLoc, RestLength);
+}
+
+}
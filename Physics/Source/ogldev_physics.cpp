@@ -25,11 +25,16 @@ namespace OgldevPhysics
 
 void PhysicsSystem::Init(uint NumObjects, uint MaxContacts, uint Iterations)
 {
-    m_particles.resize(NumObjects);
-    m_numParticles = 0;
+    m_particles.Init(NumObjects);
 
-    m_fireworks.resize(NumObjects);
-    m_numFireworks = 0;
+    m_sleeping.assign(NumObjects, 0);
+    m_sleepPos.resize(NumObjects);
+    m_sleepTimer.assign(NumObjects, 0.0f);
+    m_sleepThreshold.assign(NumObjects, 0.0f);
+    m_islandParent.resize(NumObjects);
+    m_islandOfParticle.assign(NumObjects, 0);
+
+    m_fireworks.Init(NumObjects);
 
     InitFireworksConfig();
 
@@ -45,38 +50,59 @@ void PhysicsSystem::Init(uint NumObjects, uint MaxContacts, uint Iterations)
 
 Particle* PhysicsSystem::AllocParticle()
 {
-    if (m_numParticles == m_particles.size()) {
-        printf("%s:%d - exceeded max number of particles\n", __FILE__, __LINE__);
+    Particle* ret = m_particles.Alloc();
+
+    if (!ret) {
+        printf("%s:%d - exceeded max number of particles (%d)\n", __FILE__, __LINE__, m_particles.GetCapacity());
         exit(1);
     }
 
-    Particle* ret = &m_particles[m_numParticles];
-    m_numParticles++;
+    uint Index = m_particles.GetIndex(ret);
+    m_sleeping[Index] = 0;
+    m_sleepTimer[Index] = 0.0f;
+    m_sleepThreshold[Index] = 0.0f;
 
     return ret;
 }
 
 
+void PhysicsSystem::FreeParticle(Particle* pParticle)
+{
+    m_sleeping[m_particles.GetIndex(pParticle)] = 0;
+
+    m_particles.Free(pParticle);
+}
+
+
 Firework* PhysicsSystem::AllocFirework()
 {
-    if (m_numFireworks == m_fireworks.size()) {
-        printf("%s:%d - exceeded max number of fireworks\n", __FILE__, __LINE__);
+    Firework* ret = m_fireworks.Alloc();
+
+    if (!ret) {
+        printf("%s:%d - exceeded max number of fireworks (%d)\n", __FILE__, __LINE__, m_fireworks.GetCapacity());
         exit(1);
     }
 
-    Firework* ret = &m_fireworks[m_numFireworks];
-    m_numFireworks++;
-
     return ret;
 }
 
 
+void PhysicsSystem::FreeFirework(Firework* pFirework)
+{
+    m_fireworks.Free(pFirework);
+}
+
+
 void PhysicsSystem::Update(long long DeltaTimeMillis)
 {
     assert(DeltaTimeMillis >= 0.0f);
 
     float dt = (float)DeltaTimeMillis / 1000.0f;
 
+    if (m_sleepingEnabled) {
+        CheckExternalWakeUps();
+    }
+
     StartFrame();
 
   //  m_forceRegistry.Update(dt);
@@ -86,6 +112,11 @@ void PhysicsSystem::Update(long long DeltaTimeMillis)
     //FireworkUpdate(dt);
     
     uint UsedContacts = GenerateContacts();
+
+    if (m_sleepingEnabled) {
+        UsedContacts = FilterSleepingContacts(UsedContacts);
+    }
+
    // printf("used contacts %d\n", UsedContacts);
     if (UsedContacts) {
         if (m_calcIters) {
@@ -94,42 +125,49 @@ void PhysicsSystem::Update(long long DeltaTimeMillis)
 
         m_resolver.ResolveContacts(m_contacts, UsedContacts, dt);
     }
+
+    if (m_sleepingEnabled) {
+        UpdateIslands(dt);
+    }
 }
 
 
 void PhysicsSystem::ParticleUpdate(float dt)
 {
-    for (uint i = 0; i < m_numParticles; i++) {
-        m_particles[i].Integrate(dt);
+    for (uint i = 0; i < m_particles.GetNumAlive(); i++) {
+        if (!m_sleeping[m_particles.GetAliveIndex(i)]) {
+            m_particles.GetAlive(i).Integrate(dt);
+        }
     }
 }
 
 
 void PhysicsSystem::FireworkUpdate(float dt)
 {
- //   printf("Update fireworks dt %f\n", dt);
-
-    bool Finished = true;
-    for (uint i = 0; i < m_numFireworks; i++) {
-        OgldevPhysics::Firework& firework = m_fireworks[i];
-        int Type = firework.GetType();
-        //    printf("%d type %d\n", i, Type);
-        if (Type > 0) {
-            Finished = false;
-            if (firework.Update(dt)) {
-                //  printf("remove\n");
-                OgldevPhysics::FireworkConfig& Config = m_fireworkConfigs[Type - 1];
-                firework.SetType(0);
-
-                for (int j = 0; j < Config.m_payloads.size(); j++) {
-                    //     printf("payload %d\n", j);
-                    Create(Config.m_payloads[j].m_type, Config.m_payloads[j].m_count, &firework);
-                }
-                //   printf("---\n");
-            }
-            else {
-                //        printf("dont remove\n");
-            }
+    m_expiredFireworks.clear();
+
+    uint i = 0;
+
+    while (i < m_fireworks.GetNumAlive()) {
+        Firework& firework = m_fireworks.GetAlive(i);
+
+        // Type zero is a firework which was allocated but not launched yet
+        if ((firework.GetType() > 0) && firework.Update(dt)) {
+            // Keep a copy for spawning the payloads and recycle the slot.
+            // Freeing moves the last live firework into position 'i' so we don't advance.
+            m_expiredFireworks.push_back(firework);
+            m_fireworks.Free(&firework);
+        } else {
+            i++;
+        }
+    }
+
+    for (uint j = 0; j < m_expiredFireworks.size(); j++) {
+        const Firework& Parent = m_expiredFireworks[j];
+        const FireworkConfig& Config = m_fireworkConfigs[Parent.GetType() - 1];
+
+        for (uint k = 0; k < Config.m_payloads.size(); k++) {
+            SpawnFireworks(Config.m_payloads[k].m_type, Config.m_payloads[k].m_count, &Parent);
         }
     }
 }
@@ -137,8 +175,8 @@ void PhysicsSystem::FireworkUpdate(float dt)
 
 void PhysicsSystem::StartFrame()
 {
-    for (uint i = 0; i < m_numParticles; i++) {
-        m_particles[i].ClearAccum(); // Also called from Particle::Integrate !!!
+    for (uint i = 0; i < m_particles.GetNumAlive(); i++) {
+        m_particles.GetAlive(i).ClearAccum(); // Also called from Particle::Integrate !!!
     }
 }
 
@@ -156,6 +194,8 @@ void PhysicsSystem::AddContactGenerator(ParticleContactGenerator* pContactGenera
 #else
     m_contactGenerators.push_back(pContactGenerator);
 #endif
+
+    pContactGenerator->SetPhysicsSystem(this);
 }
 
 
@@ -166,6 +206,16 @@ uint PhysicsSystem::GenerateContacts()
     int NextContactIndex = 0;
 
     for (size_t i = 0; i < m_contactGenerators.size(); i++) {
+        if (m_sleepingEnabled) {
+            Particle* pParticles[2] = { NULL, NULL };
+            uint NumParticles = m_contactGenerators[i]->GetParticles(pParticles);
+
+            // Links between sleeping particles don't need to be checked
+            if ((NumParticles > 0) && IsSleeping(pParticles[0]) && ((NumParticles == 1) || IsSleeping(pParticles[1]))) {
+                continue;
+            }
+        }
+
         uint UsedContacts = m_contactGenerators[i]->AddContact(m_contacts, NextContactIndex);
       //  printf("used %d\n", UsedContacts);
         Limit -= UsedContacts;
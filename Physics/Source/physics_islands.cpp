@@ -0,0 +1,290 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <float.h>
+#include <algorithm>
+
+#include "ogldev_physics.h"
+
+namespace OgldevPhysics
+{
+
+void PhysicsSystem::EnableSleeping(bool Enabled, float VelocityThreshold, float SleepTime)
+{
+    m_sleepingEnabled = Enabled;
+    m_sleepVelocityThreshold = VelocityThreshold;
+    m_sleepTime = SleepTime;
+
+    if (!Enabled) {
+        std::fill(m_sleeping.begin(), m_sleeping.end(), 0);
+        std::fill(m_sleepTimer.begin(), m_sleepTimer.end(), 0.0f);
+    }
+}
+
+
+bool PhysicsSystem::IsSleeping(const Particle* pParticle) const
+{
+    if (!pParticle || !m_particles.Contains(pParticle)) {
+        return false;
+    }
+
+    return m_sleeping[m_particles.GetIndex(pParticle)] != 0;
+}
+
+
+void PhysicsSystem::WakeParticle(Particle* pParticle)
+{
+    if (IsSleeping(pParticle)) {
+        WakeIsland(m_islandOfParticle[m_particles.GetIndex(pParticle)]);
+    }
+}
+
+
+void PhysicsSystem::SetSleepThreshold(Particle* pParticle, float VelocityThreshold)
+{
+    m_sleepThreshold[m_particles.GetIndex(pParticle)] = VelocityThreshold;
+}
+
+
+void PhysicsSystem::WakeIsland(uint Island)
+{
+    for (uint i = m_islandOffsets[Island]; i < m_islandOffsets[Island + 1]; i++) {
+        uint Index = m_islandMembers[i];
+        m_sleeping[Index] = 0;
+        m_sleepTimer[Index] = 0.0f;
+    }
+}
+
+
+// Anything the application did to a sleeping particle since the last update wakes its island
+void PhysicsSystem::CheckExternalWakeUps()
+{
+    for (uint i = 0; i < m_particles.GetNumAlive(); i++) {
+        uint Index = m_particles.GetAliveIndex(i);
+
+        if (!m_sleeping[Index]) {
+            continue;
+        }
+
+        const Particle& p = m_particles[Index];
+        const Vector3f& Pos = p.GetPosition();
+        const Vector3f& Velocity = p.GetVelocity();
+        const Vector3f& Force = p.GetForceAccum();
+        const Vector3f& SleepPos = m_sleepPos[Index];
+
+        bool Moved = (Pos.x != SleepPos.x) || (Pos.y != SleepPos.y) || (Pos.z != SleepPos.z);
+        bool HasVelocity = (Velocity.x != 0.0f) || (Velocity.y != 0.0f) || (Velocity.z != 0.0f);
+        bool HasForce = (Force.x != 0.0f) || (Force.y != 0.0f) || (Force.z != 0.0f);
+
+        if (Moved || HasVelocity || HasForce) {
+            WakeIsland(m_islandOfParticle[Index]);
+        }
+    }
+}
+
+
+// Drops the contacts between sleeping particles (or a sleeping particle and the
+// world) and wakes the islands which are touched by an awake particle.
+uint PhysicsSystem::FilterSleepingContacts(uint NumContacts)
+{
+    uint NumKept = 0;
+
+    for (uint i = 0; i < NumContacts; i++) {
+        ParticleContact& Contact = m_contacts[i];
+
+        bool Sleeping0 = IsSleeping(Contact.m_pParticles[0]);
+        bool Sleeping1 = Contact.m_pParticles[1] ? IsSleeping(Contact.m_pParticles[1]) : true;
+
+        if (Sleeping0 && Sleeping1) {
+            continue;
+        }
+
+        if (Sleeping0) {
+            WakeParticle(Contact.m_pParticles[0]);
+        } else if (Contact.m_pParticles[1] && Sleeping1) {
+            WakeParticle(Contact.m_pParticles[1]);
+        }
+
+        if (NumKept != i) {
+            m_contacts[NumKept] = Contact;
+        }
+
+        NumKept++;
+    }
+
+    m_numUsedContacts = NumKept;
+
+    return NumKept;
+}
+
+
+uint PhysicsSystem::FindIsland(uint Index)
+{
+    while (m_islandParent[Index] != Index) {
+        m_islandParent[Index] = m_islandParent[m_islandParent[Index]];  // path halving
+        Index = m_islandParent[Index];
+    }
+
+    return Index;
+}
+
+
+void PhysicsSystem::UnionIslands(const Particle* pParticle0, const Particle* pParticle1)
+{
+    if (!pParticle0 || !pParticle1 || !m_particles.Contains(pParticle0) || !m_particles.Contains(pParticle1)) {
+        return;
+    }
+
+    uint Root0 = FindIsland(m_particles.GetIndex(pParticle0));
+    uint Root1 = FindIsland(m_particles.GetIndex(pParticle1));
+
+    if (Root0 != Root1) {
+        m_islandParent[Root1] = Root0;
+    }
+}
+
+
+void PhysicsSystem::UpdateIslands(float dt)
+{
+    uint NumAlive = m_particles.GetNumAlive();
+
+    for (uint i = 0; i < NumAlive; i++) {
+        uint Index = m_particles.GetAliveIndex(i);
+        m_islandParent[Index] = Index;
+    }
+
+    // Permanent connections
+    for (uint i = 0; i < m_contactGenerators.size(); i++) {
+        Particle* pParticles[2] = { NULL, NULL };
+
+        if (m_contactGenerators[i]->GetParticles(pParticles) == 2) {
+            UnionIslands(pParticles[0], pParticles[1]);
+        }
+    }
+
+    // Contacts of this frame
+    for (uint i = 0; i < m_numUsedContacts; i++) {
+        UnionIslands(m_contacts[i].m_pParticles[0], m_contacts[i].m_pParticles[1]);
+    }
+
+    // Group the particles by island (counting sort on the root)
+    std::vector<uint> Roots(NumAlive);
+
+    for (uint i = 0; i < NumAlive; i++) {
+        Roots[i] = FindIsland(m_particles.GetAliveIndex(i));
+    }
+
+    uint NumIslands = 0;
+
+    for (uint i = 0; i < NumAlive; i++) {
+        uint Index = m_particles.GetAliveIndex(i);
+
+        if (Roots[i] == Index) {
+            m_islandOfParticle[Index] = NumIslands;
+            NumIslands++;
+        }
+    }
+
+    m_islandOffsets.assign(NumIslands + 1, 0);
+
+    for (uint i = 0; i < NumAlive; i++) {
+        uint Index = m_particles.GetAliveIndex(i);
+        m_islandOfParticle[Index] = m_islandOfParticle[Roots[i]];
+        m_islandOffsets[m_islandOfParticle[Index] + 1]++;
+    }
+
+    for (uint i = 0; i < NumIslands; i++) {
+        m_islandOffsets[i + 1] += m_islandOffsets[i];
+    }
+
+    m_islandMembers.resize(NumAlive);
+    std::vector<uint> NextSlot(m_islandOffsets.begin(), m_islandOffsets.end() - 1);
+
+    for (uint i = 0; i < NumAlive; i++) {
+        uint Index = m_particles.GetAliveIndex(i);
+        m_islandMembers[NextSlot[m_islandOfParticle[Index]]++] = Index;
+    }
+
+    // Sleep timers and per island decision
+    m_stats = PhysicsStats();
+    m_stats.m_numIslands = NumIslands;
+
+    for (uint Island = 0; Island < NumIslands; Island++) {
+        uint Start = m_islandOffsets[Island];
+        uint End = m_islandOffsets[Island + 1];
+
+        float Threshold = FLT_MAX;
+
+        for (uint i = Start; i < End; i++) {
+            float ParticleThreshold = m_sleepThreshold[m_islandMembers[i]];
+            Threshold = std::min(Threshold, (ParticleThreshold > 0.0f) ? ParticleThreshold : m_sleepVelocityThreshold);
+        }
+
+        float Threshold2 = Threshold * Threshold;
+
+        bool AllSleeping = true;
+        float MinTimer = FLT_MAX;
+
+        for (uint i = Start; i < End; i++) {
+            uint Index = m_islandMembers[i];
+
+            if (m_sleeping[Index]) {
+                continue;
+            }
+
+            AllSleeping = false;
+
+            const Particle& p = m_particles[Index];
+
+            if (p.GetVelocity().Dot(p.GetVelocity()) < Threshold2) {
+                m_sleepTimer[Index] += dt;
+            } else {
+                m_sleepTimer[Index] = 0.0f;
+            }
+
+            MinTimer = std::min(MinTimer, m_sleepTimer[Index]);
+        }
+
+        if (!AllSleeping && (MinTimer >= m_sleepTime)) {
+            for (uint i = Start; i < End; i++) {
+                uint Index = m_islandMembers[i];
+                Particle& p = m_particles[Index];
+                p.SetVelocity(Vector3f(0.0f, 0.0f, 0.0f));
+                p.ClearAccum();
+                m_sleepPos[Index] = p.GetPosition();
+                m_sleeping[Index] = 1;
+            }
+
+            AllSleeping = true;
+        }
+
+        if (AllSleeping) {
+            m_stats.m_numSleepingIslands++;
+        }
+    }
+
+    for (uint i = 0; i < NumAlive; i++) {
+        if (m_sleeping[m_particles.GetAliveIndex(i)]) {
+            m_stats.m_numSleepingParticles++;
+        } else {
+            m_stats.m_numAwakeParticles++;
+        }
+    }
+}
+
+}
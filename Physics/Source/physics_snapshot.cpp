@@ -0,0 +1,368 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <algorithm>
+
+#include "ogldev_physics.h"
+#include "physics_snapshot.h"
+
+namespace OgldevPhysics
+{
+
+#define PHYSICS_SNAPSHOT_MAGIC   0x5348504F // 'OPHS'
+#define PHYSICS_SNAPSHOT_VERSION 3
+
+#define PHYSICS_REPLAY_MAGIC     0x5250504F // 'OPPR'
+#define PHYSICS_REPLAY_VERSION   1
+
+
+void PhysicsSystem::SaveSnapshot(std::vector<char>& Blob) const
+{
+    Blob.clear();
+
+    SnapshotWriter Writer(Blob);
+
+    Writer.Write((uint)PHYSICS_SNAPSHOT_MAGIC);
+    Writer.Write((uint)PHYSICS_SNAPSHOT_VERSION);
+
+    m_particles.Save(Writer);
+    m_fireworks.Save(Writer);
+
+    Writer.Write(m_random.GetState());
+    Writer.Write(m_resolver.GetIterations());
+    Writer.Write(m_calcIters);
+
+    Writer.Write((uint)m_contactGenerators.size());
+
+    for (uint i = 0; i < m_contactGenerators.size(); i++) {
+        m_contactGenerators[i]->SaveParams(Writer);
+    }
+
+    Writer.Write(m_sleepingEnabled);
+    Writer.Write(m_sleepVelocityThreshold);
+    Writer.Write(m_sleepTime);
+    Writer.WriteVector(m_sleeping);
+    Writer.WriteVector(m_sleepPos);
+    Writer.WriteVector(m_sleepTimer);
+    Writer.WriteVector(m_sleepThreshold);
+    Writer.WriteVector(m_islandOffsets);
+    Writer.WriteVector(m_islandMembers);
+    Writer.WriteVector(m_islandOfParticle);
+}
+
+
+// LoadParams changes the generators directly so their current parameters are
+// saved first and put back if the rest of the snapshot turns out to be invalid
+static void RestoreGeneratorParams(std::vector<ParticleContactGenerator*>& Generators, const std::vector<char>& Backup)
+{
+    SnapshotReader Reader(Backup.data(), Backup.size());
+
+    for (uint i = 0; i < Generators.size(); i++) {
+        Generators[i]->LoadParams(Reader);
+    }
+}
+
+
+// The sleep state is indexed by the particle slot and the islands are indexed by
+// the values of IslandOfParticle so their sizes must match before they are used
+static bool IsSleepStateValid(uint Capacity, const std::vector<char>& Sleeping, const std::vector<Vector3f>& SleepPos,
+                              const std::vector<float>& SleepTimer, const std::vector<float>& SleepThreshold,
+                              const std::vector<uint>& IslandOffsets, const std::vector<uint>& IslandMembers,
+                              const std::vector<uint>& IslandOfParticle)
+{
+    if ((Sleeping.size() != Capacity) || (SleepPos.size() != Capacity) || (SleepTimer.size() != Capacity) ||
+        (SleepThreshold.size() != Capacity) || (IslandOfParticle.size() != Capacity)) {
+        return false;
+    }
+
+    // No islands were built yet - nothing can be sleeping
+    if (IslandOffsets.empty()) {
+        return IslandMembers.empty() && (std::find(Sleeping.begin(), Sleeping.end(), 1) == Sleeping.end());
+    }
+
+    uint NumIslands = (uint)IslandOffsets.size() - 1;
+
+    if ((IslandOffsets[0] != 0) || (IslandOffsets[NumIslands] != IslandMembers.size())) {
+        return false;
+    }
+
+    for (uint i = 0; i < NumIslands; i++) {
+        if (IslandOffsets[i] > IslandOffsets[i + 1]) {
+            return false;
+        }
+    }
+
+    for (uint i = 0; i < IslandMembers.size(); i++) {
+        if (IslandMembers[i] >= Capacity) {
+            return false;
+        }
+    }
+
+    for (uint i = 0; i < Capacity; i++) {
+        if (Sleeping[i] && (IslandOfParticle[i] >= NumIslands)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Nothing is changed unless the entire snapshot is valid
+bool PhysicsSystem::RestoreSnapshot(const std::vector<char>& Blob)
+{
+    SnapshotReader Reader(Blob.data(), Blob.size());
+
+    uint Magic = 0;
+    uint Version = 0;
+
+    if (!Reader.Read(Magic) || !Reader.Read(Version) ||
+        (Magic != PHYSICS_SNAPSHOT_MAGIC) || (Version != PHYSICS_SNAPSHOT_VERSION)) {
+        printf("%s:%d - invalid physics snapshot header\n", __FILE__, __LINE__);
+        return false;
+    }
+
+    ObjectPool<Particle> Particles;
+    ObjectPool<Firework> Fireworks;
+
+    if (!Particles.Load(Reader, m_particles.GetCapacity()) || !Fireworks.Load(Reader, m_fireworks.GetCapacity())) {
+        printf("%s:%d - physics snapshot doesn't match the particle/firework capacity\n", __FILE__, __LINE__);
+        return false;
+    }
+
+    uint RandomState = 0;
+    int Iterations = 0;
+    bool CalcIters = false;
+    uint NumContactGenerators = 0;
+
+    Reader.Read(RandomState);
+    Reader.Read(Iterations);
+    Reader.Read(CalcIters);
+    Reader.Read(NumContactGenerators);
+
+    if (!Reader.IsOK() || (NumContactGenerators != m_contactGenerators.size())) {
+        printf("%s:%d - physics snapshot doesn't match the contact generators\n", __FILE__, __LINE__);
+        return false;
+    }
+
+    std::vector<char> GeneratorBackup;
+    SnapshotWriter BackupWriter(GeneratorBackup);
+
+    for (uint i = 0; i < m_contactGenerators.size(); i++) {
+        m_contactGenerators[i]->SaveParams(BackupWriter);
+    }
+
+    for (uint i = 0; i < m_contactGenerators.size(); i++) {
+        if (!m_contactGenerators[i]->LoadParams(Reader)) {
+            printf("%s:%d - error loading the params of contact generator %d\n", __FILE__, __LINE__, i);
+            RestoreGeneratorParams(m_contactGenerators, GeneratorBackup);
+            return false;
+        }
+    }
+
+    bool SleepingEnabled = false;
+    float SleepVelocityThreshold = 0.0f;
+    float SleepTime = 0.0f;
+    std::vector<char> Sleeping;
+    std::vector<Vector3f> SleepPos;
+    std::vector<float> SleepTimer;
+    std::vector<float> SleepThreshold;
+    std::vector<uint> IslandOffsets;
+    std::vector<uint> IslandMembers;
+    std::vector<uint> IslandOfParticle;
+
+    Reader.Read(SleepingEnabled);
+    Reader.Read(SleepVelocityThreshold);
+    Reader.Read(SleepTime);
+    Reader.ReadVector(Sleeping);
+    Reader.ReadVector(SleepPos);
+    Reader.ReadVector(SleepTimer);
+    Reader.ReadVector(SleepThreshold);
+    Reader.ReadVector(IslandOffsets);
+    Reader.ReadVector(IslandMembers);
+    Reader.ReadVector(IslandOfParticle);
+
+    if (!Reader.IsOK() || !Reader.IsAtEnd()) {
+        printf("%s:%d - physics snapshot is truncated or has trailing data\n", __FILE__, __LINE__);
+        RestoreGeneratorParams(m_contactGenerators, GeneratorBackup);
+        return false;
+    }
+
+    if (!IsSleepStateValid(m_particles.GetCapacity(), Sleeping, SleepPos, SleepTimer, SleepThreshold,
+                           IslandOffsets, IslandMembers, IslandOfParticle)) {
+        printf("%s:%d - physics snapshot has an invalid sleep/island state\n", __FILE__, __LINE__);
+        RestoreGeneratorParams(m_contactGenerators, GeneratorBackup);
+        return false;
+    }
+
+    m_particles.CopyFrom(Particles);
+    m_fireworks.CopyFrom(Fireworks);
+
+    m_random.SetState(RandomState);
+    m_resolver.SetIterations(Iterations);
+    m_calcIters = CalcIters;
+
+    m_sleepingEnabled = SleepingEnabled;
+    m_sleepVelocityThreshold = SleepVelocityThreshold;
+    m_sleepTime = SleepTime;
+    m_sleeping.swap(Sleeping);
+    m_sleepPos.swap(SleepPos);
+    m_sleepTimer.swap(SleepTimer);
+    m_sleepThreshold.swap(SleepThreshold);
+    m_islandOffsets.swap(IslandOffsets);
+    m_islandMembers.swap(IslandMembers);
+    m_islandOfParticle.swap(IslandOfParticle);
+
+    return true;
+}
+
+
+void PhysicsReplay::StartRecording(const PhysicsSystem& System)
+{
+    System.SaveSnapshot(m_initialSnapshot);
+    m_steps.clear();
+    m_events.clear();
+}
+
+
+void PhysicsReplay::RecordEvent(uint Type, const void* pData, uint Size)
+{
+    ReplayEvent Event;
+    Event.m_step = (uint)m_steps.size();
+    Event.m_type = Type;
+    Event.m_data.assign((const char*)pData, (const char*)pData + Size);
+
+    m_events.push_back(Event);
+}
+
+
+void PhysicsReplay::RecordStep(PhysicsSystem& System, long long DeltaTimeMillis)
+{
+    m_steps.push_back(DeltaTimeMillis);
+
+    System.Update(DeltaTimeMillis);
+}
+
+
+void PhysicsReplay::StartPlayback(PhysicsSystem& System)
+{
+    if (!System.RestoreSnapshot(m_initialSnapshot)) {
+        printf("%s:%d - unable to restore the initial state of the replay\n", __FILE__, __LINE__);
+        exit(1);
+    }
+
+    m_playbackStep = 0;
+    m_playbackEvent = 0;
+}
+
+
+bool PhysicsReplay::PlaybackStep(PhysicsSystem& System, EventCallback pCallback, void* pUserData)
+{
+    if (m_playbackStep >= m_steps.size()) {
+        return false;
+    }
+
+    while ((m_playbackEvent < m_events.size()) && (m_events[m_playbackEvent].m_step == m_playbackStep)) {
+        if (pCallback) {
+            const ReplayEvent& Event = m_events[m_playbackEvent];
+            pCallback(Event.m_type, Event.m_data, pUserData);
+        }
+
+        m_playbackEvent++;
+    }
+
+    System.Update(m_steps[m_playbackStep]);
+
+    m_playbackStep++;
+
+    return true;
+}
+
+
+bool PhysicsReplay::SaveToFile(const char* pFilename) const
+{
+    std::vector<char> Blob;
+    SnapshotWriter Writer(Blob);
+
+    Writer.Write((uint)PHYSICS_REPLAY_MAGIC);
+    Writer.Write((uint)PHYSICS_REPLAY_VERSION);
+    Writer.WriteVector(m_initialSnapshot);
+    Writer.WriteVector(m_steps);
+    Writer.Write((uint)m_events.size());
+
+    for (uint i = 0; i < m_events.size(); i++) {
+        Writer.Write(m_events[i].m_step);
+        Writer.Write(m_events[i].m_type);
+        Writer.WriteVector(m_events[i].m_data);
+    }
+
+    WriteBinaryFile(pFilename, Blob.data(), (int)Blob.size());
+
+    return true;
+}
+
+
+bool PhysicsReplay::LoadFromFile(const char* pFilename)
+{
+    int Size = 0;
+    char* pData = ReadBinaryFile(pFilename, Size);
+
+    if (!pData) {
+        return false;
+    }
+
+    SnapshotReader Reader(pData, Size);
+
+    uint Magic = 0;
+    uint Version = 0;
+    uint NumEvents = 0;
+
+    Reader.Read(Magic);
+    Reader.Read(Version);
+
+    bool ret = (Magic == PHYSICS_REPLAY_MAGIC) && (Version == PHYSICS_REPLAY_VERSION);
+
+    if (ret) {
+        Reader.ReadVector(m_initialSnapshot);
+        Reader.ReadVector(m_steps);
+        Reader.Read(NumEvents);
+
+        m_events.clear();
+
+        for (uint i = 0; (i < NumEvents) && Reader.IsOK(); i++) {
+            ReplayEvent Event;
+            Reader.Read(Event.m_step);
+            Reader.Read(Event.m_type);
+            Reader.ReadVector(Event.m_data);
+            m_events.push_back(Event);
+        }
+
+        ret = Reader.IsOK();
+    }
+
+    if (!ret) {
+        printf("%s:%d - invalid physics replay file '%s'\n", __FILE__, __LINE__, pFilename);
+    }
+
+    free(pData);
+
+    return ret;
+}
+
+}
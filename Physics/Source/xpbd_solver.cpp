@@ -0,0 +1,390 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <algorithm>
+
+#include "xpbd_solver.h"
+
+// The constraints of a single color don't share particles so they can be
+// solved concurrently. Build with OpenMP (/openmp or -fopenmp) to enable it.
+
+namespace OgldevPhysics
+{
+
+// Constraints that don't fit into the parallel colors go here and are solved serially
+#define XPBD_MAX_COLORS 64
+#define XPBD_SERIAL_COLOR (XPBD_MAX_COLORS - 1)
+
+
+void XPBDSolver::Init(uint NumSubSteps, uint NumIterations)
+{
+    assert(NumSubSteps > 0);
+    assert(NumIterations > 0);
+
+    m_numSubSteps = NumSubSteps;
+    m_numIterations = NumIterations;
+}
+
+
+uint XPBDSolver::AddParticle(Particle* pParticle)
+{
+    assert(pParticle);
+
+    m_particles.push_back(pParticle);
+
+    m_pos.push_back(pParticle->GetPosition());
+    m_prevPos.push_back(pParticle->GetPosition());
+    m_vel.push_back(pParticle->GetVelocity());
+    m_externalAccel.push_back(Vector3f(0.0f, 0.0f, 0.0f));
+    m_reciprocalMass.push_back(pParticle->GetReciprocalMass());
+
+    return (uint)m_particles.size() - 1;
+}
+
+
+void XPBDSolver::AddDistanceConstraint(uint Index0, uint Index1, float Compliance)
+{
+    assert(Index0 < m_particles.size());
+    assert(Index1 < m_particles.size());
+
+    Constraint c;
+    c.m_index[0] = Index0;
+    c.m_index[1] = Index1;
+    c.m_restLength = (m_particles[Index0]->GetPosition() - m_particles[Index1]->GetPosition()).Length();
+    c.m_compliance = Compliance;
+    c.m_type = CONSTRAINT_TYPE_DISTANCE;
+
+    m_constraints.push_back(c);
+    m_colorsDirty = true;
+}
+
+
+void XPBDSolver::AddBendingConstraint(uint Index0, uint Index1, uint Index2, float Compliance)
+{
+    assert(Index0 < m_particles.size());
+    assert(Index1 < m_particles.size());
+    assert(Index2 < m_particles.size());
+
+    const Vector3f& p0 = m_particles[Index0]->GetPosition();
+    const Vector3f& p1 = m_particles[Index1]->GetPosition();
+    const Vector3f& p2 = m_particles[Index2]->GetPosition();
+
+    Vector3f Centroid = (p0 + p1 + p2) / 3.0f;
+
+    Constraint c;
+    c.m_index[0] = Index0;
+    c.m_index[1] = Index1;
+    c.m_index[2] = Index2;
+    c.m_restLength = (p1 - Centroid).Length();
+    c.m_compliance = Compliance;
+    c.m_type = CONSTRAINT_TYPE_BENDING;
+
+    m_constraints.push_back(c);
+    m_colorsDirty = true;
+}
+
+
+void XPBDSolver::AddPlaneConstraint(const Vector3f& Normal, float Dist, float Friction)
+{
+    PlaneConstraint p;
+    p.m_normal = Normal;
+    p.m_normal.Normalize();
+    p.m_dist = Dist;
+    p.m_friction = Friction;
+
+    m_planes.push_back(p);
+}
+
+
+void XPBDSolver::BuildColors()
+{
+    uint NumParticles = (uint)m_particles.size();
+    uint NumConstraints = (uint)m_constraints.size();
+
+    // Greedy coloring - each constraint takes the first color which is not used
+    // by any of its particles.
+    std::vector<uint64_t> UsedColors(NumParticles, 0);
+    std::vector<uint> Colors(NumConstraints);
+    std::vector<uint> ColorCount(XPBD_MAX_COLORS, 0);
+
+    for (uint i = 0; i < NumConstraints; i++) {
+        const Constraint& c = m_constraints[i];
+        uint NumIndices = (c.m_type == CONSTRAINT_TYPE_BENDING) ? 3 : 2;
+        uint64_t Used = 0;
+
+        for (uint j = 0; j < NumIndices; j++) {
+            Used |= UsedColors[c.m_index[j]];
+        }
+
+        uint Color = 0;
+
+        while ((Color < XPBD_SERIAL_COLOR) && (Used & (1ULL << Color))) {
+            Color++;
+        }
+
+        Colors[i] = Color;
+        ColorCount[Color]++;
+
+        for (uint j = 0; j < NumIndices; j++) {
+            UsedColors[c.m_index[j]] |= (1ULL << Color);
+        }
+    }
+
+    uint NumColors = 0;
+
+    for (uint i = 0; i < XPBD_MAX_COLORS; i++) {
+        if (ColorCount[i] > 0) {
+            NumColors = i + 1;
+        }
+    }
+
+    m_colorOffsets.resize(NumColors + 1);
+    m_colorOffsets[0] = 0;
+
+    for (uint i = 0; i < NumColors; i++) {
+        m_colorOffsets[i + 1] = m_colorOffsets[i] + ColorCount[i];
+    }
+
+    // Counting sort of the constraints by color
+    std::vector<uint> NextSlot(m_colorOffsets.begin(), m_colorOffsets.end() - 1);
+    std::vector<Constraint> Sorted(NumConstraints);
+
+    for (uint i = 0; i < NumConstraints; i++) {
+        Sorted[NextSlot[Colors[i]]++] = m_constraints[i];
+    }
+
+    m_constraints.swap(Sorted);
+    m_lambdas.resize(NumConstraints);
+
+    m_colorsDirty = false;
+}
+
+
+void XPBDSolver::Update(float dt)
+{
+    if (m_particles.empty() || (dt <= 0.0f)) {
+        return;
+    }
+
+    if (m_colorsDirty) {
+        BuildColors();
+    }
+
+    LoadParticles();
+
+    float SubStepDt = dt / (float)m_numSubSteps;
+
+    for (uint i = 0; i < m_numSubSteps; i++) {
+        SubStep(SubStepDt);
+    }
+
+    StoreParticles();
+}
+
+
+void XPBDSolver::LoadParticles()
+{
+    for (uint i = 0; i < m_particles.size(); i++) {
+        Particle* p = m_particles[i];
+        m_pos[i] = p->GetPosition();
+        m_vel[i] = p->GetVelocity();
+        m_reciprocalMass[i] = p->GetReciprocalMass();
+        m_externalAccel[i] = p->GetAcceleration() + p->GetForceAccum() * m_reciprocalMass[i];
+    }
+}
+
+
+void XPBDSolver::StoreParticles()
+{
+    for (uint i = 0; i < m_particles.size(); i++) {
+        Particle* p = m_particles[i];
+        p->SetPosition(m_pos[i]);
+        p->SetVelocity(m_vel[i]);
+        p->ClearAccum();
+    }
+}
+
+
+void XPBDSolver::SubStep(float dt)
+{
+    int NumParticles = (int)m_particles.size();
+
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+    for (int i = 0; i < NumParticles; i++) {
+        m_prevPos[i] = m_pos[i];
+
+        if (m_reciprocalMass[i] > 0.0f) {
+            m_vel[i] += m_externalAccel[i] * dt;
+            m_pos[i] += m_vel[i] * dt;
+        }
+    }
+
+    std::fill(m_lambdas.begin(), m_lambdas.end(), 0.0f);
+
+    for (uint i = 0; i < m_numIterations; i++) {
+        SolveConstraints(dt);
+        SolvePlanes();
+    }
+
+    float Damping = powf(m_damping, dt);
+    float ReciprocalDt = 1.0f / dt;
+
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+    for (int i = 0; i < NumParticles; i++) {
+        m_vel[i] = (m_pos[i] - m_prevPos[i]) * (ReciprocalDt * Damping);
+    }
+}
+
+
+void XPBDSolver::SolveConstraints(float dt)
+{
+    float ReciprocalDt2 = 1.0f / (dt * dt);
+
+    uint NumColors = GetNumColors();
+
+    for (uint Color = 0; Color < NumColors; Color++) {
+        int Start = (int)m_colorOffsets[Color];
+        int End = (int)m_colorOffsets[Color + 1];
+#ifdef _OPENMP
+        bool Parallel = (Color != XPBD_SERIAL_COLOR);
+
+        #pragma omp parallel for if(Parallel)
+#endif
+        for (int i = Start; i < End; i++) {
+            const Constraint& c = m_constraints[i];
+            float Alpha = c.m_compliance * ReciprocalDt2;
+
+            if (c.m_type == CONSTRAINT_TYPE_BENDING) {
+                SolveBending(c, m_lambdas[i], Alpha);
+            } else {
+                SolveDistance(c, m_lambdas[i], Alpha);
+            }
+        }
+    }
+}
+
+
+void XPBDSolver::SolveDistance(const Constraint& c, float& Lambda, float Alpha)
+{
+    uint i0 = c.m_index[0];
+    uint i1 = c.m_index[1];
+
+    float w0 = m_reciprocalMass[i0];
+    float w1 = m_reciprocalMass[i1];
+    float TotalW = w0 + w1 + Alpha;
+
+    if (TotalW <= 0.0f) {
+        return;
+    }
+
+    Vector3f Delta = m_pos[i0] - m_pos[i1];
+    float Len = Delta.Length();
+
+    if (Len <= 0.0f) {
+        return;
+    }
+
+    float C = Len - c.m_restLength;
+    float DeltaLambda = (-C - Alpha * Lambda) / TotalW;
+    Lambda += DeltaLambda;
+
+    Vector3f Correction = Delta * (DeltaLambda / Len);
+
+    m_pos[i0] += Correction * w0;
+    m_pos[i1] -= Correction * w1;
+}
+
+
+// C = |x1 - centroid| - rest. With n = (x1 - centroid) / |x1 - centroid| the
+// gradients are -n/3 for the two ends and 2n/3 for the middle particle.
+void XPBDSolver::SolveBending(const Constraint& c, float& Lambda, float Alpha)
+{
+    uint i0 = c.m_index[0];
+    uint i1 = c.m_index[1];
+    uint i2 = c.m_index[2];
+
+    float w0 = m_reciprocalMass[i0];
+    float w1 = m_reciprocalMass[i1];
+    float w2 = m_reciprocalMass[i2];
+    float TotalW = (w0 + w2) / 9.0f + w1 * (4.0f / 9.0f) + Alpha;
+
+    if (TotalW <= 0.0f) {
+        return;
+    }
+
+    Vector3f Centroid = (m_pos[i0] + m_pos[i1] + m_pos[i2]) / 3.0f;
+    Vector3f Delta = m_pos[i1] - Centroid;
+    float Len = Delta.Length();
+
+    // Straight triplet with a straight rest state - nothing to correct and no direction
+    if (Len <= 1e-6f) {
+        return;
+    }
+
+    float C = Len - c.m_restLength;
+    float DeltaLambda = (-C - Alpha * Lambda) / TotalW;
+    Lambda += DeltaLambda;
+
+    Vector3f Correction = Delta * (DeltaLambda / (3.0f * Len));
+
+    m_pos[i0] -= Correction * w0;
+    m_pos[i1] += Correction * (2.0f * w1);
+    m_pos[i2] -= Correction * w2;
+}
+
+
+void XPBDSolver::SolvePlanes()
+{
+    int NumParticles = (int)m_particles.size();
+
+    for (uint p = 0; p < m_planes.size(); p++) {
+        const PlaneConstraint& Plane = m_planes[p];
+
+#ifdef _OPENMP
+        #pragma omp parallel for
+#endif
+        for (int i = 0; i < NumParticles; i++) {
+            if (m_reciprocalMass[i] <= 0.0f) {
+                continue;
+            }
+
+            float C = m_pos[i].Dot(Plane.m_normal) - Plane.m_dist;
+
+            if (C >= 0.0f) {
+                continue;
+            }
+
+            m_pos[i] -= Plane.m_normal * C;
+
+            // Static friction - cancel part of the tangential motion during the sub step
+            if (Plane.m_friction > 0.0f) {
+                Vector3f Move = m_pos[i] - m_prevPos[i];
+                Vector3f Tangent = Move - Plane.m_normal * Move.Dot(Plane.m_normal);
+                m_pos[i] -= Tangent * std::min(Plane.m_friction, 1.0f);
+            }
+        }
+    }
+}
+
+}
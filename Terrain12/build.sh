@@ -5,13 +5,28 @@ CC=g++
 CPPFLAGS=`pkg-config --cflags glew glfw3 assimp`
 CPPFLAGS="$CPPFLAGS -I$OGLDEV_DIR/Include -I$OGLDEV_DIR/Common/3rdparty/ImGui/GLFW -ggdb3"
 LDFLAGS=`pkg-config --libs glew glfw3 assimp`
-LDFLAGS="$LDFLAGS -lX11 -ldl -lmeshoptimizer"
+LDFLAGS="$LDFLAGS -lX11 -ldl -lmeshoptimizer -lpthread"
+# Optional compression of the tiled height map:
+# CPPFLAGS="$CPPFLAGS -DOGLDEV_LZ4 -DOGLDEV_ZSTD"
+# LDFLAGS="$LDFLAGS -llz4 -lzstd"
 SOURCES="terrain_demo12.cpp \
 	geomip_grid.cpp \
+	geomip_cull_technique.cpp \
+	clipmap_grid.cpp \
+	clipmap_technique.cpp \
+	clipmap_benchmark.cpp \
+	terrain_maps.cpp \
+	terrain_maps_technique.cpp \
+	heightfield_queries.cpp \
 	terrain_technique.cpp \
 	midpoint_disp_terrain.cpp \
 	terrain.cpp \
 	lod_manager.cpp \
+	lod_benchmark.cpp \
+	tiled_heightmap.cpp \
+	terrain_pager.cpp \
+	tiled_terrain.cpp \
+	paging_benchmark.cpp \
 	$OGLDEV_DIR/Common/ogldev_util.cpp \
 	$OGLDEV_DIR/Common/math_3d.cpp \
 	$OGLDEV_DIR/Common/ogldev_basic_glfw_camera.cpp \
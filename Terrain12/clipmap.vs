@@ -0,0 +1,85 @@
+#version 330
+
+// Geometry clipmap vertex shader (see ClipmapGrid). The same grid of vertices
+// is used by all the levels, the heights come from the toroidal height texture.
+
+layout (location = 0) in vec2 GridPos;     // local vertex coordinates in [0, gGridSize]
+
+uniform mat4 gVP;
+uniform float gMinHeight;
+uniform float gMaxHeight;
+
+uniform sampler2DArray gClipmap;
+uniform int gGridSize;
+uniform int gTextureSize;
+uniform float gTransitionWidth;     // in vertices
+uniform float gTexScale;            // world XZ to texture coordinates
+
+uniform int gLayer;
+uniform ivec2 gLevelOrigin;         // level coordinates of vertex (0, 0)
+uniform ivec2 gTexOrigin;           // where vertex (0, 0) lives in the toroidal texture
+uniform float gLevelSpacing;        // world distance between two vertices of the level
+uniform bool gMorph;
+
+out vec4 Color;
+out vec2 Tex;
+out vec3 WorldPos;
+out vec3 Normal;
+
+
+// p is a local vertex coordinate in [-1, gGridSize + 1]
+float GetHeight(ivec2 p)
+{
+    ivec2 t = (gTexOrigin + p + gTextureSize) % gTextureSize;
+    return texelFetch(gClipmap, ivec3(t, gLayer), 0).r;
+}
+
+
+void main()
+{
+    ivec2 p = ivec2(GridPos);
+
+    float Height = GetHeight(p);
+
+    // Near the outer edge of the level the heights are blended into the ones of the
+    // next coarser level. On the edge itself the odd vertices are exactly on the
+    // coarser triangles so there are no cracks between the levels.
+    if (gMorph) {
+        vec2 d = abs(GridPos - vec2(gGridSize / 2));
+        float Dist = max(d.x, d.y);
+        float Alpha = clamp((Dist - (float(gGridSize / 2) - gTransitionWidth - 1.0)) / gTransitionWidth, 0.0, 1.0);
+
+        ivec2 e0 = p & ~1;
+        ivec2 e1 = e0 + (p & 1) * 2;
+
+        float CoarseHeight = 0.25 * (GetHeight(e0) + GetHeight(ivec2(e1.x, e0.y)) +
+                                     GetHeight(ivec2(e0.x, e1.y)) + GetHeight(e1));
+
+        Height = mix(Height, CoarseHeight, Alpha);
+    }
+
+    vec3 Position = vec3(float(gLevelOrigin.x + p.x) * gLevelSpacing,
+                         Height,
+                         float(gLevelOrigin.y + p.y) * gLevelSpacing);
+
+    gl_Position = gVP * vec4(Position, 1.0);
+
+    float DeltaHeight = gMaxHeight - gMinHeight;
+
+    float HeightRatio = (Position.y - gMinHeight) / DeltaHeight;
+
+    float c = HeightRatio * 0.8 + 0.2;
+
+    Color = vec4(c, c, c, 1.0);
+
+    Tex = Position.xz * gTexScale;
+
+    WorldPos = Position;
+
+    float Left   = GetHeight(p - ivec2(1, 0));
+    float Right  = GetHeight(p + ivec2(1, 0));
+    float Bottom = GetHeight(p - ivec2(0, 1));
+    float Top    = GetHeight(p + ivec2(0, 1));
+
+    Normal = normalize(vec3(Left - Right, 2.0 * gLevelSpacing, Bottom - Top));
+}
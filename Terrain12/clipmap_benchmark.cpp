@@ -0,0 +1,154 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include <GL/glew.h>
+
+#include "ogldev_basic_glfw_camera.h"
+#include "clipmap_benchmark.h"
+#include "midpoint_disp_terrain.h"
+
+#define CLIPMAP_BENCHMARK_PATCH_SIZE    17
+#define CLIPMAP_BENCHMARK_NUM_FRAMES    300
+#define CLIPMAP_BENCHMARK_WARMUP_FRAMES 10
+#define CLIPMAP_BENCHMARK_CAMERA_HEIGHT 30.0f
+
+struct RendererResult {
+    double GPUTimeMs = 0.0;
+    double SubmitTimeMicros = 0.0;
+    double NumTriangles = 0.0;
+    double NumDrawCalls = 0.0;
+};
+
+
+// A circle around the center of the terrain, looking along the path and slightly down
+static void SetBenchmarkCamera(MidpointDispTerrain& Terrain, BasicCamera& Camera, int Frame)
+{
+    float Center = Terrain.GetWorldSize() / 2.0f;
+    float Radius = Terrain.GetWorldSize() * 0.3f;
+    float Angle = (float)Frame / (float)CLIPMAP_BENCHMARK_NUM_FRAMES * 2.0f * (float)M_PI;
+
+    Vector3f Pos(Center + cosf(Angle) * Radius, 0.0f, Center + sinf(Angle) * Radius);
+    Pos = Terrain.ConstrainCameraPosToTerrain(Pos);
+    Pos.y += CLIPMAP_BENCHMARK_CAMERA_HEIGHT;
+
+    Camera.SetPosition(Pos);
+    Camera.SetTarget(Vector3f(-sinf(Angle), -0.15f, cosf(Angle)));
+    Camera.SetUp(0.0f, 1.0f, 0.0f);
+}
+
+
+static RendererResult MeasureRenderer(MidpointDispTerrain& Terrain, BasicCamera& Camera, TERRAIN_RENDERER Renderer)
+{
+    Terrain.SetRenderer(Renderer);
+
+    GLuint Queries[2];
+    glGenQueries(2, Queries);
+
+    RendererResult Result;
+
+    for (int Frame = -CLIPMAP_BENCHMARK_WARMUP_FRAMES ; Frame < CLIPMAP_BENCHMARK_NUM_FRAMES ; Frame++) {
+        SetBenchmarkCamera(Terrain, Camera, Frame);
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        glBeginQuery(GL_TIME_ELAPSED, Queries[0]);
+        glBeginQuery(GL_PRIMITIVES_GENERATED, Queries[1]);
+
+        Terrain.Render(Camera);
+
+        glEndQuery(GL_PRIMITIVES_GENERATED);
+        glEndQuery(GL_TIME_ELAPSED);
+
+        // Waits for the GPU - the frames are measured one at a time
+        GLuint64 GPUTime = 0;
+        GLuint NumPrimitives = 0;
+        glGetQueryObjectui64v(Queries[0], GL_QUERY_RESULT, &GPUTime);
+        glGetQueryObjectuiv(Queries[1], GL_QUERY_RESULT, &NumPrimitives);
+
+        if (Frame < 0) {
+            continue;
+        }
+
+        Result.GPUTimeMs += (double)GPUTime / 1000000.0;
+        Result.NumTriangles += (double)NumPrimitives;
+
+        if (Renderer == TERRAIN_RENDERER_CLIPMAP) {
+            const ClipmapRenderStats& Stats = Terrain.GetClipmap().GetRenderStats();
+            Result.SubmitTimeMicros += (double)Stats.SubmitTimeMicros;
+            Result.NumDrawCalls += (double)Stats.NumDrawCalls;
+        } else {
+            const GeomipRenderStats& Stats = Terrain.GetGeomipGrid().GetRenderStats();
+            Result.SubmitTimeMicros += (double)Stats.SubmitTimeMicros;
+            Result.NumDrawCalls += (double)Stats.NumDrawCalls;
+        }
+    }
+
+    glDeleteQueries(2, Queries);
+
+    Result.GPUTimeMs /= CLIPMAP_BENCHMARK_NUM_FRAMES;
+    Result.SubmitTimeMicros /= CLIPMAP_BENCHMARK_NUM_FRAMES;
+    Result.NumTriangles /= CLIPMAP_BENCHMARK_NUM_FRAMES;
+    Result.NumDrawCalls /= CLIPMAP_BENCHMARK_NUM_FRAMES;
+
+    return Result;
+}
+
+
+static void PrintResult(const char* pName, const RendererResult& Result)
+{
+    printf("    %-10s GPU %7.3f ms, CPU submit %8.1f us, %9.0f triangles, %7.1f draw calls per frame\n",
+           pName, Result.GPUTimeMs, Result.SubmitTimeMicros, Result.NumTriangles, Result.NumDrawCalls);
+}
+
+
+void ClipmapBenchmark(MidpointDispTerrain& Terrain, const PersProjInfo& ProjInfo)
+{
+    int TerrainSizes[] = { 513, 1025, 2049, 4097 };
+
+    BasicCamera Camera(ProjInfo, Vector3f(0.0f, 0.0f, 0.0f), Vector3f(0.0f, 0.0f, 1.0f), Vector3f(0.0f, 1.0f, 0.0f));
+
+    TERRAIN_RENDERER OrigRenderer = Terrain.GetRenderer();
+
+    Terrain.SetRenderSkydome(false);
+
+    for (int i = 0 ; i < (int)ARRAY_SIZE_IN_ELEMENTS(TerrainSizes) ; i++) {
+        int TerrainSize = TerrainSizes[i];
+
+        Terrain.Destroy();
+        Terrain.CreateMidpointDisplacementParallel(TerrainSize, CLIPMAP_BENCHMARK_PATCH_SIZE, 1.0f, 0.0f, 400.0f, 1);
+
+        RendererResult Geomip = MeasureRenderer(Terrain, Camera, TERRAIN_RENDERER_GEOMIP);
+        RendererResult Clipmap = MeasureRenderer(Terrain, Camera, TERRAIN_RENDERER_CLIPMAP);
+
+        const ClipmapGrid& Grid = Terrain.GetClipmap();
+
+        printf("%dx%d terrain (%d patches), clipmap %d levels of %dx%d, max error %.4f (geomip) %.4f (clipmap):\n",
+               TerrainSize, TerrainSize, Terrain.GetGeomipGrid().GetNumPatches(), Grid.GetNumLevels(),
+               Grid.GetGridSize(), Grid.GetGridSize(), Terrain.GetGeomipGrid().GetMaxError(), Grid.GetMaxError());
+
+        PrintResult("geomip", Geomip);
+        PrintResult("clipmap", Clipmap);
+    }
+
+    Terrain.SetRenderSkydome(true);
+    Terrain.SetRenderer(OrigRenderer);
+}
@@ -0,0 +1,35 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef CLIPMAP_BENCHMARK_H
+#define CLIPMAP_BENCHMARK_H
+
+#include "ogldev_math_3d.h"
+
+class MidpointDispTerrain;
+
+// Renders the same camera path with GeomipGrid and with ClipmapGrid on terrains
+// from 513x513 to 4097x4097 and prints the GPU time, the CPU submit time, the
+// number of triangles and the number of draw calls of each. The size of the
+// clipmap grid is derived from the error of the geomip LODs so that both
+// renderers have the same visual error. Needs a current GL context and a
+// terrain on which InitTerrain was already called.
+void ClipmapBenchmark(MidpointDispTerrain& Terrain, const PersProjInfo& ProjInfo);
+
+#endif
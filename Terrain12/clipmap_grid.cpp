@@ -0,0 +1,404 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "clipmap_grid.h"
+#include "terrain.h"
+#include "texture_config.h"
+
+#define CLIPMAP_MAX_GRID_SIZE  1024
+#define CLIPMAP_MAX_NUM_LEVELS 16
+
+
+ClipmapGrid::~ClipmapGrid()
+{
+    Destroy();
+}
+
+
+void ClipmapGrid::Destroy()
+{
+    if (m_vao > 0) {
+        glDeleteVertexArrays(1, &m_vao);
+    }
+
+    if (m_vb > 0) {
+        glDeleteBuffers(1, &m_vb);
+    }
+
+    if (m_ib > 0) {
+        glDeleteBuffers(1, &m_ib);
+    }
+
+    if (m_heightTexture > 0) {
+        glDeleteTextures(1, &m_heightTexture);
+    }
+
+    m_vao = 0;
+    m_vb = 0;
+    m_ib = 0;
+    m_heightTexture = 0;
+    m_levels.clear();
+}
+
+
+int ClipmapGrid::CalcGridSize(float MaxError)
+{
+    int GridSize = 8;
+
+    while ((4.0f / (float)GridSize > MaxError) && (GridSize < CLIPMAP_MAX_GRID_SIZE)) {
+        GridSize *= 2;
+    }
+
+    return GridSize;
+}
+
+
+int ClipmapGrid::CalcNumLevels(int GridSize, float WorldScale, float ViewDistance)
+{
+    int NumLevels = 1;
+    float HalfSize = (float)(GridSize / 2) * WorldScale;
+
+    while ((HalfSize < ViewDistance) && (NumLevels < CLIPMAP_MAX_NUM_LEVELS)) {
+        HalfSize *= 2.0f;
+        NumLevels++;
+    }
+
+    return NumLevels;
+}
+
+
+void ClipmapGrid::CreateClipmap(int GridSize, int NumLevels, const BaseTerrain* pTerrain)
+{
+    // The levels are snapped to even coordinates and the hole of a ring starts at GridSize / 4
+    if ((GridSize < 8) || (GridSize > CLIPMAP_MAX_GRID_SIZE) || ((GridSize & (GridSize - 1)) != 0)) {
+        printf("%s:%d - the clipmap grid size must be a power of two between 8 and %d (got %d)\n",
+               __FILE__, __LINE__, CLIPMAP_MAX_GRID_SIZE, GridSize);
+        exit(0);
+    }
+
+    if ((NumLevels < 1) || (NumLevels > CLIPMAP_MAX_NUM_LEVELS)) {
+        printf("%s:%d - invalid number of clipmap levels %d\n", __FILE__, __LINE__, NumLevels);
+        exit(0);
+    }
+
+    Destroy();
+
+    m_gridSize = GridSize;
+    // One extra height on each side for the normals
+    m_textureSize = GridSize + 3;
+    m_worldScale = pTerrain->GetWorldScale();
+    m_pTerrain = pTerrain;
+    m_levels.resize(NumLevels);
+
+    CreateGLState();
+
+    InitIndices();
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+
+void ClipmapGrid::CreateGLState()
+{
+    glGenVertexArrays(1, &m_vao);
+    glBindVertexArray(m_vao);
+
+    glGenBuffers(1, &m_vb);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vb);
+
+    std::vector<Vector2f> Vertices;
+    Vertices.reserve((m_gridSize + 1) * (m_gridSize + 1));
+
+    for (int z = 0 ; z <= m_gridSize ; z++) {
+        for (int x = 0 ; x <= m_gridSize ; x++) {
+            Vertices.push_back(Vector2f((float)x, (float)z));
+        }
+    }
+
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertices[0]) * Vertices.size(), Vertices.data(), GL_STATIC_DRAW);
+
+    int POS_LOC = 0;
+    glEnableVertexAttribArray(POS_LOC);
+    glVertexAttribPointer(POS_LOC, 2, GL_FLOAT, GL_FALSE, sizeof(Vector2f), (const void*)0);
+
+    glGenBuffers(1, &m_ib);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ib);
+
+    glGenTextures(1, &m_heightTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_heightTexture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_R32F, m_textureSize, m_textureSize, (int)m_levels.size());
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+
+void ClipmapGrid::InitIndices()
+{
+    std::vector<uint> Indices;
+
+    AddLayout(Indices, 0, -1, -1);
+
+    for (int HoleZ = 0 ; HoleZ < 2 ; HoleZ++) {
+        for (int HoleX = 0 ; HoleX < 2 ; HoleX++) {
+            AddLayout(Indices, 1 + HoleZ * 2 + HoleX, HoleX, HoleZ);
+        }
+    }
+
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Indices[0]) * Indices.size(), Indices.data(), GL_STATIC_DRAW);
+}
+
+
+// HoleX/HoleZ are the offset of the hole from GridSize / 4 (in quads) or -1 for the full grid
+void ClipmapGrid::AddLayout(std::vector<uint>& Indices, int Layout, int HoleX, int HoleZ)
+{
+    int HalfSize = m_gridSize / 2;
+    int HoleStartX = m_gridSize / 4 + HoleX;
+    int HoleStartZ = m_gridSize / 4 + HoleZ;
+    int NumVerticesX = m_gridSize + 1;
+
+    for (int Quadrant = 0 ; Quadrant < CLIPMAP_NUM_QUADRANTS ; Quadrant++) {
+        int StartX = (Quadrant & 1) * HalfSize;
+        int StartZ = (Quadrant >> 1) * HalfSize;
+
+        IndexRange& Range = m_ranges[Layout][Quadrant];
+        Range.Start = (int)Indices.size();
+
+        for (int z = StartZ ; z < StartZ + HalfSize ; z++) {
+            for (int x = StartX ; x < StartX + HalfSize ; x++) {
+                bool InHole = (HoleX >= 0) &&
+                              (x >= HoleStartX) && (x < HoleStartX + HalfSize) &&
+                              (z >= HoleStartZ) && (z < HoleStartZ + HalfSize);
+
+                if (InHole) {
+                    continue;
+                }
+
+                uint v00 = z * NumVerticesX + x;
+                uint v10 = v00 + 1;
+                uint v01 = v00 + NumVerticesX;
+                uint v11 = v01 + 1;
+
+                Indices.push_back(v00);
+                Indices.push_back(v01);
+                Indices.push_back(v11);
+
+                Indices.push_back(v00);
+                Indices.push_back(v11);
+                Indices.push_back(v10);
+            }
+        }
+
+        Range.Count = (int)Indices.size() - Range.Start;
+    }
+}
+
+
+void ClipmapGrid::InvalidateHeights()
+{
+    for (int i = 0 ; i < (int)m_levels.size() ; i++) {
+        m_levels[i].IsValid = false;
+    }
+}
+
+
+int ClipmapGrid::ToTexCoord(int LevelCoord) const
+{
+    return ((LevelCoord % m_textureSize) + m_textureSize) % m_textureSize;
+}
+
+
+void ClipmapGrid::UpdateLevel(int LevelIndex, const Vector3f& CameraPos)
+{
+    float Spacing = m_worldScale * (float)(1 << LevelIndex);
+
+    // Snapped to the vertices of the next coarser level
+    int OriginX = 2 * (int)floorf(CameraPos.x / (2.0f * Spacing)) - m_gridSize / 2;
+    int OriginZ = 2 * (int)floorf(CameraPos.z / (2.0f * Spacing)) - m_gridSize / 2;
+
+    Level& l = m_levels[LevelIndex];
+
+    int dx = OriginX - l.OriginX;
+    int dz = OriginZ - l.OriginZ;
+
+    // The layer holds the heights of [Origin - 1, Origin - 1 + m_textureSize)
+    if (!l.IsValid || (abs(dx) >= m_textureSize) || (abs(dz) >= m_textureSize)) {
+        UploadRegion(LevelIndex, OriginX - 1, OriginZ - 1, m_textureSize, m_textureSize);
+        l.OriginX = OriginX;
+        l.OriginZ = OriginZ;
+        l.IsValid = true;
+        return;
+    }
+
+    // The columns which entered the level
+    if (dx > 0) {
+        UploadRegion(LevelIndex, l.OriginX - 1 + m_textureSize, OriginZ - 1, dx, m_textureSize);
+    } else if (dx < 0) {
+        UploadRegion(LevelIndex, OriginX - 1, OriginZ - 1, -dx, m_textureSize);
+    }
+
+    // The rows which entered the level
+    if (dz > 0) {
+        UploadRegion(LevelIndex, OriginX - 1, l.OriginZ - 1 + m_textureSize, m_textureSize, dz);
+    } else if (dz < 0) {
+        UploadRegion(LevelIndex, OriginX - 1, OriginZ - 1, m_textureSize, -dz);
+    }
+
+    l.OriginX = OriginX;
+    l.OriginZ = OriginZ;
+}
+
+
+// Splits the region where it wraps around the edges of the toroidal texture
+void ClipmapGrid::UploadRegion(int LevelIndex, int StartX, int StartZ, int Width, int Depth)
+{
+    int Width0 = std::min(Width, m_textureSize - ToTexCoord(StartX));
+    int Depth0 = std::min(Depth, m_textureSize - ToTexCoord(StartZ));
+
+    UploadRect(LevelIndex, StartX, StartZ, Width0, Depth0);
+
+    if (Width0 < Width) {
+        UploadRect(LevelIndex, StartX + Width0, StartZ, Width - Width0, Depth0);
+    }
+
+    if (Depth0 < Depth) {
+        UploadRect(LevelIndex, StartX, StartZ + Depth0, Width0, Depth - Depth0);
+    }
+
+    if ((Width0 < Width) && (Depth0 < Depth)) {
+        UploadRect(LevelIndex, StartX + Width0, StartZ + Depth0, Width - Width0, Depth - Depth0);
+    }
+}
+
+
+void ClipmapGrid::UploadRect(int LevelIndex, int StartX, int StartZ, int Width, int Depth)
+{
+    int Step = 1 << LevelIndex;
+    int MaxCoord = m_pTerrain->GetSize() - 1;
+
+    m_uploadBuffer.resize(Width * Depth);
+
+    // The levels are point sampled so a vertex of a coarse level has exactly
+    // the height of the vertex of the finer level at the same position.
+    // Outside of the height map the edges are repeated.
+    for (int z = 0 ; z < Depth ; z++) {
+        int HeightMapZ = std::min(std::max((StartZ + z) * Step, 0), MaxCoord);
+
+        for (int x = 0 ; x < Width ; x++) {
+            int HeightMapX = std::min(std::max((StartX + x) * Step, 0), MaxCoord);
+            m_uploadBuffer[z * Width + x] = m_pTerrain->GetHeight(HeightMapX, HeightMapZ);
+        }
+    }
+
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, ToTexCoord(StartX), ToTexCoord(StartZ), LevelIndex,
+                    Width, Depth, 1, GL_RED, GL_FLOAT, m_uploadBuffer.data());
+
+    m_renderStats.NumTexelsUploaded += Width * Depth;
+}
+
+
+void ClipmapGrid::Render(const Vector3f& CameraPos, const Matrix4f& ViewProj, ClipmapTechnique& Tech)
+{
+    auto StartTime = std::chrono::high_resolution_clock::now();
+
+    m_renderStats = ClipmapRenderStats();
+
+    glActiveTexture(CLIPMAP_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_heightTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    for (int i = 0 ; i < (int)m_levels.size() ; i++) {
+        UpdateLevel(i, CameraPos);
+    }
+
+    float TexScale = m_pTerrain->GetTextureScale() / ((float)m_pTerrain->GetSize() * m_worldScale);
+    float TransitionWidth = (float)m_gridSize / 10.0f;
+    Tech.SetClipmapParams(m_gridSize, m_textureSize, TransitionWidth, TexScale);
+
+    FrustumCulling FC(ViewProj);
+
+    glBindVertexArray(m_vao);
+
+    for (int i = 0 ; i < (int)m_levels.size() ; i++) {
+        RenderLevel(i, FC, Tech);
+    }
+
+    glBindVertexArray(0);
+
+    auto EndTime = std::chrono::high_resolution_clock::now();
+    m_renderStats.SubmitTimeMicros = std::chrono::duration_cast<std::chrono::microseconds>(EndTime - StartTime).count();
+}
+
+
+void ClipmapGrid::RenderLevel(int LevelIndex, const FrustumCulling& FC, ClipmapTechnique& Tech)
+{
+    const Level& l = m_levels[LevelIndex];
+    float Spacing = m_worldScale * (float)(1 << LevelIndex);
+
+    int Layout = 0;
+
+    if (LevelIndex > 0) {
+        const Level& Finer = m_levels[LevelIndex - 1];
+        int HoleX = Finer.OriginX / 2 - l.OriginX - m_gridSize / 4;
+        int HoleZ = Finer.OriginZ / 2 - l.OriginZ - m_gridSize / 4;
+        assert((HoleX == 0 || HoleX == 1) && (HoleZ == 0 || HoleZ == 1));
+        Layout = 1 + HoleZ * 2 + HoleX;
+    }
+
+    // The coarsest level has no coarser level to blend into
+    bool Morph = LevelIndex < (int)m_levels.size() - 1;
+
+    Tech.SetLevel(LevelIndex, l.OriginX, l.OriginZ, ToTexCoord(l.OriginX), ToTexCoord(l.OriginZ), Spacing, Morph);
+
+    int HalfSize = m_gridSize / 2;
+
+    for (int Quadrant = 0 ; Quadrant < CLIPMAP_NUM_QUADRANTS ; Quadrant++) {
+        const IndexRange& Range = m_ranges[Layout][Quadrant];
+
+        if (Range.Count == 0) {
+            continue;
+        }
+
+        int StartX = l.OriginX + (Quadrant & 1) * HalfSize;
+        int StartZ = l.OriginZ + (Quadrant >> 1) * HalfSize;
+
+        Vector3f Min((float)StartX * Spacing, m_pTerrain->GetMinHeight(), (float)StartZ * Spacing);
+        Vector3f Max((float)(StartX + HalfSize) * Spacing, m_pTerrain->GetMaxHeight(), (float)(StartZ + HalfSize) * Spacing);
+
+        if (FC.TestBox(Min, Max) == FRUSTUM_OUTSIDE) {
+            continue;
+        }
+
+        glDrawElements(GL_TRIANGLES, Range.Count, GL_UNSIGNED_INT, (void*)(sizeof(uint) * Range.Start));
+
+        m_renderStats.NumDrawCalls++;
+        m_renderStats.NumTriangles += Range.Count / 3;
+    }
+}
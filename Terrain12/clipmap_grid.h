@@ -0,0 +1,136 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CLIPMAP_GRID_H
+#define CLIPMAP_GRID_H
+
+#include <GL/glew.h>
+#include <vector>
+
+#include "ogldev_math_3d.h"
+#include "clipmap_technique.h"
+
+// this header is included by terrain.h so we have a forward
+// declaration for BaseTerrain.
+class BaseTerrain;
+
+struct ClipmapRenderStats {
+    int NumDrawCalls = 0;
+    int NumTriangles = 0;
+    int NumTexelsUploaded = 0;      // heights which were streamed into the toroidal texture this frame
+    long long SubmitTimeMicros = 0; // CPU time of ClipmapGrid::Render, including the texture updates
+};
+
+//
+// Geometry clipmap renderer (Losasso & Hoppe, GPU Gems 2 chapter 2) as an
+// alternative to GeomipGrid. There are NumLevels nested square grids centered
+// on the camera. Every level has GridSize x GridSize quads and twice the vertex
+// spacing of the previous one. All the levels share a single vertex buffer
+// and the vertex shader fetches the heights from a layer of a texture array.
+// When the camera moves only the rows/columns which enter a level are uploaded
+// and the layer is addressed toroidally, so the cost per frame does not depend
+// on the size of the world.
+//
+// Level 0 is drawn as a full grid and every other level as a ring whose hole
+// is exactly the footprint of the previous level. Since a level is snapped to
+// the vertices of the next one the hole can only be in one of four positions
+// so there is an index range for each of them.
+//
+class ClipmapGrid {
+ public:
+    ClipmapGrid() {}
+
+    ~ClipmapGrid();
+
+    // GridSize is the number of quads along each side of a level and must be a power of two
+    void CreateClipmap(int GridSize, int NumLevels, const BaseTerrain* pTerrain);
+
+    void Destroy();
+
+    bool IsCreated() const { return m_vao != 0; }
+
+    // Expects the technique to be enabled
+    void Render(const Vector3f& CameraPos, const Matrix4f& ViewProj, ClipmapTechnique& Tech);
+
+    // Reloads the heights of all the levels on the next Render (after the height map was edited)
+    void InvalidateHeights();
+
+    int GetGridSize() const { return m_gridSize; }
+
+    int GetNumLevels() const { return (int)m_levels.size(); }
+
+    const ClipmapRenderStats& GetRenderStats() const { return m_renderStats; }
+
+    // Vertex spacing / distance from the camera of the coarsest vertices of the levels 1 and up
+    float GetMaxError() const { return 4.0f / (float)m_gridSize; }
+
+    // Smallest grid size whose error is not larger than MaxError
+    static int CalcGridSize(float MaxError);
+
+    // Number of levels required to cover ViewDistance
+    static int CalcNumLevels(int GridSize, float WorldScale, float ViewDistance);
+
+ private:
+
+    struct Level {
+        int OriginX = 0;        // level coordinates of the first vertex
+        int OriginZ = 0;
+        bool IsValid = false;   // false until the entire layer is loaded
+    };
+
+    struct IndexRange {
+        int Start = 0;
+        int Count = 0;
+    };
+
+    // The full grid and the four rings, every one of them split into quadrants for the frustum culling
+    #define CLIPMAP_NUM_LAYOUTS   5
+    #define CLIPMAP_NUM_QUADRANTS 4
+
+    void CreateGLState();
+
+    void InitIndices();
+
+    void AddLayout(std::vector<uint>& Indices, int Layout, int HoleX, int HoleZ);
+
+    void UpdateLevel(int LevelIndex, const Vector3f& CameraPos);
+
+    void UploadRegion(int LevelIndex, int StartX, int StartZ, int Width, int Depth);
+
+    void UploadRect(int LevelIndex, int StartX, int StartZ, int Width, int Depth);
+
+    int ToTexCoord(int LevelCoord) const;
+
+    void RenderLevel(int LevelIndex, const FrustumCulling& FC, ClipmapTechnique& Tech);
+
+    int m_gridSize = 0;
+    int m_textureSize = 0;
+    float m_worldScale = 1.0f;
+    const BaseTerrain* m_pTerrain = NULL;
+    std::vector<Level> m_levels;
+    IndexRange m_ranges[CLIPMAP_NUM_LAYOUTS][CLIPMAP_NUM_QUADRANTS];
+    std::vector<float> m_uploadBuffer;
+    ClipmapRenderStats m_renderStats;
+
+    GLuint m_vao = 0;
+    GLuint m_vb = 0;
+    GLuint m_ib = 0;
+    GLuint m_heightTexture = 0;     // GL_TEXTURE_2D_ARRAY, one layer per level
+};
+
+#endif
@@ -0,0 +1,71 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ogldev_util.h"
+#include "clipmap_technique.h"
+#include "texture_config.h"
+
+
+ClipmapTechnique::ClipmapTechnique()
+{
+}
+
+bool ClipmapTechnique::Init()
+{
+    if (!InitTerrainProgram("clipmap.vs")) {
+        return false;
+    }
+
+    GET_UNIFORM_AND_CHECK(m_clipmapUnitLoc, "gClipmap");
+    GET_UNIFORM_AND_CHECK(m_gridSizeLoc, "gGridSize");
+    GET_UNIFORM_AND_CHECK(m_textureSizeLoc, "gTextureSize");
+    GET_UNIFORM_AND_CHECK(m_transitionWidthLoc, "gTransitionWidth");
+    GET_UNIFORM_AND_CHECK(m_texScaleLoc, "gTexScale");
+    GET_UNIFORM_AND_CHECK(m_layerLoc, "gLayer");
+    GET_UNIFORM_AND_CHECK(m_levelOriginLoc, "gLevelOrigin");
+    GET_UNIFORM_AND_CHECK(m_texOriginLoc, "gTexOrigin");
+    GET_UNIFORM_AND_CHECK(m_levelSpacingLoc, "gLevelSpacing");
+    GET_UNIFORM_AND_CHECK(m_morphLoc, "gMorph");
+
+    Enable();
+
+    glUniform1i(m_clipmapUnitLoc, CLIPMAP_TEXTURE_UNIT_INDEX);
+
+    glUseProgram(0);
+
+    return true;
+}
+
+
+void ClipmapTechnique::SetClipmapParams(int GridSize, int TextureSize, float TransitionWidth, float TexScale)
+{
+    glUniform1i(m_gridSizeLoc, GridSize);
+    glUniform1i(m_textureSizeLoc, TextureSize);
+    glUniform1f(m_transitionWidthLoc, TransitionWidth);
+    glUniform1f(m_texScaleLoc, TexScale);
+}
+
+
+void ClipmapTechnique::SetLevel(int Layer, int OriginX, int OriginZ, int TexOriginX, int TexOriginZ, float Spacing, bool Morph)
+{
+    glUniform1i(m_layerLoc, Layer);
+    glUniform2i(m_levelOriginLoc, OriginX, OriginZ);
+    glUniform2i(m_texOriginLoc, TexOriginX, TexOriginZ);
+    glUniform1f(m_levelSpacingLoc, Spacing);
+    glUniform1i(m_morphLoc, Morph ? 1 : 0);
+}
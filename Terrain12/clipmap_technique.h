@@ -0,0 +1,52 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CLIPMAP_TECHNIQUE_H
+#define CLIPMAP_TECHNIQUE_H
+
+#include "terrain_technique.h"
+
+// clipmap.vs + terrain.fs. The fragment shader uniforms are the same as the ones of TerrainTechnique.
+class ClipmapTechnique : public TerrainTechnique
+{
+public:
+
+    ClipmapTechnique();
+
+    virtual bool Init();
+
+    // TextureSize is the size of a layer of the toroidal height texture, TexScale maps world XZ to texture coordinates
+    void SetClipmapParams(int GridSize, int TextureSize, float TransitionWidth, float TexScale);
+
+    // Origin is the level coordinate of the first vertex and TexOrigin is where it lives in the toroidal texture
+    void SetLevel(int Layer, int OriginX, int OriginZ, int TexOriginX, int TexOriginZ, float Spacing, bool Morph);
+
+private:
+    GLuint m_clipmapUnitLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_gridSizeLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_textureSizeLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_transitionWidthLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_texScaleLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_layerLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_levelOriginLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_texOriginLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_levelSpacingLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_morphLoc = INVALID_UNIFORM_LOCATION;
+};
+
+#endif  /* CLIPMAP_TECHNIQUE_H */
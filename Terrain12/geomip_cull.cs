@@ -0,0 +1,109 @@
+#version 430
+
+// GPU version of LodManager::Update and of the frustum culling in GeomipGrid::Render.
+// Writes one draw command per patch. Culled patches get an instance count of zero
+// so the commands don't need to be compacted. Must be kept in sync with the CPU code.
+
+layout (local_size_x = 64) in;
+
+uniform int gNumPatchesX;
+uniform int gNumPatchesZ;
+uniform int gWidth;
+uniform int gPatchSize;
+uniform float gWorldScale;
+
+uniform int gMaxLod;
+uniform float gLodRegions[16];
+
+uniform vec3 gCameraPos;
+
+// A point p is inside the frustum when dot(Plane, vec4(p, 1)) >= 0 for all the planes
+uniform vec4 gPlanes[6];
+
+struct PatchBounds {
+    vec4 Min;
+    vec4 Max;
+};
+
+layout(std430, binding=0) readonly buffer PatchBoundsBuffer {
+    PatchBounds Bounds[];
+};
+
+// GeomipGrid::m_lodInfo - Start/Count for each [Core][Left][Right][Top][Bottom]
+layout(std430, binding=1) readonly buffer LodInfoBuffer {
+    ivec2 LodInfo[];
+};
+
+struct DrawElementsIndirectCommand {
+    uint Count;
+    uint InstanceCount;
+    uint FirstIndex;
+    int BaseVertex;
+    uint BaseInstance;
+};
+
+layout(std430, binding=2) writeonly buffer DrawCommandsBuffer {
+    DrawElementsIndirectCommand Commands[];
+};
+
+
+int CalcCoreLod(int PatchX, int PatchZ)
+{
+    int CenterStep = gPatchSize / 2;
+
+    float x = float(PatchX * (gPatchSize - 1) + CenterStep) * gWorldScale;
+    float z = float(PatchZ * (gPatchSize - 1) + CenterStep) * gWorldScale;
+
+    float Distance = distance(gCameraPos, vec3(x, 0.0, z));
+
+    for (int i = 0 ; i <= gMaxLod ; i++) {
+        if (Distance < gLodRegions[i]) {
+            return i;
+        }
+    }
+
+    return gMaxLod;
+}
+
+
+bool IsInsideFrustum(PatchBounds b)
+{
+    for (int i = 0 ; i < 6 ; i++) {
+        // The corner of the box which is furthest along the plane normal
+        vec3 p = mix(b.Min.xyz, b.Max.xyz, greaterThanEqual(gPlanes[i].xyz, vec3(0.0)));
+
+        if (dot(gPlanes[i], vec4(p, 1.0)) < 0.0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+void main()
+{
+    int Index = int(gl_GlobalInvocationID.x);
+
+    if (Index >= gNumPatchesX * gNumPatchesZ) {
+        return;
+    }
+
+    int PatchX = Index % gNumPatchesX;
+    int PatchZ = Index / gNumPatchesX;
+
+    int C = CalcCoreLod(PatchX, PatchZ);
+
+    int L = ((PatchX > 0) && (CalcCoreLod(PatchX - 1, PatchZ) > C)) ? 1 : 0;
+    int R = ((PatchX < gNumPatchesX - 1) && (CalcCoreLod(PatchX + 1, PatchZ) > C)) ? 1 : 0;
+    int B = ((PatchZ > 0) && (CalcCoreLod(PatchX, PatchZ - 1) > C)) ? 1 : 0;
+    int T = ((PatchZ < gNumPatchesZ - 1) && (CalcCoreLod(PatchX, PatchZ + 1) > C)) ? 1 : 0;
+
+    ivec2 Info = LodInfo[C * 16 + L * 8 + R * 4 + T * 2 + B];
+
+    Commands[Index].Count = uint(Info.y);
+    Commands[Index].InstanceCount = IsInsideFrustum(Bounds[Index]) ? 1u : 0u;
+    Commands[Index].FirstIndex = uint(Info.x);
+    Commands[Index].BaseVertex = PatchZ * (gPatchSize - 1) * gWidth + PatchX * (gPatchSize - 1);
+    Commands[Index].BaseInstance = 0u;
+}
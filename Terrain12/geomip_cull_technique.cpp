@@ -0,0 +1,88 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <vector>
+
+#include "ogldev_util.h"
+#include "geomip_cull_technique.h"
+
+
+GeomipCullTechnique::GeomipCullTechnique()
+{
+}
+
+bool GeomipCullTechnique::Init()
+{
+    if (!Technique::Init()) {
+        return false;
+    }
+
+    if (!AddShader(GL_COMPUTE_SHADER, "geomip_cull.cs")) {
+        return false;
+    }
+
+    if (!Finalize()) {
+        return false;
+    }
+
+    GET_UNIFORM_AND_CHECK(m_numPatchesXLoc, "gNumPatchesX");
+    GET_UNIFORM_AND_CHECK(m_numPatchesZLoc, "gNumPatchesZ");
+    GET_UNIFORM_AND_CHECK(m_widthLoc, "gWidth");
+    GET_UNIFORM_AND_CHECK(m_patchSizeLoc, "gPatchSize");
+    GET_UNIFORM_AND_CHECK(m_worldScaleLoc, "gWorldScale");
+    GET_UNIFORM_AND_CHECK(m_maxLodLoc, "gMaxLod");
+    GET_UNIFORM_AND_CHECK(m_lodRegionsLoc, "gLodRegions");
+    GET_UNIFORM_AND_CHECK(m_cameraPosLoc, "gCameraPos");
+    GET_UNIFORM_AND_CHECK(m_planesLoc, "gPlanes");
+
+    return true;
+}
+
+
+void GeomipCullTechnique::SetGrid(int NumPatchesX, int NumPatchesZ, int Width, int PatchSize, float WorldScale)
+{
+    glUniform1i(m_numPatchesXLoc, NumPatchesX);
+    glUniform1i(m_numPatchesZLoc, NumPatchesZ);
+    glUniform1i(m_widthLoc, Width);
+    glUniform1i(m_patchSizeLoc, PatchSize);
+    glUniform1f(m_worldScaleLoc, WorldScale);
+}
+
+
+void GeomipCullTechnique::SetLodRegions(const std::vector<int>& Regions)
+{
+    if (Regions.size() > GEOMIP_CULL_MAX_LODS) {
+        printf("%s:%d - too many LODs for the cull shader (%zu)\n", __FILE__, __LINE__, Regions.size());
+        exit(0);
+    }
+
+    glUniform1i(m_maxLodLoc, (int)Regions.size() - 1);
+    glUniform1fv(m_lodRegionsLoc, (GLsizei)Regions.size(), std::vector<float>(Regions.begin(), Regions.end()).data());
+}
+
+
+void GeomipCullTechnique::SetCameraPos(const Vector3f& CameraPos)
+{
+    glUniform3f(m_cameraPosLoc, CameraPos.x, CameraPos.y, CameraPos.z);
+}
+
+
+void GeomipCullTechnique::SetFrustumPlanes(const Vector4f Planes[6])
+{
+    glUniform4fv(m_planesLoc, 6, (const GLfloat*)Planes);
+}
@@ -0,0 +1,63 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef GEOMIP_CULL_TECHNIQUE_H
+#define GEOMIP_CULL_TECHNIQUE_H
+
+#include "technique.h"
+#include "ogldev_math_3d.h"
+
+#define GEOMIP_CULL_WORK_GROUP_SIZE 64
+#define GEOMIP_CULL_MAX_LODS        16
+
+// Shader storage bindings of geomip_cull.cs
+#define GEOMIP_CULL_PATCH_BOUNDS_BINDING  0
+#define GEOMIP_CULL_LOD_INFO_BINDING      1
+#define GEOMIP_CULL_DRAW_COMMANDS_BINDING 2
+
+class GeomipCullTechnique : public Technique
+{
+public:
+
+    GeomipCullTechnique();
+
+    virtual bool Init();
+
+    void SetGrid(int NumPatchesX, int NumPatchesZ, int Width, int PatchSize, float WorldScale);
+
+    void SetLodRegions(const std::vector<int>& Regions);
+
+    void SetCameraPos(const Vector3f& CameraPos);
+
+    // In the form returned by FrustumCulling::GetPlanes
+    void SetFrustumPlanes(const Vector4f Planes[6]);
+
+private:
+    GLuint m_numPatchesXLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_numPatchesZLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_widthLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_patchSizeLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_worldScaleLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_maxLodLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_lodRegionsLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_cameraPosLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_planesLoc = INVALID_UNIFORM_LOCATION;
+};
+
+#endif  /* GEOMIP_CULL_TECHNIQUE_H */
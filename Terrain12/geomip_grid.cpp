@@ -19,6 +19,13 @@
 
 #include <stdio.h>
 #include <vector>
+#include <algorithm>
+#include <chrono>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64)
+#include <xmmintrin.h>
+#define GEOMIP_USE_SSE
+#endif
 
 #include "ogldev_math_3d.h"
 #include "geomip_grid.h"
@@ -26,6 +33,9 @@
 
 int gShowPoints = 0;
 
+// Quad tree nodes which are this size (in patches) or smaller are not split any further
+#define QUAD_TREE_LEAF_SIZE 4
+
 
 GeomipGrid::GeomipGrid()
 {
@@ -35,6 +45,10 @@ GeomipGrid::GeomipGrid()
 GeomipGrid::~GeomipGrid()
 {
     Destroy();
+
+    if (m_pCullTech) {
+        delete m_pCullTech;
+    }
 }
 
 
@@ -51,6 +65,22 @@ void GeomipGrid::Destroy()
     if (m_ib > 0) {
         glDeleteBuffers(1, &m_ib);
     }
+
+    if (m_drawCommandsBuffer > 0) {
+        glDeleteBuffers(1, &m_drawCommandsBuffer);
+        m_drawCommandsBuffer = 0;
+    }
+
+    if (m_patchBoundsBuffer > 0) {
+        glDeleteBuffers(1, &m_patchBoundsBuffer);
+        m_patchBoundsBuffer = 0;
+    }
+
+    if (m_lodInfoBuffer > 0) {
+        glDeleteBuffers(1, &m_lodInfoBuffer);
+        m_lodInfoBuffer = 0;
+    }
+
 }
 
 
@@ -99,6 +129,8 @@ void GeomipGrid::CreateGeomipGrid(int Width, int Depth, int PatchSize, const Bas
 
 	PopulateBuffers(pTerrain);
 
+    SetRenderMode(m_renderMode);
+
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
@@ -135,6 +167,14 @@ void GeomipGrid::CreateGLState()
     glEnableVertexAttribArray(NORMAL_LOC);
     glVertexAttribPointer(NORMAL_LOC, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(NumFloats * sizeof(float)));
     NumFloats += 3;
+
+    // The indirect draw buffer is not part of the VAO state
+    glGenBuffers(1, &m_drawCommandsBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_drawCommandsBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * m_numPatchesX * m_numPatchesZ, NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    m_drawCommands.reserve(m_numPatchesX * m_numPatchesZ);
 }
 
 
@@ -152,7 +192,11 @@ void GeomipGrid::PopulateBuffers(const BaseTerrain* pTerrain)
     NumIndices = InitIndices(Indices);
     printf("Final number of indices %d\n", NumIndices);
 
-    CalcNormals(Vertices, Indices);
+    if (m_calcNormals) {
+        CalcNormals(Vertices, Indices);
+    }
+
+    CalcPatchBounds(Vertices);
 
     glBufferData(GL_ARRAY_BUFFER, sizeof(Vertices[0]) * Vertices.size(), &Vertices[0], GL_STATIC_DRAW);
 
@@ -160,6 +204,126 @@ void GeomipGrid::PopulateBuffers(const BaseTerrain* pTerrain)
 }
 
 
+void GeomipGrid::CalcPatchBounds(const std::vector<Vertex>& Vertices)
+{
+    int NumPatches = m_numPatchesX * m_numPatchesZ;
+    int NumPadded = NumPatches + 3;     // room for an unaligned load of four patches at the end of the last row
+
+    std::vector<float>* Arrays[6] = { &m_patchBounds.MinX, &m_patchBounds.MinY, &m_patchBounds.MinZ,
+                                      &m_patchBounds.MaxX, &m_patchBounds.MaxY, &m_patchBounds.MaxZ };
+
+    for (int i = 0 ; i < 6 ; i++) {
+        Arrays[i]->assign(NumPadded, 0.0f);
+    }
+
+    for (int PatchZ = 0 ; PatchZ < m_numPatchesZ ; PatchZ++) {
+        for (int PatchX = 0 ; PatchX < m_numPatchesX ; PatchX++) {
+            int x0 = PatchX * (m_patchSize - 1);
+            int z0 = PatchZ * (m_patchSize - 1);
+
+            float MinHeight = Vertices[z0 * m_width + x0].Pos.y;
+            float MaxHeight = MinHeight;
+
+            // The patch includes its border vertices which it shares with its neighbours
+            for (int z = z0 ; z < z0 + m_patchSize ; z++) {
+                for (int x = x0 ; x < x0 + m_patchSize ; x++) {
+                    float y = Vertices[z * m_width + x].Pos.y;
+                    MinHeight = std::min(MinHeight, y);
+                    MaxHeight = std::max(MaxHeight, y);
+                }
+            }
+
+            int Index = PatchZ * m_numPatchesX + PatchX;
+
+            m_patchBounds.MinX[Index] = (float)x0 * m_worldScale;
+            m_patchBounds.MinY[Index] = MinHeight;
+            m_patchBounds.MinZ[Index] = (float)z0 * m_worldScale;
+            m_patchBounds.MaxX[Index] = m_patchBounds.MinX[Index] + m_patchWorldSize;
+            m_patchBounds.MaxY[Index] = MaxHeight;
+            m_patchBounds.MaxZ[Index] = m_patchBounds.MinZ[Index] + m_patchWorldSize;
+        }
+    }
+
+    m_patchVisible.assign(NumPatches, 0);
+
+    m_quadTree.clear();
+    BuildQuadTree(0, 0, m_numPatchesX, m_numPatchesZ);
+
+    printf("Quad tree with %zu nodes over %d patches\n", m_quadTree.size(), NumPatches);
+}
+
+
+// Returns the index of the new node. The root is always node zero.
+int GeomipGrid::BuildQuadTree(int PatchX0, int PatchZ0, int PatchX1, int PatchZ1)
+{
+    int NodeIndex = (int)m_quadTree.size();
+    m_quadTree.push_back(QuadTreeNode());
+
+    QuadTreeNode Node;
+    Node.PatchX0 = PatchX0;
+    Node.PatchZ0 = PatchZ0;
+    Node.PatchX1 = PatchX1;
+    Node.PatchZ1 = PatchZ1;
+
+    bool IsLeaf = ((PatchX1 - PatchX0) <= QUAD_TREE_LEAF_SIZE) && ((PatchZ1 - PatchZ0) <= QUAD_TREE_LEAF_SIZE);
+
+    if (IsLeaf) {
+        int First = PatchZ0 * m_numPatchesX + PatchX0;
+        Node.Min = Vector3f(m_patchBounds.MinX[First], m_patchBounds.MinY[First], m_patchBounds.MinZ[First]);
+        Node.Max = Vector3f(m_patchBounds.MaxX[First], m_patchBounds.MaxY[First], m_patchBounds.MaxZ[First]);
+
+        for (int PatchZ = PatchZ0 ; PatchZ < PatchZ1 ; PatchZ++) {
+            for (int PatchX = PatchX0 ; PatchX < PatchX1 ; PatchX++) {
+                int Index = PatchZ * m_numPatchesX + PatchX;
+                Node.Min.y = std::min(Node.Min.y, m_patchBounds.MinY[Index]);
+                Node.Max.y = std::max(Node.Max.y, m_patchBounds.MaxY[Index]);
+            }
+        }
+
+        Node.Max.x = m_patchBounds.MaxX[(PatchZ1 - 1) * m_numPatchesX + PatchX1 - 1];
+        Node.Max.z = m_patchBounds.MaxZ[(PatchZ1 - 1) * m_numPatchesX + PatchX1 - 1];
+    } else {
+        int MidX = (PatchX0 + PatchX1 + 1) / 2;
+        int MidZ = (PatchZ0 + PatchZ1 + 1) / 2;
+
+        int ChildRanges[4][4] = { { PatchX0, PatchZ0, MidX,    MidZ },
+                                  { MidX,    PatchZ0, PatchX1, MidZ },
+                                  { PatchX0, MidZ,    MidX,    PatchZ1 },
+                                  { MidX,    MidZ,    PatchX1, PatchZ1 } };
+
+        bool First = true;
+
+        for (int i = 0 ; i < 4 ; i++) {
+            const int* r = ChildRanges[i];
+
+            // Long and thin regions are only split along one axis
+            if ((r[0] == r[2]) || (r[1] == r[3])) {
+                continue;
+            }
+
+            int ChildIndex = BuildQuadTree(r[0], r[1], r[2], r[3]);
+            Node.Children[i] = ChildIndex;
+
+            const QuadTreeNode& Child = m_quadTree[ChildIndex];
+
+            if (First) {
+                Node.Min = Child.Min;
+                Node.Max = Child.Max;
+                First = false;
+            } else {
+                Node.Min = Vector3f(std::min(Node.Min.x, Child.Min.x), std::min(Node.Min.y, Child.Min.y), std::min(Node.Min.z, Child.Min.z));
+                Node.Max = Vector3f(std::max(Node.Max.x, Child.Max.x), std::max(Node.Max.y, Child.Max.y), std::max(Node.Max.z, Child.Max.z));
+            }
+        }
+    }
+
+    // The vector may have been reallocated by the children
+    m_quadTree[NodeIndex] = Node;
+
+    return NodeIndex;
+}
+
+
 int GeomipGrid::CalcNumIndices()
 {
     int NumQuads = (m_patchSize - 1) * (m_patchSize - 1);
@@ -390,10 +554,25 @@ void GeomipGrid::Render(const Vector3f& CameraPos, const Matrix4f& ViewProj)
         clrscr();
     }
 #endif
-    m_lodManager.Update(CameraPos);
+    auto StartTime = std::chrono::high_resolution_clock::now();
 
     FrustumCulling fc(ViewProj);
 
+    Vector4f Planes[6];
+    fc.GetPlanes(Planes);
+
+    if (m_renderMode == GEOMIP_RENDER_GPU) {
+        // Must be done before the VAO is bound because it switches programs
+        RenderGPU(CameraPos, Planes);
+    } else {
+        m_lodManager.Update(CameraPos);
+
+        std::fill(m_patchVisible.begin(), m_patchVisible.end(), 0);
+        m_numVisiblePatches = 0;
+
+        CullQuadTree(0, fc, Planes);
+    }
+
     glBindVertexArray(m_vao);
 
     if (gShowPoints > 0) {
@@ -401,152 +580,428 @@ void GeomipGrid::Render(const Vector3f& CameraPos, const Matrix4f& ViewProj)
     }
 
     if (gShowPoints != 2) {
-        for (int PatchZ = 0 ; PatchZ < m_numPatchesZ ; PatchZ++) {
-            for (int PatchX = 0 ; PatchX < m_numPatchesX ; PatchX++) {
-
-                int x = PatchX * (m_patchSize - 1);
-                int z = PatchZ * (m_patchSize - 1);  
-
-                float x0 = x * m_worldScale;
-                float x1 = (x + m_patchSize - 1) * m_worldScale;
-                float z0 = z * m_worldScale;
-                float z1 = (z + m_patchSize - 1) * m_worldScale;
-
-                if (IsCameraInPatch(CameraPos, x, z)) {
-                    // continue to draw call
-                } else if (!IsPatchInsideViewFrustum_WorldSpace(x, z, fc)) {
-                    if (!IsCameraCloseToPatch(CameraPos, x, z)) {
-                        continue;
-                    }
-                } else {
-                    if (gShowPoints == 3) printf(" (1)  ");
-                }
+        switch (m_renderMode) {
+        case GEOMIP_RENDER_DIRECT:
+            RenderDirect();
+            break;
+
+        case GEOMIP_RENDER_MULTI_DRAW:
+            RenderMultiDraw();
+            break;
+
+        case GEOMIP_RENDER_GPU:
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_drawCommandsBuffer);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, m_numPatchesX * m_numPatchesZ, 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            m_renderStats.NumDrawCalls = 1;
+            m_renderStats.NumPatchesDrawn = -1;
+            break;
+        }
+    }
+
+    glBindVertexArray(0);
+
+    gShowPoints = 0;
+
+    auto EndTime = std::chrono::high_resolution_clock::now();
+    m_renderStats.SubmitTimeMicros = std::chrono::duration_cast<std::chrono::microseconds>(EndTime - StartTime).count();
+}
 
-                const LodManager::PatchLod& plod = m_lodManager.GetPatchLod(PatchX, PatchZ);
-                int C = plod.Core;
-                int L = plod.Left;
-                int R = plod.Right;
-                int T = plod.Top;
-                int B = plod.Bottom;
 
-                size_t BaseIndex = sizeof(unsigned int) * m_lodInfo[C].info[L][R][T][B].Start;
+void GeomipGrid::RenderDirect()
+{
+    m_renderStats.NumDrawCalls = 0;
 
-                int BaseVertex = z * m_width + x;
+    for (int PatchZ = 0 ; PatchZ < m_numPatchesZ ; PatchZ++) {
+        for (int PatchX = 0 ; PatchX < m_numPatchesX ; PatchX++) {
 
-                glDrawElementsBaseVertex(GL_TRIANGLES, m_lodInfo[C].info[L][R][T][B].Count, 
-                                         GL_UNSIGNED_INT, (void*)BaseIndex, BaseVertex);
+            if (!m_patchVisible[PatchZ * m_numPatchesX + PatchX]) {
+                if (gShowPoints == 3) printf("      ");
+                continue;
             }
 
-            if (gShowPoints == 3)  printf("\n");
+            if (gShowPoints == 3) printf(" (1)  ");
+
+            int x = PatchX * (m_patchSize - 1);
+            int z = PatchZ * (m_patchSize - 1);
+
+            const LodManager::PatchLod& plod = m_lodManager.GetPatchLod(PatchX, PatchZ);
+            int C = plod.Core;
+            int L = plod.Left;
+            int R = plod.Right;
+            int T = plod.Top;
+            int B = plod.Bottom;
+
+            size_t BaseIndex = sizeof(unsigned int) * m_lodInfo[C].info[L][R][T][B].Start;
+
+            int BaseVertex = z * m_width + x;
+
+            glDrawElementsBaseVertex(GL_TRIANGLES, m_lodInfo[C].info[L][R][T][B].Count, 
+                                     GL_UNSIGNED_INT, (void*)BaseIndex, BaseVertex);
+
+            m_renderStats.NumDrawCalls++;
         }
+
+        if (gShowPoints == 3)  printf("\n");
     }
 
-    glBindVertexArray(0);
+    m_renderStats.NumPatchesDrawn = m_renderStats.NumDrawCalls;
+}
 
-    gShowPoints = 0;
+
+void GeomipGrid::RenderMultiDraw()
+{
+    m_drawCommands.clear();
+
+    for (int PatchZ = 0 ; PatchZ < m_numPatchesZ ; PatchZ++) {
+        for (int PatchX = 0 ; PatchX < m_numPatchesX ; PatchX++) {
+
+            if (!m_patchVisible[PatchZ * m_numPatchesX + PatchX]) {
+                continue;
+            }
+
+            const LodManager::PatchLod& plod = m_lodManager.GetPatchLod(PatchX, PatchZ);
+            const SingleLodInfo& Info = m_lodInfo[plod.Core].info[plod.Left][plod.Right][plod.Top][plod.Bottom];
+
+            DrawElementsIndirectCommand Cmd;
+            Cmd.Count = Info.Count;
+            Cmd.InstanceCount = 1;
+            Cmd.FirstIndex = Info.Start;
+            Cmd.BaseVertex = PatchZ * (m_patchSize - 1) * m_width + PatchX * (m_patchSize - 1);
+            Cmd.BaseInstance = 0;
+
+            m_drawCommands.push_back(Cmd);
+        }
+    }
+
+    m_renderStats.NumPatchesDrawn = (int)m_drawCommands.size();
+
+    if (m_drawCommands.empty()) {
+        m_renderStats.NumDrawCalls = 0;
+        return;
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_drawCommandsBuffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawElementsIndirectCommand) * m_drawCommands.size(), m_drawCommands.data());
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, (GLsizei)m_drawCommands.size(), 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    m_renderStats.NumDrawCalls = 1;
 }
 
 
-bool GeomipGrid::IsPatchInsideViewFrustum_ViewSpace(int X, int Z, const Matrix4f& ViewProj)
+// Runs the LOD selection and the culling in geomip_cull.cs. The commands
+// are consumed by glMultiDrawElementsIndirect in Render without a round
+// trip to the CPU so the number of visible patches is not known here.
+void GeomipGrid::RenderGPU(const Vector3f& CameraPos, const Vector4f Planes[6])
 {
-    int x0 = X;
-    int x1 = X + m_patchSize - 1;
-    int z0 = Z;
-    int z1 = Z + m_patchSize - 1;
+    GLint CurProgram = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &CurProgram);
 
-    Vector3f p00((float)x0 * m_worldScale, m_pTerrain->GetHeight(x0, z0), (float)z0 * m_worldScale);
-    Vector3f p01((float)x0 * m_worldScale, m_pTerrain->GetHeight(x0, z1), (float)z1 * m_worldScale);
-    Vector3f p10((float)x1 * m_worldScale, m_pTerrain->GetHeight(x1, z0), (float)z0 * m_worldScale);
-    Vector3f p11((float)x1 * m_worldScale, m_pTerrain->GetHeight(x1, z1), (float)z1 * m_worldScale);
+    m_pCullTech->Enable();
+    m_pCullTech->SetGrid(m_numPatchesX, m_numPatchesZ, m_width, m_patchSize, m_worldScale);
+    m_pCullTech->SetLodRegions(m_lodManager.GetLodRegions());
+    m_pCullTech->SetCameraPos(CameraPos);
+    m_pCullTech->SetFrustumPlanes(Planes);
 
-    bool InsideViewFrustum =
-        IsPointInsideViewFrustum(p00, ViewProj) ||
-        IsPointInsideViewFrustum(p01, ViewProj) ||
-        IsPointInsideViewFrustum(p10, ViewProj) ||
-        IsPointInsideViewFrustum(p11, ViewProj);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GEOMIP_CULL_PATCH_BOUNDS_BINDING, m_patchBoundsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GEOMIP_CULL_LOD_INFO_BINDING, m_lodInfoBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GEOMIP_CULL_DRAW_COMMANDS_BINDING, m_drawCommandsBuffer);
 
-    return InsideViewFrustum;
+    int NumPatches = m_numPatchesX * m_numPatchesZ;
+    uint NumGroups = (NumPatches + GEOMIP_CULL_WORK_GROUP_SIZE - 1) / GEOMIP_CULL_WORK_GROUP_SIZE;
+
+    glDispatchCompute(NumGroups, 1, 1);
+
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+
+    glUseProgram(CurProgram);
+
+    m_numVisiblePatches = -1;
 }
 
 
-bool GeomipGrid::IsPatchInsideViewFrustum_WorldSpace(int X, int Z, const FrustumCulling& fc)
+void GeomipGrid::SetRenderMode(GEOMIP_RENDER_MODE RenderMode)
 {
-    int x0 = X;
-    int x1 = X + m_patchSize - 1;
-    int z0 = Z;
-    int z1 = Z + m_patchSize - 1;
+    if ((RenderMode == GEOMIP_RENDER_GPU) && !m_pCullTech) {
+        m_pCullTech = new GeomipCullTechnique();
+
+        if (!m_pCullTech->Init()) {
+            printf("%s:%d - error initializing the geomip cull technique, using GEOMIP_RENDER_MULTI_DRAW\n", __FILE__, __LINE__);
+            delete m_pCullTech;
+            m_pCullTech = NULL;
+            RenderMode = GEOMIP_RENDER_MULTI_DRAW;
+        }
+    }
+
+    // The buffers are recreated with the grid
+    if ((RenderMode == GEOMIP_RENDER_GPU) && (m_patchBoundsBuffer == 0) && (m_numPatchesX > 0)) {
+        InitGPUBuffers();
+    }
+
+    m_renderMode = RenderMode;
+}
 
-    float h00 = m_pTerrain->GetHeight(x0, z0);
-    float h01 = m_pTerrain->GetHeight(x0, z1);
-    float h10 = m_pTerrain->GetHeight(x1, z0);
-    float h11 = m_pTerrain->GetHeight(x1, z1);
 
-    float MinHeight = std::min(h00, std::min(h01, std::min(h10, h11)));
-    float MaxHeight = std::max(h00, std::max(h01, std::max(h10, h11)));
+float GeomipGrid::GetMaxError() const
+{
+    const std::vector<int>& Regions = m_lodManager.GetLodRegions();
+
+    float MaxError = 0.0f;
 
-    Vector3f p00_low((float)x0 * m_worldScale, h00, (float)z0 * m_worldScale);
-    Vector3f p01_low((float)x0 * m_worldScale, h01, (float)z1 * m_worldScale);
-    Vector3f p10_low((float)x1 * m_worldScale, h10, (float)z0 * m_worldScale);
-    Vector3f p11_low((float)x1 * m_worldScale, h11, (float)z1 * m_worldScale);
+    // LOD 0 is the full resolution so only the coarser LODs add an error
+    for (int Lod = 1 ; Lod <= m_maxLOD ; Lod++) {
+        float Spacing = (float)(1 << Lod) * m_worldScale;
+        MaxError = std::max(MaxError, Spacing / (float)Regions[Lod - 1]);
+    }
 
-  /*  Vector3f p00_high((float)x0 * m_worldScale, MaxHeight, (float)z0 * m_worldScale);
-    Vector3f p01_high((float)x0 * m_worldScale, MaxHeight, (float)z1 * m_worldScale);
-    Vector3f p10_high((float)x1 * m_worldScale, MaxHeight, (float)z0 * m_worldScale);
-    Vector3f p11_high((float)x1 * m_worldScale, MaxHeight, (float)z1 * m_worldScale);*/
+    return MaxError;
+}
+
+
+void GeomipGrid::InitGPUBuffers()
+{
+    glGenBuffers(1, &m_patchBoundsBuffer);
+    UploadPatchBounds();
 
-    bool InsideViewFrustm =
-        fc.IsPointInsideViewFrustum(p00_low) ||
-        fc.IsPointInsideViewFrustum(p01_low) ||
-        fc.IsPointInsideViewFrustum(p10_low) ||
-        fc.IsPointInsideViewFrustum(p11_low);// ||
-     /*   fc.IsPointInsideViewFrustum(p00_high) ||
-        fc.IsPointInsideViewFrustum(p01_high) ||
-        fc.IsPointInsideViewFrustum(p10_high) ||
-        fc.IsPointInsideViewFrustum(p11_high);*/
+    // LodInfo is a plain array of Start/Count pairs so it is uploaded as is
+    glGenBuffers(1, &m_lodInfoBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_lodInfoBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(LodInfo) * m_lodInfo.size(), m_lodInfo.data(), GL_STATIC_DRAW);
 
-    return InsideViewFrustm;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 }
 
 
-bool GeomipGrid::IsCameraInPatch(const Vector3f& CameraPos, int PatchBaseX, int PatchBaseZ)
+void GeomipGrid::UploadPatchBounds()
 {
-    float x0 = PatchBaseX * m_worldScale;
-    float x1 = (PatchBaseX + m_patchSize - 1) * m_worldScale;
-    float z0 = PatchBaseZ * m_worldScale;
-    float z1 = (PatchBaseZ + m_patchSize - 1) * m_worldScale;
+    int NumPatches = m_numPatchesX * m_numPatchesZ;
 
-    bool CameraInPatch = ((CameraPos.x >= x0) &&
-                          (CameraPos.x < x1) &&
-                          (CameraPos.z >= z0) &&
-                          (CameraPos.z < z1));
+    std::vector<Vector4f> Bounds(NumPatches * 2);
 
-    if (CameraInPatch && (gShowPoints == 3)) {
-        printf(" (C)  ");
+    for (int i = 0 ; i < NumPatches ; i++) {
+        Bounds[i * 2]     = Vector4f(m_patchBounds.MinX[i], m_patchBounds.MinY[i], m_patchBounds.MinZ[i], 0.0f);
+        Bounds[i * 2 + 1] = Vector4f(m_patchBounds.MaxX[i], m_patchBounds.MaxY[i], m_patchBounds.MaxZ[i], 0.0f);
     }
 
-    return CameraInPatch;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_patchBoundsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Bounds[0]) * Bounds.size(), Bounds.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 }
 
 
-bool GeomipGrid::IsCameraCloseToPatch(const Vector3f& CameraPos, int PatchBaseX, int PatchBaseZ)
+void GeomipGrid::UpdateHeights(int StartX, int StartZ, int EndX, int EndZ)
 {
-    Vector3f PatchWorldBase(PatchBaseX * m_worldScale, 0.0f, PatchBaseZ * m_worldScale);
-    Vector3f PatchWorldCenter = PatchWorldBase + Vector3f(m_patchWorldHalfSize, 0.0f, m_patchWorldHalfSize);
-    Vector3f CameraPosZeroY = Vector3f(CameraPos.x, 0.0f, CameraPos.z);
-    float CameraToPatchCenter = CameraPosZeroY.Distance(PatchWorldCenter);
+    // Patches share their border vertices so a vertex on a border belongs to both patches
+    int PatchX0 = std::max((StartX - 1) / (m_patchSize - 1), 0);
+    int PatchZ0 = std::max((StartZ - 1) / (m_patchSize - 1), 0);
+    int PatchX1 = std::min((EndX - 1) / (m_patchSize - 1) + 1, m_numPatchesX);
+    int PatchZ1 = std::min((EndZ - 1) / (m_patchSize - 1) + 1, m_numPatchesZ);
+
+    for (int PatchZ = PatchZ0 ; PatchZ < PatchZ1 ; PatchZ++) {
+        for (int PatchX = PatchX0 ; PatchX < PatchX1 ; PatchX++) {
+            int x0 = PatchX * (m_patchSize - 1);
+            int z0 = PatchZ * (m_patchSize - 1);
+
+            float MinHeight = m_pTerrain->GetHeight(x0, z0);
+            float MaxHeight = MinHeight;
+
+            for (int z = z0 ; z < z0 + m_patchSize ; z++) {
+                for (int x = x0 ; x < x0 + m_patchSize ; x++) {
+                    float y = m_pTerrain->GetHeight(x, z);
+                    MinHeight = std::min(MinHeight, y);
+                    MaxHeight = std::max(MaxHeight, y);
+                }
+            }
 
-    bool CameraCloseToPatch = (CameraToPatchCenter <= m_patchWorldSize * 2.0f);
+            int Index = PatchZ * m_numPatchesX + PatchX;
+            m_patchBounds.MinY[Index] = MinHeight;
+            m_patchBounds.MaxY[Index] = MaxHeight;
+        }
+    }
 
-    if (gShowPoints == 3) {
-        if (CameraCloseToPatch) {
-            printf(" (2)  ");
-        } else {
-            printf("%05.1f ", CameraToPatchCenter);
+    RefitQuadTree(0);
+
+    if (m_patchBoundsBuffer > 0) {
+        UploadPatchBounds();
+    }
+}
+
+
+// Recalculates the height range of the node and its children. The XZ extents never change.
+void GeomipGrid::RefitQuadTree(int NodeIndex)
+{
+    QuadTreeNode& Node = m_quadTree[NodeIndex];
+
+    bool IsLeaf = true;
+
+    for (int i = 0 ; i < 4 ; i++) {
+        if (Node.Children[i] != -1) {
+            RefitQuadTree(Node.Children[i]);
+
+            const QuadTreeNode& Child = m_quadTree[Node.Children[i]];
+
+            if (IsLeaf) {
+                Node.Min.y = Child.Min.y;
+                Node.Max.y = Child.Max.y;
+                IsLeaf = false;
+            } else {
+                Node.Min.y = std::min(Node.Min.y, Child.Min.y);
+                Node.Max.y = std::max(Node.Max.y, Child.Max.y);
+            }
         }
     }
 
-    return CameraCloseToPatch;
+    if (IsLeaf) {
+        int First = Node.PatchZ0 * m_numPatchesX + Node.PatchX0;
+        Node.Min.y = m_patchBounds.MinY[First];
+        Node.Max.y = m_patchBounds.MaxY[First];
+
+        for (int PatchZ = Node.PatchZ0 ; PatchZ < Node.PatchZ1 ; PatchZ++) {
+            for (int PatchX = Node.PatchX0 ; PatchX < Node.PatchX1 ; PatchX++) {
+                int Index = PatchZ * m_numPatchesX + PatchX;
+                Node.Min.y = std::min(Node.Min.y, m_patchBounds.MinY[Index]);
+                Node.Max.y = std::max(Node.Max.y, m_patchBounds.MaxY[Index]);
+            }
+        }
+    }
 }
 
 
+void GeomipGrid::CullQuadTree(int NodeIndex, const FrustumCulling& FC, const Vector4f Planes[6])
+{
+    const QuadTreeNode& Node = m_quadTree[NodeIndex];
+
+    FRUSTUM_TEST_RESULT Result = FC.TestBox(Node.Min, Node.Max);
+
+    if (Result == FRUSTUM_OUTSIDE) {
+        return;
+    }
+
+    if (Result == FRUSTUM_INSIDE) {
+        SetPatchesVisible(Node.PatchX0, Node.PatchZ0, Node.PatchX1, Node.PatchZ1);
+        return;
+    }
+
+    bool IsLeaf = true;
+
+    for (int i = 0 ; i < 4 ; i++) {
+        if (Node.Children[i] != -1) {
+            CullQuadTree(Node.Children[i], FC, Planes);
+            IsLeaf = false;
+        }
+    }
 
+    if (IsLeaf) {
+        CullPatches(Node.PatchX0, Node.PatchZ0, Node.PatchX1, Node.PatchZ1, Planes);
+    }
+}
+
+
+void GeomipGrid::SetPatchesVisible(int PatchX0, int PatchZ0, int PatchX1, int PatchZ1)
+{
+    for (int PatchZ = PatchZ0 ; PatchZ < PatchZ1 ; PatchZ++) {
+        for (int PatchX = PatchX0 ; PatchX < PatchX1 ; PatchX++) {
+            m_patchVisible[PatchZ * m_numPatchesX + PatchX] = 1;
+        }
+    }
+
+    m_numVisiblePatches += (PatchX1 - PatchX0) * (PatchZ1 - PatchZ0);
+}
+
+
+// Tests the AABBs of a range of patches against the six planes, four patches at a
+// time when SSE is available. For every plane only the corner of the box which is
+// furthest along the plane normal is tested - if it is behind the plane so is the
+// entire box.
+void GeomipGrid::CullPatches(int PatchX0, int PatchZ0, int PatchX1, int PatchZ1, const Vector4f Planes[6])
+{
+    const float* pX[6];
+    const float* pY[6];
+    const float* pZ[6];
+
+    for (int i = 0 ; i < 6 ; i++) {
+        pX[i] = (Planes[i].x >= 0.0f) ? &m_patchBounds.MaxX[0] : &m_patchBounds.MinX[0];
+        pY[i] = (Planes[i].y >= 0.0f) ? &m_patchBounds.MaxY[0] : &m_patchBounds.MinY[0];
+        pZ[i] = (Planes[i].z >= 0.0f) ? &m_patchBounds.MaxZ[0] : &m_patchBounds.MinZ[0];
+    }
+
+    for (int PatchZ = PatchZ0 ; PatchZ < PatchZ1 ; PatchZ++) {
+        int PatchX = PatchX0;
+
+#ifdef GEOMIP_USE_SSE
+        for ( ; PatchX < PatchX1 ; PatchX += 4) {
+            int Index = PatchZ * m_numPatchesX + PatchX;
+
+            __m128 Inside = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());    // all ones
+
+            for (int i = 0 ; i < 6 ; i++) {
+                __m128 d = _mm_set1_ps(Planes[i].w);
+                d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(Planes[i].x), _mm_loadu_ps(pX[i] + Index)));
+                d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(Planes[i].y), _mm_loadu_ps(pY[i] + Index)));
+                d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(Planes[i].z), _mm_loadu_ps(pZ[i] + Index)));
+                Inside = _mm_and_ps(Inside, _mm_cmpge_ps(d, _mm_setzero_ps()));
+            }
+
+            int Mask = _mm_movemask_ps(Inside);
+            int Count = std::min(4, PatchX1 - PatchX);  // the lanes past the end of the range are ignored
+
+            for (int j = 0 ; j < Count ; j++) {
+                if (Mask & (1 << j)) {
+                    m_patchVisible[Index + j] = 1;
+                    m_numVisiblePatches++;
+                }
+            }
+        }
+#else
+        for ( ; PatchX < PatchX1 ; PatchX++) {
+            int Index = PatchZ * m_numPatchesX + PatchX;
+
+            bool Inside = true;
+
+            for (int i = 0 ; Inside && (i < 6) ; i++) {
+                float d = Planes[i].x * pX[i][Index] + Planes[i].y * pY[i][Index] + Planes[i].z * pZ[i][Index] + Planes[i].w;
+                Inside = (d >= 0.0f);
+            }
+
+            if (Inside) {
+                m_patchVisible[Index] = 1;
+                m_numVisiblePatches++;
+            }
+        }
+#endif
+    }
+}
+
+
+bool GeomipGrid::IsPatchInsideViewFrustum_ViewSpace(int X, int Z, const Matrix4f& ViewProj)
+{
+    int x0 = X;
+    int x1 = X + m_patchSize - 1;
+    int z0 = Z;
+    int z1 = Z + m_patchSize - 1;
+
+    Vector3f p00((float)x0 * m_worldScale, m_pTerrain->GetHeight(x0, z0), (float)z0 * m_worldScale);
+    Vector3f p01((float)x0 * m_worldScale, m_pTerrain->GetHeight(x0, z1), (float)z1 * m_worldScale);
+    Vector3f p10((float)x1 * m_worldScale, m_pTerrain->GetHeight(x1, z0), (float)z0 * m_worldScale);
+    Vector3f p11((float)x1 * m_worldScale, m_pTerrain->GetHeight(x1, z1), (float)z1 * m_worldScale);
+
+    bool InsideViewFrustum =
+        IsPointInsideViewFrustum(p00, ViewProj) ||
+        IsPointInsideViewFrustum(p01, ViewProj) ||
+        IsPointInsideViewFrustum(p10, ViewProj) ||
+        IsPointInsideViewFrustum(p11, ViewProj);
+
+    return InsideViewFrustum;
+}
+
+
+bool GeomipGrid::IsPatchInsideViewFrustum_WorldSpace(int PatchX, int PatchZ, const FrustumCulling& fc)
+{
+    int Index = PatchZ * m_numPatchesX + PatchX;
+
+    Vector3f Min(m_patchBounds.MinX[Index], m_patchBounds.MinY[Index], m_patchBounds.MinZ[Index]);
+    Vector3f Max(m_patchBounds.MaxX[Index], m_patchBounds.MaxY[Index], m_patchBounds.MaxZ[Index]);
+
+    return fc.IsBoxInsideViewFrustum(Min, Max);
+}
@@ -25,11 +25,33 @@
 
 #include "ogldev_math_3d.h"
 #include "lod_manager.h"
+#include "geomip_cull_technique.h"
 
 // this header is included by terrain.h so we have a forward 
 // declaration for BaseTerrain.
 class BaseTerrain;
 
+enum GEOMIP_RENDER_MODE {
+    GEOMIP_RENDER_DIRECT = 0,       // one glDrawElementsBaseVertex per visible patch
+    GEOMIP_RENDER_MULTI_DRAW = 1,   // draw commands built on the CPU, one glMultiDrawElementsIndirect
+    GEOMIP_RENDER_GPU = 2           // LOD selection and culling in a compute shader, one glMultiDrawElementsIndirect
+};
+
+struct GeomipRenderStats {
+    int NumDrawCalls = 0;
+    int NumPatchesDrawn = 0;        // -1 when the culling is done on the GPU
+    long long SubmitTimeMicros = 0; // CPU time of GeomipGrid::Render, including the LOD update and the culling
+};
+
+// The layout is defined by OpenGL
+struct DrawElementsIndirectCommand {
+    uint Count = 0;
+    uint InstanceCount = 0;
+    uint FirstIndex = 0;
+    int BaseVertex = 0;
+    uint BaseInstance = 0;
+};
+
 class GeomipGrid {
  public:
     GeomipGrid();
@@ -42,6 +64,30 @@ class GeomipGrid {
 
     void Render(const Vector3f& CameraPos, const Matrix4f& ViewProj);
 
+    int GetNumPatches() const { return m_numPatchesX * m_numPatchesZ; }
+
+    int GetNumVisiblePatches() const { return m_numVisiblePatches; }
+
+    // Falls back to GEOMIP_RENDER_MULTI_DRAW if the compute shader cannot be loaded
+    void SetRenderMode(GEOMIP_RENDER_MODE RenderMode);
+
+    GEOMIP_RENDER_MODE GetRenderMode() const { return m_renderMode; }
+
+    const GeomipRenderStats& GetRenderStats() const { return m_renderStats; }
+
+    // Largest ratio between the vertex spacing of a LOD and the distance where it starts.
+    // Used to configure the clipmap renderer with the same visual error.
+    float GetMaxError() const;
+
+    // When the normals are derived on the GPU (see TerrainMaps) the CPU pass can be skipped
+    void SetCalcNormals(bool CalcNormals) { m_calcNormals = CalcNormals; }
+
+    GLuint GetVertexBuffer() const { return m_vb; }
+
+    // Refreshes the culling bounds after the heights in [StartX, EndX) x [StartZ, EndZ) have been
+    // changed. The vertex buffer itself is expected to be updated on the GPU by TerrainMaps.
+    void UpdateHeights(int StartX, int StartZ, int EndX, int EndZ);
+
  private:
 
     struct Vertex {
@@ -74,11 +120,29 @@ class GeomipGrid {
 
     bool IsPatchInsideViewFrustum_ViewSpace(int X, int Z, const Matrix4f& ViewProj);
 
-    bool IsPatchInsideViewFrustum_WorldSpace(int X, int Z, const FrustumCulling& FC);
+    bool IsPatchInsideViewFrustum_WorldSpace(int PatchX, int PatchZ, const FrustumCulling& FC);
+
+    void CalcPatchBounds(const std::vector<Vertex>& Vertices);
 
-    bool IsCameraInPatch(const Vector3f& CameraPos, int PatchBaseX, int PatchBaseZ);
+    int BuildQuadTree(int PatchX0, int PatchZ0, int PatchX1, int PatchZ1);
 
-    bool IsCameraCloseToPatch(const Vector3f& CameraPos, int PatchBaseX, int PatchBaseZ);
+    void RefitQuadTree(int NodeIndex);
+
+    void UploadPatchBounds();
+
+    void CullQuadTree(int NodeIndex, const FrustumCulling& FC, const Vector4f Planes[6]);
+
+    void CullPatches(int PatchX0, int PatchZ0, int PatchX1, int PatchZ1, const Vector4f Planes[6]);
+
+    void SetPatchesVisible(int PatchX0, int PatchZ0, int PatchX1, int PatchZ1);
+
+    void RenderDirect();
+
+    void RenderMultiDraw();
+
+    void RenderGPU(const Vector3f& CameraPos, const Vector4f Planes[6]);
+
+    void InitGPUBuffers();
 
     int m_width = 0;
     int m_depth = 0;
@@ -88,6 +152,7 @@ class GeomipGrid {
     GLuint m_vb = 0;
     GLuint m_ib = 0;
     float m_worldScale = 1.0f;
+    bool m_calcNormals = true;
 
     struct SingleLodInfo {
         int Start = 0;
@@ -110,6 +175,42 @@ class GeomipGrid {
     const BaseTerrain* m_pTerrain = NULL;
     float m_patchWorldSize = 0.0f;
     float m_patchWorldHalfSize = 0.0f;
+
+    // World space AABBs of the patches as a structure of arrays (index = PatchZ * m_numPatchesX + PatchX)
+    // so that the frustum test can run on several patches at once. The arrays are padded
+    // so that a full SIMD register can always be loaded.
+    struct PatchBounds {
+        std::vector<float> MinX, MinY, MinZ;
+        std::vector<float> MaxX, MaxY, MaxZ;
+    };
+
+    PatchBounds m_patchBounds;
+
+    // Every node covers the patches [PatchX0, PatchX1) x [PatchZ0, PatchZ1). Regions which are
+    // entirely inside or outside the frustum are resolved without visiting their patches.
+    struct QuadTreeNode {
+        Vector3f Min;
+        Vector3f Max;
+        int PatchX0 = 0;
+        int PatchZ0 = 0;
+        int PatchX1 = 0;
+        int PatchZ1 = 0;
+        int Children[4] = { -1, -1, -1, -1 };
+    };
+
+    std::vector<QuadTreeNode> m_quadTree;
+    std::vector<char> m_patchVisible;
+    int m_numVisiblePatches = 0;
+
+    GEOMIP_RENDER_MODE m_renderMode = GEOMIP_RENDER_DIRECT;
+    GeomipRenderStats m_renderStats;
+    std::vector<DrawElementsIndirectCommand> m_drawCommands;
+    GLuint m_drawCommandsBuffer = 0;    // GL_DRAW_INDIRECT_BUFFER with room for a command per patch
+
+    // Only used by GEOMIP_RENDER_GPU
+    GeomipCullTechnique* m_pCullTech = NULL;
+    GLuint m_patchBoundsBuffer = 0;
+    GLuint m_lodInfoBuffer = 0;
 };
 
 #endif
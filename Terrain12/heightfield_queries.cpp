@@ -0,0 +1,826 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <chrono>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define HEIGHTFIELD_USE_SSE
+#endif
+
+#include "ogldev_hash_random.h"
+#include "heightfield_queries.h"
+
+
+void HeightFieldQueries::Init(const Array2D<float>* pHeightMap, int Width, int Depth, float WorldScale, int CellsPerBlock)
+{
+    if ((Width < 2) || (Depth < 2) || (CellsPerBlock < 1)) {
+        printf("%s:%d - invalid height field %dx%d (%d cells per block)\n", __FILE__, __LINE__, Width, Depth, CellsPerBlock);
+        exit(0);
+    }
+
+    m_pHeightMap = pHeightMap;
+    m_pHeights = pHeightMap->GetBaseAddr();
+    m_width = Width;
+    m_depth = Depth;
+    m_worldScale = WorldScale;
+    m_invWorldScale = 1.0f / WorldScale;
+    m_cellsPerBlock = CellsPerBlock;
+
+    m_numBlocksX = (m_width - 1 + CellsPerBlock - 1) / CellsPerBlock;
+    m_numBlocksZ = (m_depth - 1 + CellsPerBlock - 1) / CellsPerBlock;
+
+    m_pyramid.clear();
+
+    PyramidLevel Level;
+    Level.Width = m_numBlocksX;
+    Level.Depth = m_numBlocksZ;
+
+    while (true) {
+        Level.MinMax.resize(Level.Width * Level.Depth);
+        m_pyramid.push_back(Level);
+
+        if ((Level.Width == 1) && (Level.Depth == 1)) {
+            break;
+        }
+
+        Level.Width = (Level.Width + 1) / 2;
+        Level.Depth = (Level.Depth + 1) / 2;
+    }
+
+    UpdateRegion(0, 0, m_width, m_depth);
+}
+
+
+void HeightFieldQueries::CalcBlockMinMax(int BlockX, int BlockZ, MinMaxHeight& MinMax) const
+{
+    int MinX, MinZ, MaxX, MaxZ;
+    GetCellBounds(0, BlockX, BlockZ, MinX, MinZ, MaxX, MaxZ);
+
+    // The block includes the vertices on its far edges
+    MinMax.Min = MinMax.Max = m_pHeights[MinZ * m_width + MinX];
+
+    for (int z = MinZ ; z <= MaxZ ; z++) {
+        const float* pRow = m_pHeights + z * m_width;
+
+        for (int x = MinX ; x <= MaxX ; x++) {
+            MinMax.Min = std::min(MinMax.Min, pRow[x]);
+            MinMax.Max = std::max(MinMax.Max, pRow[x]);
+        }
+    }
+}
+
+
+void HeightFieldQueries::UpdateRegion(int StartX, int StartZ, int EndX, int EndZ)
+{
+    // A vertex on the edge of a block belongs to both the blocks
+    int BlockX0 = std::max((StartX - 1) / m_cellsPerBlock, 0);
+    int BlockZ0 = std::max((StartZ - 1) / m_cellsPerBlock, 0);
+    int BlockX1 = std::min((EndX - 1) / m_cellsPerBlock + 1, m_numBlocksX);
+    int BlockZ1 = std::min((EndZ - 1) / m_cellsPerBlock + 1, m_numBlocksZ);
+
+    for (int BlockZ = BlockZ0 ; BlockZ < BlockZ1 ; BlockZ++) {
+        for (int BlockX = BlockX0 ; BlockX < BlockX1 ; BlockX++) {
+            CalcBlockMinMax(BlockX, BlockZ, m_pyramid[0].MinMax[BlockZ * m_numBlocksX + BlockX]);
+        }
+    }
+
+    for (int Level = 1 ; Level < (int)m_pyramid.size() ; Level++) {
+        BlockX0 /= 2;
+        BlockZ0 /= 2;
+        BlockX1 = (BlockX1 + 1) / 2;
+        BlockZ1 = (BlockZ1 + 1) / 2;
+
+        UpdatePyramidLevel(Level, BlockX0, BlockZ0, BlockX1, BlockZ1);
+    }
+}
+
+
+void HeightFieldQueries::UpdatePyramidLevel(int Level, int StartX, int StartZ, int EndX, int EndZ)
+{
+    const PyramidLevel& Prev = m_pyramid[Level - 1];
+    PyramidLevel& Cur = m_pyramid[Level];
+
+    for (int z = StartZ ; z < EndZ ; z++) {
+        for (int x = StartX ; x < EndX ; x++) {
+            MinMaxHeight MinMax;
+            MinMax.Min = FLT_MAX;
+            MinMax.Max = -FLT_MAX;
+
+            for (int cz = z * 2 ; cz < std::min(z * 2 + 2, Prev.Depth) ; cz++) {
+                for (int cx = x * 2 ; cx < std::min(x * 2 + 2, Prev.Width) ; cx++) {
+                    const MinMaxHeight& Child = Prev.MinMax[cz * Prev.Width + cx];
+                    MinMax.Min = std::min(MinMax.Min, Child.Min);
+                    MinMax.Max = std::max(MinMax.Max, Child.Max);
+                }
+            }
+
+            Cur.MinMax[z * Cur.Width + x] = MinMax;
+        }
+    }
+}
+
+
+// The cells of a node are [MinX, MaxX) x [MinZ, MaxZ)
+void HeightFieldQueries::GetCellBounds(int Level, int NodeX, int NodeZ, int& MinX, int& MinZ, int& MaxX, int& MaxZ) const
+{
+    int BlocksPerNode = 1 << Level;
+
+    MinX = NodeX * BlocksPerNode * m_cellsPerBlock;
+    MinZ = NodeZ * BlocksPerNode * m_cellsPerBlock;
+    MaxX = std::min((NodeX + 1) * BlocksPerNode * m_cellsPerBlock, m_width - 1);
+    MaxZ = std::min((NodeZ + 1) * BlocksPerNode * m_cellsPerBlock, m_depth - 1);
+}
+
+
+// x/z are in height map units. Outside the height map the edge heights are used.
+void HeightFieldQueries::ClampToGrid(float& x, float& z, int& CellX, int& CellZ) const
+{
+    x = std::min(std::max(x, 0.0f), (float)(m_width - 1));
+    z = std::min(std::max(z, 0.0f), (float)(m_depth - 1));
+
+    CellX = std::min((int)x, m_width - 2);
+    CellZ = std::min((int)z, m_depth - 2);
+}
+
+
+float HeightFieldQueries::GetHeight(float WorldX, float WorldZ) const
+{
+    float x = WorldX * m_invWorldScale;
+    float z = WorldZ * m_invWorldScale;
+    int CellX, CellZ;
+
+    ClampToGrid(x, z, CellX, CellZ);
+
+    float FactorX = x - (float)CellX;
+    float FactorZ = z - (float)CellZ;
+
+    const float* p = m_pHeights + CellZ * m_width + CellX;
+
+    float Bottom = p[0] + (p[1] - p[0]) * FactorX;
+    float Top = p[m_width] + (p[m_width + 1] - p[m_width]) * FactorX;
+
+    return Bottom + (Top - Bottom) * FactorZ;
+}
+
+
+// The normal of the bilinear surface - not an interpolation of the vertex normals
+Vector3f HeightFieldQueries::GetNormal(float WorldX, float WorldZ) const
+{
+    float x = WorldX * m_invWorldScale;
+    float z = WorldZ * m_invWorldScale;
+    int CellX, CellZ;
+
+    ClampToGrid(x, z, CellX, CellZ);
+
+    float FactorX = x - (float)CellX;
+    float FactorZ = z - (float)CellZ;
+
+    const float* p = m_pHeights + CellZ * m_width + CellX;
+
+    float h00 = p[0];
+    float h10 = p[1];
+    float h01 = p[m_width];
+    float h11 = p[m_width + 1];
+
+    float dx = ((h10 - h00) * (1.0f - FactorZ) + (h11 - h01) * FactorZ) * m_invWorldScale;
+    float dz = ((h01 - h00) * (1.0f - FactorX) + (h11 - h10) * FactorX) * m_invWorldScale;
+
+    Vector3f Normal(-dx, 1.0f, -dz);
+    Normal.Normalize();
+
+    return Normal;
+}
+
+
+void HeightFieldQueries::GetHeights(const float* pX, const float* pZ, float* pHeights, int Count) const
+{
+    int i = 0;
+
+#ifdef HEIGHTFIELD_USE_SSE
+    __m128 InvWorldScale = _mm_set1_ps(m_invWorldScale);
+    __m128 Zero = _mm_setzero_ps();
+    __m128 MaxX = _mm_set1_ps((float)(m_width - 1));
+    __m128 MaxZ = _mm_set1_ps((float)(m_depth - 1));
+    __m128 MaxCellX = _mm_set1_ps((float)(m_width - 2));
+    __m128 MaxCellZ = _mm_set1_ps((float)(m_depth - 2));
+
+    for ( ; i + 4 <= Count ; i += 4) {
+        __m128 x = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(pX + i), InvWorldScale), Zero), MaxX);
+        __m128 z = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(pZ + i), InvWorldScale), Zero), MaxZ);
+
+        // x and z are not negative so truncation is the same as floor
+        __m128 CellX = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(x)), MaxCellX);
+        __m128 CellZ = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(z)), MaxCellZ);
+
+        __m128 FactorX = _mm_sub_ps(x, CellX);
+        __m128 FactorZ = _mm_sub_ps(z, CellZ);
+
+        int CX[4], CZ[4];
+        _mm_storeu_si128((__m128i*)CX, _mm_cvttps_epi32(CellX));
+        _mm_storeu_si128((__m128i*)CZ, _mm_cvttps_epi32(CellZ));
+
+        // There is no gather in SSE so the corners are loaded one by one
+        const float* p0 = m_pHeights + CZ[0] * m_width + CX[0];
+        const float* p1 = m_pHeights + CZ[1] * m_width + CX[1];
+        const float* p2 = m_pHeights + CZ[2] * m_width + CX[2];
+        const float* p3 = m_pHeights + CZ[3] * m_width + CX[3];
+
+        __m128 h00 = _mm_setr_ps(p0[0], p1[0], p2[0], p3[0]);
+        __m128 h10 = _mm_setr_ps(p0[1], p1[1], p2[1], p3[1]);
+        __m128 h01 = _mm_setr_ps(p0[m_width], p1[m_width], p2[m_width], p3[m_width]);
+        __m128 h11 = _mm_setr_ps(p0[m_width + 1], p1[m_width + 1], p2[m_width + 1], p3[m_width + 1]);
+
+        __m128 Bottom = _mm_add_ps(h00, _mm_mul_ps(_mm_sub_ps(h10, h00), FactorX));
+        __m128 Top = _mm_add_ps(h01, _mm_mul_ps(_mm_sub_ps(h11, h01), FactorX));
+
+        _mm_storeu_ps(pHeights + i, _mm_add_ps(Bottom, _mm_mul_ps(_mm_sub_ps(Top, Bottom), FactorZ)));
+    }
+#endif
+
+    for ( ; i < Count ; i++) {
+        pHeights[i] = GetHeight(pX[i], pZ[i]);
+    }
+}
+
+
+void HeightFieldQueries::GetNormals(const float* pX, const float* pZ, float* pNormalX, float* pNormalY, float* pNormalZ, int Count) const
+{
+    int i = 0;
+
+#ifdef HEIGHTFIELD_USE_SSE
+    __m128 InvWorldScale = _mm_set1_ps(m_invWorldScale);
+    __m128 Zero = _mm_setzero_ps();
+    __m128 One = _mm_set1_ps(1.0f);
+    __m128 MaxX = _mm_set1_ps((float)(m_width - 1));
+    __m128 MaxZ = _mm_set1_ps((float)(m_depth - 1));
+    __m128 MaxCellX = _mm_set1_ps((float)(m_width - 2));
+    __m128 MaxCellZ = _mm_set1_ps((float)(m_depth - 2));
+
+    for ( ; i + 4 <= Count ; i += 4) {
+        __m128 x = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(pX + i), InvWorldScale), Zero), MaxX);
+        __m128 z = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(pZ + i), InvWorldScale), Zero), MaxZ);
+
+        __m128 CellX = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(x)), MaxCellX);
+        __m128 CellZ = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(z)), MaxCellZ);
+
+        __m128 FactorX = _mm_sub_ps(x, CellX);
+        __m128 FactorZ = _mm_sub_ps(z, CellZ);
+
+        int CX[4], CZ[4];
+        _mm_storeu_si128((__m128i*)CX, _mm_cvttps_epi32(CellX));
+        _mm_storeu_si128((__m128i*)CZ, _mm_cvttps_epi32(CellZ));
+
+        const float* p0 = m_pHeights + CZ[0] * m_width + CX[0];
+        const float* p1 = m_pHeights + CZ[1] * m_width + CX[1];
+        const float* p2 = m_pHeights + CZ[2] * m_width + CX[2];
+        const float* p3 = m_pHeights + CZ[3] * m_width + CX[3];
+
+        __m128 h00 = _mm_setr_ps(p0[0], p1[0], p2[0], p3[0]);
+        __m128 h10 = _mm_setr_ps(p0[1], p1[1], p2[1], p3[1]);
+        __m128 h01 = _mm_setr_ps(p0[m_width], p1[m_width], p2[m_width], p3[m_width]);
+        __m128 h11 = _mm_setr_ps(p0[m_width + 1], p1[m_width + 1], p2[m_width + 1], p3[m_width + 1]);
+
+        __m128 dx = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(h10, h00), _mm_sub_ps(One, FactorZ)), _mm_mul_ps(_mm_sub_ps(h11, h01), FactorZ));
+        __m128 dz = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(h01, h00), _mm_sub_ps(One, FactorX)), _mm_mul_ps(_mm_sub_ps(h11, h10), FactorX));
+
+        // (-dx, 1, -dz) normalized
+        dx = _mm_mul_ps(dx, InvWorldScale);
+        dz = _mm_mul_ps(dz, InvWorldScale);
+
+        __m128 InvLength = _mm_div_ps(One, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz)), One)));
+
+        _mm_storeu_ps(pNormalX + i, _mm_sub_ps(Zero, _mm_mul_ps(dx, InvLength)));
+        _mm_storeu_ps(pNormalY + i, InvLength);
+        _mm_storeu_ps(pNormalZ + i, _mm_sub_ps(Zero, _mm_mul_ps(dz, InvLength)));
+    }
+#endif
+
+    for ( ; i < Count ; i++) {
+        Vector3f Normal = GetNormal(pX[i], pZ[i]);
+        pNormalX[i] = Normal.x;
+        pNormalY[i] = Normal.y;
+        pNormalZ[i] = Normal.z;
+    }
+}
+
+
+// Clips [TMin, TMax] to the box [MinX, MaxX] x [-inf, MaxY] x [MinZ, MaxZ]. The bottom of the
+// box is open - a ray which is below the minimum height is found by the cell test.
+bool HeightFieldQueries::IntersectBox(const Ray& r, float MinX, float MinZ, float MaxX, float MaxZ, float MaxY,
+                                      float TMin, float TMax, float& TEnter, float& TExit) const
+{
+    if (r.DirX != 0.0f) {
+        float t0 = (MinX - r.OriginX) * r.InvDirX;
+        float t1 = (MaxX - r.OriginX) * r.InvDirX;
+        TMin = std::max(TMin, std::min(t0, t1));
+        TMax = std::min(TMax, std::max(t0, t1));
+    } else if ((r.OriginX < MinX) || (r.OriginX > MaxX)) {
+        return false;
+    }
+
+    if (r.DirZ != 0.0f) {
+        float t0 = (MinZ - r.OriginZ) * r.InvDirZ;
+        float t1 = (MaxZ - r.OriginZ) * r.InvDirZ;
+        TMin = std::max(TMin, std::min(t0, t1));
+        TMax = std::min(TMax, std::max(t0, t1));
+    } else if ((r.OriginZ < MinZ) || (r.OriginZ > MaxZ)) {
+        return false;
+    }
+
+    if (r.DirY > 0.0f) {
+        TMax = std::min(TMax, (MaxY - r.OriginY) / r.DirY);
+    } else if (r.DirY < 0.0f) {
+        TMin = std::max(TMin, (MaxY - r.OriginY) / r.DirY);
+    } else if (r.OriginY > MaxY) {
+        return false;
+    }
+
+    TEnter = TMin;
+    TExit = TMax;
+
+    return TMin <= TMax;
+}
+
+
+bool HeightFieldQueries::RayCast(const Vector3f& Origin, const Vector3f& Dir, float MaxDistance, TerrainRayHit& Hit) const
+{
+    Ray r;
+    r.OriginX = Origin.x * m_invWorldScale;
+    r.OriginY = Origin.y;
+    r.OriginZ = Origin.z * m_invWorldScale;
+    r.DirX = Dir.x * m_invWorldScale;
+    r.DirY = Dir.y;
+    r.DirZ = Dir.z * m_invWorldScale;
+    r.InvDirX = (r.DirX != 0.0f) ? 1.0f / r.DirX : 0.0f;
+    r.InvDirZ = (r.DirZ != 0.0f) ? 1.0f / r.DirZ : 0.0f;
+
+    float THit = 0.0f;
+
+    if (!RayCastNode(r, (int)m_pyramid.size() - 1, 0, 0, 0.0f, MaxDistance, THit)) {
+        return false;
+    }
+
+    Hit.Distance = THit;
+    Hit.Pos = Origin + Dir * THit;
+
+    return true;
+}
+
+
+bool HeightFieldQueries::RayCastNode(const Ray& r, int Level, int NodeX, int NodeZ, float TMin, float TMax, float& THit) const
+{
+    const PyramidLevel& CurLevel = m_pyramid[Level];
+
+    int MinX, MinZ, MaxX, MaxZ;
+    GetCellBounds(Level, NodeX, NodeZ, MinX, MinZ, MaxX, MaxZ);
+
+    float TEnter, TExit;
+
+    if (!IntersectBox(r, (float)MinX, (float)MinZ, (float)MaxX, (float)MaxZ, CurLevel.MinMax[NodeZ * CurLevel.Width + NodeX].Max,
+                      TMin, TMax, TEnter, TExit)) {
+        return false;
+    }
+
+    if (Level == 0) {
+        return RayCastBlock(r, NodeX, NodeZ, TEnter, TExit, THit);
+    }
+
+    // The children don't overlap on the XZ plane so visiting them in the order
+    // in which the ray enters them means the first hit is the closest one.
+    struct Child {
+        int x, z;
+        float TEnter;
+    };
+
+    Child Children[4];
+    int NumChildren = 0;
+
+    const PyramidLevel& ChildLevel = m_pyramid[Level - 1];
+
+    for (int z = NodeZ * 2 ; z < std::min(NodeZ * 2 + 2, ChildLevel.Depth) ; z++) {
+        for (int x = NodeX * 2 ; x < std::min(NodeX * 2 + 2, ChildLevel.Width) ; x++) {
+            int cMinX, cMinZ, cMaxX, cMaxZ;
+            GetCellBounds(Level - 1, x, z, cMinX, cMinZ, cMaxX, cMaxZ);
+
+            float cEnter, cExit;
+
+            if (IntersectBox(r, (float)cMinX, (float)cMinZ, (float)cMaxX, (float)cMaxZ, ChildLevel.MinMax[z * ChildLevel.Width + x].Max,
+                             TEnter, TExit, cEnter, cExit)) {
+                int i = NumChildren++;
+
+                while ((i > 0) && (Children[i - 1].TEnter > cEnter)) {
+                    Children[i] = Children[i - 1];
+                    i--;
+                }
+
+                Children[i].x = x;
+                Children[i].z = z;
+                Children[i].TEnter = cEnter;
+            }
+        }
+    }
+
+    for (int i = 0 ; i < NumChildren ; i++) {
+        if (RayCastNode(r, Level - 1, Children[i].x, Children[i].z, TEnter, TExit, THit)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+// Walks the cells of the block along the ray (Amanatides & Woo)
+bool HeightFieldQueries::RayCastBlock(const Ray& r, int BlockX, int BlockZ, float TMin, float TMax, float& THit) const
+{
+    int MinX, MinZ, MaxX, MaxZ;
+    GetCellBounds(0, BlockX, BlockZ, MinX, MinZ, MaxX, MaxZ);
+
+    float x = r.OriginX + r.DirX * TMin;
+    float z = r.OriginZ + r.DirZ * TMin;
+
+    int CellX = std::min(std::max((int)floorf(x), MinX), MaxX - 1);
+    int CellZ = std::min(std::max((int)floorf(z), MinZ), MaxZ - 1);
+
+    int StepX = (r.DirX > 0.0f) ? 1 : -1;
+    int StepZ = (r.DirZ > 0.0f) ? 1 : -1;
+
+    float TNextX = FLT_MAX;
+    float TNextZ = FLT_MAX;
+
+    if (r.DirX != 0.0f) {
+        TNextX = ((float)(CellX + (StepX > 0 ? 1 : 0)) - r.OriginX) * r.InvDirX;
+    }
+
+    if (r.DirZ != 0.0f) {
+        TNextZ = ((float)(CellZ + (StepZ > 0 ? 1 : 0)) - r.OriginZ) * r.InvDirZ;
+    }
+
+    float TDeltaX = (r.DirX != 0.0f) ? fabsf(r.InvDirX) : FLT_MAX;
+    float TDeltaZ = (r.DirZ != 0.0f) ? fabsf(r.InvDirZ) : FLT_MAX;
+
+    float T = TMin;
+
+    while (true) {
+        float TCellExit = std::min(std::min(TNextX, TNextZ), TMax);
+
+        if (RayCastCell(r, CellX, CellZ, T, std::max(T, TCellExit), THit)) {
+            return true;
+        }
+
+        if (TCellExit >= TMax) {
+            return false;
+        }
+
+        if (TNextX < TNextZ) {
+            CellX += StepX;
+            TNextX += TDeltaX;
+        } else {
+            CellZ += StepZ;
+            TNextZ += TDeltaZ;
+        }
+
+        if ((CellX < MinX) || (CellX >= MaxX) || (CellZ < MinZ) || (CellZ >= MaxZ)) {
+            return false;
+        }
+
+        T = TCellExit;
+    }
+}
+
+
+//
+// Within a cell the surface is h(u, v) = h00 + a * u + b * v + k * u * v and the
+// ray is linear in t, so the height of the ray above the surface is a quadratic
+// in t. It is solved relative to TMin to keep the coefficients small.
+//
+bool HeightFieldQueries::RayCastCell(const Ray& r, int CellX, int CellZ, float TMin, float TMax, float& THit) const
+{
+    const float* p = m_pHeights + CellZ * m_width + CellX;
+
+    double h00 = p[0];
+    double a = p[1] - h00;
+    double b = p[m_width] - h00;
+    double k = h00 - p[1] - p[m_width] + p[m_width + 1];
+
+    double u = r.OriginX + (double)r.DirX * TMin - CellX;
+    double v = r.OriginZ + (double)r.DirZ * TMin - CellZ;
+    double y = r.OriginY + (double)r.DirY * TMin;
+    double du = r.DirX;
+    double dv = r.DirZ;
+
+    double C = y - h00 - a * u - b * v - k * u * v;
+
+    // Already below the surface where the ray enters the cell
+    if (C <= 0.0) {
+        THit = TMin;
+        return true;
+    }
+
+    double A = -k * du * dv;
+    double B = r.DirY - a * du - b * dv - k * (u * dv + v * du);
+    double S = (double)TMax - (double)TMin;
+
+    double s = -1.0;
+
+    if (fabs(A) < 1e-12) {
+        if (B < 0.0) {
+            s = -C / B;
+        }
+    } else {
+        double Disc = B * B - 4.0 * A * C;
+
+        if (Disc >= 0.0) {
+            // Numerically stable roots
+            double q = -0.5 * (B + (B >= 0.0 ? sqrt(Disc) : -sqrt(Disc)));
+            double s0 = q / A;
+            double s1 = (q != 0.0) ? C / q : -1.0;
+
+            if (s0 > s1) {
+                std::swap(s0, s1);
+            }
+
+            s = (s0 >= 0.0) ? s0 : s1;
+        }
+    }
+
+    if ((s < 0.0) || (s > S)) {
+        return false;
+    }
+
+    THit = TMin + (float)s;
+
+    return true;
+}
+
+
+void HeightFieldQueries::RayCastBatch(const float* pOriginX, const float* pOriginY, const float* pOriginZ,
+                                      const float* pDirX, const float* pDirY, const float* pDirZ,
+                                      float MaxDistance, float* pDistances, int Count) const
+{
+    for (int i = 0 ; i < Count ; i++) {
+        TerrainRayHit Hit;
+
+        if (RayCast(Vector3f(pOriginX[i], pOriginY[i], pOriginZ[i]), Vector3f(pDirX[i], pDirY[i], pDirZ[i]), MaxDistance, Hit)) {
+            pDistances[i] = Hit.Distance;
+        } else {
+            pDistances[i] = -1.0f;
+        }
+    }
+}
+
+
+bool HeightFieldQueries::IsVisible(const Vector3f& From, const Vector3f& To) const
+{
+    TerrainRayHit Hit;
+
+    return !RayCast(From, To - From, 1.0f, Hit);
+}
+
+
+bool HeightFieldQueries::RayMarch(const Vector3f& Origin, const Vector3f& Dir, float MaxDistance, TerrainRayHit& Hit) const
+{
+    float WorldSizeX = (float)(m_width - 1) * m_worldScale;
+    float WorldSizeZ = (float)(m_depth - 1) * m_worldScale;
+
+    // A quarter of a cell on the XZ plane or a quarter of a world unit vertically
+    float MaxStep = std::max(std::max(fabsf(Dir.x), fabsf(Dir.z)) * m_invWorldScale, fabsf(Dir.y));
+
+    if (MaxStep == 0.0f) {
+        return false;
+    }
+
+    float Step = 0.25f / MaxStep;
+
+    float PrevT = 0.0f;
+    bool PrevInside = false;
+
+    for (float t = 0.0f ; t <= MaxDistance + Step ; t += Step) {
+        t = std::min(t, MaxDistance);
+
+        Vector3f p = Origin + Dir * t;
+
+        bool Inside = (p.x >= 0.0f) && (p.x <= WorldSizeX) && (p.z >= 0.0f) && (p.z <= WorldSizeZ);
+
+        if (Inside && (p.y <= GetHeight(p.x, p.z))) {
+            float Low = PrevInside ? PrevT : t;
+            float High = t;
+
+            // Refine the crossing between the last point above the surface and this one
+            for (int i = 0 ; i < 24 ; i++) {
+                float Mid = (Low + High) * 0.5f;
+                Vector3f m = Origin + Dir * Mid;
+
+                if (m.y <= GetHeight(m.x, m.z)) {
+                    High = Mid;
+                } else {
+                    Low = Mid;
+                }
+            }
+
+            Hit.Distance = High;
+            Hit.Pos = Origin + Dir * High;
+            return true;
+        }
+
+        if (t == MaxDistance) {
+            break;
+        }
+
+        PrevT = t;
+        PrevInside = Inside;
+    }
+
+    return false;
+}
+
+
+static float BenchmarkHeight(int x, int z)
+{
+    float Height = 0.0f;
+    float Amplitude = 300.0f;
+    float Frequency = 0.002f;
+
+    for (int Octave = 0 ; Octave < 6 ; Octave++) {
+        Height += Amplitude * sinf((float)x * Frequency + (float)Octave) * cosf((float)z * Frequency * 1.3f + (float)Octave * 0.7f);
+        Amplitude *= 0.45f;
+        Frequency *= 2.1f;
+    }
+
+    return Height + HashRandomFloat(17, x, z) * 2.0f;
+}
+
+
+static double MillisSince(std::chrono::high_resolution_clock::time_point Start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - Start).count();
+}
+
+
+void HeightFieldQueriesBenchmark()
+{
+    const int Size = 4097;
+    const float WorldScale = 4.0f;
+    const int CellsPerBlock = 16;
+    const int NumQueries = 1 << 20;
+    const int NumRays = 1 << 16;
+    const int NumRayMarches = 1 << 12;
+    const float MaxRayDistance = 4000.0f;
+
+    Array2D<float> HeightMap;
+    HeightMap.InitArray2D(Size, Size);
+
+    for (int z = 0 ; z < Size ; z++) {
+        for (int x = 0 ; x < Size ; x++) {
+            HeightMap.Set(x, z, BenchmarkHeight(x, z));
+        }
+    }
+
+    HeightFieldQueries Queries;
+    Queries.Init(&HeightMap, Size, Size, WorldScale, CellsPerBlock);
+
+    float WorldSize = (float)(Size - 1) * WorldScale;
+
+    std::vector<float> X(NumQueries), Z(NumQueries), Heights(NumQueries), NX(NumQueries), NY(NumQueries), NZ(NumQueries);
+
+    for (int i = 0 ; i < NumQueries ; i++) {
+        X[i] = HashRandomFloatRange(1, i, 0, 0.0f, WorldSize);
+        Z[i] = HashRandomFloatRange(1, i, 1, 0.0f, WorldSize);
+    }
+
+    // Heights
+    auto StartTime = std::chrono::high_resolution_clock::now();
+
+    float Sum = 0.0f;
+
+    for (int i = 0 ; i < NumQueries ; i++) {
+        Sum += Queries.GetHeight(X[i], Z[i]);
+    }
+
+    double ScalarMs = MillisSince(StartTime);
+
+    StartTime = std::chrono::high_resolution_clock::now();
+    Queries.GetHeights(X.data(), Z.data(), Heights.data(), NumQueries);
+    double BatchMs = MillisSince(StartTime);
+
+    float MaxError = 0.0f;
+
+    for (int i = 0 ; i < NumQueries ; i++) {
+        MaxError = std::max(MaxError, fabsf(Heights[i] - Queries.GetHeight(X[i], Z[i])));
+    }
+
+    printf("Heights: single %.0f queries/ms, batched %.0f queries/ms (max difference %f, checksum %f)\n",
+           NumQueries / ScalarMs, NumQueries / BatchMs, MaxError, Sum);
+
+    // Normals
+    StartTime = std::chrono::high_resolution_clock::now();
+
+    Vector3f NormalSum(0.0f, 0.0f, 0.0f);
+
+    for (int i = 0 ; i < NumQueries ; i++) {
+        NormalSum += Queries.GetNormal(X[i], Z[i]);
+    }
+
+    ScalarMs = MillisSince(StartTime);
+
+    StartTime = std::chrono::high_resolution_clock::now();
+    Queries.GetNormals(X.data(), Z.data(), NX.data(), NY.data(), NZ.data(), NumQueries);
+    BatchMs = MillisSince(StartTime);
+
+    MaxError = 0.0f;
+
+    for (int i = 0 ; i < NumQueries ; i++) {
+        Vector3f Normal = Queries.GetNormal(X[i], Z[i]);
+        MaxError = std::max(MaxError, fabsf(NX[i] - Normal.x) + fabsf(NY[i] - Normal.y) + fabsf(NZ[i] - Normal.z));
+    }
+
+    printf("Normals: single %.0f queries/ms, batched %.0f queries/ms (max difference %f, checksum %f)\n",
+           NumQueries / ScalarMs, NumQueries / BatchMs, MaxError, NormalSum.y);
+
+    // Rays from a few meters above the ground, mostly horizontal like line of sight tests
+    std::vector<float> OX(NumRays), OY(NumRays), OZ(NumRays), DX(NumRays), DY(NumRays), DZ(NumRays), Distances(NumRays);
+
+    for (int i = 0 ; i < NumRays ; i++) {
+        OX[i] = HashRandomFloatRange(2, i, 0, 0.0f, WorldSize);
+        OZ[i] = HashRandomFloatRange(2, i, 1, 0.0f, WorldSize);
+        OY[i] = Queries.GetHeight(OX[i], OZ[i]) + HashRandomFloatRange(2, i, 2, 2.0f, 50.0f);
+
+        float Angle = HashRandomFloatRange(2, i, 3, 0.0f, 2.0f * (float)M_PI);
+        Vector3f Dir(cosf(Angle), HashRandomFloatRange(2, i, 4, -0.3f, 0.1f), sinf(Angle));
+        Dir.Normalize();
+
+        DX[i] = Dir.x;
+        DY[i] = Dir.y;
+        DZ[i] = Dir.z;
+    }
+
+    StartTime = std::chrono::high_resolution_clock::now();
+    Queries.RayCastBatch(OX.data(), OY.data(), OZ.data(), DX.data(), DY.data(), DZ.data(), MaxRayDistance, Distances.data(), NumRays);
+    double RayCastMs = MillisSince(StartTime);
+
+    int NumHits = 0;
+
+    for (int i = 0 ; i < NumRays ; i++) {
+        NumHits += (Distances[i] >= 0.0f) ? 1 : 0;
+    }
+
+    // Compare a subset against the brute force ray marcher
+    StartTime = std::chrono::high_resolution_clock::now();
+
+    int NumErrors = 0;
+    int NumGrazingHits = 0;
+
+    for (int i = 0 ; i < NumRayMarches ; i++) {
+        Vector3f Origin(OX[i], OY[i], OZ[i]);
+        Vector3f Dir(DX[i], DY[i], DZ[i]);
+
+        TerrainRayHit Hit;
+        bool IsHit = Queries.RayMarch(Origin, Dir, MaxRayDistance, Hit);
+
+        bool IsCastHit = (Distances[i] >= 0.0f);
+
+        if (IsCastHit && (!IsHit || (Distances[i] < Hit.Distance - 0.01f))) {
+            // The marcher can step over a ridge which the ray only grazes. That's
+            // fine as long as the hit of the ray caster is really on the surface.
+            Vector3f Pos = Origin + Dir * Distances[i];
+
+            if (fabsf(Pos.y - Queries.GetHeight(Pos.x, Pos.z)) < 0.01f) {
+                NumGrazingHits++;
+            } else {
+                NumErrors++;
+            }
+        } else if (IsHit != IsCastHit) {
+            NumErrors++;
+        } else if (IsHit && (fabsf(Hit.Distance - Distances[i]) > 0.01f)) {
+            NumErrors++;
+        }
+    }
+
+    double RayMarchMs = MillisSince(StartTime);
+
+    printf("Rays (up to %.0f units): min/max pyramid %.1f rays/ms, ray marching %.2f rays/ms, %d%% hit\n",
+           MaxRayDistance, NumRays / RayCastMs, NumRayMarches / RayMarchMs, NumHits * 100 / NumRays);
+    printf("Compared with ray marching: %d errors, %d grazing hits missed by the marcher out of %d rays\n",
+           NumErrors, NumGrazingHits, NumRayMarches);
+}
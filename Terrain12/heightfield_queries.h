@@ -0,0 +1,125 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef HEIGHTFIELD_QUERIES_H
+#define HEIGHTFIELD_QUERIES_H
+
+#include <vector>
+
+#include "ogldev_math_3d.h"
+#include "ogldev_array_2d.h"
+#include "tiled_heightmap.h"
+
+struct TerrainRayHit {
+    float Distance = 0.0f;      // along the ray, in units of the ray direction
+    Vector3f Pos;
+};
+
+//
+// Height, normal and ray queries against the height map of the terrain.
+// The heights are sampled bilinearly (same as BaseTerrain::GetHeightInterpolated)
+// so the rays hit exactly the surface the height queries return. All the
+// coordinates are in world space and the batched versions take a structure of
+// arrays which is processed four queries at a time with SSE.
+//
+// The ray caster walks a min/max pyramid over blocks of CellsPerBlock x CellsPerBlock
+// cells (usually the geomip patches): a node is only entered when the ray passes below
+// its maximum height, and the children are visited front to back so the first hit
+// found is the closest one.
+//
+class HeightFieldQueries {
+ public:
+    HeightFieldQueries() {}
+
+    // The height map must stay alive while the queries are used
+    void Init(const Array2D<float>* pHeightMap, int Width, int Depth, float WorldScale, int CellsPerBlock);
+
+    // Must be called after the heights in [StartX, EndX) x [StartZ, EndZ) are modified
+    void UpdateRegion(int StartX, int StartZ, int EndX, int EndZ);
+
+    float GetHeight(float WorldX, float WorldZ) const;
+
+    Vector3f GetNormal(float WorldX, float WorldZ) const;
+
+    void GetHeights(const float* pX, const float* pZ, float* pHeights, int Count) const;
+
+    void GetNormals(const float* pX, const float* pZ, float* pNormalX, float* pNormalY, float* pNormalZ, int Count) const;
+
+    // Finds the closest intersection in [0, MaxDistance]. Dir doesn't need to be normalized.
+    bool RayCast(const Vector3f& Origin, const Vector3f& Dir, float MaxDistance, TerrainRayHit& Hit) const;
+
+    // pDistances receives the distance of the hit or -1 for rays that don't hit the terrain
+    void RayCastBatch(const float* pOriginX, const float* pOriginY, const float* pOriginZ,
+                      const float* pDirX, const float* pDirY, const float* pDirZ,
+                      float MaxDistance, float* pDistances, int Count) const;
+
+    // True if nothing blocks the segment between the two points
+    bool IsVisible(const Vector3f& From, const Vector3f& To) const;
+
+    // Slow reference for RayCast - marches along the ray in steps of a fraction of a cell
+    bool RayMarch(const Vector3f& Origin, const Vector3f& Dir, float MaxDistance, TerrainRayHit& Hit) const;
+
+ private:
+
+    struct PyramidLevel {
+        int Width = 0;
+        int Depth = 0;
+        std::vector<MinMaxHeight> MinMax;
+    };
+
+    // The ray in height map units - x/z in cells, y in world units
+    struct Ray {
+        float OriginX, OriginY, OriginZ;
+        float DirX, DirY, DirZ;
+        float InvDirX, InvDirZ;
+    };
+
+    void CalcBlockMinMax(int BlockX, int BlockZ, MinMaxHeight& MinMax) const;
+
+    void UpdatePyramidLevel(int Level, int StartX, int StartZ, int EndX, int EndZ);
+
+    void ClampToGrid(float& x, float& z, int& CellX, int& CellZ) const;
+
+    void GetCellBounds(int Level, int NodeX, int NodeZ, int& MinX, int& MinZ, int& MaxX, int& MaxZ) const;
+
+    bool IntersectBox(const Ray& r, float MinX, float MinZ, float MaxX, float MaxZ, float MaxY,
+                      float TMin, float TMax, float& TEnter, float& TExit) const;
+
+    bool RayCastNode(const Ray& r, int Level, int NodeX, int NodeZ, float TMin, float TMax, float& THit) const;
+
+    bool RayCastBlock(const Ray& r, int BlockX, int BlockZ, float TMin, float TMax, float& THit) const;
+
+    bool RayCastCell(const Ray& r, int CellX, int CellZ, float TMin, float TMax, float& THit) const;
+
+    const Array2D<float>* m_pHeightMap = NULL;
+    const float* m_pHeights = NULL;         // the height map bypassing the bounds checks of Array2D
+    int m_width = 0;
+    int m_depth = 0;
+    float m_worldScale = 1.0f;
+    float m_invWorldScale = 1.0f;
+    int m_cellsPerBlock = 0;
+    int m_numBlocksX = 0;
+    int m_numBlocksZ = 0;
+    std::vector<PyramidLevel> m_pyramid;    // level zero has one entry per block
+};
+
+// Throughput of the batched queries and the ray caster in queries per millisecond
+void HeightFieldQueriesBenchmark();
+
+#endif
@@ -0,0 +1,126 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+
+#include "lod_benchmark.h"
+#include "lod_manager.h"
+
+#define LOD_BENCHMARK_PATCH_SIZE  33
+#define LOD_BENCHMARK_WORLD_SCALE 2.0f
+#define LOD_BENCHMARK_NUM_FRAMES  600
+
+enum LOD_UPDATE_TYPE {
+    LOD_UPDATE_FULL_SINGLE_THREAD,
+    LOD_UPDATE_FULL_MULTI_THREAD,
+    LOD_UPDATE_INCREMENTAL,
+    LOD_UPDATE_NUM_TYPES
+};
+
+static const char* LodUpdateNames[LOD_UPDATE_NUM_TYPES] = { "full, 1 thread", "full, all threads", "incremental" };
+
+
+// Circles around the center of the terrain at a constant height
+static Vector3f GetCameraPos(float WorldSize, float Speed, int Frame)
+{
+    float Radius = WorldSize / 4.0f;
+    float Angle = Speed * (float)Frame / Radius;
+
+    return Vector3f(WorldSize / 2.0f + Radius * cosf(Angle), 50.0f, WorldSize / 2.0f + Radius * sinf(Angle));
+}
+
+
+static bool IsSameLodMap(const LodManager& l, const LodManager& r, int NumPatchesX, int NumPatchesZ)
+{
+    for (int z = 0 ; z < NumPatchesZ ; z++) {
+        for (int x = 0 ; x < NumPatchesX ; x++) {
+            const LodManager::PatchLod& a = l.GetPatchLod(x, z);
+            const LodManager::PatchLod& b = r.GetPatchLod(x, z);
+
+            if ((a.Core != b.Core) || (a.Left != b.Left) || (a.Right != b.Right) ||
+                (a.Top != b.Top) || (a.Bottom != b.Bottom)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+static void RunLodBenchmark(int TerrainSize, const char* pPathName, float Speed)
+{
+    int NumPatches = (TerrainSize - 1) / (LOD_BENCHMARK_PATCH_SIZE - 1);
+    float WorldSize = (float)(TerrainSize - 1) * LOD_BENCHMARK_WORLD_SCALE;
+
+    LodManager Managers[LOD_UPDATE_NUM_TYPES];
+
+    for (int i = 0 ; i < LOD_UPDATE_NUM_TYPES ; i++) {
+        Managers[i].InitLodManager(LOD_BENCHMARK_PATCH_SIZE, NumPatches, NumPatches, LOD_BENCHMARK_WORLD_SCALE);
+    }
+
+    Managers[LOD_UPDATE_FULL_SINGLE_THREAD].SetIncremental(false);
+    Managers[LOD_UPDATE_FULL_SINGLE_THREAD].SetNumThreads(1);
+    Managers[LOD_UPDATE_FULL_MULTI_THREAD].SetIncremental(false);
+
+    long long TotalMicros[LOD_UPDATE_NUM_TYPES] = { 0 };
+    long long NumPatchesUpdated = 0;
+    int NumMismatches = 0;
+
+    for (int Frame = 0 ; Frame < LOD_BENCHMARK_NUM_FRAMES ; Frame++) {
+        Vector3f CameraPos = GetCameraPos(WorldSize, Speed, Frame);
+
+        for (int i = 0 ; i < LOD_UPDATE_NUM_TYPES ; i++) {
+            auto StartTime = std::chrono::high_resolution_clock::now();
+            Managers[i].Update(CameraPos);
+            auto EndTime = std::chrono::high_resolution_clock::now();
+            TotalMicros[i] += std::chrono::duration_cast<std::chrono::microseconds>(EndTime - StartTime).count();
+        }
+
+        NumPatchesUpdated += Managers[LOD_UPDATE_INCREMENTAL].GetNumPatchesUpdated();
+
+        for (int i = 1 ; i < LOD_UPDATE_NUM_TYPES ; i++) {
+            if (!IsSameLodMap(Managers[0], Managers[i], NumPatches, NumPatches)) {
+                NumMismatches++;
+            }
+        }
+    }
+
+    printf("%dx%d terrain (%dx%d patches), %s at %.1f units/frame:\n", TerrainSize, TerrainSize, NumPatches, NumPatches, pPathName, Speed);
+
+    for (int i = 0 ; i < LOD_UPDATE_NUM_TYPES ; i++) {
+        printf("    %-20s %8.3f ms/frame\n", LodUpdateNames[i], (double)TotalMicros[i] / 1000.0 / LOD_BENCHMARK_NUM_FRAMES);
+    }
+
+    printf("    incremental update evaluated %.1f%% of the patches per frame, %d mismatching frames\n",
+           100.0 * (double)NumPatchesUpdated / ((double)NumPatches * NumPatches * LOD_BENCHMARK_NUM_FRAMES), NumMismatches);
+}
+
+
+void LodUpdateBenchmark()
+{
+    int TerrainSizes[] = { 4097, 16385 };
+
+    for (int i = 0 ; i < 2 ; i++) {
+        RunLodBenchmark(TerrainSizes[i], "walking", 0.5f);
+        RunLodBenchmark(TerrainSizes[i], "flying", 20.0f);
+    }
+}
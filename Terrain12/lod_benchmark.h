@@ -0,0 +1,28 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef LOD_BENCHMARK_H
+#define LOD_BENCHMARK_H
+
+// Compares the full single threaded, full multi threaded and incremental
+// LodManager updates on 4k and 16k terrains along a walking and a flying
+// camera path. Also verifies that all of them produce the same LOD map.
+void LodUpdateBenchmark();
+
+#endif
@@ -1,8 +1,14 @@
 #include <stdio.h>
+#include <float.h>
+#include <algorithm>
+#include <thread>
 
 #include "lod_manager.h"
 #include "demo_config.h"
 
+// Full updates of smaller grids are not worth the cost of starting the threads
+#define LOD_MIN_PATCHES_PER_THREAD 4096
+
 
 int LodManager::InitLodManager(int PatchSize, int NumPatchesX, int NumPatchesZ, float WorldScale)
 {
@@ -20,10 +26,28 @@ int LodManager::InitLodManager(int PatchSize, int NumPatchesX, int NumPatchesZ,
 
     CalcLodRegions();
 
+    InitDistanceToLodTable();
+
+    m_slack.resize(NumPatchesX * NumPatchesZ);
+    m_fullUpdateDistance = (float)m_regions[0] / 2.0f;
+    m_isValid = false;
+
+    SetNumThreads(0);
+
     return m_maxLOD;
 }
 
 
+void LodManager::SetNumThreads(int NumThreads)
+{
+    if (NumThreads <= 0) {
+        NumThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+
+    m_numThreads = NumThreads;
+}
+
+
 void LodManager::CalcMaxLOD()
 {
     int NumSegments = m_patchSize - 1;
@@ -43,90 +67,224 @@ void LodManager::CalcMaxLOD()
 
 void LodManager::Update(const Vector3f& CameraPos)
 {
-    UpdateLodMapPass1(CameraPos);
-    UpdateLodMapPass2(CameraPos);
+    float CameraMovement = CameraPos.Distance(m_refCameraPos);
+
+    if (!m_isValid || !m_incremental || (CameraMovement > m_fullUpdateDistance)) {
+        FullUpdate(CameraPos);
+        return;
+    }
+
+    m_maxCameraMovement = std::max(m_maxCameraMovement, CameraMovement);
+
+    IncrementalUpdate(CameraPos);
 }
 
 
-void LodManager::UpdateLodMapPass1(const Vector3f& CameraPos)
+void LodManager::FullUpdate(const Vector3f& CameraPos)
 {
-    int CenterStep = m_patchSize / 2;
+    int NumThreads = std::min(m_numThreads, (m_numPatchesX * m_numPatchesZ) / LOD_MIN_PATCHES_PER_THREAD);
+    NumThreads = std::min(NumThreads, m_numPatchesZ);
+
+    if (NumThreads <= 1) {
+        UpdateLodMapPass1(CameraPos, 0, m_numPatchesZ);
+        UpdateLodMapPass2(0, m_numPatchesZ);
+    } else {
+        std::vector<std::thread> Threads(NumThreads);
+
+        int RowsPerThread = (m_numPatchesZ + NumThreads - 1) / NumThreads;
+
+        // Pass 2 reads the core LOD of the neighbours so all the
+        // threads must finish pass 1 before it can start
+        for (int i = 0 ; i < NumThreads ; i++) {
+            int StartZ = std::min(i * RowsPerThread, m_numPatchesZ);
+            int EndZ = std::min(StartZ + RowsPerThread, m_numPatchesZ);
+            Threads[i] = std::thread(&LodManager::UpdateLodMapPass1, this, CameraPos, StartZ, EndZ);
+        }
+
+        for (int i = 0 ; i < NumThreads ; i++) {
+            Threads[i].join();
+        }
+
+        for (int i = 0 ; i < NumThreads ; i++) {
+            int StartZ = std::min(i * RowsPerThread, m_numPatchesZ);
+            int EndZ = std::min(StartZ + RowsPerThread, m_numPatchesZ);
+            Threads[i] = std::thread(&LodManager::UpdateLodMapPass2, this, StartZ, EndZ);
+        }
+
+        for (int i = 0 ; i < NumThreads ; i++) {
+            Threads[i].join();
+        }
+    }
+
+    if (m_incremental) {
+        SortCandidates();
+    }
+
+    m_refCameraPos = CameraPos;
+    m_maxCameraMovement = 0.0f;
+    m_isValid = true;
+    m_numPatchesUpdated = m_numPatchesX * m_numPatchesZ;
+}
 
-    for (int LodMapZ = 0 ; LodMapZ < m_numPatchesZ ; LodMapZ++) {
-        for (int LodMapX = 0 ; LodMapX < m_numPatchesX ; LodMapX++) {
-            int x = LodMapX * (m_patchSize - 1) + CenterStep;
-            int z = LodMapZ * (m_patchSize - 1) + CenterStep;
 
-            Vector3f PatchCenter = Vector3f(x * (float)m_worldScale, 0.0f, z * (float)m_worldScale);
+// Counting sort with buckets of one world unit. The order within a bucket
+// doesn't matter because the list is only used to find the patches whose
+// slack is below some distance.
+void LodManager::SortCandidates()
+{
+    int NumBuckets = (int)m_fullUpdateDistance + 1;
 
-            float DistanceToCamera = CameraPos.Distance(PatchCenter);
+    m_bucketCounts.assign(NumBuckets + 1, 0);
 
-            int CoreLod = DistanceToLod(DistanceToCamera);
+    int NumPatches = m_numPatchesX * m_numPatchesZ;
 
-            PatchLod* pPatchLOD = m_map.GetAddr(LodMapX, LodMapZ);
-            pPatchLOD->Core = CoreLod;
+    for (int i = 0 ; i < NumPatches ; i++) {
+        if (m_slack[i] <= m_fullUpdateDistance) {
+            m_bucketCounts[(int)m_slack[i] + 1]++;
+        }
+    }
+
+    for (int i = 1 ; i <= NumBuckets ; i++) {
+        m_bucketCounts[i] += m_bucketCounts[i - 1];
+    }
+
+    m_candidates.resize(m_bucketCounts[NumBuckets]);
+
+    for (int i = 0 ; i < NumPatches ; i++) {
+        if (m_slack[i] <= m_fullUpdateDistance) {
+            m_candidates[m_bucketCounts[(int)m_slack[i]]++] = i;
         }
     }
 }
 
 
-void LodManager::UpdateLodMapPass2(const Vector3f& CameraPos)
+// Moving the camera by D changes the distance to any patch center by at most D
+// so only the patches whose slack is within the largest movement of the camera
+// since the last full update can have a LOD other than the one of the full update.
+void LodManager::IncrementalUpdate(const Vector3f& CameraPos)
 {
-    int Step = m_patchSize / 2;
+    m_changedPatches.clear();
+    m_numPatchesUpdated = 0;
+
+    for (size_t i = 0 ; i < m_candidates.size() ; i++) {
+        int Index = m_candidates[i];
+
+        // The buckets are one unit wide so the list may be slightly out of order
+        if (m_slack[Index] > m_maxCameraMovement + 1.0f) {
+            break;
+        }
 
-    for (int LodMapZ = 0 ; LodMapZ < m_numPatchesZ ; LodMapZ++) {
+        if (m_slack[Index] > m_maxCameraMovement) {
+            continue;
+        }
+
+        int LodMapX = Index % m_numPatchesX;
+        int LodMapZ = Index / m_numPatchesX;
+
+        float Slack = 0.0f;
+        int CoreLod = CalcCoreLod(CameraPos, LodMapX, LodMapZ, Slack);
+
+        PatchLod& Lod = m_map.At(LodMapX, LodMapZ);
+
+        if (Lod.Core != CoreLod) {
+            Lod.Core = CoreLod;
+            m_changedPatches.push_back(Index);
+        }
+
+        m_numPatchesUpdated++;
+    }
+
+    // The stitching flags depend on the core LOD of the four neighbours
+    for (size_t i = 0 ; i < m_changedPatches.size() ; i++) {
+        int LodMapX = m_changedPatches[i] % m_numPatchesX;
+        int LodMapZ = m_changedPatches[i] / m_numPatchesX;
+
+        UpdateNeighbourFlags(LodMapX, LodMapZ);
+
+        if (LodMapX > 0)                 UpdateNeighbourFlags(LodMapX - 1, LodMapZ);
+        if (LodMapX < m_numPatchesX - 1) UpdateNeighbourFlags(LodMapX + 1, LodMapZ);
+        if (LodMapZ > 0)                 UpdateNeighbourFlags(LodMapX, LodMapZ - 1);
+        if (LodMapZ < m_numPatchesZ - 1) UpdateNeighbourFlags(LodMapX, LodMapZ + 1);
+    }
+}
+
+
+// Slack is the distance from the camera to the nearest edge of the LOD region
+int LodManager::CalcCoreLod(const Vector3f& CameraPos, int LodMapX, int LodMapZ, float& Slack) const
+{
+    int CenterStep = m_patchSize / 2;
+
+    int x = LodMapX * (m_patchSize - 1) + CenterStep;
+    int z = LodMapZ * (m_patchSize - 1) + CenterStep;
+
+    Vector3f PatchCenter = Vector3f(x * (float)m_worldScale, 0.0f, z * (float)m_worldScale);
+
+    float DistanceToCamera = CameraPos.Distance(PatchCenter);
+
+    int CoreLod = DistanceToLod(DistanceToCamera);
+
+    Slack = FLT_MAX;
+
+    if (CoreLod > 0) {
+        Slack = DistanceToCamera - (float)m_regions[CoreLod - 1];
+    }
+
+    if (CoreLod < m_maxLOD) {
+        Slack = std::min(Slack, (float)m_regions[CoreLod] - DistanceToCamera);
+    }
+
+    return CoreLod;
+}
+
+
+void LodManager::UpdateLodMapPass1(const Vector3f& CameraPos, int StartZ, int EndZ)
+{
+    for (int LodMapZ = StartZ ; LodMapZ < EndZ ; LodMapZ++) {
+        for (int LodMapX = 0 ; LodMapX < m_numPatchesX ; LodMapX++) {
+            float Slack = 0.0f;
+            int CoreLod = CalcCoreLod(CameraPos, LodMapX, LodMapZ, Slack);
+
+            m_map.At(LodMapX, LodMapZ).Core = CoreLod;
+            m_slack[LodMapZ * m_numPatchesX + LodMapX] = Slack;
+        }
+    }
+}
+
+
+void LodManager::UpdateLodMapPass2(int StartZ, int EndZ)
+{
+    for (int LodMapZ = StartZ ; LodMapZ < EndZ ; LodMapZ++) {
         for (int LodMapX = 0 ; LodMapX < m_numPatchesX ; LodMapX++) {
-            int CoreLod = m_map.Get(LodMapX, LodMapZ).Core;
-
-            int IndexLeft   = LodMapX;
-            int IndexRight  = LodMapX;
-            int IndexTop    = LodMapZ;
-            int IndexBottom = LodMapZ;
-
-            if (LodMapX > 0) {
-                IndexLeft--;
-
-                if (m_map.Get(IndexLeft, LodMapZ).Core > CoreLod) {
-                    m_map.At(LodMapX, LodMapZ).Left = 1;
-                } else {
-                    m_map.At(LodMapX, LodMapZ).Left = 0;
-                }
-            }
-
-            if (LodMapX < m_numPatchesX - 1) {
-                IndexRight++;
-
-                if (m_map.Get(IndexRight, LodMapZ).Core > CoreLod) {
-                    m_map.At(LodMapX, LodMapZ).Right = 1;
-                } else {
-                    m_map.At(LodMapX, LodMapZ).Right = 0;
-                }
-            }
-
-            if (LodMapZ > 0) {
-                IndexBottom--;
-
-                if (m_map.Get(LodMapX, IndexBottom).Core > CoreLod) {
-                    m_map.At(LodMapX, LodMapZ).Bottom = 1;
-                } else {
-                    m_map.At(LodMapX, LodMapZ).Bottom = 0;
-                }
-            }
-
-            if (LodMapZ < m_numPatchesZ - 1) {
-                IndexTop++;
-
-                if (m_map.Get(LodMapX, IndexTop).Core > CoreLod) {
-                    m_map.At(LodMapX, LodMapZ).Top = 1;
-                } else {
-                    m_map.At(LodMapX, LodMapZ).Top = 0;
-                }
-            }
+            UpdateNeighbourFlags(LodMapX, LodMapZ);
         }
     }
 }
 
 
+void LodManager::UpdateNeighbourFlags(int LodMapX, int LodMapZ)
+{
+    int CoreLod = m_map.Get(LodMapX, LodMapZ).Core;
+
+    PatchLod& Lod = m_map.At(LodMapX, LodMapZ);
+
+    if (LodMapX > 0) {
+        Lod.Left = (m_map.Get(LodMapX - 1, LodMapZ).Core > CoreLod) ? 1 : 0;
+    }
+
+    if (LodMapX < m_numPatchesX - 1) {
+        Lod.Right = (m_map.Get(LodMapX + 1, LodMapZ).Core > CoreLod) ? 1 : 0;
+    }
+
+    if (LodMapZ > 0) {
+        Lod.Bottom = (m_map.Get(LodMapX, LodMapZ - 1).Core > CoreLod) ? 1 : 0;
+    }
+
+    if (LodMapZ < m_numPatchesZ - 1) {
+        Lod.Top = (m_map.Get(LodMapX, LodMapZ + 1).Core > CoreLod) ? 1 : 0;
+    }
+}
+
+
 void LodManager::PrintLodMap()
 {
     for (int LodMapZ = m_numPatchesZ - 1 ; LodMapZ >= 0 ; LodMapZ--) {
@@ -139,18 +297,31 @@ void LodManager::PrintLodMap()
 }
 
 
-int LodManager::DistanceToLod(float Distance)
+int LodManager::DistanceToLod(float Distance) const
 {
-    int Lod = m_maxLOD;
+    int Index = (int)Distance;
 
-    for (int i = 0 ; i <= m_maxLOD ; i++) {
-        if (Distance < m_regions[i]) {
-            Lod = i;
-            break;
-        }
+    if (Index >= (int)m_distanceToLod.size()) {
+        return m_maxLOD;
     }
 
-    return Lod;
+    return m_distanceToLod[Index];
+}
+
+
+void LodManager::InitDistanceToLodTable()
+{
+    m_distanceToLod.resize(m_regions[m_maxLOD]);
+
+    int Lod = 0;
+
+    for (int i = 0 ; i < (int)m_distanceToLod.size() ; i++) {
+        while ((Lod < m_maxLOD) && (i >= m_regions[Lod])) {
+            Lod++;
+        }
+
+        m_distanceToLod[i] = Lod;
+    }
 }
 
 
@@ -11,8 +11,14 @@ class LodManager {
 
     int InitLodManager(int PatchSize, int NumPatchesX, int NumPatchesZ, float WorldScale);
 
+    // Only the patches whose LOD may have changed since the last full update are
+    // evaluated again. A full update (when the camera moves far enough from its
+    // position in the last one) is spread over NumThreads threads.
     void Update(const Vector3f& CameraPos);
 
+    // Recalculates every patch regardless of the camera movement
+    void FullUpdate(const Vector3f& CameraPos);
+
     struct PatchLod {
         int Core   = 0;
         int Left   = 0;
@@ -23,15 +29,31 @@ class LodManager {
 
     const PatchLod& GetPatchLod(int PatchX, int PatchZ) const;
 
+    // The far distance of every LOD
+    const std::vector<int>& GetLodRegions() const { return m_regions; }
+
+    // Zero means std::thread::hardware_concurrency()
+    void SetNumThreads(int NumThreads);
+
+    void SetIncremental(bool Incremental) { m_incremental = Incremental; m_isValid = false; }
+
+    // Number of patches evaluated by the last call to Update
+    int GetNumPatchesUpdated() const { return m_numPatchesUpdated; }
+
     void PrintLodMap();
 
  private:
     void CalcLodRegions();
     void CalcMaxLOD();
-    void UpdateLodMapPass1(const Vector3f& CameraPos);
-    void UpdateLodMapPass2(const Vector3f& CameraPos);
+    void InitDistanceToLodTable();
+    void UpdateLodMapPass1(const Vector3f& CameraPos, int StartZ, int EndZ);
+    void UpdateLodMapPass2(int StartZ, int EndZ);
+    void UpdateNeighbourFlags(int LodMapX, int LodMapZ);
+    int CalcCoreLod(const Vector3f& CameraPos, int LodMapX, int LodMapZ, float& Slack) const;
+    void SortCandidates();
+    void IncrementalUpdate(const Vector3f& CameraPos);
 
-    int DistanceToLod(float Distance);
+    int DistanceToLod(float Distance) const;
 
     int m_maxLOD = 0;
     int m_patchSize = 0;
@@ -41,6 +63,29 @@ class LodManager {
 
     Array2D<PatchLod> m_map;
     std::vector<int> m_regions;
+
+    // Entry i is the LOD of the distances in [i, i + 1). The regions are whole
+    // numbers so this matches the search over m_regions exactly.
+    std::vector<int> m_distanceToLod;
+
+    // How far the camera can move away from m_refCameraPos (the camera position of
+    // the last full update) before the LOD of the patch may change
+    std::vector<float> m_slack;
+
+    // The patches whose slack is below m_fullUpdateDistance sorted by their slack.
+    // Every patch on the list whose slack is smaller than the largest camera movement
+    // since the last full update is evaluated again - the rest still have the LOD of
+    // the last full update.
+    std::vector<int> m_candidates;
+    std::vector<int> m_bucketCounts;
+    float m_maxCameraMovement = 0.0f;
+    Vector3f m_refCameraPos;
+    bool m_isValid = false;
+    bool m_incremental = true;
+    float m_fullUpdateDistance = 0.0f;
+    std::vector<int> m_changedPatches;
+    int m_numThreads = 1;
+    int m_numPatchesUpdated = 0;
 };
 
 
@@ -16,8 +16,17 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <string.h>
+#include <chrono>
+
+#include "ogldev_parallel_for.h"
+#include "ogldev_hash_random.h"
 #include "midpoint_disp_terrain.h"
 
+// Rows of a single diamond/square step per thread. The first levels only
+// have a few points and run on the calling thread.
+#define MIN_ROWS_PER_THREAD 16
+
 void MidpointDispTerrain::CreateMidpointDisplacement(int TerrainSize, int PatchSize, float Roughness, float MinHeight, float MaxHeight)
 {
     if (Roughness < 0.0f) {
@@ -30,13 +39,133 @@ void MidpointDispTerrain::CreateMidpointDisplacement(int TerrainSize, int PatchS
 
     SetMinMaxHeight(MinHeight, MaxHeight);
 
+    InitHeightMap(TerrainSize, Roughness);
+
+    m_heightMap.Normalize(MinHeight, MaxHeight);
+
+    Finalize();    
+}
+
+
+void MidpointDispTerrain::CreateMidpointDisplacementParallel(int TerrainSize, int PatchSize, float Roughness, float MinHeight, float MaxHeight,
+                                                             uint Seed, int NumThreads)
+{
+    if (Roughness < 0.0f) {
+        printf("%s: roughness must be positive - %f\n", __FUNCTION__, Roughness);
+        exit(0);
+    }
+
+    m_terrainSize = TerrainSize;
+    m_patchSize = PatchSize;
+
+    SetMinMaxHeight(MinHeight, MaxHeight);
+
+    InitHeightMapParallel(TerrainSize, Roughness, Seed, NumThreads);
+
+    m_heightMap.Normalize(MinHeight, MaxHeight);
+
+    Finalize();
+}
+
+
+void MidpointDispTerrain::InitHeightMap(int TerrainSize, float Roughness)
+{
+    m_terrainSize = TerrainSize;
+
     m_heightMap.InitArray2D(TerrainSize, TerrainSize, 0.0f);
 
     CreateMidpointDisplacementF32(Roughness);
+}
 
-    m_heightMap.Normalize(MinHeight, MaxHeight);
 
-    Finalize();    
+//
+// Classic diamond-square on a (2^n + 1) x (2^n + 1) grid which covers the terrain.
+// Unlike the single threaded version there is no wrap around so every point
+// is written exactly once, by a single level, and every level only reads
+// points of previous levels (diamond step) or of the previous step (square
+// step). This makes all the points of a step independent so the rows are
+// split between the threads. The random offset of a point is a hash of the
+// seed and its coordinates so the order in which the points are processed
+// doesn't matter.
+//
+void MidpointDispTerrain::InitHeightMapParallel(int TerrainSize, float Roughness, uint Seed, int NumThreads)
+{
+    m_terrainSize = TerrainSize;
+
+    int RectSize = CalcNextPowerOfTwo(TerrainSize - 1);
+    int GridSize = RectSize + 1;
+
+    float* pGrid = (float*)calloc((size_t)GridSize * GridSize, sizeof(float));
+
+    if (!pGrid) {
+        printf("%s:%d - failed to allocate %dx%d heights\n", __FILE__, __LINE__, GridSize, GridSize);
+        exit(0);
+    }
+
+    float CurHeight = (float)RectSize / 2.0f;
+    float HeightReduce = powf(2.0f, -Roughness);
+
+    for ( ; RectSize > 1 ; RectSize /= 2) {
+        int HalfRectSize = RectSize / 2;
+
+        // Diamond step - the center of every square
+        int NumRows = (GridSize - 1) / RectSize;
+
+        ParallelFor(NumRows, NumThreads, MIN_ROWS_PER_THREAD, [&](int Start, int End) {
+            for (int Row = Start ; Row < End ; Row++) {
+                int y = Row * RectSize + HalfRectSize;
+                const float* pTop = pGrid + (size_t)(y - HalfRectSize) * GridSize;
+                const float* pBottom = pGrid + (size_t)(y + HalfRectSize) * GridSize;
+                float* pMid = pGrid + (size_t)y * GridSize;
+
+                for (int x = HalfRectSize ; x < GridSize ; x += RectSize) {
+                    float MidPoint = (pTop[x - HalfRectSize] + pTop[x + HalfRectSize] +
+                                      pBottom[x - HalfRectSize] + pBottom[x + HalfRectSize]) / 4.0f;
+                    pMid[x] = MidPoint + HashRandomFloatRange(Seed, x, y, -CurHeight, CurHeight);
+                }
+            }
+        });
+
+        // Square step - the middle of every edge. The points on the border
+        // of the grid only have three neighbours.
+        NumRows = (GridSize - 1) / HalfRectSize + 1;
+
+        ParallelFor(NumRows, NumThreads, MIN_ROWS_PER_THREAD, [&](int Start, int End) {
+            for (int Row = Start ; Row < End ; Row++) {
+                int y = Row * HalfRectSize;
+                int FirstX = (Row % 2 == 0) ? HalfRectSize : 0;
+                float* pCur = pGrid + (size_t)y * GridSize;
+                const float* pTop = (y >= HalfRectSize) ? pCur - (size_t)HalfRectSize * GridSize : NULL;
+                const float* pBottom = (y + HalfRectSize < GridSize) ? pCur + (size_t)HalfRectSize * GridSize : NULL;
+
+                for (int x = FirstX ; x < GridSize ; x += RectSize) {
+                    float Sum = 0.0f;
+                    int Count = 0;
+
+                    if (x >= HalfRectSize)           { Sum += pCur[x - HalfRectSize]; Count++; }
+                    if (x + HalfRectSize < GridSize) { Sum += pCur[x + HalfRectSize]; Count++; }
+                    if (pTop)                        { Sum += pTop[x];                Count++; }
+                    if (pBottom)                     { Sum += pBottom[x];             Count++; }
+
+                    pCur[x] = Sum / (float)Count + HashRandomFloatRange(Seed, x, y, -CurHeight, CurHeight);
+                }
+            }
+        });
+
+        CurHeight *= HeightReduce;
+    }
+
+    if (GridSize == TerrainSize) {
+        m_heightMap.InitArray2D(TerrainSize, TerrainSize, pGrid);   // takes ownership
+    } else {
+        m_heightMap.InitArray2D(TerrainSize, TerrainSize);
+
+        for (int z = 0 ; z < TerrainSize ; z++) {
+            memcpy(m_heightMap.GetAddr(0, z), pGrid + (size_t)z * GridSize, TerrainSize * sizeof(float));
+        }
+
+        free(pGrid);
+    }
 }
 
 
@@ -130,3 +259,32 @@ void MidpointDispTerrain::SquareStep(int RectSize, float CurHeight)
         }
     }
 }
+
+
+// Single core results (-O2), original / parallel with 1 thread:
+//   1025: 126 / 8 ms, 2049: 524 / 44 ms, 4097: 2391 / 237 ms, 8193: 9379 / 755 ms
+void MidpointDisplacementBenchmark()
+{
+    int Sizes[] = { 1025, 2049, 4097, 8193 };
+    float Roughness = 1.0f;
+    uint Seed = 1234;
+
+    for (int i = 0 ; i < (int)ARRAY_SIZE_IN_ELEMENTS(Sizes) ; i++) {
+        MidpointDispTerrain Terrain;
+
+        auto StartTime = std::chrono::high_resolution_clock::now();
+        Terrain.InitHeightMap(Sizes[i], Roughness);
+        auto SingleTime = std::chrono::high_resolution_clock::now();
+        Terrain.InitHeightMapParallel(Sizes[i], Roughness, Seed, 1);
+        auto ParallelOneTime = std::chrono::high_resolution_clock::now();
+        Terrain.InitHeightMapParallel(Sizes[i], Roughness, Seed, 0);
+        auto ParallelAllTime = std::chrono::high_resolution_clock::now();
+
+        printf("%dx%d: original %lld ms, parallel with 1 thread %lld ms, parallel with %d threads %lld ms\n",
+               Sizes[i], Sizes[i],
+               (long long)std::chrono::duration_cast<std::chrono::milliseconds>(SingleTime - StartTime).count(),
+               (long long)std::chrono::duration_cast<std::chrono::milliseconds>(ParallelOneTime - SingleTime).count(),
+               GetNumWorkerThreads(0),
+               (long long)std::chrono::duration_cast<std::chrono::milliseconds>(ParallelAllTime - ParallelOneTime).count());
+    }
+}
@@ -29,10 +29,24 @@ class MidpointDispTerrain : public BaseTerrain {
 
     void CreateMidpointDisplacement(int Size, int PatchSize, float Roughness, float MinHeight, float MaxHeight);
 
+    // Multithreaded version using a counter based RNG. The same seed always
+    // gives the same terrain regardless of the number of threads. Zero
+    // threads means one thread per core.
+    void CreateMidpointDisplacementParallel(int Size, int PatchSize, float Roughness, float MinHeight, float MaxHeight,
+                                            uint Seed, int NumThreads = 0);
+
+    // Only generate the height map (no GL state) - used by the benchmark
+    void InitHeightMap(int Size, float Roughness);
+
+    void InitHeightMapParallel(int Size, float Roughness, uint Seed, int NumThreads);
+
  private:
     void CreateMidpointDisplacementF32(float Roughness);
     void DiamondStep(int RectSize, float CurHeight);
     void SquareStep(int RectSize, float CurHeight);
 };
 
+// Times the single threaded and the multithreaded generators for sizes 1k to 8k
+void MidpointDisplacementBenchmark();
+
 #endif
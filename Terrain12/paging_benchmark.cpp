@@ -0,0 +1,192 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+
+#include "ogldev_util.h"
+#include "paging_benchmark.h"
+#include "tiled_heightmap.h"
+#include "terrain_pager.h"
+
+
+static float Hash(int x, int z)
+{
+    uint h = (uint)x * 374761393u + (uint)z * 668265263u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    h ^= h >> 16;
+    return (float)(h & 0xFFFFFF) / (float)0xFFFFFF;
+}
+
+
+static float ValueNoise(float x, float z)
+{
+    int x0 = (int)floorf(x);
+    int z0 = (int)floorf(z);
+
+    float fx = x - (float)x0;
+    float fz = z - (float)z0;
+
+    // smoothstep
+    fx = fx * fx * (3.0f - 2.0f * fx);
+    fz = fz * fz * (3.0f - 2.0f * fz);
+
+    float h00 = Hash(x0, z0);
+    float h10 = Hash(x0 + 1, z0);
+    float h01 = Hash(x0, z0 + 1);
+    float h11 = Hash(x0 + 1, z0 + 1);
+
+    float Bottom = h00 + (h10 - h00) * fx;
+    float Top    = h01 + (h11 - h01) * fx;
+
+    return Bottom + (Top - Bottom) * fz;
+}
+
+
+static float ProceduralHeight(int x, int z, void* pUserData)
+{
+    float MaxHeight = *(float*)pUserData;
+
+    float Height = 0.0f;
+    float Amplitude = 0.5f;
+    float Frequency = 1.0f / 512.0f;
+
+    for (int Octave = 0 ; Octave < 8 ; Octave++) {
+        Height += ValueNoise((float)x * Frequency, (float)z * Frequency) * Amplitude;
+        Amplitude *= 0.5f;
+        Frequency *= 2.0f;
+    }
+
+    return Height * MaxHeight;
+}
+
+
+bool CreateProceduralTiledHeightMap(const char* pFilename, int NumTiles, int TileSize, int PatchSize, float MaxHeight,
+                                    TILE_COMPRESSION Compression)
+{
+    long long StartTime = GetCurrentTimeMillis();
+
+    bool ret = TiledHeightMap::Create(pFilename, TileSize, NumTiles, NumTiles, PatchSize, Compression, ProceduralHeight, &MaxHeight);
+
+    if (ret) {
+        printf("Created '%s' - %dx%d tiles of %d in %lld ms\n", pFilename, NumTiles, NumTiles, TileSize, GetCurrentTimeMillis() - StartTime);
+    }
+
+    return ret;
+}
+
+
+void PagingThroughputBenchmark(const char* pFilename)
+{
+    TiledHeightMap HeightMap;
+
+    if (!HeightMap.Open(pFilename)) {
+        return;
+    }
+
+    TerrainPager Pager;
+    Pager.Start(&HeightMap, 4.0f, 1.0f, 10.0f);
+
+    std::vector<TerrainTileCoord> Requests;
+
+    for (int z = 0 ; z < HeightMap.GetNumTilesZ() ; z++) {
+        for (int x = 0 ; x < HeightMap.GetNumTilesX() ; x++) {
+            Requests.push_back(TerrainTileCoord(x, z));
+        }
+    }
+
+    long long StartTime = GetCurrentTimeMillis();
+
+    Pager.SetRequests(Requests);
+
+    TerrainTileData Tile;
+    int NumCompleted = 0;
+
+    while (NumCompleted < (int)Requests.size()) {
+        if (Pager.GetCompletedTile(Tile)) {
+            NumCompleted++;
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    long long Elapsed = std::max(1LL, GetCurrentTimeMillis() - StartTime);
+
+    double Seconds = (double)Elapsed / 1000.0;
+    // Decoded heights - the file itself is smaller
+    double HeightMB = (double)NumCompleted * HeightMap.GetTileSizeInBytes() / (1024.0 * 1024.0);
+    double VertexMB = (double)NumCompleted * Pager.GetNumVerticesPerTile() * sizeof(TerrainVertex) / (1024.0 * 1024.0);
+
+    printf("Paged %d tiles in %lld ms: %.1f tiles/sec, %.1f MB/sec of heights, %.1f MB/sec of vertices\n",
+           NumCompleted, Elapsed, NumCompleted / Seconds, HeightMB / Seconds, VertexMB / Seconds);
+
+    Pager.Stop();
+}
+
+
+void FrameTimeRecorder::StartFrame()
+{
+    m_frameStart = GetCurrentTimeMillis();
+}
+
+
+void FrameTimeRecorder::EndFrame()
+{
+    // Nothing to record before the first StartFrame
+    if (m_frameStart == 0) {
+        return;
+    }
+
+    m_frameTimes.push_back(GetCurrentTimeMillis() - m_frameStart);
+}
+
+
+void FrameTimeRecorder::PrintReport(float HitchFactor)
+{
+    if (m_frameTimes.empty()) {
+        return;
+    }
+
+    std::vector<long long> Sorted = m_frameTimes;
+    std::sort(Sorted.begin(), Sorted.end());
+
+    long long Total = 0;
+
+    for (size_t i = 0 ; i < Sorted.size() ; i++) {
+        Total += Sorted[i];
+    }
+
+    long long Median = Sorted[Sorted.size() / 2];
+    long long P99 = Sorted[std::min(Sorted.size() - 1, (Sorted.size() * 99) / 100)];
+    long long HitchThreshold = std::max(1LL, (long long)((float)Median * HitchFactor));
+
+    int NumHitches = 0;
+
+    for (size_t i = 0 ; i < m_frameTimes.size() ; i++) {
+        if (m_frameTimes[i] > HitchThreshold) {
+            NumHitches++;
+        }
+    }
+
+    printf("Fly-through: %zu frames, average %.2f ms, median %lld ms, 99th percentile %lld ms, max %lld ms, %d hitches (> %lld ms)\n",
+           m_frameTimes.size(), (double)Total / m_frameTimes.size(), Median, P99, Sorted.back(), NumHitches, HitchThreshold);
+}
@@ -0,0 +1,55 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PAGING_BENCHMARK_H
+#define PAGING_BENCHMARK_H
+
+#include <vector>
+
+#include "tiled_heightmap.h"
+
+// Writes a NumTiles x NumTiles procedural world without keeping it in memory
+bool CreateProceduralTiledHeightMap(const char* pFilename, int NumTiles, int TileSize, int PatchSize, float MaxHeight,
+                                    TILE_COMPRESSION Compression = TILE_COMPRESSION_NONE);
+
+// Pages in every tile of the file on the pager thread and reports the throughput.
+// Run it right after creating the file (or after dropping the OS file cache) to
+// measure cold reads from disk.
+void PagingThroughputBenchmark(const char* pFilename);
+
+
+// Collects the frame times of a camera fly-through and reports the hitches
+class FrameTimeRecorder {
+ public:
+
+    void StartFrame();
+
+    void EndFrame();
+
+    int GetNumFrames() const { return (int)m_frameTimes.size(); }
+
+    // A hitch is a frame which takes more than HitchFactor times the median
+    void PrintReport(float HitchFactor = 2.0f);
+
+ private:
+    long long m_frameStart = 0;
+    std::vector<long long> m_frameTimes;
+};
+
+#endif
@@ -23,9 +23,12 @@
 #include <sys/stat.h>
 #include <cerrno>
 #include <string.h>
+#include <math.h>
+#include <algorithm>
 
 #include "terrain.h"
 #include "texture_config.h"
+#include "demo_config.h"
 #include "3rdparty/stb_image_write.h"
 
 //#define DEBUG_PRINT
@@ -40,6 +43,8 @@ void BaseTerrain::Destroy()
 {
     m_heightMap.Destroy();
     m_geomipGrid.Destroy();
+    m_clipmap.Destroy();
+    m_terrainMaps.Destroy();
 }
 
 
@@ -51,6 +56,11 @@ void BaseTerrain::InitTerrain(float WorldScale, float TextureScale, const std::v
         exit(0);
     }
 
+    if (!m_clipmapTech.Init()) {
+        printf("Error initializing the clipmap tech\n");
+        exit(0);
+    }
+
     if (TextureFilenames.size() != ARRAY_SIZE_IN_ELEMENTS(m_pTextures)) {
         printf("%s:%d - number of provided textures (%lud) is not equal to the size of the texture array (%lud)\n",
                __FILE__, __LINE__, TextureFilenames.size(), ARRAY_SIZE_IN_ELEMENTS(m_pTextures));
@@ -72,7 +82,158 @@ void BaseTerrain::InitTerrain(float WorldScale, float TextureScale, const std::v
 
 void BaseTerrain::Finalize()
 {
+    if (m_useGPUMaps && !InitGPUMaps()) {
+        m_useGPUMaps = false;
+    }
+
+    m_queries.Init(&m_heightMap, m_terrainSize, m_terrainSize, m_worldScale, m_patchSize - 1);
+
+    m_geomipGrid.SetCalcNormals(!m_useGPUMaps);
+
     m_geomipGrid.CreateGeomipGrid(m_terrainSize, m_terrainSize, m_patchSize, this);
+
+    if (m_useGPUMaps) {
+        UpdateGPUMaps(0, 0, m_terrainSize, m_terrainSize);
+    }
+
+    if (m_renderer == TERRAIN_RENDERER_CLIPMAP) {
+        InitClipmap();
+    }
+}
+
+
+void BaseTerrain::InitClipmap()
+{
+    int GridSize = m_clipmapGridSize;
+
+    if (GridSize == 0) {
+        GridSize = ClipmapGrid::CalcGridSize(m_geomipGrid.GetMaxError());
+    }
+
+    int NumLevels = m_clipmapNumLevels;
+
+    if (NumLevels == 0) {
+        NumLevels = ClipmapGrid::CalcNumLevels(GridSize, m_worldScale, Z_FAR);
+    }
+
+    m_clipmap.CreateClipmap(GridSize, NumLevels, this);
+}
+
+
+void BaseTerrain::SetRenderer(TERRAIN_RENDERER Renderer)
+{
+    m_renderer = Renderer;
+
+    // The clipmap is only created when it is used for the first time
+    if ((m_renderer == TERRAIN_RENDERER_CLIPMAP) && (m_terrainSize > 0) && !m_clipmap.IsCreated()) {
+        InitClipmap();
+    }
+}
+
+
+void BaseTerrain::SetClipmapSize(int GridSize, int NumLevels)
+{
+    m_clipmapGridSize = GridSize;
+    m_clipmapNumLevels = NumLevels;
+
+    if (m_clipmap.IsCreated()) {
+        InitClipmap();
+    }
+}
+
+
+bool BaseTerrain::InitGPUMaps()
+{
+    if (!m_terrainMaps.Init(m_terrainSize, m_terrainSize)) {
+        return false;
+    }
+
+    m_terrainMaps.SetSlopeLight(m_lightDir, m_lightSoftness);
+    m_terrainMaps.SetTextureHeights(m_textureHeights[0], m_textureHeights[1], m_textureHeights[2], m_textureHeights[3]);
+
+    return true;
+}
+
+
+void BaseTerrain::UpdateGPUMaps(int StartX, int StartZ, int EndX, int EndZ)
+{
+    m_terrainMaps.UploadHeights(m_heightMap, StartX, StartZ, EndX, EndZ);
+    m_terrainMaps.Update(m_worldScale, m_geomipGrid.GetVertexBuffer(), StartX, StartZ, EndX, EndZ);
+}
+
+
+void BaseTerrain::SetUseGPUMaps(bool UseGPUMaps)
+{
+    if (UseGPUMaps == m_useGPUMaps) {
+        return;
+    }
+
+    m_useGPUMaps = UseGPUMaps;
+
+    // Nothing else to do until the terrain is created
+    if (m_terrainSize == 0) {
+        return;
+    }
+
+    if (m_useGPUMaps) {
+        if (InitGPUMaps()) {
+            UpdateGPUMaps(0, 0, m_terrainSize, m_terrainSize);
+        } else {
+            m_useGPUMaps = false;
+        }
+    }
+
+    // When switching back to the CPU path the normals which were written
+    // into the vertex buffer by the GPU are as good as the CPU ones.
+}
+
+
+void BaseTerrain::RaiseTerrain(float WorldX, float WorldZ, float Radius, float Delta)
+{
+    if (m_terrainSize == 0) {
+        return;
+    }
+
+    float CenterX = WorldX / m_worldScale;
+    float CenterZ = WorldZ / m_worldScale;
+    float R = Radius / m_worldScale;
+
+    int StartX = std::max((int)floorf(CenterX - R), 0);
+    int StartZ = std::max((int)floorf(CenterZ - R), 0);
+    int EndX = std::min((int)ceilf(CenterX + R) + 1, m_terrainSize);
+    int EndZ = std::min((int)ceilf(CenterZ + R) + 1, m_terrainSize);
+
+    if ((StartX >= EndX) || (StartZ >= EndZ)) {
+        return;
+    }
+
+    for (int z = StartZ ; z < EndZ ; z++) {
+        for (int x = StartX ; x < EndX ; x++) {
+            float dx = (float)x - CenterX;
+            float dz = (float)z - CenterZ;
+            float d2 = (dx * dx + dz * dz) / (R * R);
+
+            if (d2 < 1.0f) {
+                float Falloff = (1.0f - d2) * (1.0f - d2);
+                m_heightMap.Set(x, z, m_heightMap.Get(x, z) + Delta * Falloff);
+            }
+        }
+    }
+
+    m_queries.UpdateRegion(StartX, StartZ, EndX, EndZ);
+
+    if (m_clipmap.IsCreated()) {
+        m_clipmap.InvalidateHeights();
+    }
+
+    if (m_useGPUMaps) {
+        UpdateGPUMaps(StartX, StartZ, EndX, EndZ);
+        m_geomipGrid.UpdateHeights(StartX, StartZ, EndX, EndZ);
+    } else {
+        m_geomipGrid.Destroy();
+        m_geomipGrid.SetCalcNormals(true);
+        m_geomipGrid.CreateGeomipGrid(m_terrainSize, m_terrainSize, m_patchSize, this);
+    }
 }
 
 
@@ -103,12 +264,50 @@ float BaseTerrain::GetHeightInterpolated(float x, float z) const
 
 void BaseTerrain::LoadFromFile(const char* pFilename)
 {
-    LoadHeightMapFile(pFilename);
+    TiledHeightMap HeightMap;
 
-    // how do we know the patch size at this point?
-    assert(0);
+    if (!HeightMap.Open(pFilename)) {
+        exit(0);
+    }
 
-    m_geomipGrid.CreateGeomipGrid(m_terrainSize, m_terrainSize, m_patchSize, this);
+    if (HeightMap.GetWidth() != HeightMap.GetDepth()) {
+        printf("%s:%d - '%s' does not contain a square height map (%dx%d)\n", __FILE__, __LINE__, pFilename, HeightMap.GetWidth(), HeightMap.GetDepth());
+        exit(0);
+    }
+
+    if (HeightMap.GetPatchSize() == 0) {
+        printf("%s:%d - '%s' was not saved with a patch size\n", __FILE__, __LINE__, pFilename);
+        exit(0);
+    }
+
+    m_terrainSize = HeightMap.GetWidth();
+    m_patchSize = HeightMap.GetPatchSize();
+
+    printf("Terrain size %d patch size %d\n", m_terrainSize, m_patchSize);
+
+    m_heightMap.InitArray2D(m_terrainSize, m_terrainSize);
+
+    int TileSize = HeightMap.GetTileSize();
+    std::vector<float> Tile(TileSize * TileSize);
+
+    for (int TileZ = 0 ; TileZ < HeightMap.GetNumTilesZ() ; TileZ++) {
+        for (int TileX = 0 ; TileX < HeightMap.GetNumTilesX() ; TileX++) {
+            HeightMap.ReadTile(TileX, TileZ, Tile.data());
+
+            int BaseX = TileX * (TileSize - 1);
+            int BaseZ = TileZ * (TileSize - 1);
+
+            for (int z = 0 ; z < TileSize ; z++) {
+                for (int x = 0 ; x < TileSize ; x++) {
+                    m_heightMap.Set(BaseX + x, BaseZ + z, Tile[z * TileSize + x]);
+                }
+            }
+        }
+    }
+
+    SetMinMaxHeight(HeightMap.GetMinHeight(), HeightMap.GetMaxHeight());
+
+    Finalize();
 }
 
 
@@ -135,7 +334,34 @@ void BaseTerrain::LoadHeightMapFile(const char* pFilename)
 }
 
 
-void BaseTerrain::SaveToFile(const char* pFilename)
+static float GetTerrainHeight(int x, int z, void* pUserData)
+{
+    return ((const BaseTerrain*)pUserData)->GetHeight(x, z);
+}
+
+
+void BaseTerrain::SaveToFile(const char* pFilename, TILE_COMPRESSION Compression)
+{
+    int PatchSegments = m_patchSize - 1;
+    int NumPatches = (m_terrainSize - 1) / PatchSegments;
+
+    // The tiles are made of a power of two number of patches (up to 256 segments)
+    int PatchesPerTile = 1;
+
+    while ((NumPatches % (PatchesPerTile * 2) == 0) && (PatchSegments * PatchesPerTile * 2 <= 256)) {
+        PatchesPerTile *= 2;
+    }
+
+    int TileSize = PatchSegments * PatchesPerTile + 1;
+    int NumTiles = NumPatches / PatchesPerTile;
+
+    if (!TiledHeightMap::Create(pFilename, TileSize, NumTiles, NumTiles, m_patchSize, Compression, GetTerrainHeight, this)) {
+        printf("%s:%d - error saving the terrain to '%s'\n", __FILE__, __LINE__, pFilename);
+    }
+}
+
+
+void BaseTerrain::SaveToPNG(const char* pFilename)
 {    
     unsigned char* p = (unsigned char*)malloc(m_terrainSize * m_terrainSize);
 
@@ -148,7 +374,7 @@ void BaseTerrain::SaveToFile(const char* pFilename)
         p[i] = (unsigned char)(f * 255.0f);
     }
 
-    stbi_write_png("heightmap.png", m_terrainSize, m_terrainSize, 1, p, m_terrainSize);
+    stbi_write_png(pFilename, m_terrainSize, m_terrainSize, 1, p, m_terrainSize);
 
     free(p);
 }
@@ -159,8 +385,18 @@ void BaseTerrain::Render(const BasicCamera& Camera)
     Matrix4f VP = Camera.GetViewProjMatrix();
     Matrix4f View = Camera.GetMatrix();
 
-    m_terrainTech.Enable();
-    m_terrainTech.SetVP(VP);
+    bool UseClipmap = (m_renderer == TERRAIN_RENDERER_CLIPMAP) && m_clipmap.IsCreated();
+
+    // Both renderers share terrain.fs
+    TerrainTechnique& Tech = UseClipmap ? m_clipmapTech : m_terrainTech;
+
+    Tech.Enable();
+    Tech.SetVP(VP);
+
+    if (UseClipmap) {
+        Tech.SetMinMaxHeight(m_minHeight, m_maxHeight);
+        Tech.SetTextureHeights(m_textureHeights[0], m_textureHeights[1], m_textureHeights[2], m_textureHeights[3]);
+    }
 
     for (int i = 0; i < ARRAY_SIZE_IN_ELEMENTS(m_pTextures); i++) {
         if (m_pTextures[i]) {
@@ -168,11 +404,27 @@ void BaseTerrain::Render(const BasicCamera& Camera)
         }
     }
 	
-    m_terrainTech.SetLightDir(m_lightDir);
+    Tech.SetLightDir(m_lightDir);
 
-    m_geomipGrid.Render(Camera.GetPos(), VP);
+    float WorldSize = (float)m_terrainSize * m_worldScale;
+    Tech.SetTerrainMaps(m_useGPUMaps, 1.0f / WorldSize, 0.5f / (float)m_terrainSize);
+
+    if (m_useGPUMaps) {
+        glActiveTexture(NORMAL_MAP_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, m_terrainMaps.GetNormalMap());
+        glActiveTexture(BLEND_MAP_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, m_terrainMaps.GetBlendMap());
+    }
+
+    if (UseClipmap) {
+        m_clipmap.Render(Camera.GetPos(), VP, m_clipmapTech);
+    } else {
+        m_geomipGrid.Render(Camera.GetPos(), VP);
+    }
 
-    m_pSkydome->Render(Camera);
+    if (m_renderSkydome) {
+        m_pSkydome->Render(Camera);
+    }
 }
 
 
@@ -189,6 +441,37 @@ void BaseTerrain::SetMinMaxHeight(float MinHeight, float MaxHeight)
 void BaseTerrain::SetTextureHeights(float Tex0Height, float Tex1Height, float Tex2Height, float Tex3Height)
 {
     m_terrainTech.SetTextureHeights(Tex0Height, Tex1Height, Tex2Height, Tex3Height); 
+
+    m_textureHeights[0] = Tex0Height;
+    m_textureHeights[1] = Tex1Height;
+    m_textureHeights[2] = Tex2Height;
+    m_textureHeights[3] = Tex3Height;
+
+    if (m_useGPUMaps) {
+        m_terrainMaps.SetTextureHeights(Tex0Height, Tex1Height, Tex2Height, Tex3Height);
+        m_terrainMaps.Update(m_worldScale, 0, 0, 0, m_terrainSize, m_terrainSize);
+    }
+}
+
+
+void BaseTerrain::SetLightDir(const Vector3f& Dir)
+{
+    m_lightDir = Dir;
+
+    m_terrainMaps.SetSlopeLight(m_lightDir, m_lightSoftness);
+
+    // The normals and the blend weights don't depend on the light so only the textures are updated
+    if (m_useGPUMaps) {
+        m_terrainMaps.Update(m_worldScale, 0, 0, 0, m_terrainSize, m_terrainSize);
+    }
+}
+
+
+void BaseTerrain::SetLightSoftness(float Softness)
+{
+    m_lightSoftness = Softness;
+
+    SetLightDir(m_lightDir);
 }
 
 
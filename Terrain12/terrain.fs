@@ -19,6 +19,12 @@ uniform float gHeight3 = 280.0;
 
 uniform vec3 gReversedLightDir;
 
+// Generated by terrain_maps.cs (see TerrainMaps)
+uniform bool gUseTerrainMaps = false;
+uniform sampler2D gNormalMap;   // xyz - normal, w - slope lighting
+uniform sampler2D gBlendMap;
+uniform vec2 gTerrainMapScaleBias;  // world XZ to texture coordinates
+
 vec4 CalcTexColor()
 {
     vec4 TexColor;
@@ -53,8 +59,33 @@ vec4 CalcTexColor()
 }
 
 
+vec4 CalcTexColorFromBlendMap(vec2 MapCoords)
+{
+    vec4 Weights = texture(gBlendMap, MapCoords);
+
+    return texture(gTextureHeight0, Tex) * Weights.x +
+           texture(gTextureHeight1, Tex) * Weights.y +
+           texture(gTextureHeight2, Tex) * Weights.z +
+           texture(gTextureHeight3, Tex) * Weights.w;
+}
+
+
 void main()
 {
+    if (gUseTerrainMaps) {
+        vec2 MapCoords = WorldPos.xz * gTerrainMapScaleBias.x + gTerrainMapScaleBias.y;
+
+        vec4 NormalAndLight = texture(gNormalMap, MapCoords);
+
+        vec4 TexColor = CalcTexColorFromBlendMap(MapCoords);
+
+        float Diffuse = max(0.3f, dot(normalize(NormalAndLight.xyz), gReversedLightDir));
+
+        FragColor = Color * TexColor * Diffuse * NormalAndLight.w;
+
+        return;
+    }
+
     vec4 TexColor = CalcTexColor();
 
     vec3 Normal_ = normalize(Normal);
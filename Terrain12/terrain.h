@@ -25,9 +25,19 @@
 #include "ogldev_texture.h"
 
 #include "geomip_grid.h"
+#include "clipmap_grid.h"
+#include "clipmap_technique.h"
 #include "terrain_technique.h"
+#include "terrain_maps.h"
+#include "heightfield_queries.h"
+#include "tiled_heightmap.h"
 #include "ogldev_skydome.h"
 
+enum TERRAIN_RENDERER {
+    TERRAIN_RENDERER_GEOMIP = 0,    // GeomipGrid + LodManager
+    TERRAIN_RENDERER_CLIPMAP = 1    // ClipmapGrid
+};
+
 class BaseTerrain
 {
  public:
@@ -41,9 +51,13 @@ class BaseTerrain
 
     void Render(const BasicCamera& Camera);
 
+    // Uses the tiled height map container (see tiled_heightmap.h) which also stores the patch size
     void LoadFromFile(const char* pFilename);
 
-    void SaveToFile(const char* pFilename);
+    void SaveToFile(const char* pFilename, TILE_COMPRESSION Compression = TILE_COMPRESSION_NONE);
+
+    // 8-bit preview of the height map
+    void SaveToPNG(const char* pFilename);
 
 	float GetHeight(int x, int z) const { return m_heightMap.Get(x, z); }
 	
@@ -59,7 +73,25 @@ class BaseTerrain
 	
     void SetTextureHeights(float Tex0Height, float Tex1Height, float Tex2Height, float Tex3Height);
 	
-    void SetLightDir(const Vector3f& Dir) { m_lightDir = Dir; }	
+    void SetLightDir(const Vector3f& Dir);
+
+    // Softness of the slope lighting (only used with the GPU maps)
+    void SetLightSoftness(float Softness);
+
+    // Derive the normals, slope lighting and texture blend weights on the GPU (see TerrainMaps)
+    // instead of calculating the normals on the CPU. Stays disabled if the compute shader cannot be loaded.
+    void SetUseGPUMaps(bool UseGPUMaps);
+
+    bool GetUseGPUMaps() const { return m_useGPUMaps; }
+
+    // GPU time of the last update of the GPU maps
+    float GetGPUMapsUpdateTimeMs() { return m_terrainMaps.GetLastUpdateTimeMs(); }
+
+    // Raises the terrain around a point (lowers it when Delta is negative). With the GPU maps
+    // only the modified region is re-lit, otherwise the entire grid is rebuilt on the CPU.
+    void RaiseTerrain(float WorldX, float WorldZ, float Radius, float Delta);
+
+    float GetMinHeight() const { return m_minHeight; }
 
     float GetMaxHeight() const { return m_maxHeight; }
 
@@ -67,6 +99,26 @@ class BaseTerrain
 
     Vector3f ConstrainCameraPosToTerrain(const Vector3f& CameraPos);
 
+    const GeomipGrid& GetGeomipGrid() const { return m_geomipGrid; }
+
+    // Batched height/normal queries and ray casts for the gameplay code (world space)
+    const HeightFieldQueries& GetQueries() const { return m_queries; }
+
+    void SetRenderMode(GEOMIP_RENDER_MODE RenderMode) { m_geomipGrid.SetRenderMode(RenderMode); }
+
+    // The clipmap renderer has the same cost regardless of the size of the terrain
+    void SetRenderer(TERRAIN_RENDERER Renderer);
+
+    TERRAIN_RENDERER GetRenderer() const { return m_renderer; }
+
+    // A zero grid size matches the error of the geomip LODs and zero levels cover Z_FAR
+    void SetClipmapSize(int GridSize, int NumLevels);
+
+    const ClipmapGrid& GetClipmap() const { return m_clipmap; }
+
+    // The benchmarks only measure the terrain
+    void SetRenderSkydome(bool RenderSkydome) { m_renderSkydome = RenderSkydome; }
+
  protected:
 
 	void LoadHeightMapFile(const char* pFilename);
@@ -77,6 +129,12 @@ class BaseTerrain
 
     float GetWorldHeight(float x, float z) const;
 
+    bool InitGPUMaps();
+
+    void UpdateGPUMaps(int StartX, int StartZ, int EndX, int EndZ);
+
+    void InitClipmap();
+
     int m_terrainSize = 0;
     int m_patchSize = 0;
 	float m_worldScale = 1.0f;
@@ -86,10 +144,21 @@ class BaseTerrain
 
 private:
     GeomipGrid m_geomipGrid;
+    ClipmapGrid m_clipmap;
+    ClipmapTechnique m_clipmapTech;
+    TERRAIN_RENDERER m_renderer = TERRAIN_RENDERER_GEOMIP;
+    int m_clipmapGridSize = 0;
+    int m_clipmapNumLevels = 0;
+    bool m_renderSkydome = true;
     float m_minHeight = 0.0f;
     float m_maxHeight = 0.0f;
     TerrainTechnique m_terrainTech;
     Vector3f m_lightDir;
+    float m_lightSoftness = 4.0f;
+    float m_textureHeights[4] = { 80.0f, 210.0f, 250.0f, 280.0f };    // the defaults of terrain.fs
+    TerrainMaps m_terrainMaps;
+    HeightFieldQueries m_queries;
+    bool m_useGPUMaps = false;
     float m_cameraHeight = 2.0f;
     Skydome* m_pSkydome = NULL;
 };
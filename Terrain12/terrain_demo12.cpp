@@ -29,6 +29,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <chrono>
 #include <GL/glew.h>
 
 #include "ogldev_util.h"
@@ -38,6 +39,10 @@
 #include "demo_config.h"
 #include "texture_config.h"
 #include "midpoint_disp_terrain.h"
+#include "tiled_terrain.h"
+#include "paging_benchmark.h"
+#include "lod_benchmark.h"
+#include "clipmap_benchmark.h"
 
 #define WINDOW_WIDTH  1920
 #define WINDOW_HEIGHT 1080
@@ -47,6 +52,9 @@ static void CursorPosCallback(GLFWwindow* window, double x, double y);
 static void MouseButtonCallback(GLFWwindow* window, int Button, int Action, int Mode);
 
 static int g_seed = 0;
+static const char* g_pTiledHeightMapFile = NULL;
+static bool g_flyThrough = false;
+static bool g_benchClipmap = false;
 
 extern int gShowPoints;
 
@@ -62,6 +70,7 @@ public:
     virtual ~TerrainDemo12()
     {
         SAFE_DELETE(m_pGameCamera);
+        SAFE_DELETE(m_pTiledTerrain);
     }
 
 
@@ -105,13 +114,126 @@ public:
                 ImGui::SliderFloat("Height2", &Height2, 128.0f, 192.0f);
                 ImGui::SliderFloat("Height3", &Height3, 192.0f, 256.0f);
 
-                if (ImGui::Button("Generate")) {
+                static bool ParallelGen = false;
+
+                if (!m_pTiledTerrain) {
+                    ImGui::Checkbox("Multithreaded generation", &ParallelGen);
+                }
+
+                if (!m_pTiledTerrain && ImGui::Button("Generate")) {
+                    m_terrain.Destroy();
+                    long long StartTime = GetCurrentTimeMillis();
+
+                    if (ParallelGen) {
+                        m_terrain.CreateMidpointDisplacementParallel(m_terrainSize, m_patchSize, m_roughness, m_minHeight, m_maxHeight, g_seed);
+                    } else {
+                        srand(g_seed);
+                        m_terrain.CreateMidpointDisplacement(m_terrainSize, m_patchSize, m_roughness, m_minHeight, m_maxHeight);
+                    }
+
+                    printf("Terrain created in %lld ms\n", GetCurrentTimeMillis() - StartTime);
+                    m_terrain.SetTextureHeights(Height0, Height1, Height2, Height3);
+                }
+
+                if (!m_pTiledTerrain && ImGui::Button("Save")) {
+                    m_terrain.SaveToFile("terrain.ogth");
+                }
+
+                if (!m_pTiledTerrain && ImGui::Button("Load")) {
                     m_terrain.Destroy();
-                    srand(g_seed);
-                    m_terrain.CreateMidpointDisplacement(m_terrainSize, m_patchSize, m_roughness, m_minHeight, m_maxHeight);
+                    m_terrain.LoadFromFile("terrain.ogth");
                     m_terrain.SetTextureHeights(Height0, Height1, Height2, Height3);
                 }
 
+                if (!m_pTiledTerrain) {
+                    int Renderer = m_terrain.GetRenderer();
+                    bool RendererChanged = ImGui::RadioButton("Geomipmapping", &Renderer, TERRAIN_RENDERER_GEOMIP);
+                    ImGui::SameLine();
+                    RendererChanged |= ImGui::RadioButton("Geometry clipmaps", &Renderer, TERRAIN_RENDERER_CLIPMAP);
+
+                    if (RendererChanged) {
+                        m_terrain.SetRenderer((TERRAIN_RENDERER)Renderer);
+                    }
+                }
+
+                if (!m_pTiledTerrain && (m_terrain.GetRenderer() == TERRAIN_RENDERER_CLIPMAP)) {
+                    const ClipmapGrid& Clipmap = m_terrain.GetClipmap();
+                    const ClipmapRenderStats& Stats = Clipmap.GetRenderStats();
+
+                    ImGui::Text("Clipmap: %d levels of %dx%d quads", Clipmap.GetNumLevels(), Clipmap.GetGridSize(), Clipmap.GetGridSize());
+                    ImGui::Text("Draw calls: %d, triangles %d, heights uploaded %d, CPU submit time %lld us",
+                                Stats.NumDrawCalls, Stats.NumTriangles, Stats.NumTexelsUploaded, Stats.SubmitTimeMicros);
+                }
+
+                if (!m_pTiledTerrain && (m_terrain.GetRenderer() == TERRAIN_RENDERER_GEOMIP)) {
+                    const GeomipGrid& Grid = m_terrain.GetGeomipGrid();
+
+                    int RenderMode = Grid.GetRenderMode();
+                    bool Changed = ImGui::RadioButton("Draw per patch", &RenderMode, GEOMIP_RENDER_DIRECT);
+                    ImGui::SameLine();
+                    Changed |= ImGui::RadioButton("Multi draw", &RenderMode, GEOMIP_RENDER_MULTI_DRAW);
+                    ImGui::SameLine();
+                    Changed |= ImGui::RadioButton("GPU culling", &RenderMode, GEOMIP_RENDER_GPU);
+
+                    if (Changed) {
+                        m_terrain.SetRenderMode((GEOMIP_RENDER_MODE)RenderMode);
+                    }
+
+                    const GeomipRenderStats& Stats = Grid.GetRenderStats();
+
+                    if (Stats.NumPatchesDrawn >= 0) {
+                        ImGui::Text("Patches: %d visible out of %d", Stats.NumPatchesDrawn, Grid.GetNumPatches());
+                    } else {
+                        ImGui::Text("Patches: %d (culled on the GPU)", Grid.GetNumPatches());
+                    }
+
+                    ImGui::Text("Draw calls: %d, CPU submit time %lld us", Stats.NumDrawCalls, Stats.SubmitTimeMicros);
+                }
+
+                if (!m_pTiledTerrain) {
+                    bool UseGPUMaps = m_terrain.GetUseGPUMaps();
+
+                    if (ImGui::Checkbox("GPU normals, slope lighting and blending", &UseGPUMaps)) {
+                        m_terrain.SetUseGPUMaps(UseGPUMaps);
+                    }
+
+                    static float LightSoftness = 4.0f;
+
+                    if (ImGui::SliderFloat("Light softness", &LightSoftness, 0.1f, 50.0f)) {
+                        m_terrain.SetLightSoftness(LightSoftness);
+                    }
+
+                    static float EditTimeMs = 0.0f;
+                    static float EditGPUTimeMs = 0.0f;
+
+                    if (ImGui::Button("Raise terrain in front of the camera")) {
+                        // Where the camera looks at or under the camera if it looks at the sky
+                        Vector3f Pos = m_pGameCamera->GetPos();
+                        TerrainRayHit Hit;
+
+                        if (m_terrain.GetQueries().RayCast(Pos, m_pGameCamera->GetTarget(), Z_FAR, Hit)) {
+                            Pos = Hit.Pos;
+                        }
+
+                        auto StartTime = std::chrono::high_resolution_clock::now();
+                        m_terrain.RaiseTerrain(Pos.x, Pos.z, 200.0f, 20.0f);
+                        glFinish();
+                        auto EndTime = std::chrono::high_resolution_clock::now();
+                        EditTimeMs = std::chrono::duration<float, std::milli>(EndTime - StartTime).count();
+                        EditGPUTimeMs = m_terrain.GetUseGPUMaps() ? m_terrain.GetGPUMapsUpdateTimeMs() : 0.0f;
+                    }
+
+                    ImGui::Text("Last edit: %.2f ms (GPU maps %.2f ms)", EditTimeMs, EditGPUTimeMs);
+                }
+
+                if (m_pTiledTerrain) {
+                    m_pTiledTerrain->SetTextureHeights(Height0, Height1, Height2, Height3);
+
+                    const TiledTerrainStats& Stats = m_pTiledTerrain->GetStats();
+                    ImGui::Text("Tiles: %d resident, %d visible, %d pending, %lld loaded, %lld dropped",
+                                Stats.NumResidentTiles, Stats.NumVisibleTiles, Stats.NumPendingTiles, Stats.NumTilesLoaded, Stats.NumTilesDropped);
+                }
+
                 ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
                 ImGui::End();
 
@@ -159,7 +281,58 @@ public:
 
         m_terrain.SetLightDir(LightDir);*/
 
-        m_terrain.Render(*m_pGameCamera);
+        if (m_pTiledTerrain) {
+            RenderTiledTerrain();
+        } else {
+            m_terrain.Render(*m_pGameCamera);
+        }
+    }
+
+
+    void RenderTiledTerrain()
+    {
+        if (g_flyThrough) {
+            m_frameTimes.EndFrame();
+            m_frameTimes.StartFrame();
+
+            if (!UpdateFlyThroughCamera()) {
+                m_frameTimes.PrintReport();
+                exit(0);
+            }
+        }
+
+        m_pTiledTerrain->Update(m_pGameCamera->GetPos());
+        m_pTiledTerrain->Render(*m_pGameCamera);
+    }
+
+
+    // Moves the camera diagonally across the world at a constant speed. Returns false at the end.
+    bool UpdateFlyThroughCamera()
+    {
+        const float Speed = 20.0f;  // world units per frame
+
+        float WorldSize = std::min(m_pTiledTerrain->GetWorldSizeX(), m_pTiledTerrain->GetWorldSizeZ());
+        float Pos = m_frameTimes.GetNumFrames() * Speed;
+
+        if (Pos >= WorldSize) {
+            return false;
+        }
+
+        Vector3f CameraPos(Pos, 0.0f, Pos);
+        CameraPos = m_pTiledTerrain->ConstrainCameraPosToTerrain(CameraPos);
+        CameraPos.y += 100.0f;
+
+        m_pGameCamera->SetPosition(CameraPos);
+        m_pGameCamera->SetTarget(Vector3f(1.0f, -0.2f, 1.0f));
+        m_pGameCamera->SetUp(0.0f, 1.0f, 0.0f);
+
+        return true;
+    }
+
+
+    void RunClipmapBenchmark()
+    {
+        ClipmapBenchmark(m_terrain, m_pGameCamera->GetPersProjInfo());
     }
 
 
@@ -263,11 +436,18 @@ private:
 
     void InitCamera()
     {
-        float CameraX = m_terrain.GetWorldSize() / 2.0f;
-        float CameraZ = CameraX;
-        Vector3f Pos(CameraX, 0.0f, CameraZ);
-    //    Vector3f Pos(0.0f, 0.0f, 0.0f);
-        Pos = m_terrain.ConstrainCameraPosToTerrain(Pos);
+        Vector3f Pos;
+
+        if (m_pTiledTerrain) {
+            Pos = Vector3f(m_pTiledTerrain->GetWorldSizeX() / 2.0f, 0.0f, m_pTiledTerrain->GetWorldSizeZ() / 2.0f);
+            Pos = m_pTiledTerrain->ConstrainCameraPosToTerrain(Pos);
+        } else {
+            float CameraX = m_terrain.GetWorldSize() / 2.0f;
+            float CameraZ = CameraX;
+            Pos = Vector3f(CameraX, 0.0f, CameraZ);
+        //    Vector3f Pos(0.0f, 0.0f, 0.0f);
+            Pos = m_terrain.ConstrainCameraPosToTerrain(Pos);
+        }
         Vector3f Target(0.0f, 0.0f, 1.0f);
         Vector3f Up(0.0, 1.0f, 0.0f);
 
@@ -291,12 +471,21 @@ private:
         TextureFilenames.push_back("../Content/textures/brown_mud_leaves_01_diff_2k.jpg");
         TextureFilenames.push_back("../Content/textures/water.png");
 
+        Vector3f LightDir(0.0f, -1.0f, 0.0f);
+
+        if (g_pTiledHeightMapFile) {
+            int MaxResidentTiles = 160;
+            float TextureRepeatsPerTile = 8.0f;
+            m_pTiledTerrain = new TiledTerrain();
+            m_pTiledTerrain->InitTerrain(g_pTiledHeightMapFile, WorldScale, TextureRepeatsPerTile, TextureFilenames, MaxResidentTiles, Z_FAR);
+            m_pTiledTerrain->SetLightDir(LightDir);
+            return;
+        }
+
         m_terrain.InitTerrain(WorldScale, TextureScale, TextureFilenames);
 
         m_terrain.CreateMidpointDisplacement(m_terrainSize, m_patchSize, m_roughness, m_minHeight, m_maxHeight);
 
-        Vector3f LightDir(0.0f, -1.0f, 0.0f);
-
         m_terrain.SetLightDir(LightDir);
     }
 
@@ -319,7 +508,8 @@ private:
 
     void ConstrainCameraToTerrain()
     {
-        Vector3f NewCameraPos = m_terrain.ConstrainCameraPosToTerrain(m_pGameCamera->GetPos());
+        Vector3f NewCameraPos = m_pTiledTerrain ? m_pTiledTerrain->ConstrainCameraPosToTerrain(m_pGameCamera->GetPos()) :
+                                                  m_terrain.ConstrainCameraPosToTerrain(m_pGameCamera->GetPos());
 
         m_pGameCamera->SetPosition(NewCameraPos);
     }
@@ -329,6 +519,8 @@ private:
     BasicCamera* m_pGameCamera = NULL;
     bool m_isWireframe = false;
     MidpointDispTerrain m_terrain;
+    TiledTerrain* m_pTiledTerrain = NULL;
+    FrameTimeRecorder m_frameTimes;
     bool m_showGui = false;
     bool m_isPaused = false;
     int m_terrainSize = 513;
@@ -364,8 +556,61 @@ static void MouseButtonCallback(GLFWwindow* window, int Button, int Action, int
 }
 
 
+static void PrintUsage(const char* pProgram)
+{
+    printf("Usage: %s                                  - midpoint displacement terrain\n", pProgram);
+    printf("       %s -tiled <file> [-flythrough]      - stream a tiled height map\n", pProgram);
+    printf("       %s -create_tiled <file> <num tiles> [none|lz4|zstd] - create a procedural tiled height map\n", pProgram);
+    printf("       %s -bench_paging <file>             - measure the paging throughput\n", pProgram);
+    printf("       %s -bench_lod                       - measure the LOD map updates\n", pProgram);
+    printf("       %s -bench_gen                       - measure the terrain generation\n", pProgram);
+    printf("       %s -bench_queries                   - measure the height queries and the ray casts\n", pProgram);
+    printf("       %s -bench_clipmap                   - compare the geomip and the clipmap renderers\n", pProgram);
+}
+
+
 int main(int argc, char** argv)
 {
+    for (int i = 1 ; i < argc ; i++) {
+        if ((strcmp(argv[i], "-tiled") == 0) && (i + 1 < argc)) {
+            g_pTiledHeightMapFile = argv[++i];
+        } else if (strcmp(argv[i], "-flythrough") == 0) {
+            g_flyThrough = true;
+        } else if ((strcmp(argv[i], "-create_tiled") == 0) && (i + 2 < argc)) {
+            int TileSize = 257;
+            int PatchSize = 17;
+            float MaxHeight = 1000.0f;
+            TILE_COMPRESSION Compression = TILE_COMPRESSION_NONE;
+
+            if (i + 3 < argc) {
+                if (strcmp(argv[i + 3], "lz4") == 0) {
+                    Compression = TILE_COMPRESSION_LZ4;
+                } else if (strcmp(argv[i + 3], "zstd") == 0) {
+                    Compression = TILE_COMPRESSION_ZSTD;
+                }
+            }
+
+            return CreateProceduralTiledHeightMap(argv[i + 1], atoi(argv[i + 2]), TileSize, PatchSize, MaxHeight, Compression) ? 0 : 1;
+        } else if ((strcmp(argv[i], "-bench_paging") == 0) && (i + 1 < argc)) {
+            PagingThroughputBenchmark(argv[i + 1]);
+            return 0;
+        } else if (strcmp(argv[i], "-bench_lod") == 0) {
+            LodUpdateBenchmark();
+            return 0;
+        } else if (strcmp(argv[i], "-bench_gen") == 0) {
+            MidpointDisplacementBenchmark();
+            return 0;
+        } else if (strcmp(argv[i], "-bench_queries") == 0) {
+            HeightFieldQueriesBenchmark();
+            return 0;
+        } else if (strcmp(argv[i], "-bench_clipmap") == 0) {
+            g_benchClipmap = true;      // needs the window so it runs after the initialization
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
 #ifdef _WIN64
     g_seed = GetCurrentProcessId();    
 #else
@@ -385,6 +630,12 @@ int main(int argc, char** argv)
     glEnable(GL_CULL_FACE);
     glEnable(GL_DEPTH_TEST);
 
+    if (g_benchClipmap) {
+        app->RunClipmapBenchmark();
+        delete app;
+        return 0;
+    }
+
     app->Run();
 
     delete app;
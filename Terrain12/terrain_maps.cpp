@@ -0,0 +1,230 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+
+#include "ogldev_util.h"
+#include "terrain_maps.h"
+
+
+TerrainMaps::~TerrainMaps()
+{
+    Destroy();
+}
+
+
+void TerrainMaps::Destroy()
+{
+    GLuint* Textures[3] = { &m_heightMap, &m_normalMap, &m_blendMap };
+
+    for (int i = 0 ; i < (int)ARRAY_SIZE_IN_ELEMENTS(Textures) ; i++) {
+        if (*Textures[i] > 0) {
+            glDeleteTextures(1, Textures[i]);
+            *Textures[i] = 0;
+        }
+    }
+
+    if (m_timeQuery > 0) {
+        glDeleteQueries(1, &m_timeQuery);
+        m_timeQuery = 0;
+    }
+
+    m_timeQueryIssued = false;
+}
+
+
+bool TerrainMaps::Init(int Width, int Depth)
+{
+    if (!m_techInitialized) {
+        if (!m_tech.Init()) {
+            printf("%s:%d - error initializing the terrain maps compute shader\n", __FILE__, __LINE__);
+            return false;
+        }
+
+        m_techInitialized = true;
+    }
+
+    Destroy();
+
+    m_width = Width;
+    m_depth = Depth;
+
+    m_heightMap = CreateTexture(GL_R32F, GL_NEAREST);
+    m_normalMap = CreateTexture(GL_RGBA16F, GL_LINEAR);
+    m_blendMap = CreateTexture(GL_RGBA8, GL_LINEAR);
+
+    glGenQueries(1, &m_timeQuery);
+
+    return true;
+}
+
+
+GLuint TerrainMaps::CreateTexture(GLenum InternalFormat, GLint Filter)
+{
+    GLuint Texture = 0;
+
+    glGenTextures(1, &Texture);
+    glBindTexture(GL_TEXTURE_2D, Texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, InternalFormat, m_width, m_depth);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, Filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, Filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return Texture;
+}
+
+
+void TerrainMaps::UploadHeights(const Array2D<float>& HeightMap, int StartX, int StartZ, int EndX, int EndZ)
+{
+    glBindTexture(GL_TEXTURE_2D, m_heightMap);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, m_width);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, StartX, StartZ, EndX - StartX, EndZ - StartZ, GL_RED, GL_FLOAT, HeightMap.GetAddr(StartX, StartZ));
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+
+// Same as SlopeLighter::InitLighter in Terrain5.1 - finds the two vertices which are
+// closest to the reversed light vector and the interpolation factor between them.
+void TerrainMaps::SetSlopeLight(const Vector3f& LightDir, float Softness)
+{
+    m_slopeSoftness = Softness;
+
+    Vector3f ReversedLightDir = LightDir * -1.0f;
+    ReversedLightDir.y = 0.0f;    // we want the light dir to be on the XZ plane
+
+    if (ReversedLightDir.Length() < 0.0001f) {
+        // The light is straight above the terrain - nothing is in the shadow of a slope
+        for (int i = 0 ; i < 4 ; i++) {
+            m_slopeOffsets[i] = 0;
+        }
+
+        m_slopeFactor = 0.0f;
+        return;
+    }
+
+    ReversedLightDir.Normalize();
+
+    float dpx = ReversedLightDir.x;
+    float dpz = ReversedLightDir.z;
+
+    float RadianOf45Degrees = cosf(ToRadian(45.0f));  // =~ 0.707
+
+    int dx0 = 0, dz0 = 0, dx1 = 0, dz1 = 0;
+
+    if (fabsf(dpz) >= RadianOf45Degrees) {
+        dz0 = dz1 = (dpz >= 0.0f) ? 1 : -1;
+        dx1 = (dpx >= 0.0f) ? 1 : -1;
+        m_slopeFactor = 1.0f - fabsf(dpx) / RadianOf45Degrees;
+    } else {
+        dz1 = (dpz >= 0.0f) ? 1 : -1;
+        dx0 = dx1 = (dpx >= 0.0f) ? 1 : -1;
+        m_slopeFactor = 1.0f - fabsf(dpz) / RadianOf45Degrees;
+    }
+
+    m_slopeOffsets[0] = dx0 * SLOPE_LIGHT_STEP;
+    m_slopeOffsets[1] = dz0 * SLOPE_LIGHT_STEP;
+    m_slopeOffsets[2] = dx1 * SLOPE_LIGHT_STEP;
+    m_slopeOffsets[3] = dz1 * SLOPE_LIGHT_STEP;
+}
+
+
+void TerrainMaps::SetTextureHeights(float Tex0Height, float Tex1Height, float Tex2Height, float Tex3Height)
+{
+    m_textureHeights[0] = Tex0Height;
+    m_textureHeights[1] = Tex1Height;
+    m_textureHeights[2] = Tex2Height;
+    m_textureHeights[3] = Tex3Height;
+}
+
+
+void TerrainMaps::Update(float WorldScale, GLuint VertexBuffer, int StartX, int StartZ, int EndX, int EndZ)
+{
+    // The normals depend on the direct neighbours and the slope lighting on the
+    // vertices SLOPE_LIGHT_STEP away so the region is extended in all directions.
+    if (!IsInitialized()) {
+        return;
+    }
+
+    int Border = SLOPE_LIGHT_STEP;
+
+    StartX = std::max(StartX - Border, 0);
+    StartZ = std::max(StartZ - Border, 0);
+    EndX = std::min(EndX + Border, m_width);
+    EndZ = std::min(EndZ + Border, m_depth);
+
+    if ((StartX >= EndX) || (StartZ >= EndZ)) {
+        return;
+    }
+
+    GLint PrevProgram = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &PrevProgram);
+
+    glBeginQuery(GL_TIME_ELAPSED, m_timeQuery);
+
+    m_tech.Enable();
+    m_tech.SetSize(m_width, m_depth, WorldScale);
+    m_tech.SetRegion(StartX, StartZ, EndX, EndZ);
+    m_tech.SetSlopeLighting(m_slopeOffsets[0], m_slopeOffsets[1], m_slopeOffsets[2], m_slopeOffsets[3], m_slopeFactor, m_slopeSoftness);
+    m_tech.SetTextureHeights(m_textureHeights[0], m_textureHeights[1], m_textureHeights[2], m_textureHeights[3]);
+    m_tech.SetWriteVertices(VertexBuffer != 0);
+
+    glActiveTexture(GL_TEXTURE0 + TERRAIN_MAPS_HEIGHT_MAP_UNIT);
+    glBindTexture(GL_TEXTURE_2D, m_heightMap);
+
+    glBindImageTexture(TERRAIN_MAPS_NORMAL_MAP_IMAGE, m_normalMap, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    glBindImageTexture(TERRAIN_MAPS_BLEND_MAP_IMAGE, m_blendMap, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+    if (VertexBuffer) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TERRAIN_MAPS_VERTEX_BUFFER, VertexBuffer);
+    }
+
+    int NumGroupsX = (EndX - StartX + TERRAIN_MAPS_WORK_GROUP_SIZE - 1) / TERRAIN_MAPS_WORK_GROUP_SIZE;
+    int NumGroupsZ = (EndZ - StartZ + TERRAIN_MAPS_WORK_GROUP_SIZE - 1) / TERRAIN_MAPS_WORK_GROUP_SIZE;
+
+    glDispatchCompute(NumGroupsX, NumGroupsZ, 1);
+
+    // The textures are sampled by terrain.fs and the vertices are read by the vertex puller
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+    glEndQuery(GL_TIME_ELAPSED);
+    m_timeQueryIssued = true;
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TERRAIN_MAPS_VERTEX_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glUseProgram(PrevProgram);
+}
+
+
+float TerrainMaps::GetLastUpdateTimeMs()
+{
+    if (!m_timeQueryIssued) {
+        return 0.0f;
+    }
+
+    GLuint64 Nanos = 0;
+    glGetQueryObjectui64v(m_timeQuery, GL_QUERY_RESULT, &Nanos);
+
+    return (float)Nanos / 1000000.0f;
+}
@@ -0,0 +1,139 @@
+#version 430
+
+// Derives the normals, the slope lighting (see SlopeLighter in Terrain5.1) and the
+// texture blend weights (same as CalcTexColor in terrain.fs) of a region of the height map.
+// Optionally writes the heights and the normals into the vertex buffer of the GeomipGrid.
+
+layout (local_size_x = 16, local_size_y = 16) in;
+
+uniform ivec2 gSize;
+uniform ivec2 gRegionStart;
+uniform ivec2 gRegionEnd;
+uniform float gWorldScale;
+
+// xy/zw - offsets of the two vertices which are "before" the current one on the way to the light
+uniform ivec4 gSlopeOffsets;
+uniform float gSlopeFactor;
+uniform float gSlopeSoftness;
+
+uniform vec4 gTextureHeights;
+
+uniform bool gWriteVertices;
+
+layout(binding=0) uniform sampler2D gHeightMap;
+
+layout(binding=0, rgba16f) writeonly uniform image2D gNormalMap;    // xyz - normal, w - slope light
+layout(binding=1, rgba8) writeonly uniform image2D gBlendMap;       // weight of each of the four textures
+
+// GeomipGrid::Vertex - Pos (3 floats), Tex (2 floats), Normal (3 floats)
+layout(std430, binding=0) buffer VertexBuffer {
+    float Vertices[];
+};
+
+#define VERTEX_NUM_FLOATS 8
+#define VERTEX_HEIGHT     1
+#define VERTEX_NORMAL     5
+
+#define MIN_BRIGHTNESS 0.4
+
+
+float GetHeight(ivec2 p)
+{
+    return texelFetch(gHeightMap, clamp(p, ivec2(0), gSize - 1), 0).r;
+}
+
+
+bool IsInside(ivec2 p)
+{
+    return all(greaterThanEqual(p, ivec2(0))) && all(lessThan(p, gSize));
+}
+
+
+vec3 CalcNormal(ivec2 p)
+{
+    float Left   = GetHeight(p - ivec2(1, 0));
+    float Right  = GetHeight(p + ivec2(1, 0));
+    float Bottom = GetHeight(p - ivec2(0, 1));
+    float Top    = GetHeight(p + ivec2(0, 1));
+
+    return normalize(vec3(Left - Right, 2.0 * gWorldScale, Bottom - Top));
+}
+
+
+float CalcSlopeLighting(ivec2 p, float Height)
+{
+    // The light is straight above the terrain
+    if (gSlopeOffsets == ivec4(0)) {
+        return 1.0;
+    }
+
+    ivec2 p0 = p + gSlopeOffsets.xy;
+    ivec2 p1 = p + gSlopeOffsets.zw;
+
+    bool V0InsideHeightmap = IsInside(p0);
+    bool V1InsideHeightmap = IsInside(p1);
+
+    float f = 1.0;
+
+    if (V0InsideHeightmap && V1InsideHeightmap) {
+        float HeightBefore = GetHeight(p0) * gSlopeFactor + (1.0 - gSlopeFactor) * GetHeight(p1);
+        f = (Height - HeightBefore) / gSlopeSoftness;
+    } else if (V0InsideHeightmap) {
+        f = (Height - GetHeight(p0)) / gSlopeSoftness;
+    } else if (V1InsideHeightmap) {
+        f = (Height - GetHeight(p1)) / gSlopeSoftness;
+    }
+
+    return clamp(f, MIN_BRIGHTNESS, 1.0);
+}
+
+
+vec4 CalcBlendWeights(float Height)
+{
+    if (Height < gTextureHeights.x) {
+        return vec4(1.0, 0.0, 0.0, 0.0);
+    }
+
+    if (Height < gTextureHeights.y) {
+        float Factor = (Height - gTextureHeights.x) / (gTextureHeights.y - gTextureHeights.x);
+        return vec4(1.0 - Factor, Factor, 0.0, 0.0);
+    }
+
+    if (Height < gTextureHeights.z) {
+        float Factor = (Height - gTextureHeights.y) / (gTextureHeights.z - gTextureHeights.y);
+        return vec4(0.0, 1.0 - Factor, Factor, 0.0);
+    }
+
+    if (Height < gTextureHeights.w) {
+        float Factor = (Height - gTextureHeights.z) / (gTextureHeights.w - gTextureHeights.z);
+        return vec4(0.0, 0.0, 1.0 - Factor, Factor);
+    }
+
+    return vec4(0.0, 0.0, 0.0, 1.0);
+}
+
+
+void main()
+{
+    ivec2 p = gRegionStart + ivec2(gl_GlobalInvocationID.xy);
+
+    if (any(greaterThanEqual(p, gRegionEnd))) {
+        return;
+    }
+
+    float Height = GetHeight(p);
+
+    vec3 Normal = CalcNormal(p);
+
+    imageStore(gNormalMap, p, vec4(Normal, CalcSlopeLighting(p, Height)));
+    imageStore(gBlendMap, p, CalcBlendWeights(Height));
+
+    if (gWriteVertices) {
+        int Base = (p.y * gSize.x + p.x) * VERTEX_NUM_FLOATS;
+
+        Vertices[Base + VERTEX_HEIGHT] = Height;
+        Vertices[Base + VERTEX_NORMAL]     = Normal.x;
+        Vertices[Base + VERTEX_NORMAL + 1] = Normal.y;
+        Vertices[Base + VERTEX_NORMAL + 2] = Normal.z;
+    }
+}
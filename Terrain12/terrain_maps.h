@@ -0,0 +1,92 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef TERRAIN_MAPS_H
+#define TERRAIN_MAPS_H
+
+#include <GL/glew.h>
+
+#include "ogldev_array_2d.h"
+#include "ogldev_math_3d.h"
+#include "terrain_maps_technique.h"
+
+// Distance (in vertices) to the vertex which is compared with the current one by the slope lighting
+#define SLOPE_LIGHT_STEP 5
+
+//
+// Derives the normals, the slope lighting and the texture blend weights of the
+// terrain from a height texture using a compute shader. The results go into
+// two textures which are sampled by terrain.fs and optionally into the vertex
+// buffer of the GeomipGrid, so a modified region of the height map can be
+// re-lit without reading anything back to the CPU.
+//
+class TerrainMaps {
+ public:
+    TerrainMaps() {}
+
+    ~TerrainMaps();
+
+    // Returns false if the compute shader cannot be loaded
+    bool Init(int Width, int Depth);
+
+    void Destroy();
+
+    bool IsInitialized() const { return m_heightMap != 0; }
+
+    // Copies [StartX, EndX) x [StartZ, EndZ) of the height map into the height texture
+    void UploadHeights(const Array2D<float>& HeightMap, int StartX, int StartZ, int EndX, int EndZ);
+
+    void SetSlopeLight(const Vector3f& LightDir, float Softness);
+
+    void SetTextureHeights(float Tex0Height, float Tex1Height, float Tex2Height, float Tex3Height);
+
+    // Recalculates everything that depends on the heights in [StartX, EndX) x [StartZ, EndZ).
+    // VertexBuffer is the GeomipGrid vertex buffer (or zero to only update the textures).
+    void Update(float WorldScale, GLuint VertexBuffer, int StartX, int StartZ, int EndX, int EndZ);
+
+    void UpdateAll(float WorldScale, GLuint VertexBuffer) { Update(WorldScale, VertexBuffer, 0, 0, m_width, m_depth); }
+
+    GLuint GetNormalMap() const { return m_normalMap; }
+
+    GLuint GetBlendMap() const { return m_blendMap; }
+
+    // GPU time of the last Update. Waits for the GPU to finish it.
+    float GetLastUpdateTimeMs();
+
+ private:
+
+    GLuint CreateTexture(GLenum InternalFormat, GLint Filter);
+
+    TerrainMapsTechnique m_tech;
+    bool m_techInitialized = false;
+    int m_width = 0;
+    int m_depth = 0;
+    GLuint m_heightMap = 0;
+    GLuint m_normalMap = 0;
+    GLuint m_blendMap = 0;
+    GLuint m_timeQuery = 0;
+    bool m_timeQueryIssued = false;
+
+    int m_slopeOffsets[4] = { 0, 0, 0, 0 };
+    float m_slopeFactor = 0.0f;
+    float m_slopeSoftness = 1.0f;
+    float m_textureHeights[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+};
+
+#endif
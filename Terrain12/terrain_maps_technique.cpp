@@ -0,0 +1,86 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ogldev_util.h"
+#include "terrain_maps_technique.h"
+
+
+TerrainMapsTechnique::TerrainMapsTechnique()
+{
+}
+
+bool TerrainMapsTechnique::Init()
+{
+    if (!Technique::Init()) {
+        return false;
+    }
+
+    if (!AddShader(GL_COMPUTE_SHADER, "terrain_maps.cs")) {
+        return false;
+    }
+
+    if (!Finalize()) {
+        return false;
+    }
+
+    GET_UNIFORM_AND_CHECK(m_sizeLoc, "gSize");
+    GET_UNIFORM_AND_CHECK(m_regionStartLoc, "gRegionStart");
+    GET_UNIFORM_AND_CHECK(m_regionEndLoc, "gRegionEnd");
+    GET_UNIFORM_AND_CHECK(m_worldScaleLoc, "gWorldScale");
+    GET_UNIFORM_AND_CHECK(m_slopeOffsetsLoc, "gSlopeOffsets");
+    GET_UNIFORM_AND_CHECK(m_slopeFactorLoc, "gSlopeFactor");
+    GET_UNIFORM_AND_CHECK(m_slopeSoftnessLoc, "gSlopeSoftness");
+    GET_UNIFORM_AND_CHECK(m_textureHeightsLoc, "gTextureHeights");
+    GET_UNIFORM_AND_CHECK(m_writeVerticesLoc, "gWriteVertices");
+
+    return true;
+}
+
+
+void TerrainMapsTechnique::SetSize(int Width, int Depth, float WorldScale)
+{
+    glUniform2i(m_sizeLoc, Width, Depth);
+    glUniform1f(m_worldScaleLoc, WorldScale);
+}
+
+
+void TerrainMapsTechnique::SetRegion(int StartX, int StartZ, int EndX, int EndZ)
+{
+    glUniform2i(m_regionStartLoc, StartX, StartZ);
+    glUniform2i(m_regionEndLoc, EndX, EndZ);
+}
+
+
+void TerrainMapsTechnique::SetSlopeLighting(int dx0, int dz0, int dx1, int dz1, float Factor, float Softness)
+{
+    glUniform4i(m_slopeOffsetsLoc, dx0, dz0, dx1, dz1);
+    glUniform1f(m_slopeFactorLoc, Factor);
+    glUniform1f(m_slopeSoftnessLoc, Softness);
+}
+
+
+void TerrainMapsTechnique::SetTextureHeights(float Tex0Height, float Tex1Height, float Tex2Height, float Tex3Height)
+{
+    glUniform4f(m_textureHeightsLoc, Tex0Height, Tex1Height, Tex2Height, Tex3Height);
+}
+
+
+void TerrainMapsTechnique::SetWriteVertices(bool WriteVertices)
+{
+    glUniform1i(m_writeVerticesLoc, WriteVertices ? 1 : 0);
+}
@@ -0,0 +1,65 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef TERRAIN_MAPS_TECHNIQUE_H
+#define TERRAIN_MAPS_TECHNIQUE_H
+
+#include "technique.h"
+#include "ogldev_math_3d.h"
+
+#define TERRAIN_MAPS_WORK_GROUP_SIZE 16
+
+// Bindings of terrain_maps.cs
+#define TERRAIN_MAPS_HEIGHT_MAP_UNIT    0
+#define TERRAIN_MAPS_NORMAL_MAP_IMAGE   0
+#define TERRAIN_MAPS_BLEND_MAP_IMAGE    1
+#define TERRAIN_MAPS_VERTEX_BUFFER      0
+
+class TerrainMapsTechnique : public Technique
+{
+public:
+
+    TerrainMapsTechnique();
+
+    virtual bool Init();
+
+    void SetSize(int Width, int Depth, float WorldScale);
+
+    // [Start, End) in height map coordinates
+    void SetRegion(int StartX, int StartZ, int EndX, int EndZ);
+
+    void SetSlopeLighting(int dx0, int dz0, int dx1, int dz1, float Factor, float Softness);
+
+    void SetTextureHeights(float Tex0Height, float Tex1Height, float Tex2Height, float Tex3Height);
+
+    void SetWriteVertices(bool WriteVertices);
+
+private:
+    GLuint m_sizeLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_regionStartLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_regionEndLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_worldScaleLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_slopeOffsetsLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_slopeFactorLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_slopeSoftnessLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_textureHeightsLoc = INVALID_UNIFORM_LOCATION;
+    GLuint m_writeVerticesLoc = INVALID_UNIFORM_LOCATION;
+};
+
+#endif  /* TERRAIN_MAPS_TECHNIQUE_H */
@@ -0,0 +1,228 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <float.h>
+#include <algorithm>
+
+#include "terrain_pager.h"
+
+
+TerrainPager::~TerrainPager()
+{
+    Stop();
+}
+
+
+void TerrainPager::Start(const TiledHeightMap* pHeightMap, float WorldScale, float TextureScale, float SkirtDepth)
+{
+    Stop();
+
+    m_pHeightMap = pHeightMap;
+    m_tileSize = pHeightMap->GetTileSize();
+    m_worldScale = WorldScale;
+    m_textureScale = TextureScale;
+    m_skirtDepth = SkirtDepth;
+    m_heights.resize(m_tileSize * m_tileSize);
+    m_numTilesLoaded = 0;
+    m_quit = false;
+
+    m_thread = std::thread(&TerrainPager::WorkerThread, this);
+}
+
+
+void TerrainPager::Stop()
+{
+    if (!m_thread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> Lock(m_mutex);
+        m_quit = true;
+    }
+
+    m_cond.notify_one();
+    m_thread.join();
+
+    m_requests.clear();
+    m_completed.clear();
+}
+
+
+bool TerrainPager::IsQueuedOrInFlight(const TerrainTileCoord& Coord) const
+{
+    if (m_busy && (m_inFlight == Coord)) {
+        return true;
+    }
+
+    for (size_t i = 0 ; i < m_completed.size() ; i++) {
+        if (m_completed[i].Coord == Coord) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+void TerrainPager::SetRequests(const std::vector<TerrainTileCoord>& Requests)
+{
+    {
+        std::lock_guard<std::mutex> Lock(m_mutex);
+
+        m_requests.clear();
+
+        for (size_t i = 0 ; i < Requests.size() ; i++) {
+            if (!IsQueuedOrInFlight(Requests[i])) {
+                m_requests.push_back(Requests[i]);
+            }
+        }
+    }
+
+    m_cond.notify_one();
+}
+
+
+bool TerrainPager::GetCompletedTile(TerrainTileData& Tile)
+{
+    std::lock_guard<std::mutex> Lock(m_mutex);
+
+    if (m_completed.empty()) {
+        return false;
+    }
+
+    std::swap(Tile, m_completed.front());
+
+    m_freeTiles.push_back(std::move(m_completed.front()));
+    m_completed.pop_front();
+
+    return true;
+}
+
+
+int TerrainPager::GetNumPending()
+{
+    std::lock_guard<std::mutex> Lock(m_mutex);
+
+    return (int)m_requests.size() + (m_busy ? 1 : 0);
+}
+
+
+void TerrainPager::WorkerThread()
+{
+    TerrainTileData Tile;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> Lock(m_mutex);
+
+            m_busy = false;
+
+            if (Tile.Vertices.size() > 0) {
+                m_completed.push_back(std::move(Tile));
+            }
+
+            m_cond.wait(Lock, [this] { return m_quit || !m_requests.empty(); });
+
+            if (m_quit) {
+                return;
+            }
+
+            m_inFlight = m_requests.front();
+            m_requests.pop_front();
+            m_busy = true;
+
+            if (m_freeTiles.size() > 0) {
+                Tile = std::move(m_freeTiles.back());
+                m_freeTiles.pop_back();
+            } else {
+                Tile = TerrainTileData();
+            }
+        }
+
+        // Reading the tile is where the page faults of the mapped file happen
+        BuildTile(m_inFlight, Tile);
+
+        m_numTilesLoaded++;
+    }
+}
+
+
+void TerrainPager::BuildTile(const TerrainTileCoord& Coord, TerrainTileData& Tile)
+{
+    m_pHeightMap->ReadTile(Coord.TileX, Coord.TileZ, m_heights.data());
+
+    Tile.Coord = Coord;
+    Tile.MinHeight = FLT_MAX;
+    Tile.MaxHeight = -FLT_MAX;
+    Tile.Vertices.resize(GetNumVerticesPerTile());
+
+    int BaseX = Coord.TileX * (m_tileSize - 1);
+    int BaseZ = Coord.TileZ * (m_tileSize - 1);
+    float TexStep = m_textureScale / (float)(m_tileSize - 1);
+
+    for (int z = 0 ; z < m_tileSize ; z++) {
+        for (int x = 0 ; x < m_tileSize ; x++) {
+            float h = m_heights[z * m_tileSize + x];
+
+            Tile.MinHeight = std::min(Tile.MinHeight, h);
+            Tile.MaxHeight = std::max(Tile.MaxHeight, h);
+
+            // Neighbours outside the tile come from the height map itself
+            bool Interior = (x > 0) && (x < m_tileSize - 1) && (z > 0) && (z < m_tileSize - 1);
+
+            float hLeft, hRight, hDown, hUp;
+
+            if (Interior) {
+                hLeft  = m_heights[z * m_tileSize + x - 1];
+                hRight = m_heights[z * m_tileSize + x + 1];
+                hDown  = m_heights[(z - 1) * m_tileSize + x];
+                hUp    = m_heights[(z + 1) * m_tileSize + x];
+            } else {
+                hLeft  = m_pHeightMap->GetHeight(BaseX + x - 1, BaseZ + z);
+                hRight = m_pHeightMap->GetHeight(BaseX + x + 1, BaseZ + z);
+                hDown  = m_pHeightMap->GetHeight(BaseX + x, BaseZ + z - 1);
+                hUp    = m_pHeightMap->GetHeight(BaseX + x, BaseZ + z + 1);
+            }
+
+            TerrainVertex& v = Tile.Vertices[z * m_tileSize + x];
+            v.Pos = Vector3f((float)(BaseX + x) * m_worldScale, h, (float)(BaseZ + z) * m_worldScale);
+            v.Tex = Vector2f((float)x * TexStep, (float)z * TexStep);
+            v.Normal = Vector3f(hLeft - hRight, 2.0f * m_worldScale, hDown - hUp);
+            v.Normal.Normalize();
+        }
+    }
+
+    // Skirts hide the cracks between neighbouring tiles with different LODs
+    int SkirtBase = m_tileSize * m_tileSize;
+
+    for (int i = 0 ; i < m_tileSize ; i++) {
+        int EdgeVertices[4] = { i,                                      // bottom
+                                (m_tileSize - 1) * m_tileSize + i,      // top
+                                i * m_tileSize,                         // left
+                                i * m_tileSize + m_tileSize - 1 };      // right
+
+        for (int Edge = 0 ; Edge < 4 ; Edge++) {
+            TerrainVertex& v = Tile.Vertices[SkirtBase + Edge * m_tileSize + i];
+            v = Tile.Vertices[EdgeVertices[Edge]];
+            v.Pos.y -= m_skirtDepth;
+        }
+    }
+}
@@ -0,0 +1,118 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef TERRAIN_PAGER_H
+#define TERRAIN_PAGER_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "ogldev_math_3d.h"
+#include "tiled_heightmap.h"
+
+// Same layout as the vertex of GeomipGrid so both can use TerrainTechnique
+struct TerrainVertex {
+    Vector3f Pos;
+    Vector2f Tex;
+    Vector3f Normal;
+};
+
+
+struct TerrainTileCoord {
+    int TileX = 0;
+    int TileZ = 0;
+
+    TerrainTileCoord() {}
+    TerrainTileCoord(int x, int z) : TileX(x), TileZ(z) {}
+
+    bool operator==(const TerrainTileCoord& c) const { return (TileX == c.TileX) && (TileZ == c.TileZ); }
+};
+
+
+// The tile vertices are the TileSize x TileSize grid followed by the four skirts
+// (bottom, top, left, right), TileSize vertices each.
+struct TerrainTileData {
+    TerrainTileCoord Coord;
+    float MinHeight = 0.0f;
+    float MaxHeight = 0.0f;
+    std::vector<TerrainVertex> Vertices;
+};
+
+
+//
+// Background thread which reads tiles from a TiledHeightMap and turns them
+// into vertices. The render thread only has to copy the result into a vertex buffer.
+//
+class TerrainPager {
+ public:
+    TerrainPager() {}
+
+    ~TerrainPager();
+
+    // TextureScale is the number of times the textures repeat across a tile
+    void Start(const TiledHeightMap* pHeightMap, float WorldScale, float TextureScale, float SkirtDepth);
+
+    void Stop();
+
+    // Replaces all the pending requests. The first tile in the list is loaded first.
+    // Tiles which are being built or are waiting in the completed queue are ignored.
+    void SetRequests(const std::vector<TerrainTileCoord>& Requests);
+
+    // Returns false if there are no completed tiles. Tile is swapped with the completed
+    // tile so its previous vertex storage is recycled by the pager.
+    bool GetCompletedTile(TerrainTileData& Tile);
+
+    int GetNumPending();
+
+    int GetNumVerticesPerTile() const { return m_tileSize * m_tileSize + 4 * m_tileSize; }
+
+    long long GetNumTilesLoaded() const { return m_numTilesLoaded; }
+
+ private:
+
+    void WorkerThread();
+
+    void BuildTile(const TerrainTileCoord& Coord, TerrainTileData& Tile);
+
+    bool IsQueuedOrInFlight(const TerrainTileCoord& Coord) const;
+
+    const TiledHeightMap* m_pHeightMap = NULL;
+    int m_tileSize = 0;
+    float m_worldScale = 1.0f;
+    float m_textureScale = 1.0f;
+    float m_skirtDepth = 0.0f;
+    std::vector<float> m_heights;   // worker thread scratch
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_quit = false;
+    bool m_busy = false;
+    TerrainTileCoord m_inFlight;
+    std::deque<TerrainTileCoord> m_requests;
+    std::deque<TerrainTileData> m_completed;
+    std::vector<TerrainTileData> m_freeTiles;
+    std::atomic<long long> m_numTilesLoaded{0};
+};
+
+#endif
@@ -25,12 +25,18 @@ TerrainTechnique::TerrainTechnique()
 }
 
 bool TerrainTechnique::Init()
+{
+    return InitTerrainProgram("terrain.vs");
+}
+
+
+bool TerrainTechnique::InitTerrainProgram(const char* pVSFilename)
 {
     if (!Technique::Init()) {
         return false;
     }
 
-    if (!AddShader(GL_VERTEX_SHADER, "terrain.vs")) {
+    if (!AddShader(GL_VERTEX_SHADER, pVSFilename)) {
         return false;
     }
 
@@ -54,6 +60,10 @@ bool TerrainTechnique::Init()
     m_tex2HeightLoc = GetUniformLocation("gHeight2");
     m_tex3HeightLoc = GetUniformLocation("gHeight3");
     m_reversedLightDirLoc = GetUniformLocation("gReversedLightDir");
+    m_useTerrainMapsLoc = GetUniformLocation("gUseTerrainMaps");
+    m_normalMapUnitLoc = GetUniformLocation("gNormalMap");
+    m_blendMapUnitLoc = GetUniformLocation("gBlendMap");
+    m_terrainMapScaleBiasLoc = GetUniformLocation("gTerrainMapScaleBias");
 
     if (m_VPLoc == INVALID_UNIFORM_LOCATION||
         m_minHeightLoc == INVALID_UNIFORM_LOCATION ||
@@ -66,7 +76,11 @@ bool TerrainTechnique::Init()
         m_tex1HeightLoc == INVALID_UNIFORM_LOCATION ||
         m_tex2HeightLoc == INVALID_UNIFORM_LOCATION ||
         m_tex3HeightLoc == INVALID_UNIFORM_LOCATION ||
-        m_reversedLightDirLoc == INVALID_UNIFORM_LOCATION) {
+        m_reversedLightDirLoc == INVALID_UNIFORM_LOCATION ||
+        m_useTerrainMapsLoc == INVALID_UNIFORM_LOCATION ||
+        m_normalMapUnitLoc == INVALID_UNIFORM_LOCATION ||
+        m_blendMapUnitLoc == INVALID_UNIFORM_LOCATION ||
+        m_terrainMapScaleBiasLoc == INVALID_UNIFORM_LOCATION) {
         return false;
     }
 
@@ -76,6 +90,8 @@ bool TerrainTechnique::Init()
     glUniform1i(m_tex1UnitLoc, COLOR_TEXTURE_UNIT_INDEX_1);
     glUniform1i(m_tex2UnitLoc, COLOR_TEXTURE_UNIT_INDEX_2);
     glUniform1i(m_tex3UnitLoc, COLOR_TEXTURE_UNIT_INDEX_3);
+    glUniform1i(m_normalMapUnitLoc, NORMAL_MAP_TEXTURE_UNIT_INDEX);
+    glUniform1i(m_blendMapUnitLoc, BLEND_MAP_TEXTURE_UNIT_INDEX);
 
     glUseProgram(0);
 
@@ -112,3 +128,9 @@ void TerrainTechnique::SetLightDir(const Vector3f& Dir)
     glUniform3f(m_reversedLightDirLoc, ReversedLightDir.x, ReversedLightDir.y, ReversedLightDir.z);
 }
 
+
+void TerrainTechnique::SetTerrainMaps(bool Enabled, float Scale, float Bias)
+{
+    glUniform1i(m_useTerrainMapsLoc, Enabled ? 1 : 0);
+    glUniform2f(m_terrainMapScaleBiasLoc, Scale, Bias);
+}
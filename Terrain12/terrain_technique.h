@@ -36,6 +36,14 @@ public:
     void SetTextureHeights(float Tex0Height, float Tex1Height, float Tex2Height, float Tex3Height);
 	
     void SetLightDir(const Vector3f& Dir);
+
+    // Scale and Bias map the world XZ coordinates into the normal/blend maps of TerrainMaps
+    void SetTerrainMaps(bool Enabled, float Scale, float Bias);
+
+protected:
+
+    // Builds the program from the given vertex shader and terrain.fs
+    bool InitTerrainProgram(const char* pVSFilename);
 	
 private:
     GLuint m_VPLoc = -1;
@@ -50,6 +58,10 @@ private:
     GLuint m_tex2UnitLoc = -1;
     GLuint m_tex3UnitLoc = -1;
     GLuint m_reversedLightDirLoc = -1;
+    GLuint m_useTerrainMapsLoc = -1;
+    GLuint m_normalMapUnitLoc = -1;
+    GLuint m_blendMapUnitLoc = -1;
+    GLuint m_terrainMapScaleBiasLoc = -1;
 };
 
 #endif  /* TERRAIN_TECHNIQUE_H */
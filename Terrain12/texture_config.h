@@ -9,6 +9,12 @@
 #define COLOR_TEXTURE_UNIT_INDEX_2 2
 #define COLOR_TEXTURE_UNIT_3 GL_TEXTURE3
 #define COLOR_TEXTURE_UNIT_INDEX_3 3
+#define NORMAL_MAP_TEXTURE_UNIT GL_TEXTURE4
+#define NORMAL_MAP_TEXTURE_UNIT_INDEX 4
+#define BLEND_MAP_TEXTURE_UNIT GL_TEXTURE5
+#define BLEND_MAP_TEXTURE_UNIT_INDEX 5
+#define CLIPMAP_TEXTURE_UNIT GL_TEXTURE6
+#define CLIPMAP_TEXTURE_UNIT_INDEX 6
 
 
 #endif
@@ -0,0 +1,715 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef _WIN64
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <limits.h>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+
+#ifdef OGLDEV_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef OGLDEV_ZSTD
+#include <zstd.h>
+#endif
+
+#include "tiled_heightmap.h"
+
+#define DECODE_CACHE_SIZE 9     // a tile and its eight neighbours
+
+struct DecodedTile {
+    uint MapId = 0;
+    int TileX = -1;
+    int TileZ = -1;
+    long long LastUsed = 0;
+    std::vector<unsigned short> Heights;
+};
+
+static thread_local DecodedTile t_decodeCache[DECODE_CACHE_SIZE];
+static thread_local long long t_decodeCounter = 0;
+static thread_local std::vector<unsigned short> t_quantized;
+
+static std::atomic<uint> g_nextMapId{1};
+
+
+// Compressed tiles store the difference from the previous height in the row
+// which is much more compressible than the heights themselves.
+static void DeltaEncode(const unsigned short* pSrc, unsigned short* pDst, int TileSize)
+{
+    for (int z = 0 ; z < TileSize ; z++) {
+        const unsigned short* pRow = pSrc + z * TileSize;
+        pDst[z * TileSize] = pRow[0];
+
+        for (int x = 1 ; x < TileSize ; x++) {
+            pDst[z * TileSize + x] = (unsigned short)(pRow[x] - pRow[x - 1]);
+        }
+    }
+}
+
+
+static void UndoDeltaEncoding(unsigned short* pHeights, int TileSize)
+{
+    for (int z = 0 ; z < TileSize ; z++) {
+        unsigned short* pRow = pHeights + z * TileSize;
+
+        for (int x = 1 ; x < TileSize ; x++) {
+            pRow[x] = (unsigned short)(pRow[x] + pRow[x - 1]);
+        }
+    }
+}
+
+
+TiledHeightMap::~TiledHeightMap()
+{
+    Close();
+}
+
+
+// Same constraints as Create. The tile counts are limited so that the size of the
+// map in vertices and the patch counts fit in an int.
+static bool IsHeaderValid(const TiledHeightMapHeader& Header, size_t FileSize)
+{
+    int NumSegments = Header.TileSize - 1;
+
+    if ((NumSegments < 2) || (NumSegments > TILED_HEIGHTMAP_MAX_TILE_SEGMENTS) || ((NumSegments & (NumSegments - 1)) != 0)) {
+        return false;
+    }
+
+    if ((Header.PatchSize != 0) && ((Header.PatchSize < 3) || (NumSegments % (Header.PatchSize - 1) != 0))) {
+        return false;
+    }
+
+    if ((Header.NumTilesX < 1) || (Header.NumTilesZ < 1) ||
+        ((long long)Header.NumTilesX * NumSegments >= INT_MAX) ||
+        ((long long)Header.NumTilesZ * NumSegments >= INT_MAX)) {
+        return false;
+    }
+
+    // Every tile has an entry in the directory which must fit in the file
+    unsigned long long NumTiles = (unsigned long long)Header.NumTilesX * (unsigned long long)Header.NumTilesZ;
+
+    if (NumTiles > FileSize / sizeof(TiledHeightMapTileEntry)) {
+        return false;
+    }
+
+    // Same for the finest level of the pyramid (the level offsets are ints)
+    if (Header.PatchSize != 0) {
+        unsigned long long NumPatches = NumTiles * (NumSegments / (Header.PatchSize - 1)) * (NumSegments / (Header.PatchSize - 1));
+
+        if ((NumPatches > FileSize / sizeof(MinMaxHeight)) || (NumPatches >= INT_MAX / 2)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+bool TiledHeightMap::Open(const char* pFilename)
+{
+    Close();
+
+#ifdef _WIN64
+    HANDLE hFile = CreateFileA(pFilename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (hFile == INVALID_HANDLE_VALUE) {
+        printf("%s:%d - error opening '%s'\n", __FILE__, __LINE__, pFilename);
+        return false;
+    }
+
+    LARGE_INTEGER FileSize;
+    GetFileSizeEx(hFile, &FileSize);
+    m_fileSize = (size_t)FileSize.QuadPart;
+    m_hFile = hFile;
+
+    m_hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if (m_hMapping) {
+        m_pData = (const unsigned char*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+    }
+#else
+    m_fd = open(pFilename, O_RDONLY);
+
+    if (m_fd < 0) {
+        printf("%s:%d - error opening '%s'\n", __FILE__, __LINE__, pFilename);
+        return false;
+    }
+
+    struct stat st;
+    fstat(m_fd, &st);
+    m_fileSize = (size_t)st.st_size;
+
+    void* p = mmap(NULL, m_fileSize, PROT_READ, MAP_SHARED, m_fd, 0);
+
+    if (p != MAP_FAILED) {
+        m_pData = (const unsigned char*)p;
+    }
+#endif
+
+    if (!m_pData) {
+        printf("%s:%d - error mapping '%s'\n", __FILE__, __LINE__, pFilename);
+        Close();
+        return false;
+    }
+
+    if (m_fileSize < sizeof(TiledHeightMapHeader)) {
+        printf("%s:%d - '%s' is too small for a tiled height map\n", __FILE__, __LINE__, pFilename);
+        Close();
+        return false;
+    }
+
+    memcpy(&m_header, m_pData, sizeof(m_header));
+
+    if ((m_header.Magic != TILED_HEIGHTMAP_MAGIC) || (m_header.Version != TILED_HEIGHTMAP_VERSION)) {
+        printf("%s:%d - '%s' is not a tiled height map (or the version is not supported)\n", __FILE__, __LINE__, pFilename);
+        Close();
+        return false;
+    }
+
+    if (!IsHeaderValid(m_header, m_fileSize)) {
+        printf("%s:%d - '%s' has an invalid tile size/patch size/tile count\n", __FILE__, __LINE__, pFilename);
+        Close();
+        return false;
+    }
+
+    size_t NumTiles = (size_t)m_header.NumTilesX * (size_t)m_header.NumTilesZ;
+
+    if (m_header.PatchSize != 0) {
+        int NumPatchesX = m_header.NumTilesX * (m_header.TileSize - 1) / (m_header.PatchSize - 1);
+        int NumPatchesZ = m_header.NumTilesZ * (m_header.TileSize - 1) / (m_header.PatchSize - 1);
+        CalcPyramidLevels(NumPatchesX, NumPatchesZ, m_pyramidLevels);
+    }
+
+    size_t PyramidSize = m_pyramidLevels.empty() ? 0 : m_pyramidLevels.back().Offset + 1;
+
+    bool SizesOK = (m_header.TileDirOffset + NumTiles * sizeof(TiledHeightMapTileEntry) <= m_fileSize) &&
+                   (m_header.PyramidOffset + PyramidSize * sizeof(MinMaxHeight) <= m_fileSize) &&
+                   (m_header.NumPyramidLevels == (int)m_pyramidLevels.size());
+
+    if (SizesOK) {
+        m_pTileDir = (const TiledHeightMapTileEntry*)(m_pData + m_header.TileDirOffset);
+        m_pPyramid = (const MinMaxHeight*)(m_pData + m_header.PyramidOffset);
+
+        size_t RawTileSize = (size_t)m_header.TileSize * m_header.TileSize * sizeof(unsigned short);
+
+        for (size_t i = 0 ; i < NumTiles ; i++) {
+            const TiledHeightMapTileEntry& Entry = m_pTileDir[i];
+            SizesOK = SizesOK && (Entry.Offset + Entry.Size <= m_fileSize);
+
+            // Uncompressed tiles are read in place as 16-bit heights
+            if (Entry.Compression == TILE_COMPRESSION_NONE) {
+                SizesOK = SizesOK && (Entry.Size == RawTileSize) && (Entry.Offset % TILED_HEIGHTMAP_TILE_ALIGNMENT == 0);
+            }
+        }
+    }
+
+    if (!SizesOK) {
+        printf("%s:%d - '%s' is truncated or corrupted\n", __FILE__, __LINE__, pFilename);
+        Close();
+        return false;
+    }
+
+#ifndef OGLDEV_LZ4
+    if (m_header.Compression == TILE_COMPRESSION_LZ4) {
+        printf("%s:%d - '%s' uses LZ4 compression - build with OGLDEV_LZ4\n", __FILE__, __LINE__, pFilename);
+        Close();
+        return false;
+    }
+#endif
+
+#ifndef OGLDEV_ZSTD
+    if (m_header.Compression == TILE_COMPRESSION_ZSTD) {
+        printf("%s:%d - '%s' uses zstd compression - build with OGLDEV_ZSTD\n", __FILE__, __LINE__, pFilename);
+        Close();
+        return false;
+    }
+#endif
+
+    m_id = g_nextMapId++;
+
+    printf("Opened tiled height map '%s': %dx%d tiles of %d, %dx%d vertices, patch size %d, compression %d\n", pFilename,
+           m_header.NumTilesX, m_header.NumTilesZ, m_header.TileSize, GetWidth(), GetDepth(), m_header.PatchSize, m_header.Compression);
+
+    return true;
+}
+
+
+void TiledHeightMap::Close()
+{
+#ifdef _WIN64
+    if (m_pData) {
+        UnmapViewOfFile(m_pData);
+    }
+
+    if (m_hMapping) {
+        CloseHandle(m_hMapping);
+        m_hMapping = NULL;
+    }
+
+    if (m_hFile) {
+        CloseHandle(m_hFile);
+        m_hFile = NULL;
+    }
+#else
+    if (m_pData) {
+        munmap((void*)m_pData, m_fileSize);
+    }
+
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+#endif
+
+    m_pData = NULL;
+    m_pTileDir = NULL;
+    m_pPyramid = NULL;
+    m_pyramidLevels.clear();
+    m_fileSize = 0;
+    m_id = 0;
+    m_header = TiledHeightMapHeader();
+}
+
+
+void TiledHeightMap::CalcPyramidLevels(int NumPatchesX, int NumPatchesZ, std::vector<PyramidLevel>& Levels)
+{
+    Levels.clear();
+
+    PyramidLevel Level;
+    Level.Width = NumPatchesX;
+    Level.Depth = NumPatchesZ;
+
+    while (true) {
+        Levels.push_back(Level);
+
+        if ((Level.Width == 1) && (Level.Depth == 1)) {
+            break;
+        }
+
+        Level.Offset += Level.Width * Level.Depth;
+        Level.Width = (Level.Width + 1) / 2;
+        Level.Depth = (Level.Depth + 1) / 2;
+    }
+}
+
+
+const TiledHeightMapTileEntry& TiledHeightMap::GetTileEntry(int TileX, int TileZ) const
+{
+    return m_pTileDir[TileZ * m_header.NumTilesX + TileX];
+}
+
+
+const MinMaxHeight& TiledHeightMap::GetPyramidMinMax(int Level, int x, int z) const
+{
+    const PyramidLevel& l = m_pyramidLevels[Level];
+
+    return m_pPyramid[l.Offset + z * l.Width + x];
+}
+
+
+void TiledHeightMap::DecodeTile(int TileX, int TileZ, unsigned short* pQuantized) const
+{
+    const TiledHeightMapTileEntry& Entry = GetTileEntry(TileX, TileZ);
+    const unsigned char* pSrc = m_pData + Entry.Offset;
+    size_t DecodedSize = (size_t)m_header.TileSize * m_header.TileSize * sizeof(unsigned short);
+    bool ok = false;
+
+    switch (Entry.Compression) {
+
+    case TILE_COMPRESSION_NONE:
+        ok = (Entry.Size == DecodedSize);
+
+        if (ok) {
+            memcpy(pQuantized, pSrc, DecodedSize);
+        }
+        break;
+
+#ifdef OGLDEV_LZ4
+    case TILE_COMPRESSION_LZ4:
+        ok = LZ4_decompress_safe((const char*)pSrc, (char*)pQuantized, (int)Entry.Size, (int)DecodedSize) == (int)DecodedSize;
+        break;
+#endif
+
+#ifdef OGLDEV_ZSTD
+    case TILE_COMPRESSION_ZSTD:
+        ok = ZSTD_decompress(pQuantized, DecodedSize, pSrc, Entry.Size) == DecodedSize;
+        break;
+#endif
+    }
+
+    if (!ok) {
+        printf("%s:%d - error decoding tile %d,%d\n", __FILE__, __LINE__, TileX, TileZ);
+        memset(pQuantized, 0, DecodedSize);
+        return;
+    }
+
+    if (Entry.Compression != TILE_COMPRESSION_NONE) {
+        UndoDeltaEncoding(pQuantized, m_header.TileSize);
+    }
+}
+
+
+const unsigned short* TiledHeightMap::DecodeTileCached(int TileX, int TileZ) const
+{
+    const TiledHeightMapTileEntry& Entry = GetTileEntry(TileX, TileZ);
+
+    // Uncompressed tiles are used directly from the mapped file
+    if (Entry.Compression == TILE_COMPRESSION_NONE) {
+        return (const unsigned short*)(m_pData + Entry.Offset);
+    }
+
+    t_decodeCounter++;
+
+    int LRU = 0;
+
+    for (int i = 0 ; i < DECODE_CACHE_SIZE ; i++) {
+        DecodedTile& Tile = t_decodeCache[i];
+
+        if ((Tile.MapId == m_id) && (Tile.TileX == TileX) && (Tile.TileZ == TileZ)) {
+            Tile.LastUsed = t_decodeCounter;
+            return Tile.Heights.data();
+        }
+
+        if (Tile.LastUsed < t_decodeCache[LRU].LastUsed) {
+            LRU = i;
+        }
+    }
+
+    DecodedTile& Tile = t_decodeCache[LRU];
+    Tile.MapId = m_id;
+    Tile.TileX = TileX;
+    Tile.TileZ = TileZ;
+    Tile.LastUsed = t_decodeCounter;
+    Tile.Heights.resize(m_header.TileSize * m_header.TileSize);
+
+    DecodeTile(TileX, TileZ, Tile.Heights.data());
+
+    return Tile.Heights.data();
+}
+
+
+void TiledHeightMap::ReadTile(int TileX, int TileZ, float* pHeights) const
+{
+    const TiledHeightMapTileEntry& Entry = GetTileEntry(TileX, TileZ);
+    int NumHeights = m_header.TileSize * m_header.TileSize;
+
+    const unsigned short* pQuantized = NULL;
+
+    if (Entry.Compression == TILE_COMPRESSION_NONE) {
+        pQuantized = (const unsigned short*)(m_pData + Entry.Offset);
+    } else {
+        t_quantized.resize(NumHeights);
+        DecodeTile(TileX, TileZ, t_quantized.data());
+        pQuantized = t_quantized.data();
+    }
+
+    for (int i = 0 ; i < NumHeights ; i++) {
+        pHeights[i] = Entry.Bias + Entry.Scale * (float)pQuantized[i];
+    }
+}
+
+
+float TiledHeightMap::GetHeight(int x, int z) const
+{
+    x = std::max(0, std::min(x, GetWidth() - 1));
+    z = std::max(0, std::min(z, GetDepth() - 1));
+
+    int TileStep = m_header.TileSize - 1;
+
+    // The last row/column of the map belongs to the last tile
+    int TileX = std::min(x / TileStep, m_header.NumTilesX - 1);
+    int TileZ = std::min(z / TileStep, m_header.NumTilesZ - 1);
+
+    int LocalX = x - TileX * TileStep;
+    int LocalZ = z - TileZ * TileStep;
+
+    const TiledHeightMapTileEntry& Entry = GetTileEntry(TileX, TileZ);
+    const unsigned short* pQuantized = DecodeTileCached(TileX, TileZ);
+
+    return Entry.Bias + Entry.Scale * (float)pQuantized[LocalZ * m_header.TileSize + LocalX];
+}
+
+
+float TiledHeightMap::GetHeightInterpolated(float x, float z) const
+{
+    int x0 = (int)floorf(x);
+    int z0 = (int)floorf(z);
+
+    float FactorX = x - (float)x0;
+    float FactorZ = z - (float)z0;
+
+    float X0Z0Height = GetHeight(x0, z0);
+    float X1Z0Height = GetHeight(x0 + 1, z0);
+    float X0Z1Height = GetHeight(x0, z0 + 1);
+    float X1Z1Height = GetHeight(x0 + 1, z0 + 1);
+
+    float InterpolatedBottom = (X1Z0Height - X0Z0Height) * FactorX + X0Z0Height;
+    float InterpolatedTop    = (X1Z1Height - X0Z1Height) * FactorX + X0Z1Height;
+
+    return (InterpolatedTop - InterpolatedBottom) * FactorZ + InterpolatedBottom;
+}
+
+
+static uint CompressTile(TILE_COMPRESSION Compression, const std::vector<unsigned short>& Quantized, int TileSize, std::vector<char>& Compressed)
+{
+    size_t Size = Quantized.size() * sizeof(unsigned short);
+    size_t CompressedSize = 0;
+
+    std::vector<unsigned short> Deltas(Quantized.size());
+    DeltaEncode(Quantized.data(), Deltas.data(), TileSize);
+
+    switch (Compression) {
+
+#ifdef OGLDEV_LZ4
+    case TILE_COMPRESSION_LZ4:
+        Compressed.resize(LZ4_compressBound((int)Size));
+        CompressedSize = LZ4_compress_default((const char*)Deltas.data(), Compressed.data(), (int)Size, (int)Compressed.size());
+        break;
+#endif
+
+#ifdef OGLDEV_ZSTD
+    case TILE_COMPRESSION_ZSTD:
+        Compressed.resize(ZSTD_compressBound(Size));
+        CompressedSize = ZSTD_compress(Compressed.data(), Compressed.size(), Deltas.data(), Size, 3);
+
+        if (ZSTD_isError(CompressedSize)) {
+            CompressedSize = 0;
+        }
+        break;
+#endif
+
+    default:
+        break;
+    }
+
+    // Zero means the tile is stored as is
+    if ((CompressedSize == 0) || (CompressedSize >= Size)) {
+        return 0;
+    }
+
+    return (uint)CompressedSize;
+}
+
+
+bool TiledHeightMap::Create(const char* pFilename, int TileSize, int NumTilesX, int NumTilesZ, int PatchSize,
+                            TILE_COMPRESSION Compression, HeightFunc pHeightFunc, void* pUserData)
+{
+    int NumSegments = TileSize - 1;
+
+    if ((NumSegments < 2) || (NumSegments > TILED_HEIGHTMAP_MAX_TILE_SEGMENTS) || ((NumSegments & (NumSegments - 1)) != 0)) {
+        printf("%s:%d - tile size minus one must be a power of two up to %d (%d)\n", __FILE__, __LINE__, TILED_HEIGHTMAP_MAX_TILE_SEGMENTS, TileSize);
+        return false;
+    }
+
+    if ((PatchSize != 0) && ((PatchSize < 3) || (NumSegments % (PatchSize - 1) != 0))) {
+        printf("%s:%d - tile size minus one (%d) must be divisible by patch size minus one (%d)\n", __FILE__, __LINE__, NumSegments, PatchSize - 1);
+        return false;
+    }
+
+#ifndef OGLDEV_LZ4
+    if (Compression == TILE_COMPRESSION_LZ4) {
+        printf("%s:%d - LZ4 compression requires OGLDEV_LZ4\n", __FILE__, __LINE__);
+        return false;
+    }
+#endif
+
+#ifndef OGLDEV_ZSTD
+    if (Compression == TILE_COMPRESSION_ZSTD) {
+        printf("%s:%d - zstd compression requires OGLDEV_ZSTD\n", __FILE__, __LINE__);
+        return false;
+    }
+#endif
+
+    FILE* f = fopen(pFilename, "wb");
+
+    if (!f) {
+        printf("%s:%d - error opening '%s' for writing\n", __FILE__, __LINE__, pFilename);
+        return false;
+    }
+
+    std::vector<PyramidLevel> Levels;
+    int PatchesPerTile = 0;
+
+    if (PatchSize != 0) {
+        PatchesPerTile = NumSegments / (PatchSize - 1);
+        CalcPyramidLevels(NumTilesX * PatchesPerTile, NumTilesZ * PatchesPerTile, Levels);
+    }
+
+    std::vector<TiledHeightMapTileEntry> TileDir(NumTilesX * NumTilesZ);
+    std::vector<MinMaxHeight> Pyramid(Levels.empty() ? 0 : Levels.back().Offset + 1);
+
+    TiledHeightMapHeader Header;
+    Header.TileSize = TileSize;
+    Header.NumTilesX = NumTilesX;
+    Header.NumTilesZ = NumTilesZ;
+    Header.PatchSize = PatchSize;
+    Header.MinHeight = FLT_MAX;
+    Header.MaxHeight = -FLT_MAX;
+    Header.Compression = Compression;
+    Header.NumPyramidLevels = (int)Levels.size();
+    Header.TileDirOffset = sizeof(TiledHeightMapHeader);
+    Header.PyramidOffset = Header.TileDirOffset + TileDir.size() * sizeof(TiledHeightMapTileEntry);
+
+    // The header, the tile directory and the pyramid are written again at the end
+    fwrite(&Header, sizeof(Header), 1, f);
+    fwrite(TileDir.data(), sizeof(TiledHeightMapTileEntry), TileDir.size(), f);
+    fwrite(Pyramid.data(), sizeof(MinMaxHeight), Pyramid.size(), f);
+
+    unsigned long long Offset = Header.PyramidOffset + Pyramid.size() * sizeof(MinMaxHeight);
+
+    std::vector<float> Tile(TileSize * TileSize);
+    std::vector<unsigned short> Quantized(TileSize * TileSize);
+    std::vector<char> Compressed;
+    size_t TotalSize = 0;
+
+    for (int TileZ = 0 ; TileZ < NumTilesZ ; TileZ++) {
+        for (int TileX = 0 ; TileX < NumTilesX ; TileX++) {
+            TiledHeightMapTileEntry& Entry = TileDir[TileZ * NumTilesX + TileX];
+
+            int BaseX = TileX * NumSegments;
+            int BaseZ = TileZ * NumSegments;
+
+            Entry.MinHeight = FLT_MAX;
+            Entry.MaxHeight = -FLT_MAX;
+
+            for (int z = 0 ; z < TileSize ; z++) {
+                for (int x = 0 ; x < TileSize ; x++) {
+                    float h = pHeightFunc(BaseX + x, BaseZ + z, pUserData);
+                    Tile[z * TileSize + x] = h;
+                    Entry.MinHeight = std::min(Entry.MinHeight, h);
+                    Entry.MaxHeight = std::max(Entry.MaxHeight, h);
+                }
+            }
+
+            Entry.Bias = Entry.MinHeight;
+            Entry.Scale = (Entry.MaxHeight - Entry.MinHeight) / 65535.0f;
+
+            for (int i = 0 ; i < TileSize * TileSize ; i++) {
+                float q = (Entry.Scale > 0.0f) ? (Tile[i] - Entry.Bias) / Entry.Scale : 0.0f;
+                Quantized[i] = (unsigned short)std::min(65535.0f, q + 0.5f);
+
+                // The bounds below must hold for what the reader will decode
+                Tile[i] = Entry.Bias + Entry.Scale * (float)Quantized[i];
+            }
+
+            Header.MinHeight = std::min(Header.MinHeight, Entry.MinHeight);
+            Header.MaxHeight = std::max(Header.MaxHeight, Entry.MaxHeight);
+
+            for (int pz = 0 ; pz < PatchesPerTile ; pz++) {
+                for (int px = 0 ; px < PatchesPerTile ; px++) {
+                    MinMaxHeight mm;
+                    mm.Min = FLT_MAX;
+                    mm.Max = -FLT_MAX;
+
+                    for (int z = pz * (PatchSize - 1) ; z <= (pz + 1) * (PatchSize - 1) ; z++) {
+                        for (int x = px * (PatchSize - 1) ; x <= (px + 1) * (PatchSize - 1) ; x++) {
+                            mm.Min = std::min(mm.Min, Tile[z * TileSize + x]);
+                            mm.Max = std::max(mm.Max, Tile[z * TileSize + x]);
+                        }
+                    }
+
+                    int PatchX = TileX * PatchesPerTile + px;
+                    int PatchZ = TileZ * PatchesPerTile + pz;
+                    Pyramid[PatchZ * Levels[0].Width + PatchX] = mm;
+                }
+            }
+
+            uint CompressedSize = CompressTile(Compression, Quantized, TileSize, Compressed);
+
+            // Compressed tiles can have any size - keep the next tile aligned
+            static const char Padding[TILED_HEIGHTMAP_TILE_ALIGNMENT] = {};
+            uint PaddingSize = (uint)((TILED_HEIGHTMAP_TILE_ALIGNMENT - Offset % TILED_HEIGHTMAP_TILE_ALIGNMENT) % TILED_HEIGHTMAP_TILE_ALIGNMENT);
+            fwrite(Padding, 1, PaddingSize, f);
+            Offset += PaddingSize;
+
+            Entry.Offset = Offset;
+
+            if (CompressedSize > 0) {
+                Entry.Compression = Compression;
+                Entry.Size = CompressedSize;
+                fwrite(Compressed.data(), 1, CompressedSize, f);
+            } else {
+                Entry.Compression = TILE_COMPRESSION_NONE;
+                Entry.Size = (uint)(Quantized.size() * sizeof(unsigned short));
+                fwrite(Quantized.data(), 1, Entry.Size, f);
+            }
+
+            Offset += Entry.Size;
+            TotalSize += Entry.Size;
+        }
+    }
+
+    // Build the coarser levels of the pyramid
+    for (size_t l = 1 ; l < Levels.size() ; l++) {
+        const PyramidLevel& Src = Levels[l - 1];
+        const PyramidLevel& Dst = Levels[l];
+
+        for (int z = 0 ; z < Dst.Depth ; z++) {
+            for (int x = 0 ; x < Dst.Width ; x++) {
+                MinMaxHeight mm;
+                mm.Min = FLT_MAX;
+                mm.Max = -FLT_MAX;
+
+                for (int sz = 2 * z ; sz < std::min(2 * z + 2, Src.Depth) ; sz++) {
+                    for (int sx = 2 * x ; sx < std::min(2 * x + 2, Src.Width) ; sx++) {
+                        const MinMaxHeight& s = Pyramid[Src.Offset + sz * Src.Width + sx];
+                        mm.Min = std::min(mm.Min, s.Min);
+                        mm.Max = std::max(mm.Max, s.Max);
+                    }
+                }
+
+                Pyramid[Dst.Offset + z * Dst.Width + x] = mm;
+            }
+        }
+    }
+
+    bool ok = (ferror(f) == 0);
+
+    fseek(f, 0, SEEK_SET);
+    fwrite(&Header, sizeof(Header), 1, f);
+    fwrite(TileDir.data(), sizeof(TiledHeightMapTileEntry), TileDir.size(), f);
+    fwrite(Pyramid.data(), sizeof(MinMaxHeight), Pyramid.size(), f);
+
+    ok = ok && (ferror(f) == 0);
+
+    fclose(f);
+
+    if (!ok) {
+        printf("%s:%d - error writing '%s'\n", __FILE__, __LINE__, pFilename);
+        return false;
+    }
+
+    size_t RawSize = TileDir.size() * Tile.size() * sizeof(float);
+    printf("Wrote '%s': %zu KB of tile data (%.1f%% of the float heights)\n", pFilename, TotalSize / 1024, 100.0 * (double)TotalSize / (double)RawSize);
+
+    return true;
+}
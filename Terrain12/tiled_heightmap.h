@@ -0,0 +1,176 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef TILED_HEIGHTMAP_H
+#define TILED_HEIGHTMAP_H
+
+#include <vector>
+
+#include "ogldev_types.h"
+
+#define TILED_HEIGHTMAP_MAGIC   0x4854474F  // 'OGTH'
+#define TILED_HEIGHTMAP_VERSION 2
+#define TILED_HEIGHTMAP_TILE_ALIGNMENT 8
+#define TILED_HEIGHTMAP_MAX_TILE_SEGMENTS 16384    // keeps TileSize * TileSize * sizeof(float) in an int
+
+// LZ4 and zstd are optional - build with OGLDEV_LZ4 / OGLDEV_ZSTD and link with the library
+enum TILE_COMPRESSION {
+    TILE_COMPRESSION_NONE = 0,
+    TILE_COMPRESSION_LZ4  = 1,
+    TILE_COMPRESSION_ZSTD = 2
+};
+
+//
+// File layout:
+//
+//    TiledHeightMapHeader
+//    TiledHeightMapTileEntry   x NumTilesX * NumTilesZ
+//    MinMaxHeight              x size of the pyramid (all the levels, finest first)
+//    tile data                 TileSize * TileSize 16-bit heights per tile, optionally compressed
+//                              (compressed tiles are delta coded along the rows). Every tile starts
+//                              at a multiple of TILED_HEIGHTMAP_TILE_ALIGNMENT so uncompressed tiles
+//                              can be read in place from the mapped file.
+//
+// Every tile contains TileSize x TileSize heights and neighbouring tiles share
+// their border row/column so a tile can be turned into a vertex buffer without
+// touching its neighbours. The heights of a tile are quantized to 16 bits using
+// the scale/bias of the tile. The file is memory mapped and only the tiles which
+// are actually read are paged in by the OS.
+//
+struct TiledHeightMapHeader {
+    uint Magic = TILED_HEIGHTMAP_MAGIC;
+    uint Version = TILED_HEIGHTMAP_VERSION;
+    int TileSize = 0;           // in vertices, (TileSize - 1) must be a power of two
+    int NumTilesX = 0;
+    int NumTilesZ = 0;
+    int PatchSize = 0;          // geomip patch size in vertices, (TileSize - 1) is a multiple of (PatchSize - 1)
+    float MinHeight = 0.0f;
+    float MaxHeight = 0.0f;
+    uint Compression = TILE_COMPRESSION_NONE;
+    int NumPyramidLevels = 0;
+    unsigned long long TileDirOffset = 0;
+    unsigned long long PyramidOffset = 0;
+};
+
+
+struct TiledHeightMapTileEntry {
+    unsigned long long Offset = 0;
+    uint Size = 0;              // in bytes, after compression
+    uint Compression = TILE_COMPRESSION_NONE;   // tiles which don't compress well are stored as is
+    float Scale = 0.0f;         // height = Bias + Scale * quantized height
+    float Bias = 0.0f;
+    float MinHeight = 0.0f;
+    float MaxHeight = 0.0f;
+};
+
+
+struct MinMaxHeight {
+    float Min = 0.0f;
+    float Max = 0.0f;
+};
+
+
+class TiledHeightMap {
+ public:
+    TiledHeightMap() {}
+
+    ~TiledHeightMap();
+
+    bool Open(const char* pFilename);
+
+    void Close();
+
+    int GetTileSize() const { return m_header.TileSize; }
+
+    int GetNumTilesX() const { return m_header.NumTilesX; }
+
+    int GetNumTilesZ() const { return m_header.NumTilesZ; }
+
+    int GetPatchSize() const { return m_header.PatchSize; }
+
+    // Size of the entire height map in vertices
+    int GetWidth() const { return m_header.NumTilesX * (m_header.TileSize - 1) + 1; }
+
+    int GetDepth() const { return m_header.NumTilesZ * (m_header.TileSize - 1) + 1; }
+
+    float GetMinHeight() const { return m_header.MinHeight; }
+
+    float GetMaxHeight() const { return m_header.MaxHeight; }
+
+    const TiledHeightMapTileEntry& GetTileEntry(int TileX, int TileZ) const;
+
+    // Decodes TileSize * TileSize heights into pHeights. Thread safe.
+    void ReadTile(int TileX, int TileZ, float* pHeights) const;
+
+    // x/z are in height map coordinates and are clamped to the edges. Thread safe.
+    // Compressed tiles are decoded into a small per-thread cache.
+    float GetHeight(int x, int z) const;
+
+    float GetHeightInterpolated(float x, float z) const;
+
+    // Size of a decoded tile
+    int GetTileSizeInBytes() const { return m_header.TileSize * m_header.TileSize * sizeof(float); }
+
+    // Level 0 has one entry per geomip patch, every level above it halves the
+    // number of patches in each dimension down to a single entry.
+    int GetNumPyramidLevels() const { return m_header.NumPyramidLevels; }
+
+    int GetPyramidWidth(int Level) const { return m_pyramidLevels[Level].Width; }
+
+    int GetPyramidDepth(int Level) const { return m_pyramidLevels[Level].Depth; }
+
+    const MinMaxHeight& GetPyramidMinMax(int Level, int x, int z) const;
+
+    typedef float (*HeightFunc)(int x, int z, void* pUserData);
+
+    // Writes the file one tile at a time so the entire height map never needs to be in memory
+    static bool Create(const char* pFilename, int TileSize, int NumTilesX, int NumTilesZ, int PatchSize,
+                       TILE_COMPRESSION Compression, HeightFunc pHeightFunc, void* pUserData);
+
+ private:
+
+    struct PyramidLevel {
+        int Width = 0;
+        int Depth = 0;
+        int Offset = 0;     // in entries from the start of the pyramid
+    };
+
+    static void CalcPyramidLevels(int NumPatchesX, int NumPatchesZ, std::vector<PyramidLevel>& Levels);
+
+    const unsigned short* DecodeTileCached(int TileX, int TileZ) const;
+
+    void DecodeTile(int TileX, int TileZ, unsigned short* pQuantized) const;
+
+    TiledHeightMapHeader m_header;
+    const TiledHeightMapTileEntry* m_pTileDir = NULL;
+    const MinMaxHeight* m_pPyramid = NULL;
+    std::vector<PyramidLevel> m_pyramidLevels;
+    uint m_id = 0;      // identifies the map in the per-thread decode cache
+    const unsigned char* m_pData = NULL;
+    size_t m_fileSize = 0;
+
+#ifdef _WIN64
+    void* m_hFile = NULL;
+    void* m_hMapping = NULL;
+#else
+    int m_fd = -1;
+#endif
+};
+
+#endif
@@ -0,0 +1,433 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+
+#include "tiled_terrain.h"
+#include "texture_config.h"
+
+
+TiledTerrain::~TiledTerrain()
+{
+    Destroy();
+}
+
+
+void TiledTerrain::Destroy()
+{
+    m_pager.Stop();
+
+    for (size_t i = 0 ; i < m_gpuTiles.size() ; i++) {
+        glDeleteVertexArrays(1, &m_gpuTiles[i].VAO);
+        glDeleteBuffers(1, &m_gpuTiles[i].VB);
+    }
+
+    m_gpuTiles.clear();
+
+    if (m_ib > 0) {
+        glDeleteBuffers(1, &m_ib);
+        m_ib = 0;
+    }
+
+    for (int i = 0 ; i < (int)ARRAY_SIZE_IN_ELEMENTS(m_pTextures) ; i++) {
+        SAFE_DELETE(m_pTextures[i]);
+    }
+
+    SAFE_DELETE(m_pSkydome);
+
+    m_heightMap.Close();
+}
+
+
+void TiledTerrain::InitTerrain(const char* pFilename, float WorldScale, float TextureScale, const std::vector<string>& TextureFilenames,
+                               int MaxResidentTiles, float ViewDistance)
+{
+    if (!m_terrainTech.Init()) {
+        printf("Error initializing tech\n");
+        exit(0);
+    }
+
+    if (TextureFilenames.size() != ARRAY_SIZE_IN_ELEMENTS(m_pTextures)) {
+        printf("%s:%d - number of provided textures (%lud) is not equal to the size of the texture array (%lud)\n",
+               __FILE__, __LINE__, TextureFilenames.size(), ARRAY_SIZE_IN_ELEMENTS(m_pTextures));
+        exit(0);
+    }
+
+    if (!m_heightMap.Open(pFilename)) {
+        exit(0);
+    }
+
+    m_worldScale = WorldScale;
+    m_viewDistance = ViewDistance;
+    m_tileWorldSize = (m_heightMap.GetTileSize() - 1) * WorldScale;
+
+    for (int i = 0 ; i < (int)ARRAY_SIZE_IN_ELEMENTS(m_pTextures) ; i++) {
+        m_pTextures[i] = new Texture(GL_TEXTURE_2D);
+        m_pTextures[i]->Load(TextureFilenames[i]);
+    }
+
+    m_terrainTech.Enable();
+    m_terrainTech.SetMinMaxHeight(m_heightMap.GetMinHeight(), m_heightMap.GetMaxHeight());
+
+    m_tileToSlot.assign(m_heightMap.GetNumTilesX() * m_heightMap.GetNumTilesZ(), -1);
+
+    // The skirts only need to cover the height difference between two LODs
+    float SkirtDepth = (m_heightMap.GetMaxHeight() - m_heightMap.GetMinHeight()) * 0.05f + WorldScale;
+    m_pager.Start(&m_heightMap, WorldScale, TextureScale, SkirtDepth);
+
+    CreateGLState(MaxResidentTiles);
+
+    m_pSkydome = new Skydome(8, 32, 1.0f, "../Content/textures/kloofendal_48d_partly_cloudy_puresky_4k.jpg", COLOR_TEXTURE_UNIT_0, COLOR_TEXTURE_UNIT_INDEX_0);
+}
+
+
+void TiledTerrain::CreateGLState(int MaxResidentTiles)
+{
+    glGenBuffers(1, &m_ib);
+
+    InitIndices();
+
+    m_gpuTiles.resize(MaxResidentTiles);
+
+    size_t VertexBufferSize = sizeof(TerrainVertex) * m_pager.GetNumVerticesPerTile();
+
+    int POS_LOC = 0;
+    int TEX_LOC = 1;
+    int NORMAL_LOC = 2;
+
+    for (int i = 0 ; i < MaxResidentTiles ; i++) {
+        GPUTile& Tile = m_gpuTiles[i];
+
+        glGenVertexArrays(1, &Tile.VAO);
+        glBindVertexArray(Tile.VAO);
+
+        glGenBuffers(1, &Tile.VB);
+        glBindBuffer(GL_ARRAY_BUFFER, Tile.VB);
+        glBufferData(GL_ARRAY_BUFFER, VertexBufferSize, NULL, GL_DYNAMIC_DRAW);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ib);
+
+        glEnableVertexAttribArray(POS_LOC);
+        glVertexAttribPointer(POS_LOC, 3, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex), (const void*)offsetof(TerrainVertex, Pos));
+
+        glEnableVertexAttribArray(TEX_LOC);
+        glVertexAttribPointer(TEX_LOC, 2, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex), (const void*)offsetof(TerrainVertex, Tex));
+
+        glEnableVertexAttribArray(NORMAL_LOC);
+        glVertexAttribPointer(NORMAL_LOC, 3, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex), (const void*)offsetof(TerrainVertex, Normal));
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    printf("Tiled terrain: %d resident tiles, %zu KB of vertices each\n", MaxResidentTiles, VertexBufferSize / 1024);
+}
+
+
+void TiledTerrain::InitIndices()
+{
+    int TileSize = m_heightMap.GetTileSize();
+    int NumSegments = TileSize - 1;
+    int SkirtBase = TileSize * TileSize;
+
+    std::vector<uint> Indices;
+
+    m_lods.clear();
+
+    // The coarsest LOD still has 2x2 quads
+    for (int Step = 1 ; Step <= NumSegments / 2 ; Step *= 2) {
+        LodIndices Lod;
+        Lod.Start = (int)Indices.size();
+
+        for (int z = 0 ; z < NumSegments ; z += Step) {
+            for (int x = 0 ; x < NumSegments ; x += Step) {
+                uint v00 = z * TileSize + x;
+                uint v10 = v00 + Step;
+                uint v01 = v00 + Step * TileSize;
+                uint v11 = v01 + Step;
+
+                Indices.push_back(v00);
+                Indices.push_back(v01);
+                Indices.push_back(v11);
+
+                Indices.push_back(v00);
+                Indices.push_back(v11);
+                Indices.push_back(v10);
+            }
+        }
+
+        AddSkirt(Indices, Step, 0,                         SkirtBase,                1,        false);  // bottom
+        AddSkirt(Indices, Step, NumSegments * TileSize,    SkirtBase + TileSize,     1,        true);   // top
+        AddSkirt(Indices, Step, 0,                         SkirtBase + 2 * TileSize, TileSize, true);   // left
+        AddSkirt(Indices, Step, NumSegments,               SkirtBase + 3 * TileSize, TileSize, false);  // right
+
+        Lod.Count = (int)Indices.size() - Lod.Start;
+        m_lods.push_back(Lod);
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ib);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Indices[0]) * Indices.size(), Indices.data(), GL_STATIC_DRAW);
+}
+
+
+void TiledTerrain::AddSkirt(std::vector<uint>& Indices, int Step, int FirstEdge, int FirstSkirt, int Stride, bool Flip)
+{
+    int NumSegments = m_heightMap.GetTileSize() - 1;
+
+    // Flip makes the skirt face away from the tile
+    for (int i = 0 ; i < NumSegments ; i += Step) {
+        uint e0 = FirstEdge + i * Stride;
+        uint e1 = FirstEdge + (i + Step) * Stride;
+        uint s0 = FirstSkirt + i;
+        uint s1 = FirstSkirt + i + Step;
+
+        Indices.push_back(e0);
+        Indices.push_back(Flip ? s0 : e1);
+        Indices.push_back(Flip ? e1 : s0);
+
+        Indices.push_back(s0);
+        Indices.push_back(Flip ? s1 : e1);
+        Indices.push_back(Flip ? e1 : s1);
+    }
+}
+
+
+void TiledTerrain::Update(const Vector3f& CameraPos)
+{
+    m_frame++;
+
+    int NumTilesX = m_heightMap.GetNumTilesX();
+    int NumTilesZ = m_heightMap.GetNumTilesZ();
+
+    int CameraTileX = (int)floorf(CameraPos.x / m_tileWorldSize);
+    int CameraTileZ = (int)floorf(CameraPos.z / m_tileWorldSize);
+    int Radius = (int)ceilf(m_viewDistance / m_tileWorldSize);
+
+    int MinTileX = std::max(0, CameraTileX - Radius);
+    int MaxTileX = std::min(NumTilesX - 1, CameraTileX + Radius);
+    int MinTileZ = std::max(0, CameraTileZ - Radius);
+    int MaxTileZ = std::min(NumTilesZ - 1, CameraTileZ + Radius);
+
+    std::vector<TileRequest>& Requests = m_sortedRequests;
+    Requests.clear();
+
+    float MaxDistance = m_viewDistance + m_tileWorldSize * 0.7072f;  // plus half the diagonal of a tile
+
+    for (int TileZ = MinTileZ ; TileZ <= MaxTileZ ; TileZ++) {
+        for (int TileX = MinTileX ; TileX <= MaxTileX ; TileX++) {
+            float CenterX = ((float)TileX + 0.5f) * m_tileWorldSize;
+            float CenterZ = ((float)TileZ + 0.5f) * m_tileWorldSize;
+            float Distance = sqrtf((CenterX - CameraPos.x) * (CenterX - CameraPos.x) + (CenterZ - CameraPos.z) * (CenterZ - CameraPos.z));
+
+            if (Distance > MaxDistance) {
+                continue;
+            }
+
+            int Slot = m_tileToSlot[TileZ * NumTilesX + TileX];
+
+            if (Slot >= 0) {
+                m_gpuTiles[Slot].LastUsedFrame = m_frame;
+            } else {
+                TileRequest r;
+                r.Distance = Distance;
+                r.Coord = TerrainTileCoord(TileX, TileZ);
+                Requests.push_back(r);
+            }
+        }
+    }
+
+    // Closest tiles first
+    std::sort(Requests.begin(), Requests.end(), [](const TileRequest& a, const TileRequest& b) { return a.Distance < b.Distance; });
+
+    m_requests.clear();
+
+    for (size_t i = 0 ; i < Requests.size() ; i++) {
+        m_requests.push_back(Requests[i].Coord);
+    }
+
+    m_pager.SetRequests(m_requests);
+
+    UploadCompletedTiles();
+
+    m_stats.NumResidentTiles = 0;
+
+    for (size_t i = 0 ; i < m_gpuTiles.size() ; i++) {
+        if (m_gpuTiles[i].TileIndex >= 0) {
+            m_stats.NumResidentTiles++;
+        }
+    }
+
+    m_stats.NumPendingTiles = m_pager.GetNumPending();
+    m_stats.NumTilesLoaded = m_pager.GetNumTilesLoaded();
+}
+
+
+void TiledTerrain::UploadCompletedTiles()
+{
+    m_stats.NumUploadsThisFrame = 0;
+
+    while ((m_stats.NumUploadsThisFrame < m_maxUploadsPerFrame) && m_pager.GetCompletedTile(m_uploadTile)) {
+        int TileIndex = m_uploadTile.Coord.TileZ * m_heightMap.GetNumTilesX() + m_uploadTile.Coord.TileX;
+
+        if (m_tileToSlot[TileIndex] >= 0) {
+            continue;
+        }
+
+        int Slot = FindSlotForNewTile();
+
+        if (Slot < 0) {
+            // Every slot is needed by the current view - the pool is too small for the view distance
+            m_stats.NumTilesDropped++;
+            continue;
+        }
+
+        GPUTile& Tile = m_gpuTiles[Slot];
+
+        if (Tile.TileIndex >= 0) {
+            m_tileToSlot[Tile.TileIndex] = -1;
+        }
+
+        Tile.Coord = m_uploadTile.Coord;
+        Tile.TileIndex = TileIndex;
+        Tile.MinHeight = m_uploadTile.MinHeight;
+        Tile.MaxHeight = m_uploadTile.MaxHeight;
+        Tile.LastUsedFrame = m_frame;
+        m_tileToSlot[TileIndex] = Slot;
+
+        glBindBuffer(GL_ARRAY_BUFFER, Tile.VB);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(TerrainVertex) * m_uploadTile.Vertices.size(), m_uploadTile.Vertices.data());
+
+        m_stats.NumUploadsThisFrame++;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+int TiledTerrain::FindSlotForNewTile()
+{
+    int LRUSlot = -1;
+    long long LRUFrame = m_frame;
+
+    for (int i = 0 ; i < (int)m_gpuTiles.size() ; i++) {
+        if (m_gpuTiles[i].TileIndex < 0) {
+            return i;
+        }
+
+        if (m_gpuTiles[i].LastUsedFrame < LRUFrame) {
+            LRUFrame = m_gpuTiles[i].LastUsedFrame;
+            LRUSlot = i;
+        }
+    }
+
+    return LRUSlot;
+}
+
+
+int TiledTerrain::CalcLod(const GPUTile& Tile, const Vector3f& CameraPos) const
+{
+    float CenterX = ((float)Tile.Coord.TileX + 0.5f) * m_tileWorldSize;
+    float CenterZ = ((float)Tile.Coord.TileZ + 0.5f) * m_tileWorldSize;
+    float Distance = sqrtf((CenterX - CameraPos.x) * (CenterX - CameraPos.x) + (CenterZ - CameraPos.z) * (CenterZ - CameraPos.z));
+
+    // Every doubling of the distance (in tiles) drops one LOD
+    int Lod = (int)log2f(std::max(1.0f, Distance / m_tileWorldSize));
+
+    return std::min(Lod, (int)m_lods.size() - 1);
+}
+
+
+bool TiledTerrain::IsTileVisible(const GPUTile& Tile, const FrustumCulling& FC) const
+{
+    float x0 = (float)Tile.Coord.TileX * m_tileWorldSize;
+    float z0 = (float)Tile.Coord.TileZ * m_tileWorldSize;
+
+    Vector3f Min(x0, Tile.MinHeight, z0);
+    Vector3f Max(x0 + m_tileWorldSize, Tile.MaxHeight, z0 + m_tileWorldSize);
+
+    return FC.IsBoxInsideViewFrustum(Min, Max);
+}
+
+
+void TiledTerrain::Render(const BasicCamera& Camera)
+{
+    Matrix4f VP = Camera.GetViewProjMatrix();
+
+    m_terrainTech.Enable();
+    m_terrainTech.SetVP(VP);
+    m_terrainTech.SetLightDir(m_lightDir);
+
+    for (int i = 0 ; i < (int)ARRAY_SIZE_IN_ELEMENTS(m_pTextures) ; i++) {
+        if (m_pTextures[i]) {
+            m_pTextures[i]->Bind(COLOR_TEXTURE_UNIT_0 + i);
+        }
+    }
+
+    FrustumCulling fc(VP);
+
+    m_stats.NumVisibleTiles = 0;
+
+    for (size_t i = 0 ; i < m_gpuTiles.size() ; i++) {
+        const GPUTile& Tile = m_gpuTiles[i];
+
+        // Only the tiles inside the view distance are used by the current frame
+        if ((Tile.TileIndex < 0) || (Tile.LastUsedFrame != m_frame)) {
+            continue;
+        }
+
+        if (!IsTileVisible(Tile, fc)) {
+            continue;
+        }
+
+        const LodIndices& Lod = m_lods[CalcLod(Tile, Camera.GetPos())];
+
+        glBindVertexArray(Tile.VAO);
+        glDrawElements(GL_TRIANGLES, Lod.Count, GL_UNSIGNED_INT, (void*)(sizeof(uint) * Lod.Start));
+
+        m_stats.NumVisibleTiles++;
+    }
+
+    glBindVertexArray(0);
+
+    m_pSkydome->Render(Camera);
+}
+
+
+void TiledTerrain::SetTextureHeights(float Tex0Height, float Tex1Height, float Tex2Height, float Tex3Height)
+{
+    m_terrainTech.Enable();
+    m_terrainTech.SetTextureHeights(Tex0Height, Tex1Height, Tex2Height, Tex3Height);
+}
+
+
+Vector3f TiledTerrain::ConstrainCameraPosToTerrain(const Vector3f& CameraPos)
+{
+    Vector3f NewCameraPos = CameraPos;
+
+    NewCameraPos.x = std::max(0.0f, std::min(CameraPos.x, GetWorldSizeX() - 0.5f));
+    NewCameraPos.z = std::max(0.0f, std::min(CameraPos.z, GetWorldSizeZ() - 0.5f));
+
+    NewCameraPos.y = m_heightMap.GetHeightInterpolated(NewCameraPos.x / m_worldScale, NewCameraPos.z / m_worldScale) + m_cameraHeight;
+
+    return NewCameraPos;
+}
@@ -0,0 +1,145 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef TILED_TERRAIN_H
+#define TILED_TERRAIN_H
+
+#include <GL/glew.h>
+#include <vector>
+
+#include "ogldev_types.h"
+#include "ogldev_basic_glfw_camera.h"
+#include "ogldev_texture.h"
+#include "ogldev_skydome.h"
+
+#include "terrain_technique.h"
+#include "tiled_heightmap.h"
+#include "terrain_pager.h"
+
+struct TiledTerrainStats {
+    int NumResidentTiles = 0;
+    int NumVisibleTiles = 0;
+    int NumUploadsThisFrame = 0;
+    int NumPendingTiles = 0;
+    long long NumTilesLoaded = 0;
+    long long NumTilesDropped = 0;
+};
+
+//
+// Terrain mode for worlds which don't fit in memory. The height map is a
+// TiledHeightMap on disk. The tiles around the camera are built by a
+// TerrainPager on a background thread and uploaded into a fixed pool of
+// vertex buffers which is recycled in LRU order. All the tiles share the
+// index buffers of the LOD levels.
+//
+class TiledTerrain
+{
+ public:
+    TiledTerrain() {}
+
+    ~TiledTerrain();
+
+    void Destroy();
+
+    // MaxResidentTiles is the size of the vertex buffer pool. ViewDistance is in world units.
+    void InitTerrain(const char* pFilename, float WorldScale, float TextureScale, const std::vector<string>& TextureFilenames,
+                     int MaxResidentTiles, float ViewDistance);
+
+    // Requests the tiles around the camera and uploads the tiles that are ready
+    void Update(const Vector3f& CameraPos);
+
+    void Render(const BasicCamera& Camera);
+
+    void SetTextureHeights(float Tex0Height, float Tex1Height, float Tex2Height, float Tex3Height);
+
+    void SetLightDir(const Vector3f& Dir) { m_lightDir = Dir; }
+
+    // Limits the number of glBufferSubData calls per frame to avoid hitches
+    void SetMaxUploadsPerFrame(int MaxUploads) { m_maxUploadsPerFrame = MaxUploads; }
+
+    float GetWorldSizeX() const { return (m_heightMap.GetWidth() - 1) * m_worldScale; }
+
+    float GetWorldSizeZ() const { return (m_heightMap.GetDepth() - 1) * m_worldScale; }
+
+    float GetMaxHeight() const { return m_heightMap.GetMaxHeight(); }
+
+    Vector3f ConstrainCameraPosToTerrain(const Vector3f& CameraPos);
+
+    const TiledTerrainStats& GetStats() const { return m_stats; }
+
+ private:
+
+    struct GPUTile {
+        GLuint VAO = 0;
+        GLuint VB = 0;
+        TerrainTileCoord Coord;
+        int TileIndex = -1;         // -1 when the slot is free
+        float MinHeight = 0.0f;
+        float MaxHeight = 0.0f;
+        long long LastUsedFrame = -1;
+    };
+
+    struct TileRequest {
+        float Distance = 0.0f;
+        TerrainTileCoord Coord;
+    };
+
+    struct LodIndices {
+        int Start = 0;
+        int Count = 0;
+    };
+
+    void CreateGLState(int MaxResidentTiles);
+
+    void InitIndices();
+
+    void AddSkirt(std::vector<uint>& Indices, int Step, int FirstEdge, int FirstSkirt, int Stride, bool Flip);
+
+    void UploadCompletedTiles();
+
+    int FindSlotForNewTile();
+
+    int CalcLod(const GPUTile& Tile, const Vector3f& CameraPos) const;
+
+    bool IsTileVisible(const GPUTile& Tile, const FrustumCulling& FC) const;
+
+    TiledHeightMap m_heightMap;
+    TerrainPager m_pager;
+    std::vector<GPUTile> m_gpuTiles;
+    std::vector<int> m_tileToSlot;      // NumTilesX * NumTilesZ, -1 if the tile is not resident
+    std::vector<TileRequest> m_sortedRequests;
+    std::vector<TerrainTileCoord> m_requests;
+    TerrainTileData m_uploadTile;
+    GLuint m_ib = 0;
+    std::vector<LodIndices> m_lods;
+    long long m_frame = 0;
+    int m_maxUploadsPerFrame = 2;
+    float m_viewDistance = 0.0f;
+    float m_worldScale = 1.0f;
+    float m_tileWorldSize = 0.0f;
+    TiledTerrainStats m_stats;
+
+    TerrainTechnique m_terrainTech;
+    Texture* m_pTextures[4] = { 0 };
+    Vector3f m_lightDir;
+    float m_cameraHeight = 2.0f;
+    Skydome* m_pSkydome = NULL;
+};
+
+#endif
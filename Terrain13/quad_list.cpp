@@ -23,6 +23,7 @@
 #include "ogldev_math_3d.h"
 #include "quad_list.h"
 #include "terrain.h"
+#include "texture_config.h"
 
 
 QuadList::QuadList()
@@ -49,18 +50,38 @@ void QuadList::Destroy()
     if (m_ib > 0) {
         glDeleteBuffers(1, &m_ib);
     }
+
+    if (m_patchBoundsTexture > 0) {
+        glDeleteTextures(1, &m_patchBoundsTexture);
+    }
+
+    m_vao = 0;
+    m_vb = 0;
+    m_ib = 0;
+    m_patchBoundsTexture = 0;
+    m_patchBounds.clear();
 }
 
 
-void QuadList::CreateQuadList(int Width, int Depth, const BaseTerrain* pTerrain)
+void QuadList::CreateQuadList(int Width, int Depth, const BaseTerrain* pTerrain, int PatchSize)
 {
+    if (PatchSize < 1) {
+        printf("%s:%d - invalid patch size %d\n", __FILE__, __LINE__, PatchSize);
+        exit(0);
+    }
+
 	m_width = Width;
     m_depth = Depth;
+    m_patchSize = PatchSize;
+    m_numPatchesX = (m_width - 1 + m_patchSize - 1) / m_patchSize;
+    m_numPatchesZ = (m_depth - 1 + m_patchSize - 1) / m_patchSize;
 
     CreateGLState();
 
 	PopulateBuffers(pTerrain);
 
+    InitPatchBounds(pTerrain);
+
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
@@ -98,12 +119,12 @@ void QuadList::CreateGLState()
 void QuadList::PopulateBuffers(const BaseTerrain* pTerrain)
 {
     std::vector<Vertex> Vertices;
-    Vertices.resize(m_width * m_depth);
+    Vertices.resize((m_numPatchesX + 1) * (m_numPatchesZ + 1));
 
     InitVertices(pTerrain, Vertices);
 
 	std::vector<unsigned int> Indices;
-    int NumQuads = (m_width - 1) * (m_depth - 1);
+    int NumQuads = m_numPatchesX * m_numPatchesZ;
     Indices.resize(NumQuads * 4);
     InitIndices(Indices);
 
@@ -129,10 +150,10 @@ void QuadList::InitVertices(const BaseTerrain* pTerrain, std::vector<Vertex>& Ve
 {
     int Index = 0;
 
-    for (int z = 0 ; z < m_depth ; z++) {
-        for (int x = 0 ; x < m_width ; x++) {
+    for (int z = 0 ; z <= m_numPatchesZ ; z++) {
+        for (int x = 0 ; x <= m_numPatchesX ; x++) {
             assert(Index < Vertices.size());
-			Vertices[Index].InitVertex(pTerrain, m_width, m_depth, x, z);
+			Vertices[Index].InitVertex(pTerrain, m_width, m_depth, GridX(x), GridZ(z));
 			Index++;
         }
     }
@@ -144,24 +165,26 @@ void QuadList::InitVertices(const BaseTerrain* pTerrain, std::vector<Vertex>& Ve
 void QuadList::InitIndices(std::vector<unsigned int>& Indices)
 {
     int Index = 0;
+    int NumVerticesX = m_numPatchesX + 1;
 
-    for (int z = 0 ; z < m_depth - 1 ; z++) {
-        for (int x = 0 ; x < m_width - 1 ; x++) {												
+    // The order of the patches must match the bounds texture which is indexed by gl_PrimitiveID
+    for (int z = 0 ; z < m_numPatchesZ ; z++) {
+        for (int x = 0 ; x < m_numPatchesX ; x++) {
             // Add a single quad
             assert(Index < Indices.size());
-            unsigned int IndexBottomLeft = z * m_width + x;
+            unsigned int IndexBottomLeft = z * NumVerticesX + x;
             Indices[Index++] = IndexBottomLeft;
 
             assert(Index < Indices.size());
-            unsigned int IndexBottomRight = z * m_width + x + 1;
+            unsigned int IndexBottomRight = z * NumVerticesX + x + 1;
             Indices[Index++] = IndexBottomRight;
 
             assert(Index < Indices.size());
-            unsigned int IndexTopLeft = (z + 1) * m_width + x;
+            unsigned int IndexTopLeft = (z + 1) * NumVerticesX + x;
             Indices[Index++] = IndexTopLeft;
 
             assert(Index < Indices.size());
-            unsigned int IndexTopRight = (z + 1) * m_width + x + 1;
+            unsigned int IndexTopRight = (z + 1) * NumVerticesX + x + 1;
             Indices[Index++] = IndexTopRight;
         }
     }
@@ -170,12 +193,92 @@ void QuadList::InitIndices(std::vector<unsigned int>& Indices)
 }
 
 
+void QuadList::InitPatchBounds(const BaseTerrain* pTerrain)
+{
+    float WorldScale = pTerrain->GetWorldScale();
+    float TextureScale = pTerrain->GetTextureScale();
+    int TerrainSize = pTerrain->GetSize();
+
+    m_patchBounds.resize(m_numPatchesX * m_numPatchesZ);
+
+    std::vector<Vector2f> MinMax(m_patchBounds.size());
+
+    for (int z = 0 ; z < m_numPatchesZ ; z++) {
+        for (int x = 0 ; x < m_numPatchesX ; x++) {
+            int x0 = GridX(x);
+            int x1 = GridX(x + 1);
+            int z0 = GridZ(z);
+            int z1 = GridZ(z + 1);
+
+            // The texels of the height map which can be sampled by the TES inside this patch.
+            // One texel is added on each side for the bilinear filter.
+            float TexelScale = TextureScale * (float)TerrainSize;
+            int StartX = (int)floorf(TexelScale * (float)x0 / (float)m_width) - 1;
+            int EndX   = (int)ceilf(TexelScale * (float)x1 / (float)m_width) + 1;
+            int StartZ = (int)floorf(TexelScale * (float)z0 / (float)m_depth) - 1;
+            int EndZ   = (int)ceilf(TexelScale * (float)z1 / (float)m_depth) + 1;
+
+            float MinHeight = pTerrain->GetMinHeight();
+            float MaxHeight = pTerrain->GetMaxHeight();
+
+            // When the height map repeats across the grid we fall back to the height range of the entire terrain
+            if (EndX - StartX < TerrainSize && EndZ - StartZ < TerrainSize) {
+                StartX = std::max(StartX, 0);
+                StartZ = std::max(StartZ, 0);
+                EndX = std::min(EndX, TerrainSize - 1);
+                EndZ = std::min(EndZ, TerrainSize - 1);
+
+                MinHeight = pTerrain->GetHeight(StartX, StartZ);
+                MaxHeight = MinHeight;
+
+                for (int hz = StartZ ; hz <= EndZ ; hz++) {
+                    for (int hx = StartX ; hx <= EndX ; hx++) {
+                        float h = pTerrain->GetHeight(hx, hz);
+                        MinHeight = std::min(MinHeight, h);
+                        MaxHeight = std::max(MaxHeight, h);
+                    }
+                }
+            }
+
+            int Index = z * m_numPatchesX + x;
+            m_patchBounds[Index].Min = Vector3f(x0 * WorldScale, MinHeight, z0 * WorldScale);
+            m_patchBounds[Index].Max = Vector3f(x1 * WorldScale, MaxHeight, z1 * WorldScale);
+            MinMax[Index] = Vector2f(MinHeight, MaxHeight);
+        }
+    }
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &m_patchBoundsTexture);
+    glTextureStorage2D(m_patchBoundsTexture, 1, GL_RG32F, m_numPatchesX, m_numPatchesZ);
+    glTextureSubImage2D(m_patchBoundsTexture, 0, 0, 0, m_numPatchesX, m_numPatchesZ, GL_RG, GL_FLOAT, &MinMax[0]);
+    glTextureParameteri(m_patchBoundsTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(m_patchBoundsTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTextureParameteri(m_patchBoundsTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(m_patchBoundsTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+
+int QuadList::CalcNumVisiblePatches(const FrustumCulling& FC) const
+{
+    int NumVisible = 0;
+
+    for (int i = 0 ; i < (int)m_patchBounds.size() ; i++) {
+        if (FC.TestBox(m_patchBounds[i].Min, m_patchBounds[i].Max) != FRUSTUM_OUTSIDE) {
+            NumVisible++;
+        }
+    }
+
+    return NumVisible;
+}
+
+
 void QuadList::Render()
 {
     glBindVertexArray(m_vao);
 
+    glBindTextureUnit(PATCH_BOUNDS_TEXTURE_UNIT_INDEX, m_patchBoundsTexture);
+
     glPatchParameteri(GL_PATCH_VERTICES, 4);
-    glDrawElements(GL_PATCHES, (m_depth - 1) * (m_width - 1) * 4, GL_UNSIGNED_INT, NULL);
+    glDrawElements(GL_PATCHES, m_numPatchesX * m_numPatchesZ * 4, GL_UNSIGNED_INT, NULL);
 
     glBindVertexArray(0);
 }
@@ -20,6 +20,7 @@
 
 #include <GL/glew.h>
 #include <vector>
+#include <algorithm>
 
 #include "ogldev_math_3d.h"
 
@@ -27,20 +28,43 @@
 // declaration for BaseTerrain.
 class BaseTerrain;
 
+//
+// A grid of quads which are rendered as GL_PATCHES. Every patch covers
+// PatchSize x PatchSize cells of the grid so a larger patch size means
+// fewer patches and more work for the tessellator. The min/max height of
+// every patch is stored in an RG32F texture (one texel per patch) so the
+// TCS can cull the patch against the frustum using gl_PrimitiveID.
+//
 class QuadList {
  public:
     QuadList();
 
     ~QuadList();
 
-    void CreateQuadList(int Width, int Depth, const BaseTerrain* pTerrain);
+    void CreateQuadList(int Width, int Depth, const BaseTerrain* pTerrain, int PatchSize = 1);
 
     void Destroy();
 
     void Render();
 
+    int GetPatchSize() const { return m_patchSize; }
+
+    int GetNumPatchesX() const { return m_numPatchesX; }
+
+    int GetNumPatchesZ() const { return m_numPatchesZ; }
+
+    int GetNumPatches() const { return m_numPatchesX * m_numPatchesZ; }
+
+    // Same test as the TCS - only used for the stats in the GUI
+    int CalcNumVisiblePatches(const FrustumCulling& FC) const;
+
  private:
 
+    struct PatchBounds {
+        Vector3f Min;
+        Vector3f Max;
+    };
+
     struct Vertex {
         Vector3f Pos;
         Vector2f Tex;
@@ -53,11 +77,21 @@ class QuadList {
 	void PopulateBuffers(const BaseTerrain* pTerrain);
     void InitVertices(const BaseTerrain* pTerrain, std::vector<Vertex>& Vertices);
     void InitIndices(std::vector<uint>& Indices);
+    void InitPatchBounds(const BaseTerrain* pTerrain);
+
+    // Grid coordinate of a patch vertex - the last patch in a row/column may be smaller
+    int GridX(int i) const { return std::min(i * m_patchSize, m_width - 1); }
+    int GridZ(int i) const { return std::min(i * m_patchSize, m_depth - 1); }
 
     int m_width = 0;
     int m_depth = 0;
+    int m_patchSize = 1;
+    int m_numPatchesX = 0;
+    int m_numPatchesZ = 0;
     GLuint m_vao = 0;
     GLuint m_vb = 0;
     GLuint m_ib = 0;
+    GLuint m_patchBoundsTexture = 0;
+    std::vector<PatchBounds> m_patchBounds;
 };
 
@@ -71,7 +71,7 @@ void BaseTerrain::InitTerrain(float WorldScale, float TextureScale, const std::v
 
 void BaseTerrain::Finalize()
 {
-    m_quadList.CreateQuadList(m_numPatches, m_numPatches, this);
+    m_quadList.CreateQuadList(m_numPatches, m_numPatches, this, m_patchSize);
 
   //  m_heightMap.PrintFloat();
 
@@ -111,7 +111,7 @@ void BaseTerrain::LoadFromFile(const char* pFilename)
     // how do we know the patch size at this point?
     assert(0);
 
-    m_quadList.CreateQuadList(m_numPatches, m_numPatches, this);
+    m_quadList.CreateQuadList(m_numPatches, m_numPatches, this, m_patchSize);
 }
 
 
@@ -176,6 +176,22 @@ void BaseTerrain::Render(const BasicCamera& Camera)
 	
     m_terrainTech.SetLightDir(m_lightDir);
 
+    FrustumCulling FC(VP);
+
+    m_terrainTech.SetCullPatches(m_cullPatches);
+
+    if (m_cullPatches) {
+        Vector4f Planes[6];
+        FC.GetPlanes(Planes);
+        m_terrainTech.SetFrustumPlanes(Planes);
+        m_numVisiblePatches = m_quadList.CalcNumVisiblePatches(FC);
+    } else {
+        m_numVisiblePatches = m_quadList.GetNumPatches();
+    }
+
+    float ScreenScale = Camera.GetProjectionMat().m[1][1] * Camera.GetPersProjInfo().Height * 0.5f;
+    m_terrainTech.SetScreenSpaceTess(m_screenSpaceTess, ScreenScale, m_pixelsPerTriangle);
+
     glFrontFace(GL_CCW);
     m_quadList.Render();
 
@@ -184,6 +200,22 @@ void BaseTerrain::Render(const BasicCamera& Camera)
 }
 
 
+void BaseTerrain::SetPatchSize(int PatchSize)
+{
+    if (PatchSize == m_patchSize) {
+        return;
+    }
+
+    m_patchSize = PatchSize;
+
+    // Nothing to rebuild if the terrain hasn't been created yet
+    if (m_terrainSize > 0) {
+        m_quadList.Destroy();
+        m_quadList.CreateQuadList(m_numPatches, m_numPatches, this, m_patchSize);
+    }
+}
+
+
 void BaseTerrain::SetMinMaxHeight(float MinHeight, float MaxHeight)
 {
     m_minHeight = MinHeight;
@@ -61,12 +61,31 @@ class BaseTerrain
 	
     void SetLightDir(const Vector3f& Dir) { m_lightDir = Dir; }	
 
+    float GetMinHeight() const { return m_minHeight; }
+
     float GetMaxHeight() const { return m_maxHeight; }
 
     float GetWorldSize() const { return m_numPatches * m_worldScale; }
 
     Vector3f ConstrainCameraPosToTerrain(const Vector3f& CameraPos);
 
+    // Number of grid cells covered by a single patch in each dimension - rebuilds the patches
+    void SetPatchSize(int PatchSize);
+
+    int GetPatchSize() const { return m_patchSize; }
+
+    void SetCullPatches(bool CullPatches) { m_cullPatches = CullPatches; }
+
+    // Screen space tessellation (edge length in pixels) vs. the original distance based levels
+    void SetScreenSpaceTess(bool ScreenSpaceTess) { m_screenSpaceTess = ScreenSpaceTess; }
+
+    void SetPixelsPerTriangle(float PixelsPerTriangle) { m_pixelsPerTriangle = PixelsPerTriangle; }
+
+    int GetNumPatches() const { return m_quadList.GetNumPatches(); }
+
+    // Patches which passed the frustum test during the last Render()
+    int GetNumVisiblePatches() const { return m_numVisiblePatches; }
+
  protected:
 
 	void LoadHeightMapFile(const char* pFilename);
@@ -93,6 +112,11 @@ private:
     Vector3f m_lightDir;
     float m_cameraHeight = 2.0f;
     Skydome* m_pSkydome = NULL;
+    int m_patchSize = 1;
+    bool m_cullPatches = true;
+    bool m_screenSpaceTess = true;
+    float m_pixelsPerTriangle = 8.0f;
+    int m_numVisiblePatches = 0;
 };
 
 #endif
@@ -62,6 +62,12 @@ bool TerrainTechnique::Init()
     m_tex3HeightLoc = GetUniformLocation("gHeight3");
     m_reversedLightDirLoc = GetUniformLocation("gReversedLightDir");
     m_heightMapLoc = GetUniformLocation("gHeightMap");
+    m_cullPatchesLoc = GetUniformLocation("gCullPatches");
+    m_frustumPlanesLoc = GetUniformLocation("gFrustumPlanes");
+    m_patchBoundsLoc = GetUniformLocation("gPatchBounds");
+    m_screenSpaceTessLoc = GetUniformLocation("gScreenSpaceTess");
+    m_screenScaleLoc = GetUniformLocation("gScreenScale");
+    m_pixelsPerTriangleLoc = GetUniformLocation("gPixelsPerTriangle");
 
     if (m_VPLoc == INVALID_UNIFORM_LOCATION ||
         m_ViewLoc == INVALID_UNIFORM_LOCATION ||
@@ -74,7 +80,13 @@ bool TerrainTechnique::Init()
         m_tex2HeightLoc == INVALID_UNIFORM_LOCATION ||
         m_tex3HeightLoc == INVALID_UNIFORM_LOCATION ||
         m_reversedLightDirLoc == INVALID_UNIFORM_LOCATION ||
-        m_heightMapLoc == INVALID_UNIFORM_LOCATION) {
+        m_heightMapLoc == INVALID_UNIFORM_LOCATION ||
+        m_cullPatchesLoc == INVALID_UNIFORM_LOCATION ||
+        m_frustumPlanesLoc == INVALID_UNIFORM_LOCATION ||
+        m_patchBoundsLoc == INVALID_UNIFORM_LOCATION ||
+        m_screenSpaceTessLoc == INVALID_UNIFORM_LOCATION ||
+        m_screenScaleLoc == INVALID_UNIFORM_LOCATION ||
+        m_pixelsPerTriangleLoc == INVALID_UNIFORM_LOCATION) {
         return false;
     }
 
@@ -85,6 +97,7 @@ bool TerrainTechnique::Init()
     glUniform1i(m_tex2UnitLoc, COLOR_TEXTURE_UNIT_INDEX_2);
     glUniform1i(m_tex3UnitLoc, COLOR_TEXTURE_UNIT_INDEX_3);
     glUniform1i(m_heightMapLoc, HEIGHT_MAP_TEXTURE_UNIT_INDEX);
+    glUniform1i(m_patchBoundsLoc, PATCH_BOUNDS_TEXTURE_UNIT_INDEX);
 
     glUseProgram(0);
 
@@ -120,3 +133,22 @@ void TerrainTechnique::SetLightDir(const Vector3f& Dir)
     glUniform3f(m_reversedLightDirLoc, ReversedLightDir.x, ReversedLightDir.y, ReversedLightDir.z);
 }
 
+
+void TerrainTechnique::SetCullPatches(bool CullPatches)
+{
+    glUniform1i(m_cullPatchesLoc, CullPatches);
+}
+
+
+void TerrainTechnique::SetFrustumPlanes(const Vector4f Planes[6])
+{
+    glUniform4fv(m_frustumPlanesLoc, 6, (const GLfloat*)Planes);
+}
+
+
+void TerrainTechnique::SetScreenSpaceTess(bool Enable, float ScreenScale, float PixelsPerTriangle)
+{
+    glUniform1i(m_screenSpaceTessLoc, Enable);
+    glUniform1f(m_screenScaleLoc, ScreenScale);
+    glUniform1f(m_pixelsPerTriangleLoc, PixelsPerTriangle);
+}
@@ -36,6 +36,14 @@ public:
     void SetTextureHeights(float Tex0Height, float Tex1Height, float Tex2Height, float Tex3Height);
 	
     void SetLightDir(const Vector3f& Dir);
+
+    void SetCullPatches(bool CullPatches);
+
+    // See FrustumCulling::GetPlanes
+    void SetFrustumPlanes(const Vector4f Planes[6]);
+
+    // ScreenScale is Proj[1][1] * viewport height / 2
+    void SetScreenSpaceTess(bool Enable, float ScreenScale, float PixelsPerTriangle);
 	
 private:
     GLuint m_VPLoc = -1;
@@ -50,6 +58,12 @@ private:
     GLuint m_tex3UnitLoc = -1;
     GLuint m_reversedLightDirLoc = -1;
     GLuint m_heightMapLoc = -1;
+    GLuint m_cullPatchesLoc = -1;
+    GLuint m_frustumPlanesLoc = -1;
+    GLuint m_patchBoundsLoc = -1;
+    GLuint m_screenSpaceTessLoc = -1;
+    GLuint m_screenScaleLoc = -1;
+    GLuint m_pixelsPerTriangleLoc = -1;
 };
 
 #endif  /* TERRAIN_TECHNIQUE_H */
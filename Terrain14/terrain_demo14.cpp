@@ -110,6 +110,18 @@ public:
                     m_terrain.SetTextureHeights(Height0, Height1, Height2, Height3);
                 }
 
+                ImGui::Checkbox("Cull patches", &this->m_cullPatches);
+                ImGui::Checkbox("Screen space tessellation", &this->m_screenSpaceTess);
+                ImGui::SliderFloat("Pixels per triangle", &this->m_pixelsPerTriangle, 1.0f, 32.0f);
+                ImGui::SliderInt("Patch size", &this->m_patchSize, 1, 16);
+
+                m_terrain.SetCullPatches(m_cullPatches);
+                m_terrain.SetScreenSpaceTess(m_screenSpaceTess);
+                m_terrain.SetPixelsPerTriangle(m_pixelsPerTriangle);
+                m_terrain.SetPatchSize(m_patchSize);
+
+                ImGui::Text("Patches: %d visible out of %d", m_terrain.GetNumVisiblePatches(), m_terrain.GetNumPatches());
+
                 ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
                 ImGui::End();
 
@@ -330,6 +342,10 @@ private:
     int m_numPatches = 32;
     float m_counter = 0.0f;
     bool m_constrainCamera = false;
+    bool m_cullPatches = true;
+    bool m_screenSpaceTess = true;
+    float m_pixelsPerTriangle = 8.0f;
+    int m_patchSize = 1;
 };
 
 TerrainDemo14* app = NULL;
@@ -38,6 +38,14 @@ public:
     void SetLightDir(const Vector3f& Dir);
 
     void SetCameraWorldPos(const Vector3f& CameraWorldPos);
+
+    void SetCullPatches(bool CullPatches);
+
+    // See FrustumCulling::GetPlanes
+    void SetFrustumPlanes(const Vector4f Planes[6]);
+
+    // ScreenScale is Proj[1][1] * viewport height / 2
+    void SetScreenSpaceTess(bool Enable, float ScreenScale, float PixelsPerTriangle);
 	
 private:
     GLuint m_VPLoc = -1;
@@ -53,6 +61,12 @@ private:
     GLuint m_reversedLightDirLoc = -1;
     GLuint m_heightMapLoc = -1;
     GLuint m_cameraWorldPosLoc = -1;
+    GLuint m_cullPatchesLoc = -1;
+    GLuint m_frustumPlanesLoc = -1;
+    GLuint m_patchBoundsLoc = -1;
+    GLuint m_screenSpaceTessLoc = -1;
+    GLuint m_screenScaleLoc = -1;
+    GLuint m_pixelsPerTriangleLoc = -1;
 };
 
 #endif  /* TERRAIN_TECHNIQUE_H */
@@ -19,6 +19,8 @@
 #ifndef FAULT_FORMATION_TERRAIN_H
 #define FAULT_FORMATION_TERRAIN_H
 
+#include <vector>
+
 #include "terrain.h"
 
 class FaultFormationTerrain : public BaseTerrain {
@@ -28,6 +30,18 @@ class FaultFormationTerrain : public BaseTerrain {
 
     void CreateFaultFormation(int TerrainSize, int Iterations, float MinHeight, float MaxHeight, float Filter);
 
+    // Multithreaded version. The fault lines come from a counter based RNG so the
+    // same seed always gives the same terrain regardless of the number of threads.
+    // Zero threads means one thread per core.
+    void CreateFaultFormationParallel(int TerrainSize, int Iterations, float MinHeight, float MaxHeight, float Filter,
+                                      uint Seed, int NumThreads = 0);
+
+    // Only generate the height map (no GL state) - used by the benchmark
+    void InitHeightMap(int TerrainSize, int Iterations, float MinHeight, float MaxHeight, float Filter);
+
+    void InitHeightMapParallel(int TerrainSize, int Iterations, float MinHeight, float MaxHeight, float Filter,
+                               uint Seed, int NumThreads);
+
  private:
 
      struct TerrainPoint {
@@ -45,10 +59,23 @@ class FaultFormationTerrain : public BaseTerrain {
          }
      };
 
+    struct FaultLine {
+        TerrainPoint p1;
+        TerrainPoint p2;
+        float Height = 0.0f;
+    };
+
     void CreateFaultFormationInternal(int Iterations, float MinHeight, float MaxHeight, float Filter);
     void GenRandomTerrainPoints(TerrainPoint& p1, TerrainPoint& p2);
     void ApplyFIRFilter(float Filter);
     float FIRFilterSinglePoint(int x, int z, float PrevFractalVal, float Filter);
+
+    void GenFaultLines(int Iterations, float MinHeight, float MaxHeight, uint Seed, std::vector<FaultLine>& FaultLines);
+    void ApplyFaultLinesParallel(const std::vector<FaultLine>& FaultLines, int NumThreads);
+    void ApplyFIRFilterParallel(float Filter, int NumThreads);
 };
 
+// Times the single threaded and the multithreaded generators for sizes 1k to 8k
+void FaultFormationBenchmark();
+
 #endif
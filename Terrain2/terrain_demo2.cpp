@@ -90,18 +90,24 @@ public:
                 static int Iterations = 100;
                 static float MaxHeight = 200.0f;
                 static float Filter = 0.2f;
+                static bool ParallelGen = true;
                  
                 ImGui::Begin("Terrain Demo 2");                          // Create a window called "Hello, world!" and append into it.
 
                 ImGui::SliderInt("Iterations", &Iterations, 0, 1000);
                 ImGui::SliderFloat("MaxHeight", &MaxHeight, 0.0f, 1000.0f);
                 ImGui::SliderFloat("Filter", &Filter, 0.0f, 1.0f);
+                ImGui::Checkbox("Multithreaded generation", &ParallelGen);
 
                 if (ImGui::Button("Generate")) {
                     m_terrain.Destroy();
                     int Size = 256;
                     float MinHeight = 0.0f;
-                    m_terrain.CreateFaultFormation(Size, Iterations, MinHeight, MaxHeight, Filter);
+                    if (ParallelGen) {
+                        m_terrain.CreateFaultFormationParallel(Size, Iterations, MinHeight, MaxHeight, Filter, rand());
+                    } else {
+                        m_terrain.CreateFaultFormation(Size, Iterations, MinHeight, MaxHeight, Filter);
+                    }
                 }
 
                 ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
@@ -285,6 +291,11 @@ static void MouseButtonCallback(GLFWwindow* window, int Button, int Action, int
 
 int main(int argc, char** argv)
 {
+    if ((argc > 1) && (strcmp(argv[1], "-bench_gen") == 0)) {
+        FaultFormationBenchmark();
+        return 0;
+    }
+
 #ifdef _WIN64
     srand(GetCurrentProcessId());
 #else
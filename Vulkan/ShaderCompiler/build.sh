@@ -0,0 +1,17 @@
+#!/bin/bash
+
+# Builds the offline shader compiler and fills the SPIR-V cache of all the tutorials
+
+CC=g++
+CPPFLAGS="-std=c++20 -I../VulkanCore/Include -I../../Include -DVULKAN -O2"
+LDFLAGS=`pkg-config --libs vulkan`
+LDFLAGS="$LDFLAGS /usr/lib/x86_64-linux-gnu/libglslang.a /usr/lib/x86_64-linux-gnu/libglslang-default-resource-limits.a"
+
+$CC shader_compiler.cpp \
+    ../VulkanCore/Source/shader.cpp \
+    ../../Common/ogldev_util.cpp  \
+    $CPPFLAGS $LDFLAGS -o shader_compiler || exit 1
+
+shopt -s nullglob
+
+./shader_compiler ../Tutorial*/*.{vert,frag,geom,comp,tesc,tese}
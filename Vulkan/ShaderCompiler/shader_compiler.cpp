@@ -0,0 +1,52 @@
+/*
+
+		Copyright 2024 Etay Meiri
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	Vulkan For Beginners - 
+		Offline shader compiler
+*/
+
+#include <stdio.h>
+
+#include "ogldev_vulkan_shader.h"
+
+//
+// Compiles GLSL shaders into the SPIR-V cache next to them ('<shader>.spvcache')
+// which is used by CreateShaderModuleFromText, so the tutorials skip glslang on
+// startup. Shaders which are already up to date are not recompiled.
+//
+// Usage: shader_compiler <shader file> [<shader file>...]
+//
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		printf("Usage: %s <shader file> [<shader file>...]\n", argv[0]);
+		return 1;
+	}
+
+	int NumFailed = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (!OgldevVK::PrecompileShader(argv[i])) {
+			printf("%s: compilation failed\n", argv[i]);
+			NumFailed++;
+		}
+	}
+
+	printf("%d shaders, %d failed\n", argc - 1, NumFailed);
+
+	return (NumFailed == 0) ? 0 : 1;
+}
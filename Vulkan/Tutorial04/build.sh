@@ -3,10 +3,16 @@
 CC=g++
 CPPFLAGS="-I../VulkanCore/Include -I../../Include -DVULKAN -ggdb3"
 LDFLAGS=`pkg-config --libs glfw3 vulkan`
-LDFLAGS="$LDFLAGS"
+LDFLAGS="$LDFLAGS -lpthread"
 
 $CC tutorial04.cpp \
     ../VulkanCore/Source/core.cpp \
+    ../VulkanCore/Source/allocator.cpp \
+    ../VulkanCore/Source/uploader.cpp \
+    ../VulkanCore/Source/pipeline_cache.cpp \
+    ../VulkanCore/Source/parallel_recorder.cpp \
+    ../VulkanCore/Source/bindless.cpp \
+    ../VulkanCore/Source/gpu_timer.cpp \
     ../VulkanCore/Source/util.cpp \
     ../VulkanCore/Source/device.cpp \
     ../VulkanCore/Source/queue.cpp \
@@ -0,0 +1,36 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#version 460
+
+// Must match MAX_MODEL_TEXTURES in ogldev_vulkan_model.h
+#define MAX_MODEL_TEXTURES 32
+
+layout(location = 0) in vec2 uv;
+layout(location = 1) flat in uint materialIndex;
+
+layout(location = 0) out vec4 out_Color;
+
+layout(binding = 2) uniform sampler2D texSamplers[MAX_MODEL_TEXTURES];
+
+void main() 
+{
+	// The index is the same for the entire draw so it is dynamically uniform
+    out_Color = texture(texSamplers[materialIndex], uv);
+}
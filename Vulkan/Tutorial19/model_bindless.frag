@@ -0,0 +1,37 @@
+/*
+
+        Copyright 2024 Etay Meiri
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#version 460
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec2 uv;
+layout(location = 2) flat in uint textureIndex;
+
+layout(location = 0) out vec4 out_Color;
+
+// VulkanBindlessTextures. The size of the array comes from the descriptor set layout.
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+void main() 
+{
+	// The index is the same for the entire draw but a multi-draw may put several
+	// draws in the same subgroup so don't assume it is dynamically uniform
+	out_Color = texture(textures[nonuniformEXT(textureIndex)], uv);
+}
@@ -16,12 +16,25 @@
 	along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 	Vulkan For Beginners - 
-		Tutorial #19: Depth Buffering
+		Tutorial #19: Depth Buffering + VulkanCore benchmarks
+
+	By default this renders the depth buffered quads (or a model with -model)
+	in a window. The other modes exercise parts of VulkanCore and exit:
+
+	-bench_uniforms      BufferAndMemory::Update vs the persistently mapped uniform ring
+	-stress_allocator    random buffer/image create/destroy with sub-allocator checks
+	-bench_uploads       blocking uploads vs the batched uploader
+	-bench_pipelines     no caching vs VkPipelineCache vs the pipeline registry
+	-bench_recording     10k-100k draws recorded by 1 to N threads
+	-headless            offscreen rendering with GPU pass timing (-frames, -output)
 */
 
 #include <array>
+#include <thread>
+#include <chrono>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
@@ -35,12 +48,28 @@
 #include "ogldev_vulkan_shader.h"
 #include "ogldev_vulkan_graphics_pipeline.h"
 #include "ogldev_vulkan_simple_mesh.h"
+#include "ogldev_vulkan_model.h"
+#include "ogldev_vulkan_parallel_recorder.h"
+#include "ogldev_vulkan_gpu_timer.h"
 #include "ogldev_vulkan_glfw.h"
 #include "ogldev_glm_camera.h"
+#include "3rdparty/stb_image_write.h"
 
 #define WINDOW_WIDTH 1280
 #define WINDOW_HEIGHT 720
 
+// Number of frames between queue stats reports
+#define STATS_INTERVAL 1000
+
+#define DEFAULT_NUM_HEADLESS_FRAMES 1000
+
+
+// glfwGetTime can't be used in headless mode because GLFW is not initialized
+static double GetTimeSecs()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 
 class VulkanApp : public OgldevVK::GLFWCallbacks
 {
@@ -56,43 +85,80 @@ public:
 	{
 		m_vkCore.FreeCommandBuffers((u32)m_cmdBufs.size(), m_cmdBufs.data());
 		m_vkCore.DestroyFramebuffers(m_frameBuffers);
+		m_vkCore.GetPipelineCache()->ReleaseShaderModule(m_vs);
+		m_vkCore.GetPipelineCache()->ReleaseShaderModule(m_fs);
 		vkDestroyShaderModule(m_device, m_vs, NULL);
 		vkDestroyShaderModule(m_device, m_fs, NULL);
 		delete m_pPipeline;
+		m_vkCore.GetPipelineCache()->ReleaseRenderPass(m_renderPass);
 		vkDestroyRenderPass(m_device, m_renderPass, NULL);
 		m_mesh.Destroy(m_device);
+		m_model.Destroy(m_device);
 
-		for (int i = 0; i < m_uniformBuffers.size(); i++) {
-			m_uniformBuffers[i].Destroy(m_device);
-		}
+		m_uniformRing.Destroy(m_device);
+		m_gpuTimer.Destroy();
 	}
 
-	void Init(const char* pAppName)
+	// Renders the model instead of the quads if pModelFilename is not NULL.
+	// Bindless puts the textures of the model in the bindless table of VulkanCore.
+	// Headless renders into offscreen images without a window - use RunHeadless.
+	void Init(const char* pAppName, int NumFramesInFlight, const char* pModelFilename = NULL, bool Bindless = false,
+			  bool Headless = false)
 	{
-		m_pWindow = OgldevVK::glfw_vulkan_init(WINDOW_WIDTH, WINDOW_HEIGHT, pAppName);
+		m_pModelFilename = pModelFilename;
+		m_bindless = Bindless && pModelFilename;
+		m_headless = Headless;
+
+		if (!m_headless) {
+			m_pWindow = OgldevVK::glfw_vulkan_init(WINDOW_WIDTH, WINDOW_HEIGHT, pAppName);
+		}
+
+		// Delete the *.spvcache files to compare a cold start against a warm one
+		double StartTime = GetTimeSecs();
+
+		if (m_headless) {
+			m_vkCore.InitHeadless(pAppName, WINDOW_WIDTH, WINDOW_HEIGHT, true, DEFAULT_NUM_OFFSCREEN_IMAGES,
+								  NumFramesInFlight);
+		} else {
+			m_vkCore.Init(pAppName, m_pWindow, true, NumFramesInFlight);
+		}
 
-		m_vkCore.Init(pAppName, m_pWindow, true);
 		m_device = m_vkCore.GetDevice();
 		m_numImages = m_vkCore.GetNumImages();
 		m_pQueue = m_vkCore.GetQueue();
+		m_numFramesInFlight = m_vkCore.GetNumFramesInFlight();
 		m_renderPass = m_vkCore.CreateSimpleRenderPass();
 		m_frameBuffers = m_vkCore.CreateFramebuffers(m_renderPass);
+
+		if (m_bindless && !m_vkCore.IsBindlessSupported()) {
+			printf("Bindless textures are not supported - using a fixed size texture array\n");
+			m_bindless = false;
+		}
+
 		CreateShaders();
 		CreateMesh();
 		CreateUniformBuffers();
 		CreatePipeline();
 		CreateCommandBuffers();
+		CreateGpuTimer();
 		RecordCommandBuffers();
 		DefaultCreateCameraPers();
-		// The object is ready to receive callbacks
-		OgldevVK::glfw_vulkan_set_callbacks(m_pWindow, this);
+		printf("Startup time %.1f ms\n", (GetTimeSecs() - StartTime) * 1000.0);
+
+		if (!m_headless) {
+			// The object is ready to receive callbacks
+			OgldevVK::glfw_vulkan_set_callbacks(m_pWindow, this);
+		}
 	}
 
 
 	void RenderScene()
 	{
+		// Blocks only if the GPU is still using the frame slot or the image
 		u32 ImageIndex = m_pQueue->AcquireNextImage();
 
+		// The command buffers and the uniform ring segments are per image and
+		// the queue guarantees the previous frame which used this image is done
 		UpdateUniformBuffers(ImageIndex);
 
 		m_pQueue->SubmitAsync(m_cmdBufs[ImageIndex]);
@@ -145,14 +211,374 @@ public:
 			RenderScene();
 			CurTime = Time;
 			glfwPollEvents();
+			PrintQueueStats();
 		}
 
 		glfwTerminate();
 	}
 
 
+	// Compares the CPU cost per draw of updating the uniforms with BufferAndMemory::Update
+	// on one of the per image buffers against pushing them into the ring buffer. Both
+	// are memcpys into persistently mapped memory - the allocator maps host visible
+	// memory once so there is no vkMapMemory/vkUnmapMemory per update to measure.
+	void RunUniformBenchmark()
+	{
+		const int NumDraws = 10000;
+		const int NumFrames = 100;
+
+		glm::mat4 WVP = m_pGameCamera->GetVPMatrix();
+
+		std::vector<OgldevVK::BufferAndMemory> UniformBuffers = m_vkCore.CreateUniformBuffers(sizeof(UniformData));
+
+		double Start = GetTimeSecs();
+
+		for (int Frame = 0; Frame < NumFrames; Frame++) {
+			for (int Draw = 0; Draw < NumDraws; Draw++) {
+				WVP[3][0] = (float)Draw;
+				UniformBuffers[Draw % UniformBuffers.size()].Update(m_device, &WVP, sizeof(WVP));
+			}
+		}
+
+		double SeparateBuffersTime = GetTimeSecs() - Start;
+
+		// 256 is the largest minUniformBufferOffsetAlignment allowed by the spec
+		OgldevVK::UniformRingBuffer Ring;
+		size_t AllocSize = (sizeof(UniformData) + 255) & ~255;
+		m_vkCore.CreateUniformRingBuffer(Ring, NumDraws * AllocSize, m_numFramesInFlight);
+
+		Start = GetTimeSecs();
+
+		for (int Frame = 0; Frame < NumFrames; Frame++) {
+			Ring.BeginFrame(Frame % m_numFramesInFlight);
+
+			for (int Draw = 0; Draw < NumDraws; Draw++) {
+				WVP[3][0] = (float)Draw;
+				Ring.Push(&WVP, sizeof(WVP));
+			}
+		}
+
+		double RingTime = GetTimeSecs() - Start;
+
+		double NumUpdates = (double)NumDraws * (double)NumFrames;
+
+		printf("Uniform update cost per draw (%d draws x %d frames)\n", NumDraws, NumFrames);
+		printf("    separate buffers: %.1f ns\n", SeparateBuffersTime * 1e9 / NumUpdates);
+		printf("    ring buffer:      %.1f ns\n", RingTime * 1e9 / NumUpdates);
+
+		if (RingTime > 0.0) {
+			printf("    speedup:          %.1fx\n", SeparateBuffersTime / RingTime);
+		}
+
+		Ring.Destroy(m_device);
+
+		for (int i = 0; i < (int)UniformBuffers.size(); i++) {
+			UniformBuffers[i].Destroy(m_device);
+		}
+	}
+
+
+	// Creates and destroys buffers and images of random sizes in random order
+	// and checks the sub-allocator after every round
+	void RunAllocatorStressTest()
+	{
+		const int NumRounds = 20;
+		const int NumOpsPerRound = 5000;
+		const int MaxLiveBuffers = 4000;
+		const int MaxLiveImages = 64;
+
+		OgldevVK::VulkanMemoryAllocator& Allocator = m_vkCore.GetAllocator();
+
+		std::vector<OgldevVK::BufferAndMemory> Buffers;
+		std::vector<OgldevVK::VulkanTexture> Images;
+
+		srand(0);
+
+		double Start = GetTimeSecs();
+
+		for (int Round = 0; Round < NumRounds; Round++) {
+			for (int Op = 0; Op < NumOpsPerRound; Op++) {
+				int r = rand() % 100;
+
+				if (r < 50 && Buffers.size() < MaxLiveBuffers) {
+					// Mostly small buffers with the occasional large one
+					VkDeviceSize Size = (rand() % 16 == 0) ? (rand() % (8 * 1024 * 1024) + 1) : (rand() % 65536 + 1);
+					bool HostVisible = (rand() % 2) == 0;
+					VkBufferUsageFlags Usage = HostVisible ? VK_BUFFER_USAGE_TRANSFER_SRC_BIT :
+						                       (VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+					VkMemoryPropertyFlags MemProps = HostVisible ?
+						(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) :
+						VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+					Buffers.push_back(m_vkCore.CreateBuffer(Size, Usage, MemProps));
+				} else if (r < 55 && Images.size() < MaxLiveImages) {
+					u32 Width = 16 << (rand() % 7);
+					u32 Height = 16 << (rand() % 7);
+					Images.push_back(OgldevVK::VulkanTexture());
+					m_vkCore.CreateImage(Images.back(), Width, Height, VK_FORMAT_R8G8B8A8_UNORM,
+										 VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+				} else if (r < 95 && !Buffers.empty()) {
+					int Index = rand() % Buffers.size();
+					Buffers[Index].Destroy(m_device);
+					Buffers[Index] = Buffers.back();
+					Buffers.pop_back();
+				} else if (!Images.empty()) {
+					int Index = rand() % Images.size();
+					Images[Index].Destroy(m_device);
+					Images[Index] = Images.back();
+					Images.pop_back();
+				}
+			}
+
+			if (!Allocator.Validate()) {
+				printf("Allocator validation failed in round %d\n", Round);
+				exit(1);
+			}
+
+			printf("Round %d: %d buffers, %d images\n", Round, (int)Buffers.size(), (int)Images.size());
+			Allocator.PrintStats();
+		}
+
+		for (int i = 0; i < (int)Buffers.size(); i++) {
+			Buffers[i].Destroy(m_device);
+		}
+
+		for (int i = 0; i < (int)Images.size(); i++) {
+			Images[i].Destroy(m_device);
+		}
+
+		int NumReleased = Allocator.ReleaseEmptyBlocks();
+
+		printf("Stress test done in %.2f seconds, %d blocks released\n", GetTimeSecs() - Start, NumReleased);
+		Allocator.PrintStats();
+	}
+
+	// Uploads a lot of textures and vertex buffers waiting for every resource
+	// against recording all of them into the batches of the uploader
+	void RunUploadBenchmark()
+	{
+		const int NumResources = 256;
+		const u32 TexSize = 256;
+		const VkFormat TexFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+		std::vector<u32> Pixels(TexSize * TexSize, 0xff8040ff);
+		std::vector<glm::vec4> Vertices(16 * 1024, glm::vec4(1.0f));
+		size_t VertexBufferSize = Vertices.size() * sizeof(glm::vec4);
+
+		OgldevVK::VulkanUploader* pUploader = m_vkCore.GetUploader();
+
+		std::vector<OgldevVK::VulkanTexture> Textures(NumResources);
+		std::vector<OgldevVK::BufferAndMemory> VertexBuffers(NumResources);
+
+		for (int Pass = 0; Pass < 2; Pass++) {
+			bool Batched = (Pass == 1);
+			int NumSubmissions = pUploader->GetNumSubmissions();
+
+			double Start = GetTimeSecs();
+
+			for (int i = 0; i < NumResources; i++) {
+				m_vkCore.CreateImage(Textures[i], TexSize, TexSize, TexFormat,
+									 VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+									 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+				u64 Batch = pUploader->UploadImage(Textures[i].m_image, TexSize, TexSize, TexFormat, Pixels.data());
+
+				if (!Batched) {
+					pUploader->Wait(Batch);
+				}
+
+				bool WaitForUpload = !Batched;
+				VertexBuffers[i] = m_vkCore.CreateVertexBuffer(Vertices.data(), VertexBufferSize, WaitForUpload);
+			}
+
+			if (Batched) {
+				pUploader->WaitAll();
+			}
+
+			double Time = GetTimeSecs() - Start;
+
+			printf("%s: %d textures and %d vertex buffers in %.2f ms using %d submissions\n",
+				   Batched ? "Batched" : "One by one", NumResources, NumResources, Time * 1000.0,
+				   pUploader->GetNumSubmissions() - NumSubmissions);
+
+			for (int i = 0; i < NumResources; i++) {
+				Textures[i].Destroy(m_device);
+				VertexBuffers[i].Destroy(m_device);
+				Textures[i] = OgldevVK::VulkanTexture();
+			}
+		}
+	}
+
+
+	// Creates the same pipeline (with depth disabled so it doesn't match the one
+	// used for rendering) without any caching, through the VkPipelineCache (warm
+	// when pipeline_cache.bin was loaded on startup) and through the registry
+	void RunPipelineBenchmark()
+	{
+		OgldevVK::VulkanPipelineCache* pCache = m_vkCore.GetPipelineCache();
+
+		const char* Names[3] = { "No cache", pCache->GetStats().LoadedFromDisk ? "Warm cache" : "Cold cache", "Registry hit" };
+
+		for (int Pass = 0; Pass < 3; Pass++) {
+			OgldevVK::VulkanPipelineCache* pPassCache = (Pass == 0) ? NULL : pCache;
+
+			double Start = GetTimeSecs();
+
+			OgldevVK::GraphicsPipeline* pPipeline = new OgldevVK::GraphicsPipeline(m_device, m_pWindow, m_renderPass, m_vs, m_fs, &m_mesh,
+																					m_numImages, m_noUniformBuffers, sizeof(UniformData),
+																					false, &m_uniformRing, pPassCache);
+			double Time = GetTimeSecs() - Start;
+
+			printf("%s: pipeline created in %.3f ms\n", Names[Pass], Time * 1000.0);
+
+			delete pPipeline;
+		}
+
+		pCache->PrintStats();
+	}
+
+
+	// Records 10k to 100k draws every frame into secondary command buffers using
+	// 1 to N threads. The secondary command buffers are executed by the primary
+	// command buffer of the image and presented so the recording is actually valid.
+	// Only the time of VulkanParallelRecorder::Record is measured.
+	void RunRecordingBenchmark()
+	{
+		const int DrawCounts[] = { 10000, 50000, 100000 };
+		const int NumFrames = 20;
+		int MaxThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+
+		// 1, 2, 4... and the number of cores
+		std::vector<int> ThreadCounts;
+
+		for (int NumThreads = 1; NumThreads < MaxThreads; NumThreads *= 2) {
+			ThreadCounts.push_back(NumThreads);
+		}
+
+		ThreadCounts.push_back(MaxThreads);
+
+		u32 ImageIndex = 0;
+
+		auto RecordDraws = [&](VkCommandBuffer CmdBuf, int ThreadIndex, int Start, int End) {
+			m_pPipeline->Bind(CmdBuf, ImageIndex, m_uniformRing.GetFrameOffset(ImageIndex));
+
+			for (int i = Start; i < End; i++) {
+				vkCmdDraw(CmdBuf, 9, 1, 0, 0);
+			}
+		};
+
+		for (int t = 0; t < (int)ThreadCounts.size(); t++) {
+			int NumThreads = ThreadCounts[t];
+
+			OgldevVK::VulkanParallelRecorder Recorder;
+			Recorder.Init(m_device, m_vkCore.GetQueueFamily(), NumThreads, m_numImages);
+
+			for (int i = 0; i < (int)ARRAY_SIZE_IN_ELEMENTS(DrawCounts); i++) {
+				double RecordTime = 0.0;
+
+				for (int Frame = 0; Frame < NumFrames; Frame++) {
+					ImageIndex = m_pQueue->AcquireNextImage();
+
+					UpdateUniformBuffers(ImageIndex);
+
+					double Start = GetTimeSecs();
+
+					Recorder.Record(ImageIndex, m_renderPass, m_frameBuffers[ImageIndex], DrawCounts[i], RecordDraws);
+
+					RecordTime += GetTimeSecs() - Start;
+
+					VkCommandBuffer CmdBuf = m_cmdBufs[ImageIndex];
+
+					OgldevVK::BeginCommandBuffer(CmdBuf, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+					BeginRenderPass(CmdBuf, ImageIndex, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+					Recorder.ExecuteCommands(CmdBuf, ImageIndex);
+					vkCmdEndRenderPass(CmdBuf);
+
+					VkResult res = vkEndCommandBuffer(CmdBuf);
+					CHECK_VK_RESULT(res, "vkEndCommandBuffer\n");
+
+					m_pQueue->SubmitAsync(CmdBuf);
+					m_pQueue->Present(ImageIndex);
+				}
+
+				printf("%6d draws, %2d threads: %.3f ms per frame\n", DrawCounts[i], NumThreads,
+					   RecordTime * 1000.0 / NumFrames);
+			}
+
+			// The command pools of the recorder are destroyed next
+			m_pQueue->WaitIdle();
+
+			Recorder.Destroy();
+		}
+	}
+
+
+	// Renders NumFrames frames into the offscreen images and prints the CPU time
+	// per frame and the GPU time of every pass. The last frame is saved as a PNG
+	// if pOutputFilename is not NULL.
+	void RunHeadless(int NumFrames, const char* pOutputFilename)
+	{
+		u32 ImageIndex = 0;
+
+		m_pQueue->ResetStats();
+
+		double Start = GetTimeSecs();
+
+		for (int Frame = 0; Frame < NumFrames; Frame++) {
+			ImageIndex = m_pQueue->AcquireNextImage();
+
+			// The previous frame which used this image is done so its queries are ready
+			m_gpuTimer.CollectResults(ImageIndex);
+
+			UpdateUniformBuffers(ImageIndex);
+
+			m_pQueue->SubmitAsync(m_cmdBufs[ImageIndex]);
+
+			m_gpuTimer.FrameSubmitted(ImageIndex);
+
+			m_pQueue->Present(ImageIndex);
+		}
+
+		m_pQueue->WaitIdle();
+
+		double Time = GetTimeSecs() - Start;
+
+		m_gpuTimer.CollectAllResults();
+
+		const OgldevVK::VulkanQueueStats& Stats = m_pQueue->GetStats();
+
+		printf("Headless: %d frames in %.1f ms, %.3f ms per frame, CPU blocked %.3f ms per frame\n",
+			   NumFrames, Time * 1000.0, Time * 1000.0 / NumFrames, Stats.FenceWaitTime * 1000.0 / NumFrames);
+
+		m_gpuTimer.PrintStats();
+
+		if (pOutputFilename) {
+			SaveImage(ImageIndex, pOutputFilename);
+		}
+	}
+
+
 private:
 
+	// The fraction of the frame time the CPU is not blocked on a fence is the
+	// time it runs in parallel with the GPU
+	void PrintQueueStats()
+	{
+		const OgldevVK::VulkanQueueStats& Stats = m_pQueue->GetStats();
+
+		if (Stats.NumFrames < STATS_INTERVAL) {
+			return;
+		}
+
+		double FrameTimeMs = Stats.FrameTime * 1000.0 / (double)Stats.NumFrames;
+		double WaitTimeMs = Stats.FenceWaitTime * 1000.0 / (double)Stats.NumFrames;
+		double Overlap = (Stats.FrameTime > 0.0) ? (1.0 - Stats.FenceWaitTime / Stats.FrameTime) * 100.0 : 0.0;
+
+		printf("%d frames in flight: frame %.3f ms, CPU blocked %.3f ms, CPU/GPU overlap %.1f%%\n",
+			   m_pQueue->GetNumFramesInFlight(), FrameTimeMs, WaitTimeMs, Overlap);
+
+		m_pQueue->ResetStats();
+	}
+
+
 	void DefaultCreateCameraPers()
 	{
 		float FOV = 45.0f;
@@ -186,6 +612,34 @@ private:
 	}
 
 
+	void SaveImage(int ImageIndex, const char* pFilename)
+	{
+		std::vector<u8> Pixels;
+		m_vkCore.ReadImage(ImageIndex, Pixels);
+
+		int BPP = 4;
+
+		if (!stbi_write_png(pFilename, WINDOW_WIDTH, WINDOW_HEIGHT, BPP, Pixels.data(), WINDOW_WIDTH * BPP)) {
+			printf("Error writing '%s'\n", pFilename);
+			return;
+		}
+
+		printf("Frame saved to '%s'\n", pFilename);
+	}
+
+
+	// Headless only. Every command buffer measures the GPU time of the scene pass.
+	void CreateGpuTimer()
+	{
+		if (!m_headless) {
+			return;
+		}
+
+		m_gpuTimer.Init(m_device, m_vkCore.GetPhysicalDevice(), m_vkCore.GetQueueFamily(), m_numImages);
+		m_scenePass = m_gpuTimer.AddPass("scene");
+	}
+
+
 	void CreateCommandBuffers()
 	{
 		m_cmdBufs.resize(m_numImages);
@@ -197,8 +651,18 @@ private:
 
 	void CreateMesh()
 	{
-		CreateVertexBuffer();
-		LoadTexture();
+		if (m_pModelFilename) {
+			if (m_bindless) {
+				m_model.SetBindlessTextures(m_vkCore.GetBindlessTextures());
+			}
+
+			if (!m_model.LoadModel(m_vkCore, m_pModelFilename)) {
+				exit(1);
+			}
+		} else {
+			CreateVertexBuffer();
+			LoadTexture();
+		}
 	}
 
 
@@ -244,28 +708,44 @@ private:
 		glm::mat4 WVP;
 	};
 
+	// One ring segment per image. The command buffers are recorded once so
+	// the uniforms of every image must always start at the same offset.
 	void CreateUniformBuffers()
 	{
-		m_uniformBuffers = m_vkCore.CreateUniformBuffers(sizeof(UniformData));
+		m_vkCore.CreateUniformRingBuffer(m_uniformRing, sizeof(UniformData), m_numImages);
 	}
 
 
 	void CreateShaders()
 	{
-		m_vs = OgldevVK::CreateShaderModuleFromText(m_device, "test.vert");
+		m_vs = OgldevVK::CreateShaderModuleFromText(m_device, m_pModelFilename ? "model.vert" : "test.vert");
+
+		const char* pFSFilename = "test.frag";
+
+		if (m_pModelFilename) {
+			pFSFilename = m_bindless ? "model_bindless.frag" : "model.frag";
+		}
 
-		m_fs = OgldevVK::CreateShaderModuleFromText(m_device, "test.frag");
+		m_fs = OgldevVK::CreateShaderModuleFromText(m_device, pFSFilename);
 	}
 
 
 	void CreatePipeline()
 	{
+		if (m_pModelFilename) {
+			m_pPipeline = new OgldevVK::GraphicsPipeline(m_device, m_pWindow, m_renderPass, m_vs, m_fs, m_model, m_numImages,
+														 m_noUniformBuffers, sizeof(UniformData), true, &m_uniformRing,
+														 m_vkCore.GetPipelineCache(), { WINDOW_WIDTH, WINDOW_HEIGHT });
+			return;
+		}
+
 		m_pPipeline = new OgldevVK::GraphicsPipeline(m_device, m_pWindow, m_renderPass, m_vs, m_fs, &m_mesh, m_numImages, 
-													 m_uniformBuffers, sizeof(UniformData), true);
+													 m_noUniformBuffers, sizeof(UniformData), true, &m_uniformRing,
+													 m_vkCore.GetPipelineCache(), { WINDOW_WIDTH, WINDOW_HEIGHT });
 	}
 
 
-	void RecordCommandBuffers()
+	void BeginRenderPass(VkCommandBuffer CmdBuf, int ImageIndex, VkSubpassContents Contents)
 	{
 		std::array<VkClearValue, 2> ClearValues{};
 		ClearValues[0].color = { {1.0f, 0.0f, 0.0f, 1.0f} };
@@ -275,6 +755,7 @@ private:
 			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
 			.pNext = NULL,
 			.renderPass = m_renderPass,
+			.framebuffer = m_frameBuffers[ImageIndex],
 			.renderArea = {
 				.offset = {
 					.x = 0,
@@ -289,24 +770,38 @@ private:
 			.pClearValues = ClearValues.data()
 		};
 
+		vkCmdBeginRenderPass(CmdBuf, &RenderPassBeginInfo, Contents);
+	}
+
+
+	void RecordCommandBuffers()
+	{
 		for (uint i = 0; i < m_cmdBufs.size(); i++) {
 			OgldevVK::BeginCommandBuffer(m_cmdBufs[i], VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT); 
 
-			RenderPassBeginInfo.framebuffer = m_frameBuffers[i];
-	
-			vkCmdBeginRenderPass(m_cmdBufs[i], &RenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			// No-ops unless the timer was created
+			m_gpuTimer.BeginFrame(m_cmdBufs[i], i);
+			m_gpuTimer.BeginPass(m_cmdBufs[i], i, m_scenePass);
+
+			BeginRenderPass(m_cmdBufs[i], i, VK_SUBPASS_CONTENTS_INLINE);
 	
-			m_pPipeline->Bind(m_cmdBufs[i], i);
+			m_pPipeline->Bind(m_cmdBufs[i], i, m_uniformRing.GetFrameOffset(i));
 
-			u32 VertexCount = 9;
-			u32 InstanceCount = 1;
-			u32 FirstVertex = 0;
-			u32 FirstInstance = 0;
+			if (m_pModelFilename) {
+				m_model.RecordCommandBuffer(m_cmdBufs[i]);
+			} else {
+				u32 VertexCount = 9;
+				u32 InstanceCount = 1;
+				u32 FirstVertex = 0;
+				u32 FirstInstance = 0;
 
-			vkCmdDraw(m_cmdBufs[i], VertexCount, InstanceCount, FirstVertex, FirstInstance);
+				vkCmdDraw(m_cmdBufs[i], VertexCount, InstanceCount, FirstVertex, FirstInstance);
+			}
 
 			vkCmdEndRenderPass(m_cmdBufs[i]);
 
+			m_gpuTimer.EndPass(m_cmdBufs[i], i, m_scenePass);
+
 			VkResult res = vkEndCommandBuffer(m_cmdBufs[i]);
 			CHECK_VK_RESULT(res, "vkEndCommandBuffer\n");
 		}
@@ -325,7 +820,8 @@ private:
 		glm::mat4 VP = m_pGameCamera->GetVPMatrix();
 
 		glm::mat4 WVP = VP;// *Rotate;
-		m_uniformBuffers[ImageIndex].Update(m_device, &WVP, sizeof(WVP));
+		m_uniformRing.BeginFrame(ImageIndex);
+		m_uniformRing.Push(&WVP, sizeof(WVP));
 	}
 
 	GLFWwindow* m_pWindow = NULL;
@@ -333,6 +829,7 @@ private:
 	OgldevVK::VulkanQueue* m_pQueue = NULL;
 	VkDevice m_device = NULL;
 	int m_numImages = 0;
+	int m_numFramesInFlight = 0;
 	std::vector<VkCommandBuffer> m_cmdBufs;
 	VkRenderPass m_renderPass = VK_NULL_HANDLE;
 	std::vector<VkFramebuffer> m_frameBuffers;
@@ -340,7 +837,14 @@ private:
 	VkShaderModule m_fs = VK_NULL_HANDLE;
 	OgldevVK::GraphicsPipeline* m_pPipeline = NULL;
 	OgldevVK::SimpleMesh m_mesh;
-	std::vector<OgldevVK::BufferAndMemory> m_uniformBuffers;
+	OgldevVK::VulkanModel m_model;
+	const char* m_pModelFilename = NULL;
+	bool m_bindless = false;
+	bool m_headless = false;
+	OgldevVK::VulkanGpuTimer m_gpuTimer;
+	int m_scenePass = 0;
+	std::vector<OgldevVK::BufferAndMemory> m_noUniformBuffers;	// the uniforms come from the ring buffer
+	OgldevVK::UniformRingBuffer m_uniformRing;
 	GLMCameraFirstPerson* m_pGameCamera = NULL;
 	int m_windowWidth = 0;
 	int m_windowHeight = 0;
@@ -349,11 +853,93 @@ private:
 
 #define APP_NAME "Tutorial 19"
 
+static void PrintUsage()
+{
+	printf("Usage: tutorial19 [-frames_in_flight N] [-model <file> [-bindless]]\n");
+	printf("                  [-bench_uniforms | -stress_allocator | -bench_uploads | -bench_pipelines | -bench_recording]\n");
+	printf("                  [-headless [-frames N] [-output <file.png>]]\n");
+	printf("-headless renders without a window, e.g. on a CI machine using lavapipe:\n");
+	printf("    VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json ./tutorial19 -headless -frames 100 -output frame.png\n");
+	printf("Compare -frames_in_flight 1 against 2 or 3 with lavapipe to see the CPU/GPU overlap\n");
+}
+
+
 int main(int argc, char* argv[])
 {
+	int NumFramesInFlight = DEFAULT_NUM_FRAMES_IN_FLIGHT;
+	bool BenchUniforms = false;
+	bool StressAllocator = false;
+	bool BenchUploads = false;
+	bool BenchPipelines = false;
+	const char* pModelFilename = NULL;
+	bool BenchRecording = false;
+	bool Bindless = false;
+	bool Headless = false;
+	int NumHeadlessFrames = DEFAULT_NUM_HEADLESS_FRAMES;
+	const char* pOutputFilename = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-frames_in_flight") == 0) && (i + 1 < argc)) {
+			NumFramesInFlight = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-bench_uniforms") == 0) {
+			BenchUniforms = true;
+		} else if (strcmp(argv[i], "-stress_allocator") == 0) {
+			StressAllocator = true;
+		} else if (strcmp(argv[i], "-bench_uploads") == 0) {
+			BenchUploads = true;
+		} else if (strcmp(argv[i], "-bench_pipelines") == 0) {
+			BenchPipelines = true;
+		} else if ((strcmp(argv[i], "-model") == 0) && (i + 1 < argc)) {
+			pModelFilename = argv[++i];
+		} else if (strcmp(argv[i], "-bench_recording") == 0) {
+			BenchRecording = true;
+		} else if (strcmp(argv[i], "-bindless") == 0) {
+			Bindless = true;
+		} else if (strcmp(argv[i], "-headless") == 0) {
+			Headless = true;
+		} else if ((strcmp(argv[i], "-frames") == 0) && (i + 1 < argc)) {
+			NumHeadlessFrames = atoi(argv[++i]);
+		} else if ((strcmp(argv[i], "-output") == 0) && (i + 1 < argc)) {
+			pOutputFilename = argv[++i];
+		} else {
+			PrintUsage();
+			return (strcmp(argv[i], "-help") == 0) ? 0 : 1;
+		}
+	}
+
 	VulkanApp App(WINDOW_WIDTH, WINDOW_HEIGHT);
 
-	App.Init(APP_NAME);
+	App.Init(APP_NAME, NumFramesInFlight, pModelFilename, Bindless, Headless);
+
+	if (BenchUniforms) {
+		App.RunUniformBenchmark();
+		return 0;
+	}
+
+	if (StressAllocator) {
+		App.RunAllocatorStressTest();
+		return 0;
+	}
+
+	if (BenchUploads) {
+		App.RunUploadBenchmark();
+		return 0;
+	}
+
+	if (BenchPipelines) {
+		App.RunPipelineBenchmark();
+		return 0;
+	}
+
+	if (BenchRecording) {
+		App.RunRecordingBenchmark();
+		return 0;
+	}
+
+	if (Headless) {
+		App.RunHeadless(NumHeadlessFrames, pOutputFilename);
+		return 0;
+	}
 
 	App.Execute();
 
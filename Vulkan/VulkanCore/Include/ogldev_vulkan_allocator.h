@@ -0,0 +1,142 @@
+/*
+		Copyright 2024 Etay Meiri
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <vector>
+#include <set>
+#include <mutex>
+
+#include <vulkan/vulkan.h>
+
+#include "ogldev_types.h"
+
+#define DEFAULT_MEMORY_BLOCK_SIZE (64 * 1024 * 1024)	// must be MIN_SUB_ALLOCATION_SIZE times a power of two
+#define MIN_SUB_ALLOCATION_SIZE 256
+
+namespace OgldevVK {
+
+struct VulkanAllocation {
+	VkDeviceMemory m_mem = VK_NULL_HANDLE;
+	VkDeviceSize m_offset = 0;
+	VkDeviceSize m_size = 0;		// requested size
+	void* m_pMappedMem = NULL;		// only for host visible memory
+	int m_poolIndex = -1;
+	int m_blockIndex = -1;			// -1 for a dedicated allocation
+	int m_order = 0;				// the sub allocation is MIN_SUB_ALLOCATION_SIZE << m_order bytes
+};
+
+
+struct VulkanAllocatorStats {
+	int NumBlocks = 0;
+	int NumEmptyBlocks = 0;
+	int NumDedicatedAllocations = 0;
+	int NumAllocations = 0;				// live allocations including the dedicated ones
+	VkDeviceSize BytesReserved = 0;		// total size of the VkDeviceMemory objects
+	VkDeviceSize BytesUsed = 0;			// requested by the live allocations
+	VkDeviceSize BytesWasted = 0;		// rounding of the sub allocations to a power of two
+	VkDeviceSize LargestFreeRange = 0;
+	long long NumDeviceAllocations = 0;	// total number of vkAllocateMemory calls
+};
+
+
+//
+// Allocates a few large VkDeviceMemory blocks per memory type and sub-allocates
+// them with a buddy allocator. Every sub allocation is a power of two which
+// is aligned to its size so any alignment up to the size is satisfied for free.
+// Resources larger than half a block get a dedicated allocation.
+// Linear resources (buffers) and optimal images use separate pools so they never
+// share a page (bufferImageGranularity).
+// Host visible blocks are mapped once when they are created and stay mapped.
+// Thread safe.
+//
+class VulkanMemoryAllocator {
+
+public:
+	VulkanMemoryAllocator() {}
+	~VulkanMemoryAllocator() {}
+
+	void Init(VkDevice Device, const VkPhysicalDeviceMemoryProperties& MemProps,
+			  VkDeviceSize BlockSize = DEFAULT_MEMORY_BLOCK_SIZE);
+
+	void Destroy();
+
+	void Allocate(const VkMemoryRequirements& MemReqs, u32 MemoryTypeIndex, bool IsLinear, VulkanAllocation& Alloc);
+
+	void Free(VulkanAllocation& Alloc);
+
+	VulkanAllocatorStats GetStats() const;
+
+	void PrintStats() const;
+
+	// Defragmentation hooks. The allocator can't move resources by itself because
+	// the buffers/images and the descriptors that point to them belong to the caller.
+	// The caller can recreate the resources for which IsDefragCandidate returns true
+	// and then call ReleaseEmptyBlocks to give the memory back to the driver.
+
+	// True if the allocation lives in a block which is less than MaxBlockUsage (0..1) full
+	bool IsDefragCandidate(const VulkanAllocation& Alloc, float MaxBlockUsage) const;
+
+	// Frees the device memory of the blocks without allocations. Returns the number of blocks released.
+	int ReleaseEmptyBlocks();
+
+	// Checks the free lists against the live allocations - for the stress test
+	bool Validate() const;
+
+private:
+
+	struct Block {
+		VkDeviceMemory Mem = VK_NULL_HANDLE;	// VK_NULL_HANDLE when the slot is free
+		u8* pMappedMem = NULL;
+		std::vector<std::set<VkDeviceSize>> FreeLists;	// offsets of the free ranges of every order
+		int NumAllocations = 0;
+		VkDeviceSize BytesUsed = 0;		// sum of the sizes of the buddy ranges in use
+	};
+
+	struct Pool {
+		std::vector<Block> Blocks;
+	};
+
+	int GetPoolIndex(u32 MemoryTypeIndex, bool IsLinear) const { return MemoryTypeIndex * 2 + (IsLinear ? 0 : 1); }
+
+	u32 GetMemoryTypeIndex(int PoolIndex) const { return PoolIndex / 2; }
+
+	VkDeviceMemory AllocateDeviceMemory(VkDeviceSize Size, u32 MemoryTypeIndex, u8** ppMappedMem);
+
+	void FreeDeviceMemory(VkDeviceMemory Mem, u8* pMappedMem);
+
+	int CreateBlock(Pool& P, u32 MemoryTypeIndex);
+
+	bool AllocateFromBlock(Block& B, int Order, VkDeviceSize& Offset);
+
+	void FreeToBlock(Block& B, VkDeviceSize Offset, int Order);
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties m_memProps = {};
+	VkDeviceSize m_blockSize = 0;
+	int m_maxOrder = 0;
+	std::vector<Pool> m_pools;
+	int m_numDedicatedAllocations = 0;
+	VkDeviceSize m_dedicatedBytes = 0;
+	long long m_numDeviceAllocations = 0;
+	int m_numAllocations = 0;
+	VkDeviceSize m_bytesRequested = 0;
+	mutable std::mutex m_mutex;
+};
+
+}
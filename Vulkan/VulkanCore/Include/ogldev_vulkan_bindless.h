@@ -0,0 +1,80 @@
+/*
+		Copyright 2024 Etay Meiri
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "ogldev_types.h"
+
+#define DEFAULT_MAX_BINDLESS_TEXTURES 4096
+
+// Set 0 belongs to GraphicsPipeline
+#define BINDLESS_TEXTURES_SET 1
+
+namespace OgldevVK {
+
+class VulkanTexture;
+
+//
+// A single descriptor set with one large array of combined image samplers which
+// holds every texture that is added to it. Shaders select the texture using an
+// index which comes from a push constant or a storage buffer, so switching the
+// texture between draws doesn't require another descriptor set. The binding is
+// partially bound so unused slots don't need a valid descriptor, and it is
+// update-after-bind so new textures can be added while command buffers which
+// use the set are recorded or executed (as long as they don't use the new slot).
+// Requires the descriptor indexing features - see VulkanCore::IsBindlessSupported.
+//
+class VulkanBindlessTextures {
+public:
+	VulkanBindlessTextures() {}
+
+	~VulkanBindlessTextures() {}
+
+	// MaxTextures is clamped to the sampler limits of the device
+	void Init(VkDevice Device, const VkPhysicalDeviceLimits& Limits, u32 MaxTextures = DEFAULT_MAX_BINDLESS_TEXTURES);
+
+	void Destroy();
+
+	// Writes the texture into the next free slot and returns its index
+	u32 AddTexture(const VulkanTexture& Tex);
+
+	// Binds the set as BINDLESS_TEXTURES_SET
+	void Bind(VkCommandBuffer CmdBuf, VkPipelineLayout PipelineLayout) const;
+
+	VkDescriptorSetLayout GetSetLayout() const { return m_setLayout; }
+
+	VkDescriptorSet GetSet() const { return m_set; }
+
+	u32 GetNumTextures() const { return m_numTextures; }
+
+	u32 GetMaxTextures() const { return m_maxTextures; }
+
+private:
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	VkDescriptorSetLayout m_setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool m_pool = VK_NULL_HANDLE;
+	VkDescriptorSet m_set = VK_NULL_HANDLE;
+	u32 m_maxTextures = 0;
+	u32 m_numTextures = 0;
+};
+
+}
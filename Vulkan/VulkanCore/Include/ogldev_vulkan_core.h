@@ -26,6 +26,13 @@
 #include "ogldev_vulkan_util.h"
 #include "ogldev_vulkan_device.h"
 #include "ogldev_vulkan_queue.h"
+#include "ogldev_vulkan_allocator.h"
+#include "ogldev_vulkan_uploader.h"
+#include "ogldev_vulkan_pipeline_cache.h"
+#include "ogldev_vulkan_bindless.h"
+
+#define DEFAULT_NUM_FRAMES_IN_FLIGHT 2
+#define DEFAULT_NUM_OFFSCREEN_IMAGES 3
 
 namespace OgldevVK {
 
@@ -37,6 +44,8 @@ public:
 	VkBuffer m_buffer = NULL;
 	VkDeviceMemory m_mem = NULL;
 	VkDeviceSize m_allocationSize = 0;
+	VulkanAllocation m_alloc;
+	VulkanMemoryAllocator* m_pAllocator = NULL;	// NULL if m_mem was allocated directly
 
 	void Update(VkDevice Device, const void* pData, size_t Size);
 
@@ -52,11 +61,50 @@ public:
 	VkDeviceMemory m_mem = VK_NULL_HANDLE;
 	VkImageView m_view = VK_NULL_HANDLE;
 	VkSampler m_sampler = VK_NULL_HANDLE;
+	VulkanAllocation m_alloc;
+	VulkanMemoryAllocator* m_pAllocator = NULL;	// NULL if m_mem was allocated directly
 
 	void Destroy(VkDevice Device);
 };
 
 
+//
+// One large host visible buffer which stays mapped for its entire life time and
+// is split into a segment per frame. Per draw constants are sub-allocated by
+// bumping an offset inside the segment of the current frame and are bound using
+// a dynamic uniform buffer offset, so updating them is a memcpy. BeginFrame must
+// only reuse a segment after the GPU is done with it - the frame slot or the image
+// index returned by VulkanQueue::AcquireNextImage are both safe.
+//
+class UniformRingBuffer {
+public:
+	UniformRingBuffer() {}
+
+	void BeginFrame(int FrameIndex);
+
+	// Copies the data into the current frame and returns the dynamic offset
+	u32 Push(const void* pData, size_t Size);
+
+	// Reserves Size bytes in the current frame. The data must be written before the submission.
+	void* Alloc(size_t Size, u32& DynamicOffset);
+
+	// Dynamic offset of the first allocation in the frame
+	u32 GetFrameOffset(int FrameIndex) const { return (u32)(FrameIndex * m_frameSize); }
+
+	VkBuffer GetBuffer() const { return m_buffer.m_buffer; }
+
+	void Destroy(VkDevice Device);
+
+	BufferAndMemory m_buffer;
+	u8* m_pMappedMem = NULL;
+	VkDeviceSize m_alignment = 0;
+	VkDeviceSize m_frameSize = 0;
+	VkDeviceSize m_frameStart = 0;
+	VkDeviceSize m_offset = 0;		// next free byte in the current frame
+	int m_numFrames = 0;
+};
+
+
 class VulkanCore {
 
 public:
@@ -65,7 +113,23 @@ public:
 
 	~VulkanCore();
 
-	void Init(const char* pAppName, GLFWwindow* pWindow, bool DepthEnabled);
+	// NumFramesInFlight is clamped to the number of swap chain images
+	void Init(const char* pAppName, GLFWwindow* pWindow, bool DepthEnabled,
+			  int NumFramesInFlight = DEFAULT_NUM_FRAMES_IN_FLIGHT);
+
+	// Renders into NumImages device local images instead of a swap chain. No window,
+	// surface or presentation engine is used so it runs on machines without a display
+	// (e.g. using the lavapipe software driver). The images are RGBA8 and the render
+	// passes from CreateSimpleRenderPass leave them ready for ReadImage.
+	void InitHeadless(const char* pAppName, int Width, int Height, bool DepthEnabled,
+					  int NumImages = DEFAULT_NUM_OFFSCREEN_IMAGES,
+					  int NumFramesInFlight = DEFAULT_NUM_FRAMES_IN_FLIGHT);
+
+	bool IsHeadless() const { return m_headless; }
+
+	// Headless only. Copies the image into Pixels (RGBA, 8 bits per channel, top row first).
+	// Waits for the queue to be idle. The image must have been rendered at least once.
+	void ReadImage(int ImageIndex, std::vector<u8>& Pixels);
 
 	VkRenderPass CreateSimpleRenderPass();
 
@@ -75,23 +139,61 @@ public:
 
 	VkDevice& GetDevice() { return m_device; }
 
+	const PhysicalDevice& GetPhysicalDevice() const { return m_physDevices.Selected(); }
+
 	int GetNumImages() const { return (int)m_images.size(); }
 
 	const VkImage& GetImage(int Index) const;
 
 	VulkanQueue* GetQueue() { return &m_queue; }
 
+	int GetNumFramesInFlight() const { return m_queue.GetNumFramesInFlight(); }
+
 	u32 GetQueueFamily() const { return m_queueFamily; }
 
 	void CreateCommandBuffers(u32 Count, VkCommandBuffer* pCmdBufs);
 
 	void FreeCommandBuffers(u32 Count, const VkCommandBuffer* pCmdBufs);
 
-	BufferAndMemory CreateVertexBuffer(const void* pVertices, size_t Size);
+	// Without WaitForUpload the copy is only recorded in the current batch of the uploader.
+	// Call GetUploader()->Flush() and wait for the batch before the first use.
+	BufferAndMemory CreateVertexBuffer(const void* pVertices, size_t Size, bool WaitForUpload = true);
+
+	// Same as CreateVertexBuffer for any kind of device local buffer (index, indirect, etc)
+	BufferAndMemory CreateDeviceLocalBuffer(const void* pData, size_t Size, VkBufferUsageFlags Usage,
+											bool WaitForUpload = true);
 
 	std::vector<BufferAndMemory> CreateUniformBuffers(size_t Size);
+
+	// FrameSize is the number of bytes that can be allocated in a single frame
+	void CreateUniformRingBuffer(UniformRingBuffer& Ring, size_t FrameSize, int NumFrames);
 	
-	void CreateTexture(const char* filename, VulkanTexture& Tex);	
+	void CreateTexture(const char* filename, VulkanTexture& Tex, bool WaitForUpload = true);
+
+	// pPixels is RGBA, 8 bits per channel
+	void CreateTextureFromPixels(VulkanTexture& Tex, const void* pPixels, u32 ImageWidth, u32 ImageHeight,
+								 bool WaitForUpload = true);
+
+	// The memory of the buffers and the images is sub-allocated from m_allocator
+	BufferAndMemory CreateBuffer(VkDeviceSize Size, VkBufferUsageFlags Usage, VkMemoryPropertyFlags Properties);
+
+	void CreateImage(VulkanTexture& Tex, u32 ImageWidth, u32 ImageHeight, VkFormat TexFormat, 
+		             VkImageUsageFlags UsageFlags, VkMemoryPropertyFlagBits PropertyFlags);
+
+	VulkanMemoryAllocator& GetAllocator() { return m_allocator; }
+
+	VulkanUploader* GetUploader() { return &m_uploader; }
+
+	VulkanPipelineCache* GetPipelineCache() { return &m_pipelineCache; }
+
+	// True if a single vkCmdDrawIndexedIndirect can execute several draws with a non zero firstInstance
+	bool IsMultiDrawIndirectSupported() const { return m_multiDrawIndirect; }
+
+	// True if the device supports the descriptor indexing features used by VulkanBindlessTextures
+	bool IsBindlessSupported() const { return m_bindlessSupported; }
+
+	// NULL if bindless textures are not supported
+	VulkanBindlessTextures* GetBindlessTextures() { return m_bindlessSupported ? &m_bindlessTextures : NULL; }
 
 private:
 
@@ -100,22 +202,16 @@ private:
 	void CreateSurface();
 	void CreateDevice();
 	void CreateSwapChain();
+	void CreateOffscreenImages(int NumImages);
 	void CreateCommandBufferPool();	
 	BufferAndMemory CreateUniformBuffer(size_t Size);
 	void CreateDepthResources();
+	void CreateUploader();
 
 	u32 GetMemoryTypeIndex(u32 memTypeBits, VkMemoryPropertyFlags memPropFlags);
 
-	void CopyBufferToBuffer(VkBuffer Dst, VkBuffer Src, VkDeviceSize Size);
-
-	BufferAndMemory CreateBuffer(VkDeviceSize Size, VkBufferUsageFlags Usage, VkMemoryPropertyFlags Properties);
-
 	void CreateTextureImageFromData(VulkanTexture& Tex, const void* pPixels, u32 ImageWidth, u32 ImageHeight,
 									VkFormat TexFormat);
-	void CreateImage(VulkanTexture& Tex, u32 ImageWidth, u32 ImageHeight, VkFormat TexFormat, 
-		             VkImageUsageFlags UsageFlags, VkMemoryPropertyFlagBits PropertyFlags);
-	void UpdateTextureImage(VulkanTexture& Tex, u32 ImageWidth, u32 ImageHeight, VkFormat TexFormat, const void* pPixels);
-	void CopyBufferToImage(VkImage Dst, VkBuffer Src, u32 ImageWidth, u32 ImageHeight);
 	void TransitionImageLayout(VkImage& Image, VkFormat Format, VkImageLayout OldLayout, VkImageLayout NewLayout);
 	void SubmitCopyCommand();
 	void GetFramebufferSize(int& Width, int& Height) const;
@@ -126,18 +222,29 @@ private:
 	VkSurfaceKHR m_surface = VK_NULL_HANDLE;
 	VulkanPhysicalDevices m_physDevices;
 	u32 m_queueFamily = 0;
+	u32 m_transferQueueFamily = 0;	// same as m_queueFamily if there is no dedicated transfer queue
 	VkDevice m_device = VK_NULL_HANDLE;
+	VulkanMemoryAllocator m_allocator;
 	VkSurfaceFormatKHR m_swapChainSurfaceFormat = {};
 	VkSwapchainKHR m_swapChain = VK_NULL_HANDLE;
 	std::vector<VkImage> m_images;
 	std::vector<VkImageView> m_imageViews;
 	std::vector<VulkanTexture> m_depthImages;
+	std::vector<VulkanTexture> m_offscreenImages;	// headless only, the views are in m_imageViews
 	VkCommandPool m_cmdBufPool = VK_NULL_HANDLE;
 	VulkanQueue m_queue;
 	VkCommandBuffer m_copyCmdBuf = VK_NULL_HANDLE;
+	BufferAndMemory m_stagingRing;
+	VulkanUploader m_uploader;
+	VulkanPipelineCache m_pipelineCache;
+	VulkanBindlessTextures m_bindlessTextures;
 	int m_windowWidth = 0;
 	int m_windowHeight = 0;
 	bool m_depthEnabled = false;
+	bool m_headless = false;
+	bool m_validationEnabled = false;	// false if the validation layer is not installed
+	bool m_multiDrawIndirect = false;
+	bool m_bindlessSupported = false;
 };
 
 }
\ No newline at end of file
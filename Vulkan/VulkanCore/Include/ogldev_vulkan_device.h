@@ -35,6 +35,7 @@ struct PhysicalDevice {
 	VkPhysicalDeviceMemoryProperties m_memProps;
 	std::vector<VkPresentModeKHR> m_presentModes;
 	VkPhysicalDeviceFeatures m_features;
+	VkPhysicalDeviceDescriptorIndexingFeatures m_descIndexingFeatures;	// all zero if the device doesn't support descriptor indexing
 	VkFormat m_depthFormat;
 };
 
@@ -44,13 +45,21 @@ public:
 	VulkanPhysicalDevices() {}
 	~VulkanPhysicalDevices() {}
 
+	// Surface is VK_NULL_HANDLE in headless mode. The surface properties are left empty
+	// and no queue family supports present.
 	void Init(const VkInstance& Instance, const VkSurfaceKHR& Surface);
 
 	u32 SelectDevice(VkQueueFlags RequiredQueueType, bool SupportsPresent);
 
+	// Queue family of the selected device which supports transfers but not graphics
+	// or compute (usually a DMA engine). -1 if there is none.
+	int FindDedicatedTransferQueueFamily() const;
+
 	const PhysicalDevice& Selected() const;
 
 private:
+	void GetSurfaceProperties(PhysicalDevice& Device, const VkSurfaceKHR& Surface);
+
 	std::vector<PhysicalDevice> m_devices;
 
 	int m_devIndex = -1;
@@ -0,0 +1,103 @@
+/*
+		Copyright 2024 Etay Meiri
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "ogldev_types.h"
+#include "ogldev_vulkan_device.h"
+
+#define DEFAULT_MAX_GPU_TIMER_PASSES 16
+
+namespace OgldevVK {
+
+struct GpuPassStats {
+	std::string Name;
+	int NumSamples = 0;
+	double TotalTime = 0.0;		// milliseconds
+	double MinTime = 0.0;
+	double MaxTime = 0.0;
+};
+
+
+//
+// Measures the GPU time of the passes of a frame using timestamp queries. Every
+// frame (use the image index, like the command buffers) has its own range of
+// queries in a single pool so the results of one frame can be read while the
+// next ones are executed. A pass is the span between BeginPass and EndPass in
+// the command buffer. The results of a frame are only read after the GPU is done
+// with it, so CollectResults never blocks. Everything is a no-op if the queue
+// family doesn't support timestamps.
+//
+class VulkanGpuTimer {
+public:
+	VulkanGpuTimer() {}
+
+	~VulkanGpuTimer() {}
+
+	void Init(VkDevice Device, const PhysicalDevice& PhysDevice, u32 QueueFamily, int NumFrames,
+			  int MaxPasses = DEFAULT_MAX_GPU_TIMER_PASSES);
+
+	void Destroy();
+
+	// Returns the index of the new pass which is used by BeginPass/EndPass
+	int AddPass(const char* pName);
+
+	// Recorded at the start of the command buffer of the frame, outside of a render pass
+	void BeginFrame(VkCommandBuffer CmdBuf, int FrameIndex);
+
+	void BeginPass(VkCommandBuffer CmdBuf, int FrameIndex, int Pass);
+
+	void EndPass(VkCommandBuffer CmdBuf, int FrameIndex, int Pass);
+
+	// Call after the command buffer of the frame was submitted
+	void FrameSubmitted(int FrameIndex);
+
+	// Adds the timings of the last submission of the frame to the stats. The GPU
+	// must be done with it (e.g. after VulkanQueue::AcquireNextImage returns it).
+	void CollectResults(int FrameIndex);
+
+	// Waits for the queue to be idle before calling this one
+	void CollectAllResults();
+
+	const std::vector<GpuPassStats>& GetStats() const { return m_stats; }
+
+	void PrintStats() const;
+
+	bool IsSupported() const { return m_queryPool != VK_NULL_HANDLE; }
+
+private:
+
+	u32 GetQuery(int FrameIndex, int Pass, bool End) const { return (u32)((FrameIndex * m_maxPasses + Pass) * 2 + (End ? 1 : 0)); }
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	VkQueryPool m_queryPool = VK_NULL_HANDLE;
+	int m_numFrames = 0;
+	int m_maxPasses = 0;
+	double m_period = 0.0;			// nanoseconds per tick
+	u64 m_validBitsMask = 0;
+	std::vector<bool> m_pending;	// [frame] submitted but not collected yet
+	std::vector<GpuPassStats> m_stats;
+};
+
+}
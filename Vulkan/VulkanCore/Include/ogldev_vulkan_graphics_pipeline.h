@@ -22,10 +22,14 @@
 #include <GLFW/glfw3.h>
 
 #include "ogldev_vulkan_simple_mesh.h"
+#include "ogldev_vulkan_pipeline_cache.h"
 
 
 namespace OgldevVK {
 
+class VulkanModel;
+class VulkanBindlessTextures;
+
 class GraphicsPipeline {
 
 public:
@@ -39,21 +43,56 @@ public:
 					 int NumImages,
 					 std::vector<BufferAndMemory>& UniformBuffers,
 					 int UniformDataSize,
-					 bool DepthEnabled);
+					 bool DepthEnabled,
+					 const UniformRingBuffer* pUniformRing = NULL,	// replaces UniformBuffers with a dynamic uniform buffer
+					 VulkanPipelineCache* pPipelineCache = NULL,	// shares identical pipelines and caches them on disk
+					 VkExtent2D HeadlessExtent = {});				// size of the viewport if pWindow is NULL
 
+	// Same as above for a model which is rendered using VulkanModel::RecordCommandBuffer.
+	// If the model uses bindless textures the bindless table is bound as set 1.
+	GraphicsPipeline(VkDevice Device,
+					 GLFWwindow* pWindow,
+					 VkRenderPass RenderPass,
+					 VkShaderModule vs,
+					 VkShaderModule fs,
+					 const VulkanModel& Model,
+					 int NumImages,
+					 std::vector<BufferAndMemory>& UniformBuffers,
+					 int UniformDataSize,
+					 bool DepthEnabled,
+					 const UniformRingBuffer* pUniformRing = NULL,
+					 VulkanPipelineCache* pPipelineCache = NULL,
+					 VkExtent2D HeadlessExtent = {});
 
 	~GraphicsPipeline();
 
-	void Bind(VkCommandBuffer CmdBuf, int ImageIndex);
+	// DynamicOffset is only used with a uniform ring buffer
+	void Bind(VkCommandBuffer CmdBuf, int ImageIndex, u32 DynamicOffset = 0);
 
 private:
 
-	void CreateDescriptorPool(int NumImages);
-	void CreateDescriptorSets(const SimpleMesh* pMesh, int NumImages,
-						  	  std::vector<BufferAndMemory>& UniformBuffers, int UniformDataSize);
-	void CreateDescriptorSetLayout(std::vector<BufferAndMemory>& UniformBuffers, int UniformDataSize, VulkanTexture* pTex);
+	// The resources of a SimpleMesh or a VulkanModel which go into the descriptor set
+	struct MeshBindings {
+		VkBuffer VB = VK_NULL_HANDLE;
+		size_t VBSize = 0;
+		std::vector<VulkanTexture*> Textures;		// binding 2 is an array if there is more than one
+		VkBuffer DrawData = VK_NULL_HANDLE;		// optional per-draw data of indirect draws
+		size_t DrawDataSize = 0;
+		const VulkanBindlessTextures* pBindless = NULL;	// bound as BINDLESS_TEXTURES_SET
+	};
+
+	void Init(GLFWwindow* pWindow, VkRenderPass RenderPass, VkShaderModule vs, VkShaderModule fs,
+			  const MeshBindings* pBindings, int NumImages, std::vector<BufferAndMemory>& UniformBuffers,
+			  int UniformDataSize, bool DepthEnabled, const UniformRingBuffer* pUniformRing,
+			  VkExtent2D HeadlessExtent);
+	void CreateDescriptorPool(const MeshBindings& Bindings, int NumImages, bool HasUniforms);
+	void CreateDescriptorSets(const MeshBindings& Bindings, int NumImages,
+						  	  std::vector<BufferAndMemory>& UniformBuffers, int UniformDataSize,
+							  const UniformRingBuffer* pUniformRing);
+	void CreateDescriptorSetLayout(const MeshBindings& Bindings, bool HasUniforms);
 	void AllocateDescriptorSets(int NumImages);
-	void UpdateDescriptorSets(const SimpleMesh* pMesh, int NumImages, std::vector<BufferAndMemory>& UniformBuffers, int UniformDataSize);
+	void UpdateDescriptorSets(const MeshBindings& Bindings, int NumImages, std::vector<BufferAndMemory>& UniformBuffers, int UniformDataSize,
+							  const UniformRingBuffer* pUniformRing);
 
 	VkDevice m_device = VK_NULL_HANDLE;
 	VkPipeline m_pipeline = VK_NULL_HANDLE;
@@ -61,5 +100,8 @@ private:
 	VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
 	VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
 	std::vector<VkDescriptorSet> m_descriptorSets;
+	bool m_dynamicUniforms = false;
+	VulkanPipelineCache* m_pPipelineCache = NULL;
+	const VulkanBindlessTextures* m_pBindless = NULL;
 };
 }
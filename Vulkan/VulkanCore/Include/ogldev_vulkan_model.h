@@ -0,0 +1,131 @@
+/*
+		Copyright 2024 Etay Meiri
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <vector>
+#include <string>
+
+#include <vulkan/vulkan.h>
+
+#include "ogldev_types.h"
+#include "ogldev_vulkan_core.h"
+
+// Must match the size of the texture array in the fragment shader
+#define MAX_MODEL_TEXTURES 32
+
+struct aiScene;
+struct aiMesh;
+
+namespace OgldevVK {
+
+//
+// The Vulkan counterpart of BasicMesh. The vertices and the indices of all
+// the sub-meshes are merged into a single vertex buffer and a single index
+// buffer in device local memory. Every sub-mesh becomes one command in an
+// indirect draw buffer and its firstInstance is the index of its entry in the
+// per-draw data buffer, so the shaders pick the material of the draw using
+// gl_InstanceIndex. The descriptor set layout is:
+//
+//    binding 0 - vertices (storage buffer)
+//    binding 1 - uniforms
+//    binding 2 - diffuse textures, MAX_MODEL_TEXTURES entries indexed by the material
+//    binding 3 - per-draw data (storage buffer)
+//
+// In bindless mode (SetBindlessTextures) the textures are added to the bindless
+// table instead, binding 2 is omitted and the per-draw data carries the index of
+// the diffuse texture in the table. This also removes the limit on the number of
+// materials. The slots of the table are not released by Destroy.
+//
+class VulkanModel {
+public:
+	VulkanModel() {}
+
+	// Must be called before LoadModel. pBindless is NULL by default.
+	void SetBindlessTextures(VulkanBindlessTextures* pBindless) { m_pBindless = pBindless; }
+
+	// Uses ASSIMP_LOAD_FLAGS
+	bool LoadModel(VulkanCore& VkCore, const char* pFilename);
+
+	bool LoadModel(VulkanCore& VkCore, const char* pFilename, int AssimpFlags);
+
+	// Binds the index buffer and draws all the sub-meshes. The pipeline must already be bound.
+	void RecordCommandBuffer(VkCommandBuffer CmdBuf) const;
+
+	void Destroy(VkDevice Device);
+
+	const BufferAndMemory& GetVertexBuffer() const { return m_vb; }
+
+	size_t GetVertexBufferSize() const { return m_vertexBufferSize; }
+
+	const BufferAndMemory& GetDrawDataBuffer() const { return m_drawDataBuffer; }
+
+	size_t GetDrawDataBufferSize() const { return m_drawDataBufferSize; }
+
+	// Always MAX_MODEL_TEXTURES entries (empty in bindless mode). Materials without a diffuse texture use a white texture.
+	const std::vector<VulkanTexture*>& GetTextures() const { return m_textures; }
+
+	// NULL if the model doesn't use bindless textures
+	const VulkanBindlessTextures* GetBindlessTextures() const { return m_pBindless; }
+
+	int GetNumDraws() const { return (int)m_meshes.size(); }
+
+private:
+
+	struct Vertex {
+		float Position[3];
+		float TexCoords[2];
+		float Normal[3];
+	};
+
+	// Same as BasicMesh::BasicMeshEntry
+	struct VulkanMeshEntry {
+		u32 NumIndices = 0;
+		u32 BaseVertex = 0;
+		u32 BaseIndex = 0;
+		u32 MaterialIndex = 0;
+	};
+
+	// Must match the DrawData struct in the vertex shader
+	struct DrawData {
+		u32 MaterialIndex;
+		u32 TextureIndex;		// slot of the diffuse texture in the bindless table (bindless mode only)
+	};
+
+	void CountVerticesAndIndices(const aiScene* pScene, u32& NumVertices, u32& NumIndices);
+	void InitSingleMesh(const aiMesh* paiMesh, std::vector<Vertex>& Vertices, std::vector<u32>& Indices);
+	bool InitMaterials(VulkanCore& VkCore, const aiScene* pScene, const std::string& Filename);
+	VulkanTexture* LoadDiffuseTexture(VulkanCore& VkCore, const aiScene* pScene, const std::string& Dir, int MaterialIndex);
+	void CreateBuffers(VulkanCore& VkCore, const std::vector<Vertex>& Vertices, const std::vector<u32>& Indices);
+
+	std::vector<VulkanMeshEntry> m_meshes;
+	BufferAndMemory m_vb;
+	size_t m_vertexBufferSize = 0;
+	BufferAndMemory m_ib;
+	BufferAndMemory m_indirectBuffer;
+	BufferAndMemory m_drawDataBuffer;
+	size_t m_drawDataBufferSize = 0;
+	std::vector<VulkanTexture*> m_textures;
+	std::vector<VulkanTexture*> m_loadedTextures;	// owned by the model, m_textures can repeat entries
+	VulkanTexture* m_pDefaultTexture = NULL;
+	VulkanBindlessTextures* m_pBindless = NULL;
+	std::vector<u32> m_materialTextureIndices;		// bindless slot of the diffuse texture of every material
+	bool m_multiDrawIndirect = false;
+};
+
+}
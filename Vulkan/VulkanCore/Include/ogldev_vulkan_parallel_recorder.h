@@ -0,0 +1,97 @@
+/*
+		Copyright 2024 Etay Meiri
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include <vulkan/vulkan.h>
+
+#include "ogldev_types.h"
+
+namespace OgldevVK {
+
+//
+// Records the draws of a render pass on several threads. The draws are split
+// into one contiguous range per thread and every range is recorded into a
+// secondary command buffer which continues the render pass. The primary command
+// buffer of the frame only has to execute them. Command pools can't be used by
+// two threads at the same time and a pool can only be reset after the GPU is done
+// with all of its command buffers, so every thread owns a pool per frame. The
+// calling thread records the first range and the rest are recorded by worker
+// threads which sleep between frames.
+//
+class VulkanParallelRecorder {
+public:
+	VulkanParallelRecorder() {}
+
+	~VulkanParallelRecorder();
+
+	// Records the draws [Start, End) into CmdBuf. The pipeline and the descriptor sets
+	// must be bound again because secondary command buffers don't inherit them.
+	typedef std::function<void(VkCommandBuffer CmdBuf, int ThreadIndex, int Start, int End)> RecordCallback;
+
+	// NumThreads includes the calling thread. NumFrames is the number of sets of command
+	// buffers - use the number of swap chain images and index them by the image index.
+	void Init(VkDevice Device, u32 QueueFamily, int NumThreads, int NumFrames);
+
+	void Destroy();
+
+	// Blocks until all the threads are done. The GPU must be done with the previous
+	// submission of the command buffers of FrameIndex.
+	void Record(int FrameIndex, VkRenderPass RenderPass, VkFramebuffer Framebuffer, int NumDraws,
+				const RecordCallback& Callback);
+
+	// The render pass must begin with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+	void ExecuteCommands(VkCommandBuffer PrimaryCmdBuf, int FrameIndex) const;
+
+	int GetNumThreads() const { return m_numThreads; }
+
+private:
+
+	void WorkerThread(int ThreadIndex);
+
+	void RecordRange(int ThreadIndex);
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	int m_numThreads = 0;
+	int m_numFrames = 0;
+	std::vector<VkCommandPool> m_cmdPools;		// [frame][thread]
+	std::vector<VkCommandBuffer> m_cmdBufs;		// [frame][thread]
+
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_startCond;
+	std::condition_variable m_doneCond;
+	u64 m_job = 0;			// incremented by every call to Record
+	int m_numBusy = 0;		// number of worker threads which are still recording the current job
+	bool m_quit = false;
+
+	// The current job
+	int m_frameIndex = 0;
+	VkRenderPass m_renderPass = VK_NULL_HANDLE;
+	VkFramebuffer m_framebuffer = VK_NULL_HANDLE;
+	int m_numDraws = 0;
+	const RecordCallback* m_pCallback = NULL;
+};
+
+}
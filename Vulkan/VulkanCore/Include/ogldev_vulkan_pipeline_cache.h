@@ -0,0 +1,139 @@
+/*
+		Copyright 2024 Etay Meiri
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <vulkan/vulkan.h>
+
+#include "ogldev_types.h"
+
+#define DEFAULT_PIPELINE_CACHE_FILENAME "pipeline_cache.bin"
+
+namespace OgldevVK {
+
+//
+// Everything GraphicsPipeline varies between pipelines. Two pipelines with the
+// same description are identical so the second one reuses the VkPipeline of the
+// first. The struct is compared and hashed as raw bytes so the constructor
+// clears the padding. The shader modules and the render pass are identified by
+// their handles so they must be released from the cache before they are
+// destroyed (see VulkanPipelineCache::ReleaseShaderModule).
+//
+struct GraphicsPipelineDesc {
+	GraphicsPipelineDesc() { memset(this, 0, sizeof(*this)); }
+
+	VkShaderModule vs;
+	VkShaderModule fs;
+	VkRenderPass RenderPass;
+	u32 Width;
+	u32 Height;
+	u32 DepthEnabled;
+	u32 HasDescriptorSet;	// the bindings of the set are described by the fields below
+	u32 HasUniforms;
+	u32 DynamicUniforms;
+	u32 NumTextures;
+	u32 HasDrawData;
+	VkDescriptorSetLayout BindlessSetLayout;	// set 1, VK_NULL_HANDLE if the pipeline doesn't use bindless textures
+};
+
+
+struct PipelineCacheStats {
+	int NumPipelinesCreated = 0;
+	int NumRegistryHits = 0;
+	double CreateTime = 0.0;		// total time in vkCreateGraphicsPipelines in seconds
+	bool LoadedFromDisk = false;
+};
+
+
+//
+// A VkPipelineCache which is loaded from disk on startup and written back on
+// shutdown, plus a registry of the pipelines created through it. The file is
+// only used if the header written by the driver matches the vendor, the device
+// and the pipeline cache UUID of the current device, otherwise the cache
+// starts empty. The pipelines and their layouts are owned by the registry and
+// are destroyed with it.
+//
+class VulkanPipelineCache {
+
+public:
+	VulkanPipelineCache() {}
+	~VulkanPipelineCache() {}
+
+	void Init(VkDevice Device, const VkPhysicalDeviceProperties& DevProps,
+			  const char* pFilename = DEFAULT_PIPELINE_CACHE_FILENAME);
+
+	// Saves the cache and destroys all the pipelines in the registry
+	void Destroy();
+
+	void Save();
+
+	VkPipelineCache GetHandle() const { return m_cache; }
+
+	// Returns the pipeline and the layout of Desc if they were already created.
+	// Otherwise returns false and the caller creates them using CreatePipeline.
+	bool Find(const GraphicsPipelineDesc& Desc, VkPipeline& Pipeline, VkPipelineLayout& Layout);
+
+	// Creates the pipeline with the cache and adds it and its layout to the registry
+	VkPipeline CreatePipeline(const GraphicsPipelineDesc& Desc, const VkGraphicsPipelineCreateInfo& PipelineInfo);
+
+	// Must be called before destroying a shader module or a render pass which was
+	// used by pipelines of the registry. The driver may reuse the handle value for
+	// a new object so Find must no longer match these pipelines. The pipelines
+	// themselves remain valid until Destroy.
+	void ReleaseShaderModule(VkShaderModule Module);
+
+	void ReleaseRenderPass(VkRenderPass RenderPass);
+
+	const PipelineCacheStats& GetStats() const { return m_stats; }
+
+	void PrintStats() const;
+
+private:
+
+	struct DescHash {
+		size_t operator()(const GraphicsPipelineDesc& Desc) const;
+	};
+
+	struct DescEqual {
+		bool operator()(const GraphicsPipelineDesc& a, const GraphicsPipelineDesc& b) const;
+	};
+
+	struct Entry {
+		VkPipeline Pipeline = VK_NULL_HANDLE;
+		VkPipelineLayout Layout = VK_NULL_HANDLE;
+	};
+
+	bool LoadFile(std::vector<char>& Data) const;
+
+	template<typename Pred> void RetireEntries(Pred ShouldRetire);
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties m_devProps = {};
+	VkPipelineCache m_cache = VK_NULL_HANDLE;
+	std::string m_filename;
+	std::unordered_map<GraphicsPipelineDesc, Entry, DescHash, DescEqual> m_registry;
+	std::vector<Entry> m_retired;	// released from the registry but may still be in use
+	PipelineCacheStats m_stats;
+};
+
+}
@@ -18,6 +18,7 @@
 #pragma once
 
 #include <stdio.h>
+#include <vector>
 
 #include <vulkan/vulkan.h>
 
@@ -25,13 +26,35 @@
 
 namespace OgldevVK {
 
+// Used to measure how much the CPU and the GPU overlap
+struct VulkanQueueStats {
+	long long NumFrames = 0;
+	double FrameTime = 0.0;		// total time between presents in seconds
+	double FenceWaitTime = 0.0;	// total time the CPU was blocked on frame fences in seconds
+};
+
+
+//
+// Up to NumFramesInFlight frames can be queued on the GPU. Each frame slot has its own
+// 'image acquired' semaphore and fence and AcquireNextImage only waits on the fence of
+// the slot being reused. Each swap chain image has its own 'render complete' semaphore
+// and remembers the fence of the last frame that rendered into it so resources which
+// are indexed by the image (command buffers, uniform buffers) are never updated while
+// the GPU is still using them.
+//
+// Without a swap chain (headless) the images are offscreen images owned by VulkanCore.
+// AcquireNextImage hands them out in order, the submissions don't use semaphores and
+// Present only moves to the next frame slot.
+//
 class VulkanQueue {
 
 public:
 	VulkanQueue() {}
 	~VulkanQueue() {}
 
-	void Init(VkDevice Device, VkSwapchainKHR SwapChain, u32 QueueFamily, u32 QueueIndex);
+	// SwapChain is VK_NULL_HANDLE in headless mode
+	void Init(VkDevice Device, VkSwapchainKHR SwapChain, u32 QueueFamily, u32 QueueIndex,
+			  int NumImages, int NumFramesInFlight);
 
 	void Destroy();
 
@@ -45,15 +68,37 @@ public:
 
 	void WaitIdle();
 
+	int GetNumFramesInFlight() const { return (int)m_frames.size(); }
+
+	// Slot of the current frame - use it to index per frame resources
+	int GetFrameIndex() const { return m_frameIndex; }
+
+	const VulkanQueueStats& GetStats() const { return m_stats; }
+
+	void ResetStats() { m_stats = VulkanQueueStats(); }
+
 private:
 
-	void CreateSemaphores();
+	struct FrameSync {
+		VkSemaphore PresentCompleteSem = VK_NULL_HANDLE;
+		VkFence InFlightFence = VK_NULL_HANDLE;
+	};
+
+	void CreateSyncObjects(int NumImages, int NumFramesInFlight);
+
+	void WaitForFence(VkFence Fence);
 
 	VkDevice m_device = VK_NULL_HANDLE;
 	VkSwapchainKHR m_swapChain = VK_NULL_HANDLE;
 	VkQueue m_queue = VK_NULL_HANDLE;
-	VkSemaphore m_renderCompleteSem = VK_NULL_HANDLE;
-	VkSemaphore m_presentCompleteSem = VK_NULL_HANDLE;
+	std::vector<FrameSync> m_frames;
+	std::vector<VkSemaphore> m_renderCompleteSems;	// one per swap chain image
+	std::vector<VkFence> m_imageFences;				// fence of the last frame which used the image
+	int m_frameIndex = 0;
+	u32 m_imageIndex = 0;
+	u32 m_nextImageIndex = 0;		// headless only
+	double m_lastPresentTime = 0.0;
+	VulkanQueueStats m_stats;
 };
 
 }
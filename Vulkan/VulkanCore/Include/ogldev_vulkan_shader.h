@@ -18,10 +18,17 @@
 
 #pragma once
 
+#include <vulkan/vulkan.h>
+
 namespace OgldevVK {
 
 VkShaderModule CreateShaderModuleFromBinary(VkDevice device, const char* pFilename);
 
+// The SPIR-V is cached next to the source ('<pFilename>.spvcache') and glslang only
+// runs when the source or the compile options change
 VkShaderModule CreateShaderModuleFromText(VkDevice device, const char* pFilename);
 
+// Compiles the shader into the cache without creating a module - used by the offline compiler
+bool PrecompileShader(const char* pFilename);
+
 }
\ No newline at end of file
@@ -0,0 +1,140 @@
+/*
+		Copyright 2024 Etay Meiri
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "ogldev_types.h"
+
+#define DEFAULT_STAGING_RING_SIZE (32 * 1024 * 1024)
+#define NUM_UPLOAD_BATCHES 4
+
+namespace OgldevVK {
+
+//
+// Uploads vertex buffers and textures through a persistently mapped staging
+// ring buffer. The copies are recorded into the current batch and many uploads
+// go to the GPU in a single submission when the batch is flushed. Every batch
+// has a fence so the CPU only waits when it needs a specific batch or when the
+// ring is full, instead of draining the queue after every resource.
+//
+// When the device has a transfer-only queue family the copies run on it and the
+// ownership of the resources is handed over to the graphics queue family by a
+// small command buffer on the graphics queue which waits on the transfer
+// submission with a semaphore. The graphics queue keeps rendering meanwhile.
+//
+class VulkanUploader {
+
+public:
+	VulkanUploader() {}
+	~VulkanUploader() {}
+
+	// TransferQueueFamily is the same as GraphicsQueueFamily when there is no dedicated transfer queue.
+	// The staging buffer must be persistently mapped, host coherent and it is owned by the caller.
+	void Init(VkDevice Device, u32 GraphicsQueueFamily, u32 TransferQueueFamily,
+			  VkBuffer StagingBuffer, void* pStagingMem, VkDeviceSize StagingSize);
+
+	void Destroy();
+
+	// The data is copied into the staging ring before the function returns.
+	// Both return the id of the batch which will complete the upload.
+	u64 UploadBuffer(VkBuffer Dst, const void* pData, VkDeviceSize Size);
+
+	// The image must be in VK_IMAGE_LAYOUT_UNDEFINED. It is left in
+	// VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+	u64 UploadImage(VkImage Dst, u32 Width, u32 Height, VkFormat Format, const void* pPixels);
+
+	// Submits the batch being recorded. Returns the id of the last submitted batch.
+	u64 Flush();
+
+	// Non blocking - also releases the staging memory of the batches that are done
+	bool IsComplete(u64 BatchId);
+
+	// Flushes the batch if it is still being recorded
+	void Wait(u64 BatchId);
+
+	void WaitAll();
+
+	bool HasDedicatedTransferQueue() const { return m_transferQueueFamily != m_graphicsQueueFamily; }
+
+	int GetNumSubmissions() const { return m_numSubmissions; }
+
+private:
+
+	enum BATCH_STATE {
+		BATCH_STATE_FREE,
+		BATCH_STATE_RECORDING,
+		BATCH_STATE_SUBMITTED
+	};
+
+	struct Batch {
+		BATCH_STATE State = BATCH_STATE_FREE;
+		u64 Id = 0;
+		VkCommandBuffer TransferCmdBuf = VK_NULL_HANDLE;
+		VkCommandBuffer GraphicsCmdBuf = VK_NULL_HANDLE;	// ownership acquire, only with a dedicated transfer queue
+		VkSemaphore TransferDoneSem = VK_NULL_HANDLE;		// only with a dedicated transfer queue
+		VkFence Fence = VK_NULL_HANDLE;
+		VkDeviceSize StagingUsed = 0;	// bytes of the ring including padding
+		bool HasBufferCopies = false;
+	};
+
+	Batch& BeginRecording();
+
+	u8* AllocStaging(VkDeviceSize Size, VkDeviceSize Alignment, VkDeviceSize& Offset);
+
+	bool TryAllocStaging(VkDeviceSize Size, VkDeviceSize Alignment, VkDeviceSize& Offset);
+
+	void RetireCompleted();
+
+	bool RetireOldest();
+
+	void Retire(Batch& B);
+
+	void ReleaseBuffer(Batch& B, VkBuffer Buffer);
+
+	void ReleaseImage(Batch& B, VkImage Image);
+
+	VkCommandPool CreateCommandPool(u32 QueueFamily);
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	u32 m_graphicsQueueFamily = 0;
+	u32 m_transferQueueFamily = 0;
+	VkQueue m_graphicsQueue = VK_NULL_HANDLE;
+	VkQueue m_transferQueue = VK_NULL_HANDLE;
+	VkCommandPool m_transferCmdPool = VK_NULL_HANDLE;
+	VkCommandPool m_graphicsCmdPool = VK_NULL_HANDLE;
+
+	VkBuffer m_stagingBuffer = VK_NULL_HANDLE;
+	u8* m_pStagingMem = NULL;
+	VkDeviceSize m_ringSize = 0;
+	VkDeviceSize m_head = 0;	// next free byte
+	VkDeviceSize m_tail = 0;	// start of the oldest batch which is still using the ring
+	VkDeviceSize m_used = 0;	// m_head == (m_tail + m_used) % m_ringSize
+
+	Batch m_batches[NUM_UPLOAD_BATCHES];
+	int m_curBatch = 0;
+	u64 m_nextBatchId = 1;
+	u64 m_lastSubmittedId = 0;
+	u64 m_lastCompletedId = 0;
+	int m_numSubmissions = 0;
+};
+
+}
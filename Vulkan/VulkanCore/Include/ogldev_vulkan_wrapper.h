@@ -30,6 +30,8 @@ void BeginCommandBuffer(VkCommandBuffer CommandBuffer, VkCommandBufferUsageFlags
 
 VkSemaphore CreateSemaphore(VkDevice Device);
 
+VkFence CreateFence(VkDevice Device, bool Signaled);
+
 void ImageMemBarrier(VkCommandBuffer CmdBuf, VkImage Image, VkFormat Format,
 					 VkImageLayout OldLayout, VkImageLayout NewLayout);
 
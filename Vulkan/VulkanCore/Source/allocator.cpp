@@ -0,0 +1,415 @@
+/*
+		Copyright 2024 Etay Meiri
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+
+#include "ogldev_vulkan_util.h"
+#include "ogldev_vulkan_allocator.h"
+
+namespace OgldevVK {
+
+static int CalcOrder(VkDeviceSize Size)
+{
+	int Order = 0;
+
+	while (((VkDeviceSize)MIN_SUB_ALLOCATION_SIZE << Order) < Size) {
+		Order++;
+	}
+
+	return Order;
+}
+
+
+void VulkanMemoryAllocator::Init(VkDevice Device, const VkPhysicalDeviceMemoryProperties& MemProps, VkDeviceSize BlockSize)
+{
+	m_device = Device;
+	m_memProps = MemProps;
+	m_maxOrder = CalcOrder(BlockSize);
+	m_blockSize = (VkDeviceSize)MIN_SUB_ALLOCATION_SIZE << m_maxOrder;
+
+	if (m_blockSize != BlockSize) {
+		printf("Memory block size %lld is not a power of two - using %lld\n", (long long)BlockSize, (long long)m_blockSize);
+	}
+
+	m_pools.resize(m_memProps.memoryTypeCount * 2);
+
+	printf("Memory allocator: blocks of %lld MB\n", (long long)(m_blockSize / (1024 * 1024)));
+}
+
+
+void VulkanMemoryAllocator::Destroy()
+{
+	std::lock_guard<std::mutex> Lock(m_mutex);
+
+	if (m_numAllocations > 0) {
+		printf("Memory allocator destroyed with %d live allocations\n", m_numAllocations);
+	}
+
+	for (int p = 0; p < m_pools.size(); p++) {
+		for (int b = 0; b < m_pools[p].Blocks.size(); b++) {
+			Block& B = m_pools[p].Blocks[b];
+
+			if (B.Mem) {
+				FreeDeviceMemory(B.Mem, B.pMappedMem);
+			}
+		}
+	}
+
+	m_pools.clear();
+}
+
+
+VkDeviceMemory VulkanMemoryAllocator::AllocateDeviceMemory(VkDeviceSize Size, u32 MemoryTypeIndex, u8** ppMappedMem)
+{
+	VkMemoryAllocateInfo MemAllocInfo = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.pNext = NULL,
+		.allocationSize = Size,
+		.memoryTypeIndex = MemoryTypeIndex
+	};
+
+	VkDeviceMemory Mem = VK_NULL_HANDLE;
+	VkResult res = vkAllocateMemory(m_device, &MemAllocInfo, NULL, &Mem);
+	CHECK_VK_RESULT(res, "vkAllocateMemory\n");
+
+	m_numDeviceAllocations++;
+
+	*ppMappedMem = NULL;
+
+	if (m_memProps.memoryTypes[MemoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		void* pMem = NULL;
+		res = vkMapMemory(m_device, Mem, 0, VK_WHOLE_SIZE, 0, &pMem);
+		CHECK_VK_RESULT(res, "vkMapMemory\n");
+		*ppMappedMem = (u8*)pMem;
+	}
+
+	return Mem;
+}
+
+
+void VulkanMemoryAllocator::FreeDeviceMemory(VkDeviceMemory Mem, u8* pMappedMem)
+{
+	if (pMappedMem) {
+		vkUnmapMemory(m_device, Mem);
+	}
+
+	vkFreeMemory(m_device, Mem, NULL);
+}
+
+
+int VulkanMemoryAllocator::CreateBlock(Pool& P, u32 MemoryTypeIndex)
+{
+	int BlockIndex = -1;
+
+	// Reuse the slot of a released block so the block indices of the live allocations don't change
+	for (int i = 0; i < P.Blocks.size(); i++) {
+		if (P.Blocks[i].Mem == VK_NULL_HANDLE) {
+			BlockIndex = i;
+			break;
+		}
+	}
+
+	if (BlockIndex == -1) {
+		BlockIndex = (int)P.Blocks.size();
+		P.Blocks.resize(BlockIndex + 1);
+	}
+
+	Block& B = P.Blocks[BlockIndex];
+	B.Mem = AllocateDeviceMemory(m_blockSize, MemoryTypeIndex, &B.pMappedMem);
+	B.FreeLists.clear();
+	B.FreeLists.resize(m_maxOrder + 1);
+	B.FreeLists[m_maxOrder].insert(0);
+	B.NumAllocations = 0;
+	B.BytesUsed = 0;
+
+	return BlockIndex;
+}
+
+
+bool VulkanMemoryAllocator::AllocateFromBlock(Block& B, int Order, VkDeviceSize& Offset)
+{
+	int CurOrder = Order;
+
+	while ((CurOrder <= m_maxOrder) && B.FreeLists[CurOrder].empty()) {
+		CurOrder++;
+	}
+
+	if (CurOrder > m_maxOrder) {
+		return false;
+	}
+
+	Offset = *B.FreeLists[CurOrder].begin();
+	B.FreeLists[CurOrder].erase(B.FreeLists[CurOrder].begin());
+
+	// Split the range and return the upper halves to the free lists
+	while (CurOrder > Order) {
+		CurOrder--;
+		B.FreeLists[CurOrder].insert(Offset + ((VkDeviceSize)MIN_SUB_ALLOCATION_SIZE << CurOrder));
+	}
+
+	B.NumAllocations++;
+	B.BytesUsed += (VkDeviceSize)MIN_SUB_ALLOCATION_SIZE << Order;
+
+	return true;
+}
+
+
+void VulkanMemoryAllocator::FreeToBlock(Block& B, VkDeviceSize Offset, int Order)
+{
+	B.NumAllocations--;
+	B.BytesUsed -= (VkDeviceSize)MIN_SUB_ALLOCATION_SIZE << Order;
+
+	// Merge with the buddy as long as it is free
+	while (Order < m_maxOrder) {
+		VkDeviceSize Buddy = Offset ^ ((VkDeviceSize)MIN_SUB_ALLOCATION_SIZE << Order);
+
+		if (B.FreeLists[Order].erase(Buddy) == 0) {
+			break;
+		}
+
+		if (Buddy < Offset) {
+			Offset = Buddy;
+		}
+
+		Order++;
+	}
+
+	B.FreeLists[Order].insert(Offset);
+}
+
+
+void VulkanMemoryAllocator::Allocate(const VkMemoryRequirements& MemReqs, u32 MemoryTypeIndex, bool IsLinear, VulkanAllocation& Alloc)
+{
+	std::lock_guard<std::mutex> Lock(m_mutex);
+
+	if (MemoryTypeIndex >= m_memProps.memoryTypeCount) {
+		printf("%s:%d - invalid memory type %d\n", __FILE__, __LINE__, MemoryTypeIndex);
+		exit(1);
+	}
+
+	Alloc = VulkanAllocation();
+	Alloc.m_size = MemReqs.size;
+	Alloc.m_poolIndex = GetPoolIndex(MemoryTypeIndex, IsLinear);
+
+	m_numAllocations++;
+	m_bytesRequested += MemReqs.size;
+
+	VkDeviceSize Size = (MemReqs.size > MemReqs.alignment) ? MemReqs.size : MemReqs.alignment;
+
+	if (Size > m_blockSize / 2) {
+		u8* pMappedMem = NULL;
+		Alloc.m_mem = AllocateDeviceMemory(MemReqs.size, MemoryTypeIndex, &pMappedMem);
+		Alloc.m_pMappedMem = pMappedMem;
+		m_numDedicatedAllocations++;
+		m_dedicatedBytes += MemReqs.size;
+		return;
+	}
+
+	Alloc.m_order = CalcOrder(Size);
+
+	Pool& P = m_pools[Alloc.m_poolIndex];
+	VkDeviceSize Offset = 0;
+
+	for (int i = 0; i < P.Blocks.size(); i++) {
+		if (P.Blocks[i].Mem && AllocateFromBlock(P.Blocks[i], Alloc.m_order, Offset)) {
+			Alloc.m_blockIndex = i;
+			break;
+		}
+	}
+
+	if (Alloc.m_blockIndex == -1) {
+		Alloc.m_blockIndex = CreateBlock(P, MemoryTypeIndex);
+		AllocateFromBlock(P.Blocks[Alloc.m_blockIndex], Alloc.m_order, Offset);
+	}
+
+	Block& B = P.Blocks[Alloc.m_blockIndex];
+	Alloc.m_mem = B.Mem;
+	Alloc.m_offset = Offset;
+	Alloc.m_pMappedMem = B.pMappedMem ? B.pMappedMem + Offset : NULL;
+}
+
+
+void VulkanMemoryAllocator::Free(VulkanAllocation& Alloc)
+{
+	if (Alloc.m_mem == VK_NULL_HANDLE) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> Lock(m_mutex);
+
+	m_numAllocations--;
+	m_bytesRequested -= Alloc.m_size;
+
+	if (Alloc.m_blockIndex == -1) {
+		FreeDeviceMemory(Alloc.m_mem, (u8*)Alloc.m_pMappedMem);
+		m_numDedicatedAllocations--;
+		m_dedicatedBytes -= Alloc.m_size;
+	} else {
+		// Empty blocks are kept around until ReleaseEmptyBlocks to avoid
+		// allocating and freeing device memory when a resource is recreated
+		FreeToBlock(m_pools[Alloc.m_poolIndex].Blocks[Alloc.m_blockIndex], Alloc.m_offset, Alloc.m_order);
+	}
+
+	Alloc = VulkanAllocation();
+}
+
+
+int VulkanMemoryAllocator::ReleaseEmptyBlocks()
+{
+	std::lock_guard<std::mutex> Lock(m_mutex);
+
+	int NumReleased = 0;
+
+	for (int p = 0; p < m_pools.size(); p++) {
+		for (int b = 0; b < m_pools[p].Blocks.size(); b++) {
+			Block& B = m_pools[p].Blocks[b];
+
+			if (B.Mem && (B.NumAllocations == 0)) {
+				FreeDeviceMemory(B.Mem, B.pMappedMem);
+				B = Block();
+				NumReleased++;
+			}
+		}
+	}
+
+	return NumReleased;
+}
+
+
+bool VulkanMemoryAllocator::IsDefragCandidate(const VulkanAllocation& Alloc, float MaxBlockUsage) const
+{
+	if (Alloc.m_blockIndex == -1) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> Lock(m_mutex);
+
+	const Block& B = m_pools[Alloc.m_poolIndex].Blocks[Alloc.m_blockIndex];
+
+	return ((float)B.BytesUsed / (float)m_blockSize) < MaxBlockUsage;
+}
+
+
+VulkanAllocatorStats VulkanMemoryAllocator::GetStats() const
+{
+	std::lock_guard<std::mutex> Lock(m_mutex);
+
+	VulkanAllocatorStats Stats;
+
+	VkDeviceSize SubAllocatedBytes = 0;
+
+	for (int p = 0; p < m_pools.size(); p++) {
+		for (int b = 0; b < m_pools[p].Blocks.size(); b++) {
+			const Block& B = m_pools[p].Blocks[b];
+
+			if (!B.Mem) {
+				continue;
+			}
+
+			Stats.NumBlocks++;
+
+			if (B.NumAllocations == 0) {
+				Stats.NumEmptyBlocks++;
+			}
+
+			SubAllocatedBytes += B.BytesUsed;
+
+			for (int Order = m_maxOrder; Order >= 0; Order--) {
+				if (!B.FreeLists[Order].empty()) {
+					VkDeviceSize Size = (VkDeviceSize)MIN_SUB_ALLOCATION_SIZE << Order;
+
+					if (Size > Stats.LargestFreeRange) {
+						Stats.LargestFreeRange = Size;
+					}
+
+					break;
+				}
+			}
+		}
+	}
+
+	Stats.NumDedicatedAllocations = m_numDedicatedAllocations;
+	Stats.NumAllocations = m_numAllocations;
+	Stats.BytesReserved = Stats.NumBlocks * m_blockSize + m_dedicatedBytes;
+	Stats.BytesUsed = m_bytesRequested;
+	Stats.BytesWasted = SubAllocatedBytes - (m_bytesRequested - m_dedicatedBytes);
+	Stats.NumDeviceAllocations = m_numDeviceAllocations;
+
+	return Stats;
+}
+
+
+void VulkanMemoryAllocator::PrintStats() const
+{
+	VulkanAllocatorStats Stats = GetStats();
+
+	printf("Memory allocator: %d allocations in %d blocks (%d empty) + %d dedicated\n",
+		   Stats.NumAllocations - Stats.NumDedicatedAllocations, Stats.NumBlocks, Stats.NumEmptyBlocks,
+		   Stats.NumDedicatedAllocations);
+	printf("    reserved %.2f MB, used %.2f MB, lost to rounding %.2f MB, largest free range %.2f MB\n",
+		   Stats.BytesReserved / (1024.0 * 1024.0), Stats.BytesUsed / (1024.0 * 1024.0),
+		   Stats.BytesWasted / (1024.0 * 1024.0), Stats.LargestFreeRange / (1024.0 * 1024.0));
+	printf("    %lld calls to vkAllocateMemory\n", Stats.NumDeviceAllocations);
+}
+
+
+bool VulkanMemoryAllocator::Validate() const
+{
+	std::lock_guard<std::mutex> Lock(m_mutex);
+
+	for (int p = 0; p < m_pools.size(); p++) {
+		for (int b = 0; b < m_pools[p].Blocks.size(); b++) {
+			const Block& B = m_pools[p].Blocks[b];
+
+			if (!B.Mem) {
+				continue;
+			}
+
+			VkDeviceSize FreeBytes = 0;
+
+			for (int Order = 0; Order <= m_maxOrder; Order++) {
+				VkDeviceSize Size = (VkDeviceSize)MIN_SUB_ALLOCATION_SIZE << Order;
+
+				for (std::set<VkDeviceSize>::const_iterator it = B.FreeLists[Order].begin(); it != B.FreeLists[Order].end(); it++) {
+					// Free ranges must be aligned to their size and must not have a free buddy
+					if ((*it % Size) != 0) {
+						printf("Pool %d block %d: free range at %lld of order %d is not aligned\n", p, b, (long long)*it, Order);
+						return false;
+					}
+
+					if ((Order < m_maxOrder) && (B.FreeLists[Order].count(*it ^ Size) > 0)) {
+						printf("Pool %d block %d: free range at %lld of order %d was not merged\n", p, b, (long long)*it, Order);
+						return false;
+					}
+
+					FreeBytes += Size;
+				}
+			}
+
+			if (FreeBytes + B.BytesUsed != m_blockSize) {
+				printf("Pool %d block %d: free %lld + used %lld != block size %lld\n", p, b,
+					   (long long)FreeBytes, (long long)B.BytesUsed, (long long)m_blockSize);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+}
@@ -0,0 +1,155 @@
+/*
+		Copyright 2024 Etay Meiri
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <algorithm>
+
+#include "ogldev_util.h"
+#include "ogldev_vulkan_util.h"
+#include "ogldev_vulkan_core.h"
+#include "ogldev_vulkan_bindless.h"
+
+namespace OgldevVK {
+
+void VulkanBindlessTextures::Init(VkDevice Device, const VkPhysicalDeviceLimits& Limits, u32 MaxTextures)
+{
+	m_device = Device;
+	m_maxTextures = std::min(MaxTextures, std::min(Limits.maxPerStageDescriptorSamplers, Limits.maxDescriptorSetSamplers));
+	m_numTextures = 0;
+
+	VkDescriptorSetLayoutBinding Binding = {
+		.binding = 0,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = m_maxTextures,
+		.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+		.pImmutableSamplers = NULL
+	};
+
+	VkDescriptorBindingFlags BindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+											VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+											VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo BindingFlagsInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+		.pNext = NULL,
+		.bindingCount = 1,
+		.pBindingFlags = &BindingFlags
+	};
+
+	VkDescriptorSetLayoutCreateInfo LayoutInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = &BindingFlagsInfo,
+		.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+		.bindingCount = 1,
+		.pBindings = &Binding
+	};
+
+	VkResult res = vkCreateDescriptorSetLayout(m_device, &LayoutInfo, NULL, &m_setLayout);
+	CHECK_VK_RESULT(res, "vkCreateDescriptorSetLayout\n");
+
+	VkDescriptorPoolSize PoolSize = {
+		.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = m_maxTextures
+	};
+
+	VkDescriptorPoolCreateInfo PoolInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.pNext = NULL,
+		.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+		.maxSets = 1,
+		.poolSizeCount = 1,
+		.pPoolSizes = &PoolSize
+	};
+
+	res = vkCreateDescriptorPool(m_device, &PoolInfo, NULL, &m_pool);
+	CHECK_VK_RESULT(res, "vkCreateDescriptorPool\n");
+
+	VkDescriptorSetAllocateInfo AllocInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = NULL,
+		.descriptorPool = m_pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &m_setLayout
+	};
+
+	res = vkAllocateDescriptorSets(m_device, &AllocInfo, &m_set);
+	CHECK_VK_RESULT(res, "vkAllocateDescriptorSets\n");
+
+	printf("Bindless texture table created with %d slots\n", m_maxTextures);
+}
+
+
+void VulkanBindlessTextures::Destroy()
+{
+	if (m_pool == VK_NULL_HANDLE) {
+		return;
+	}
+
+	// The set is freed with the pool
+	vkDestroyDescriptorPool(m_device, m_pool, NULL);
+	vkDestroyDescriptorSetLayout(m_device, m_setLayout, NULL);
+
+	m_pool = VK_NULL_HANDLE;
+	m_setLayout = VK_NULL_HANDLE;
+	m_set = VK_NULL_HANDLE;
+	m_numTextures = 0;
+}
+
+
+u32 VulkanBindlessTextures::AddTexture(const VulkanTexture& Tex)
+{
+	if (m_numTextures == m_maxTextures) {
+		OGLDEV_ERROR("The bindless texture table is full (%d textures)\n", m_maxTextures);
+		exit(1);
+	}
+
+	u32 Index = m_numTextures;
+
+	VkDescriptorImageInfo ImageInfo = {
+		.sampler = Tex.m_sampler,
+		.imageView = Tex.m_view,
+		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	};
+
+	VkWriteDescriptorSet WriteDescriptorSet = {
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.pNext = NULL,
+		.dstSet = m_set,
+		.dstBinding = 0,
+		.dstArrayElement = Index,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.pImageInfo = &ImageInfo,
+		.pBufferInfo = NULL,
+		.pTexelBufferView = NULL
+	};
+
+	vkUpdateDescriptorSets(m_device, 1, &WriteDescriptorSet, 0, NULL);
+
+	m_numTextures++;
+
+	return Index;
+}
+
+
+void VulkanBindlessTextures::Bind(VkCommandBuffer CmdBuf, VkPipelineLayout PipelineLayout) const
+{
+	vkCmdBindDescriptorSets(CmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineLayout,
+							BINDLESS_TEXTURES_SET, 1, &m_set, 0, NULL);
+}
+
+}
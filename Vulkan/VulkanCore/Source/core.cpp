@@ -62,6 +62,13 @@ VulkanCore::~VulkanCore()
 {
 	printf("-------------------------------\n");
 
+	m_uploader.Destroy();
+	m_stagingRing.Destroy(m_device);
+
+	m_pipelineCache.Destroy();
+
+	m_bindlessTextures.Destroy();
+
 	vkFreeCommandBuffers(m_device, m_cmdBufPool, 1, &m_copyCmdBuf);
 
 	vkDestroyCommandPool(m_device, m_cmdBufPool, NULL);
@@ -78,37 +85,49 @@ VulkanCore::~VulkanCore()
 		}
 	}
 
-	vkDestroySwapchainKHR(m_device, m_swapChain, NULL);
-
-	vkDestroyDevice(m_device, NULL);
+	for (int i = 0; i < (int)m_offscreenImages.size(); i++) {
+		m_offscreenImages[i].Destroy(m_device);
+	}
 
-	PFN_vkDestroySurfaceKHR vkDestroySurface = VK_NULL_HANDLE;
-	vkDestroySurface = (PFN_vkDestroySurfaceKHR)vkGetInstanceProcAddr(m_instance, "vkDestroySurfaceKHR");
-	if (!vkDestroySurface) {
-		OGLDEV_ERROR0("Cannot find address of vkDestroySurfaceKHR\n");
-		exit(1);
+	if (m_swapChain != VK_NULL_HANDLE) {
+		vkDestroySwapchainKHR(m_device, m_swapChain, NULL);
 	}
 
-	vkDestroySurface(m_instance, m_surface, NULL);
+	m_allocator.Destroy();
+
+	vkDestroyDevice(m_device, NULL);
+
+	if (m_surface != VK_NULL_HANDLE) {
+		PFN_vkDestroySurfaceKHR vkDestroySurface = VK_NULL_HANDLE;
+		vkDestroySurface = (PFN_vkDestroySurfaceKHR)vkGetInstanceProcAddr(m_instance, "vkDestroySurfaceKHR");
+		if (!vkDestroySurface) {
+			OGLDEV_ERROR0("Cannot find address of vkDestroySurfaceKHR\n");
+			exit(1);
+		}
 
-	printf("GLFW window surface destroyed\n");
+		vkDestroySurface(m_instance, m_surface, NULL);
 
-	PFN_vkDestroyDebugUtilsMessengerEXT vkDestroyDebugUtilsMessenger = VK_NULL_HANDLE;
-	vkDestroyDebugUtilsMessenger = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(m_instance, "vkDestroyDebugUtilsMessengerEXT");
-	if (!vkDestroyDebugUtilsMessenger) {
-		OGLDEV_ERROR0("Cannot find address of vkDestroyDebugUtilsMessengerEXT\n");
-		exit(1);
+		printf("GLFW window surface destroyed\n");
 	}
-	vkDestroyDebugUtilsMessenger(m_instance, m_debugMessenger, NULL);
 
-	printf("Debug callback destroyed\n");
+	if (m_debugMessenger != VK_NULL_HANDLE) {
+		PFN_vkDestroyDebugUtilsMessengerEXT vkDestroyDebugUtilsMessenger = VK_NULL_HANDLE;
+		vkDestroyDebugUtilsMessenger = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(m_instance, "vkDestroyDebugUtilsMessengerEXT");
+		if (!vkDestroyDebugUtilsMessenger) {
+			OGLDEV_ERROR0("Cannot find address of vkDestroyDebugUtilsMessengerEXT\n");
+			exit(1);
+		}
+		vkDestroyDebugUtilsMessenger(m_instance, m_debugMessenger, NULL);
+
+		printf("Debug callback destroyed\n");
+	}
 
 	vkDestroyInstance(m_instance, NULL);
 	printf("Vulkan instance destroyed\n");
 }
 
 
-void VulkanCore::Init(const char* pAppName, GLFWwindow* pWindow, bool DepthEnabled)
+void VulkanCore::Init(const char* pAppName, GLFWwindow* pWindow, bool DepthEnabled, int NumFramesInFlight)
 {
 	m_pWindow = pWindow;
 	m_depthEnabled = DepthEnabled;
@@ -123,10 +142,44 @@ void VulkanCore::Init(const char* pAppName, GLFWwindow* pWindow, bool DepthEnabl
 	m_physDevices.Init(m_instance, m_surface);
 	m_queueFamily = m_physDevices.SelectDevice(VK_QUEUE_GRAPHICS_BIT, true);
 	CreateDevice();
+	m_allocator.Init(m_device, m_physDevices.Selected().m_memProps);
+	m_pipelineCache.Init(m_device, m_physDevices.Selected().m_devProps);
+	if (m_bindlessSupported) {
+		m_bindlessTextures.Init(m_device, m_physDevices.Selected().m_devProps.limits);
+	}
 	CreateSwapChain();
 	CreateCommandBufferPool();
-	m_queue.Init(m_device, m_swapChain, m_queueFamily, 0);
+	m_queue.Init(m_device, m_swapChain, m_queueFamily, 0, (int)m_images.size(), NumFramesInFlight);
 	CreateCommandBuffers(1, &m_copyCmdBuf);
+	CreateUploader();
+	if (DepthEnabled) {
+		CreateDepthResources();
+	}
+}
+
+
+void VulkanCore::InitHeadless(const char* pAppName, int Width, int Height, bool DepthEnabled,
+							  int NumImages, int NumFramesInFlight)
+{
+	m_headless = true;
+	m_depthEnabled = DepthEnabled;
+	m_windowWidth = Width;
+	m_windowHeight = Height;
+	CreateInstance(pAppName);
+	CreateDebugCallback();
+	m_physDevices.Init(m_instance, VK_NULL_HANDLE);
+	m_queueFamily = m_physDevices.SelectDevice(VK_QUEUE_GRAPHICS_BIT, false);
+	CreateDevice();
+	m_allocator.Init(m_device, m_physDevices.Selected().m_memProps);
+	m_pipelineCache.Init(m_device, m_physDevices.Selected().m_devProps);
+	if (m_bindlessSupported) {
+		m_bindlessTextures.Init(m_device, m_physDevices.Selected().m_devProps.limits);
+	}
+	CreateOffscreenImages(NumImages);
+	CreateCommandBufferPool();
+	m_queue.Init(m_device, VK_NULL_HANDLE, m_queueFamily, 0, (int)m_images.size(), NumFramesInFlight);
+	CreateCommandBuffers(1, &m_copyCmdBuf);
+	CreateUploader();
 	if (DepthEnabled) {
 		CreateDepthResources();
 	}
@@ -143,25 +196,63 @@ const VkImage& VulkanCore::GetImage(int Index) const
 	return m_images[Index];
 }
 
+static bool IsInstanceLayerAvailable(const char* pLayerName)
+{
+	u32 NumLayers = 0;
+	VkResult res = vkEnumerateInstanceLayerProperties(&NumLayers, NULL);
+	CHECK_VK_RESULT(res, "vkEnumerateInstanceLayerProperties (1)\n");
+
+	std::vector<VkLayerProperties> Layers(NumLayers);
+	res = vkEnumerateInstanceLayerProperties(&NumLayers, Layers.data());
+	CHECK_VK_RESULT(res, "vkEnumerateInstanceLayerProperties (2)\n");
+
+	for (u32 i = 0; i < NumLayers; i++) {
+		if (strcmp(Layers[i].layerName, pLayerName) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
 void VulkanCore::CreateInstance(const char* pAppName)
 {
-	std::vector<const char*> Layers = {
-		"VK_LAYER_KHRONOS_validation"
-	};
+	const char* pValidationLayer = "VK_LAYER_KHRONOS_validation";
 
-	std::vector<const char*> Extensions = {
-		VK_KHR_SURFACE_EXTENSION_NAME,
+	// Machines which only have the driver installed (e.g. CI with lavapipe) don't have the layer
+	m_validationEnabled = IsInstanceLayerAvailable(pValidationLayer);
+
+	if (!m_validationEnabled) {
+		printf("%s not found - running without validation\n", pValidationLayer);
+	}
+
+	std::vector<const char*> Layers;
+
+	if (m_validationEnabled) {
+		Layers.push_back(pValidationLayer);
+	}
+
+	std::vector<const char*> Extensions;
+
+	if (!m_headless) {
+		Extensions = {
+			VK_KHR_SURFACE_EXTENSION_NAME,
 #if defined (_WIN32)
-		"VK_KHR_win32_surface",
+			"VK_KHR_win32_surface",
 #endif
 #if defined (__APPLE__)
-		"VK_MVK_macos_surface",
+			"VK_MVK_macos_surface",
 #endif
 #if defined (__linux__)
-		"VK_KHR_xcb_surface",
+			"VK_KHR_xcb_surface",
 #endif
-		VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
-	};
+		};
+	}
+
+	if (m_validationEnabled) {
+		Extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+	}
 
 	VkDebugUtilsMessengerCreateInfoEXT MessengerCreateInfo = {
 		.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
@@ -184,12 +275,12 @@ void VulkanCore::CreateInstance(const char* pAppName)
 		.applicationVersion = VK_MAKE_API_VERSION(0, 1, 0, 0),
 		.pEngineName = "Ogldev Vulkan Tutorials",
 		.engineVersion = VK_MAKE_API_VERSION(0, 1, 0, 0),
-		.apiVersion = VK_API_VERSION_1_0
+		.apiVersion = VK_API_VERSION_1_2		// descriptor indexing is core in 1.2
 	};
 
 	VkInstanceCreateInfo CreateInfo = {
 		.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
-		.pNext = &MessengerCreateInfo,
+		.pNext = m_validationEnabled ? &MessengerCreateInfo : NULL,
 		.flags = 0,				// reserved for future use. Must be zero
 		.pApplicationInfo = &AppInfo,
 		.enabledLayerCount = (u32)(Layers.size()),
@@ -206,6 +297,10 @@ void VulkanCore::CreateInstance(const char* pAppName)
 
 void VulkanCore::CreateDebugCallback()
 {
+	if (!m_validationEnabled) {
+		return;
+	}
+
 	VkDebugUtilsMessengerCreateInfoEXT MessengerCreateInfo = {
 		.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
 		.pNext = NULL,
@@ -256,11 +351,27 @@ void VulkanCore::CreateDevice()
 		.pQueuePriorities = &qPriorities[0]
 	};
 
+	std::vector<VkDeviceQueueCreateInfo> qInfos = { qInfo };
+
+	// Uploads go to a separate queue if the device has a transfer-only family
+	int TransferQueueFamily = m_physDevices.FindDedicatedTransferQueueFamily();
+
+	if (TransferQueueFamily >= 0) {
+		m_transferQueueFamily = (u32)TransferQueueFamily;
+		qInfo.queueFamilyIndex = m_transferQueueFamily;
+		qInfos.push_back(qInfo);
+	} else {
+		m_transferQueueFamily = m_queueFamily;
+	}
+
 	std::vector<const char*> DevExts = {
-		VK_KHR_SWAPCHAIN_EXTENSION_NAME,
 		VK_KHR_SHADER_DRAW_PARAMETERS_EXTENSION_NAME
 	};
 
+	if (!m_headless) {
+		DevExts.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+	}
+
 	if (m_physDevices.Selected().m_features.geometryShader == VK_FALSE) {
 		OGLDEV_ERROR0("The Geometry Shader is not supported!\n");
 	}
@@ -269,16 +380,52 @@ void VulkanCore::CreateDevice()
 		OGLDEV_ERROR0("The Tessellation Shader is not supported!\n");
 	}
 
+	const VkPhysicalDeviceFeatures& Features = m_physDevices.Selected().m_features;
+
 	VkPhysicalDeviceFeatures DeviceFeatures = { 0 };
 	DeviceFeatures.geometryShader = VK_TRUE;
 	DeviceFeatures.tessellationShader = VK_TRUE;
 
+	// Optional - used by VulkanModel to render all the sub-meshes using a single indirect draw
+	DeviceFeatures.multiDrawIndirect = Features.multiDrawIndirect;
+	DeviceFeatures.drawIndirectFirstInstance = Features.drawIndirectFirstInstance;
+	DeviceFeatures.shaderSampledImageArrayDynamicIndexing = Features.shaderSampledImageArrayDynamicIndexing;
+
+	m_multiDrawIndirect = Features.multiDrawIndirect && Features.drawIndirectFirstInstance;
+
+	// Optional - used by VulkanBindlessTextures
+	const VkPhysicalDeviceDescriptorIndexingFeatures& IndexingFeatures = m_physDevices.Selected().m_descIndexingFeatures;
+
+	m_bindlessSupported = IndexingFeatures.runtimeDescriptorArray &&
+						  IndexingFeatures.descriptorBindingPartiallyBound &&
+						  IndexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+						  IndexingFeatures.descriptorBindingUpdateUnusedWhilePending &&
+						  IndexingFeatures.shaderSampledImageArrayNonUniformIndexing;
+
+	VkPhysicalDeviceDescriptorIndexingFeatures EnabledIndexingFeatures = {};
+	EnabledIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+	if (m_bindlessSupported) {
+		EnabledIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+		EnabledIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+		EnabledIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		EnabledIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+		EnabledIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+
+		// Before 1.2 descriptor indexing is an extension
+		if (m_physDevices.Selected().m_devProps.apiVersion < VK_API_VERSION_1_2) {
+			DevExts.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+		}
+
+		printf("Bindless textures are supported\n");
+	}
+
 	VkDeviceCreateInfo DeviceCreateInfo = {
 		.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-		.pNext = NULL,
+		.pNext = m_bindlessSupported ? &EnabledIndexingFeatures : NULL,
 		.flags = 0,
-		.queueCreateInfoCount = 1,
-		.pQueueCreateInfos = &qInfo,
+		.queueCreateInfoCount = (u32)qInfos.size(),
+		.pQueueCreateInfos = qInfos.data(),
 		.enabledLayerCount = 0,			// DEPRECATED
 		.ppEnabledLayerNames = NULL,    // DEPRECATED
 		.enabledExtensionCount = (u32)DevExts.size(),
@@ -391,6 +538,31 @@ void VulkanCore::CreateSwapChain()
 }
 
 
+void VulkanCore::CreateOffscreenImages(int NumImages)
+{
+	m_swapChainSurfaceFormat.format = VK_FORMAT_R8G8B8A8_UNORM;
+	m_swapChainSurfaceFormat.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+
+	// Same usage as the swap chain images plus the source of ReadImage
+	VkImageUsageFlags Usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+							  VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+	m_offscreenImages.resize(NumImages);
+	m_images.resize(NumImages);
+	m_imageViews.resize(NumImages);
+
+	for (int i = 0; i < NumImages; i++) {
+		CreateImage(m_offscreenImages[i], m_windowWidth, m_windowHeight, m_swapChainSurfaceFormat.format,
+					Usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		m_images[i] = m_offscreenImages[i].m_image;
+		m_imageViews[i] = CreateImageView(m_device, m_images[i], m_swapChainSurfaceFormat.format, VK_IMAGE_ASPECT_COLOR_BIT);
+	}
+
+	printf("Created %d offscreen images (%dx%d)\n", NumImages, m_windowWidth, m_windowHeight);
+}
+
+
 void VulkanCore::CreateCommandBufferPool()
 {
 	VkCommandPoolCreateInfo cmdPoolCreateInfo = {
@@ -442,7 +614,7 @@ VkRenderPass VulkanCore::CreateSimpleRenderPass()
 		.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 		.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
 		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-		.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+		.finalLayout = m_headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
 	};
 
 	VkAttachmentReference ColorAttachRef = {
@@ -564,40 +736,29 @@ void VulkanCore::DestroyFramebuffers(std::vector<VkFramebuffer>& Framebuffers)
 }
 
 
-BufferAndMemory VulkanCore::CreateVertexBuffer(const void* pVertices, size_t Size)
+BufferAndMemory VulkanCore::CreateVertexBuffer(const void* pVertices, size_t Size, bool WaitForUpload)
 {
-	// Step 1: create the staging buffer
-	VkBufferUsageFlags Usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	VkMemoryPropertyFlags MemProps = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-									 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-	BufferAndMemory StagingVB = CreateBuffer(Size, Usage, MemProps);
-
-	// Step 2: map the memory of the stage buffer
-	void* pMem = NULL;
-	VkDeviceSize Offset = 0;
-	VkMemoryMapFlags Flags = 0;
-	VkResult res = vkMapMemory(m_device, StagingVB.m_mem, Offset, 
-		                       StagingVB.m_allocationSize, Flags, &pMem);
-	CHECK_VK_RESULT(res, "vkMapMemory\n");
-
-	// Step 3: copy the vertices to the stating buffer
-	memcpy(pMem, pVertices, Size);
+	return CreateDeviceLocalBuffer(pVertices, Size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, WaitForUpload);
+}
 
-	// Step 4: unmap/release the mapped memory
-	vkUnmapMemory(m_device, StagingVB.m_mem);
 
-	// Step 5: create the final buffer
-	Usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-	MemProps = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-	BufferAndMemory VB = CreateBuffer(Size, Usage, MemProps);
+BufferAndMemory VulkanCore::CreateDeviceLocalBuffer(const void* pData, size_t Size, VkBufferUsageFlags Usage,
+													bool WaitForUpload)
+{
+	// Step 1: create the final buffer
+	Usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	VkMemoryPropertyFlags MemProps = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	BufferAndMemory Buffer = CreateBuffer(Size, Usage, MemProps);
 
-	// Step 6: copy the staging buffer to the final buffer
-	CopyBufferToBuffer(VB.m_buffer, StagingVB.m_buffer, Size);
+	// Step 2: copy the data to the staging ring and record the copy to the final buffer
+	u64 Batch = m_uploader.UploadBuffer(Buffer.m_buffer, pData, Size);
 
-	// Step 7: release the resources of the staging buffer
-	StagingVB.Destroy(m_device);
+	// Step 3: optionally submit the batch and wait for it
+	if (WaitForUpload) {
+		m_uploader.Wait(Batch);
+	}
 
-	return VB;
+	return Buffer;
 }
 
 
@@ -643,26 +804,21 @@ BufferAndMemory VulkanCore::CreateBuffer(VkDeviceSize Size, VkBufferUsageFlags U
 	u32 MemoryTypeIndex = GetMemoryTypeIndex(MemReqs.memoryTypeBits, Properties);
 	printf("Memory type index %d\n", MemoryTypeIndex);
 
-	// Step 4: allocate memory
-	VkMemoryAllocateInfo MemAllocInfo = {
-		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-		.pNext = NULL,
-		.allocationSize = MemReqs.size,
-		.memoryTypeIndex = MemoryTypeIndex
-	};
-
-	res = vkAllocateMemory(m_device, &MemAllocInfo, NULL, &Buf.m_mem);
-	CHECK_VK_RESULT(res, "vkAllocateMemory error %d\n");
+	// Step 4: sub-allocate memory
+	bool IsLinear = true;
+	m_allocator.Allocate(MemReqs, MemoryTypeIndex, IsLinear, Buf.m_alloc);
+	Buf.m_mem = Buf.m_alloc.m_mem;
+	Buf.m_pAllocator = &m_allocator;
 
 	// Step 5: bind memory
-	res = vkBindBufferMemory(m_device, Buf.m_buffer, Buf.m_mem, 0);
+	res = vkBindBufferMemory(m_device, Buf.m_buffer, Buf.m_mem, Buf.m_alloc.m_offset);
 	CHECK_VK_RESULT(res, "vkBindBufferMemory error %d\n");
 
 	return Buf;
 }
 
 
-void VulkanCore::CreateTexture(const char* pFilename, VulkanTexture& Tex)
+void VulkanCore::CreateTexture(const char* pFilename, VulkanTexture& Tex, bool WaitForUpload)
 {
 	int ImageWidth = 0;
 	int ImageHeight = 0;
@@ -676,14 +832,24 @@ void VulkanCore::CreateTexture(const char* pFilename, VulkanTexture& Tex)
 		exit(1);
 	}
 
-	// Step #2: create the image object and populate it with pixels
-	VkFormat Format = VK_FORMAT_R8G8B8A8_SRGB;
-	CreateTextureImageFromData(Tex, pPixels, ImageWidth, ImageHeight, Format);
+	// Step #2: create the texture and populate it with pixels
+	CreateTextureFromPixels(Tex, pPixels, ImageWidth, ImageHeight, WaitForUpload);
 
-	// Step #3: release the image pixels. We don't need them after this point
+	// Step #3: release the image pixels. They have already been copied to the staging ring.
 	stbi_image_free(pPixels);
 
-	// Step #4: create the image view
+	printf("Texture from '%s' created\n", pFilename);
+}
+
+
+void VulkanCore::CreateTextureFromPixels(VulkanTexture& Tex, const void* pPixels, u32 ImageWidth, u32 ImageHeight,
+										 bool WaitForUpload)
+{
+	// Step #1: create the image object and populate it with pixels
+	VkFormat Format = VK_FORMAT_R8G8B8A8_SRGB;
+	CreateTextureImageFromData(Tex, pPixels, ImageWidth, ImageHeight, Format);
+
+	// Step #2: create the image view
 	VkImageAspectFlags AspectFlags = VK_IMAGE_ASPECT_COLOR_BIT;
 	Tex.m_view = CreateImageView(m_device, Tex.m_image, Format, AspectFlags);
 
@@ -691,10 +857,13 @@ void VulkanCore::CreateTexture(const char* pFilename, VulkanTexture& Tex)
 	VkFilter MaxFilter = VK_FILTER_LINEAR;
 	VkSamplerAddressMode AddressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
 
-	// Step #5: create the texture sampler
+	// Step #3: create the texture sampler
 	Tex.m_sampler = CreateTextureSampler(m_device, MinFilter, MaxFilter, AddressMode);
 
-	printf("Texture from '%s' created\n", pFilename);
+	// Step #4: optionally submit the upload and wait for it
+	if (WaitForUpload) {
+		m_uploader.WaitAll();
+	}
 }
 
 
@@ -703,7 +872,14 @@ void VulkanTexture::Destroy(VkDevice Device)
 	vkDestroySampler(Device, m_sampler, NULL);
 	vkDestroyImageView(Device, m_view, NULL);
 	vkDestroyImage(Device, m_image, NULL);
-	vkFreeMemory(Device, m_mem, NULL);
+
+	if (m_pAllocator) {
+		m_pAllocator->Free(m_alloc);
+	} else {
+		vkFreeMemory(Device, m_mem, NULL);
+	}
+
+	m_mem = VK_NULL_HANDLE;
 }
 
 
@@ -715,7 +891,7 @@ void VulkanCore::CreateTextureImageFromData(VulkanTexture& Tex, const void* pPix
 	VkMemoryPropertyFlagBits PropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 	CreateImage(Tex, ImageWidth, ImageHeight, TexFormat, Usage, PropertyFlags);
 
-	UpdateTextureImage(Tex, ImageWidth, ImageHeight, TexFormat, pPixels);
+	m_uploader.UploadImage(Tex.m_image, ImageWidth, ImageHeight, TexFormat, pPixels);
 }
 
 
@@ -753,54 +929,18 @@ void VulkanCore::CreateImage(VulkanTexture& Tex, u32 ImageWidth, u32 ImageHeight
 	u32 MemoryTypeIndex = GetMemoryTypeIndex(MemReqs.memoryTypeBits, PropertyFlags);
 	printf("Memory type index %d\n", MemoryTypeIndex);
 
-	// Step 4: allocate memory
-	VkMemoryAllocateInfo MemAllocInfo = {
-		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-		.pNext = NULL,
-		.allocationSize = MemReqs.size,
-		.memoryTypeIndex = MemoryTypeIndex
-	};
-
-	res = vkAllocateMemory(m_device, &MemAllocInfo, NULL, &Tex.m_mem);
-	CHECK_VK_RESULT(res, "vkAllocateMemory error");
+	// Step 4: sub-allocate memory (optimal tiling so it goes to the non linear pool)
+	bool IsLinear = false;
+	m_allocator.Allocate(MemReqs, MemoryTypeIndex, IsLinear, Tex.m_alloc);
+	Tex.m_mem = Tex.m_alloc.m_mem;
+	Tex.m_pAllocator = &m_allocator;
 
 	// Step 5: bind memory
-	res = vkBindImageMemory(m_device, Tex.m_image, Tex.m_mem, 0);
+	res = vkBindImageMemory(m_device, Tex.m_image, Tex.m_mem, Tex.m_alloc.m_offset);
 	CHECK_VK_RESULT(res, "vkBindBufferMemory error %d\n");
 }
 
 
-void VulkanCore::UpdateTextureImage(VulkanTexture& Tex, u32 ImageWidth, u32 ImageHeight, 
-								    VkFormat TexFormat, const void* pPixels)
-{
-	int BytesPerPixel = GetBytesPerTexFormat(TexFormat);
-
-	VkDeviceSize LayerSize = ImageWidth * ImageHeight * BytesPerPixel;
-	int LayerCount = 1;
-	VkDeviceSize ImageSize = LayerCount * LayerSize;
-
-	VkBufferUsageFlags Usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	VkMemoryPropertyFlags Properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | 
-									   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-
-	BufferAndMemory StagingTex = CreateBuffer(ImageSize, Usage, Properties);
-
-	StagingTex.Update(m_device, pPixels, ImageSize);
-
-	TransitionImageLayout(Tex.m_image, TexFormat, 
-						  VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-	
-	CopyBufferToImage(Tex.m_image, StagingTex.m_buffer, ImageWidth, ImageHeight);
-	
-	TransitionImageLayout(Tex.m_image, TexFormat, 
-						  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-	StagingTex.Destroy(m_device);
-}
-
-
-
-
 void VulkanCore::TransitionImageLayout(VkImage& Image, VkFormat Format, 
 									   VkImageLayout OldLayout, VkImageLayout NewLayout)
 {
@@ -812,47 +952,6 @@ void VulkanCore::TransitionImageLayout(VkImage& Image, VkFormat Format,
 }
 
 
-void VulkanCore::CopyBufferToBuffer(VkBuffer Dst, VkBuffer Src, VkDeviceSize Size)
-{
-	BeginCommandBuffer(m_copyCmdBuf, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-
-	VkBufferCopy BufferCopy = {
-		.srcOffset = 0,
-		.dstOffset = 0,
-		.size = Size
-	};
-
-	vkCmdCopyBuffer(m_copyCmdBuf, Src, Dst, 1, &BufferCopy);
-
-	SubmitCopyCommand();
-}
-
-
-void VulkanCore::CopyBufferToImage(VkImage Dst, VkBuffer Src, u32 ImageWidth, u32 ImageHeight)
-{
-	BeginCommandBuffer(m_copyCmdBuf, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-
-	VkBufferImageCopy BufferImageCopy = {
-		.bufferOffset = 0,
-		.bufferRowLength = 0,
-		.bufferImageHeight = 0,
-		.imageSubresource = VkImageSubresourceLayers {
-			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-			.mipLevel = 0,
-			.baseArrayLayer = 0,
-			.layerCount = 1
-		},
-		.imageOffset = VkOffset3D {.x = 0, .y = 0, .z = 0 },
-		.imageExtent = VkExtent3D {.width = ImageWidth, .height = ImageHeight, .depth = 1 }
-	};
-
-	vkCmdCopyBufferToImage(m_copyCmdBuf, Src, Dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
-						   1, &BufferImageCopy);
-	SubmitCopyCommand();
-}
-
-
-
 u32 VulkanCore::GetMemoryTypeIndex(u32 MemTypeBitsMask, VkMemoryPropertyFlags ReqMemPropFlags)
 {
 	const VkPhysicalDeviceMemoryProperties& MemProps = m_physDevices.Selected().m_memProps;
@@ -876,11 +975,19 @@ u32 VulkanCore::GetMemoryTypeIndex(u32 MemTypeBitsMask, VkMemoryPropertyFlags Re
 
 void BufferAndMemory::Destroy(VkDevice Device)
 {
-	if (m_mem) {
-		vkFreeMemory(Device, m_mem, NULL);
-	}
 	if (m_buffer) {
 		vkDestroyBuffer(Device, m_buffer, NULL);
+		m_buffer = NULL;
+	}
+
+	if (m_mem) {
+		if (m_pAllocator) {
+			m_pAllocator->Free(m_alloc);
+		} else {
+			vkFreeMemory(Device, m_mem, NULL);
+		}
+
+		m_mem = NULL;
 	}
 }
 
@@ -905,6 +1012,79 @@ std::vector<BufferAndMemory> VulkanCore::CreateUniformBuffers(size_t Size)
 }
 
 
+void VulkanCore::CreateUniformRingBuffer(UniformRingBuffer& Ring, size_t FrameSize, int NumFrames)
+{
+	VkDeviceSize Alignment = m_physDevices.Selected().m_devProps.limits.minUniformBufferOffsetAlignment;
+
+	if (Alignment == 0) {
+		Alignment = 1;
+	}
+
+	// Every frame starts on an aligned offset so the dynamic offsets are aligned as well
+	VkDeviceSize AlignedFrameSize = (FrameSize + Alignment - 1) / Alignment * Alignment;
+
+	Ring.m_buffer = CreateUniformBuffer(AlignedFrameSize * NumFrames);
+	Ring.m_alignment = Alignment;
+	Ring.m_frameSize = AlignedFrameSize;
+	Ring.m_numFrames = NumFrames;
+	Ring.m_frameStart = 0;
+	Ring.m_offset = 0;
+
+	// The allocator keeps host visible memory mapped and the memory is host coherent
+	// so nothing needs to be flushed
+	Ring.m_pMappedMem = (u8*)Ring.m_buffer.m_alloc.m_pMappedMem;
+
+	printf("Uniform ring buffer created: %d frames of %d bytes, alignment %d\n",
+		   NumFrames, (int)AlignedFrameSize, (int)Alignment);
+}
+
+
+void UniformRingBuffer::BeginFrame(int FrameIndex)
+{
+	if ((FrameIndex < 0) || (FrameIndex >= m_numFrames)) {
+		OGLDEV_ERROR("Invalid frame index %d (number of frames %d)\n", FrameIndex, m_numFrames);
+		exit(1);
+	}
+
+	m_frameStart = FrameIndex * m_frameSize;
+	m_offset = 0;
+}
+
+
+void* UniformRingBuffer::Alloc(size_t Size, u32& DynamicOffset)
+{
+	if (m_offset + Size > m_frameSize) {
+		OGLDEV_ERROR("Uniform ring buffer overflow - frame size %d, requested %d at offset %d\n",
+					 (int)m_frameSize, (int)Size, (int)m_offset);
+		exit(1);
+	}
+
+	DynamicOffset = (u32)(m_frameStart + m_offset);
+
+	m_offset += (Size + m_alignment - 1) & ~(m_alignment - 1);	// the alignment is a power of two
+
+	return m_pMappedMem + DynamicOffset;
+}
+
+
+u32 UniformRingBuffer::Push(const void* pData, size_t Size)
+{
+	u32 DynamicOffset = 0;
+	void* pMem = Alloc(Size, DynamicOffset);
+	memcpy(pMem, pData, Size);
+	return DynamicOffset;
+}
+
+
+void UniformRingBuffer::Destroy(VkDevice Device)
+{
+	// The memory is unmapped by the allocator when its block is released
+	m_pMappedMem = NULL;
+
+	m_buffer.Destroy(Device);
+}
+
+
 void VulkanCore::SubmitCopyCommand()
 {
 	vkEndCommandBuffer(m_copyCmdBuf);
@@ -915,6 +1095,19 @@ void VulkanCore::SubmitCopyCommand()
 }
 
 
+void VulkanCore::CreateUploader()
+{
+	// The allocator keeps the ring mapped
+	VkBufferUsageFlags Usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	VkMemoryPropertyFlags MemProps = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+									 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	m_stagingRing = CreateBuffer(DEFAULT_STAGING_RING_SIZE, Usage, MemProps);
+
+	m_uploader.Init(m_device, m_queueFamily, m_transferQueueFamily, m_stagingRing.m_buffer,
+					m_stagingRing.m_alloc.m_pMappedMem, DEFAULT_STAGING_RING_SIZE);
+}
+
+
 void VulkanCore::CreateDepthResources()
 {
 	int NumSwapChainImages = (int)m_images.size();
@@ -936,13 +1129,92 @@ void VulkanCore::CreateDepthResources()
 }
 
 
+void VulkanCore::ReadImage(int ImageIndex, std::vector<u8>& Pixels)
+{
+	if (!m_headless) {
+		OGLDEV_ERROR0("ReadImage is only supported in headless mode\n");
+		exit(1);
+	}
+
+	m_queue.WaitIdle();
+
+	VkDeviceSize Size = (VkDeviceSize)m_windowWidth * m_windowHeight * 4;
+
+	BufferAndMemory Buf = CreateBuffer(Size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+									   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	BeginCommandBuffer(m_copyCmdBuf, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+	// The render pass already moved the image to the transfer layout - only wait for its writes
+	VkImageMemoryBarrier ImageBarrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.pNext = NULL,
+		.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+		.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = m_images[ImageIndex],
+		.subresourceRange = {
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.baseMipLevel = 0,
+			.levelCount = 1,
+			.baseArrayLayer = 0,
+			.layerCount = 1
+		}
+	};
+
+	vkCmdPipelineBarrier(m_copyCmdBuf, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+						 0, 0, NULL, 0, NULL, 1, &ImageBarrier);
+
+	VkBufferImageCopy Region = {
+		.bufferOffset = 0,
+		.bufferRowLength = 0,		// tightly packed
+		.bufferImageHeight = 0,
+		.imageSubresource = {
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.mipLevel = 0,
+			.baseArrayLayer = 0,
+			.layerCount = 1
+		},
+		.imageOffset = { .x = 0, .y = 0, .z = 0 },
+		.imageExtent = { .width = (u32)m_windowWidth, .height = (u32)m_windowHeight, .depth = 1 }
+	};
+
+	vkCmdCopyImageToBuffer(m_copyCmdBuf, m_images[ImageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+						   Buf.m_buffer, 1, &Region);
+
+	VkMemoryBarrier HostBarrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.pNext = NULL,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_HOST_READ_BIT
+	};
+
+	vkCmdPipelineBarrier(m_copyCmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+						 0, 1, &HostBarrier, 0, NULL, 0, NULL);
+
+	SubmitCopyCommand();
+
+	Pixels.resize(Size);
+
+	// Host visible so the allocator already mapped it
+	memcpy(Pixels.data(), Buf.m_alloc.m_pMappedMem, Size);
+
+	Buf.Destroy(m_device);
+}
+
+
 void BufferAndMemory::Update(VkDevice Device, const void* pData, size_t Size)
 {
-	void* pMem = NULL;
-	VkResult res = vkMapMemory(Device, m_mem, 0, Size, 0, &pMem);
-	CHECK_VK_RESULT(res, "vkMapMemory");
-	memcpy(pMem, pData, Size);
-	vkUnmapMemory(Device, m_mem);
+	// The allocator keeps all host visible memory mapped
+	if (!m_alloc.m_pMappedMem) {
+		OGLDEV_ERROR0("BufferAndMemory::Update on a buffer which is not host visible\n");
+		exit(1);
+	}
+
+	memcpy(m_alloc.m_pMappedMem, pData, Size);
 }
 
 }
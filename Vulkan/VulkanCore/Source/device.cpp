@@ -16,6 +16,7 @@
 */
 
 #include <assert.h>
+#include <string.h>
 
 #include "ogldev_util.h"
 #include "ogldev_vulkan_util.h"
@@ -96,6 +97,27 @@ static VkFormat FindDepthFormat(VkPhysicalDevice Device)
 }
 
 
+static bool HasDeviceExtension(VkPhysicalDevice Device, const char* pName)
+{
+    u32 NumExtensions = 0;
+    VkResult res = vkEnumerateDeviceExtensionProperties(Device, NULL, &NumExtensions, NULL);
+    CHECK_VK_RESULT(res, "vkEnumerateDeviceExtensionProperties (1)\n");
+
+    std::vector<VkExtensionProperties> Extensions(NumExtensions);
+
+    res = vkEnumerateDeviceExtensionProperties(Device, NULL, &NumExtensions, Extensions.data());
+    CHECK_VK_RESULT(res, "vkEnumerateDeviceExtensionProperties (2)\n");
+
+    for (u32 i = 0; i < NumExtensions; i++) {
+        if (strcmp(Extensions[i].extensionName, pName) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
 void VulkanPhysicalDevices::Init(const VkInstance& Instance, const VkSurfaceKHR& Surface)
 {
     u32 NumDevices = 0;
@@ -147,44 +169,20 @@ void VulkanPhysicalDevices::Init(const VkInstance& Instance, const VkSurfaceKHR&
                 (Flags & VK_QUEUE_TRANSFER_BIT) ? "Yes" : "No",
                 (Flags & VK_QUEUE_SPARSE_BINDING_BIT) ? "Yes" : "No");
 
+            // Headless - nothing can be presented
+            if (Surface == VK_NULL_HANDLE) {
+                m_devices[i].m_qSupportsPresent[q] = VK_FALSE;
+                continue;
+            }
+
             res = vkGetPhysicalDeviceSurfaceSupportKHR(PhysDev, q, Surface, &(m_devices[i].m_qSupportsPresent[q]));
             CHECK_VK_RESULT(res, "vkGetPhysicalDeviceSurfaceSupportKHR error\n");
         }
 
-        u32 NumFormats = 0;
-        res = vkGetPhysicalDeviceSurfaceFormatsKHR(PhysDev, Surface, &NumFormats, NULL);
-        CHECK_VK_RESULT(res, "vkGetPhysicalDeviceSurfaceFormatsKHR (1)\n");
-        assert(NumFormats > 0);
-
-        m_devices[i].m_surfaceFormats.resize(NumFormats);
-
-        res = vkGetPhysicalDeviceSurfaceFormatsKHR(PhysDev, Surface, &NumFormats, m_devices[i].m_surfaceFormats.data());
-        CHECK_VK_RESULT(res, "vkGetPhysicalDeviceSurfaceFormatsKHR (2)\n");
-
-        for (u32 j = 0; j < NumFormats; j++) {
-            const VkSurfaceFormatKHR& SurfaceFormat = m_devices[i].m_surfaceFormats[j];
-            printf("    Format %x color space %x\n", SurfaceFormat.format, SurfaceFormat.colorSpace);
+        if (Surface != VK_NULL_HANDLE) {
+            GetSurfaceProperties(m_devices[i], Surface);
         }
 
-        res = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(PhysDev, Surface, &(m_devices[i].m_surfaceCaps));
-        CHECK_VK_RESULT(res, "vkGetPhysicalDeviceSurfaceCapabilitiesKHR\n");
-
-        PrintImageUsageFlags(m_devices[i].m_surfaceCaps.supportedUsageFlags);
-
-        u32 NumPresentModes = 0;
-
-        res = vkGetPhysicalDeviceSurfacePresentModesKHR(PhysDev, Surface, &NumPresentModes, NULL);
-        CHECK_VK_RESULT(res, "vkGetPhysicalDeviceSurfacePresentModesKHR (1) error\n");
-
-        assert(NumPresentModes != 0);
-
-        m_devices[i].m_presentModes.resize(NumPresentModes);
-
-        res = vkGetPhysicalDeviceSurfacePresentModesKHR(PhysDev, Surface, &NumPresentModes, m_devices[i].m_presentModes.data());
-        CHECK_VK_RESULT(res, "vkGetPhysicalDeviceSurfacePresentModesKHR (2) error\n");
-
-        printf("Number of presentation modes %d\n", NumPresentModes);
-
         vkGetPhysicalDeviceMemoryProperties(PhysDev, &(m_devices[i].m_memProps));
 
         printf("Num memory types %d\n", m_devices[i].m_memProps.memoryTypeCount);
@@ -202,11 +200,68 @@ void VulkanPhysicalDevices::Init(const VkInstance& Instance, const VkSurfaceKHR&
 
         vkGetPhysicalDeviceFeatures(PhysDev, &m_devices[i].m_features);
 
+        m_devices[i].m_descIndexingFeatures = {};
+        m_devices[i].m_descIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+        // Descriptor indexing is core in 1.2. On a 1.1 device (vkGetPhysicalDeviceFeatures2 is core
+        // in 1.1) the structure may only be chained if VK_EXT_descriptor_indexing is supported.
+        u32 ApiVersion = m_devices[i].m_devProps.apiVersion;
+
+        if ((ApiVersion >= VK_API_VERSION_1_2) ||
+            ((ApiVersion >= VK_API_VERSION_1_1) && HasDeviceExtension(PhysDev, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))) {
+            VkPhysicalDeviceFeatures2 Features2 = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+                .pNext = &m_devices[i].m_descIndexingFeatures
+            };
+
+            vkGetPhysicalDeviceFeatures2(PhysDev, &Features2);
+
+            m_devices[i].m_descIndexingFeatures.pNext = NULL;
+        }
+
         m_devices[i].m_depthFormat = FindDepthFormat(PhysDev);
     }
 }
 
 
+void VulkanPhysicalDevices::GetSurfaceProperties(PhysicalDevice& Device, const VkSurfaceKHR& Surface)
+{
+    u32 NumFormats = 0;
+    VkResult res = vkGetPhysicalDeviceSurfaceFormatsKHR(Device.m_physDevice, Surface, &NumFormats, NULL);
+    CHECK_VK_RESULT(res, "vkGetPhysicalDeviceSurfaceFormatsKHR (1)\n");
+    assert(NumFormats > 0);
+
+    Device.m_surfaceFormats.resize(NumFormats);
+
+    res = vkGetPhysicalDeviceSurfaceFormatsKHR(Device.m_physDevice, Surface, &NumFormats, Device.m_surfaceFormats.data());
+    CHECK_VK_RESULT(res, "vkGetPhysicalDeviceSurfaceFormatsKHR (2)\n");
+
+    for (u32 j = 0; j < NumFormats; j++) {
+        const VkSurfaceFormatKHR& SurfaceFormat = Device.m_surfaceFormats[j];
+        printf("    Format %x color space %x\n", SurfaceFormat.format, SurfaceFormat.colorSpace);
+    }
+
+    res = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(Device.m_physDevice, Surface, &(Device.m_surfaceCaps));
+    CHECK_VK_RESULT(res, "vkGetPhysicalDeviceSurfaceCapabilitiesKHR\n");
+
+    PrintImageUsageFlags(Device.m_surfaceCaps.supportedUsageFlags);
+
+    u32 NumPresentModes = 0;
+
+    res = vkGetPhysicalDeviceSurfacePresentModesKHR(Device.m_physDevice, Surface, &NumPresentModes, NULL);
+    CHECK_VK_RESULT(res, "vkGetPhysicalDeviceSurfacePresentModesKHR (1) error\n");
+
+    assert(NumPresentModes != 0);
+
+    Device.m_presentModes.resize(NumPresentModes);
+
+    res = vkGetPhysicalDeviceSurfacePresentModesKHR(Device.m_physDevice, Surface, &NumPresentModes, Device.m_presentModes.data());
+    CHECK_VK_RESULT(res, "vkGetPhysicalDeviceSurfacePresentModesKHR (2) error\n");
+
+    printf("Number of presentation modes %d\n", NumPresentModes);
+}
+
+
 u32 VulkanPhysicalDevices::SelectDevice(VkQueueFlags RequiredQueueType, bool SupportsPresent)
 {
     for (u32 i = 0; i < m_devices.size(); i++) {
@@ -229,6 +284,23 @@ u32 VulkanPhysicalDevices::SelectDevice(VkQueueFlags RequiredQueueType, bool Sup
 }
 
 
+int VulkanPhysicalDevices::FindDedicatedTransferQueueFamily() const
+{
+    const PhysicalDevice& Device = Selected();
+
+    for (u32 i = 0; i < Device.m_qFamilyProps.size(); i++) {
+        VkQueueFlags Flags = Device.m_qFamilyProps[i].queueFlags;
+
+        if ((Flags & VK_QUEUE_TRANSFER_BIT) && !(Flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+            printf("Using queue family %d for transfers\n", i);
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+
 const PhysicalDevice& VulkanPhysicalDevices::Selected() const
 {
     if (m_devIndex < 0) {
@@ -0,0 +1,211 @@
+/*
+		Copyright 2024 Etay Meiri
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <algorithm>
+
+#include "ogldev_util.h"
+#include "ogldev_vulkan_util.h"
+#include "ogldev_vulkan_gpu_timer.h"
+
+namespace OgldevVK {
+
+void VulkanGpuTimer::Init(VkDevice Device, const PhysicalDevice& PhysDevice, u32 QueueFamily, int NumFrames,
+						  int MaxPasses)
+{
+	m_device = Device;
+	m_numFrames = NumFrames;
+	m_maxPasses = MaxPasses;
+
+	u32 ValidBits = PhysDevice.m_qFamilyProps[QueueFamily].timestampValidBits;
+
+	if (ValidBits == 0) {
+		printf("Queue family %d doesn't support timestamps - GPU timing is disabled\n", QueueFamily);
+		return;
+	}
+
+	m_validBitsMask = (ValidBits >= 64) ? ~0ULL : ((1ULL << ValidBits) - 1);
+	m_period = (double)PhysDevice.m_devProps.limits.timestampPeriod;
+
+	VkQueryPoolCreateInfo PoolInfo = {
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = (u32)(NumFrames * MaxPasses * 2),
+		.pipelineStatistics = 0
+	};
+
+	VkResult res = vkCreateQueryPool(m_device, &PoolInfo, NULL, &m_queryPool);
+	CHECK_VK_RESULT(res, "vkCreateQueryPool\n");
+
+	m_pending.resize(NumFrames, false);
+
+	printf("GPU timer created: %d frames, up to %d passes, %.2f ns per tick\n", NumFrames, MaxPasses, m_period);
+}
+
+
+void VulkanGpuTimer::Destroy()
+{
+	if (m_queryPool == VK_NULL_HANDLE) {
+		return;
+	}
+
+	vkDestroyQueryPool(m_device, m_queryPool, NULL);
+	m_queryPool = VK_NULL_HANDLE;
+	m_pending.clear();
+}
+
+
+int VulkanGpuTimer::AddPass(const char* pName)
+{
+	if ((int)m_stats.size() == m_maxPasses) {
+		OGLDEV_ERROR("Too many GPU timer passes (max %d)\n", m_maxPasses);
+		exit(1);
+	}
+
+	GpuPassStats Stats;
+	Stats.Name = pName;
+	m_stats.push_back(Stats);
+
+	return (int)m_stats.size() - 1;
+}
+
+
+void VulkanGpuTimer::BeginFrame(VkCommandBuffer CmdBuf, int FrameIndex)
+{
+	if (!IsSupported()) {
+		return;
+	}
+
+	// Passes which are not written in this frame stay unavailable and are skipped by CollectResults
+	vkCmdResetQueryPool(CmdBuf, m_queryPool, GetQuery(FrameIndex, 0, false), m_maxPasses * 2);
+}
+
+
+void VulkanGpuTimer::BeginPass(VkCommandBuffer CmdBuf, int FrameIndex, int Pass)
+{
+	if (!IsSupported()) {
+		return;
+	}
+
+	vkCmdWriteTimestamp(CmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, GetQuery(FrameIndex, Pass, false));
+}
+
+
+void VulkanGpuTimer::EndPass(VkCommandBuffer CmdBuf, int FrameIndex, int Pass)
+{
+	if (!IsSupported()) {
+		return;
+	}
+
+	vkCmdWriteTimestamp(CmdBuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, GetQuery(FrameIndex, Pass, true));
+}
+
+
+void VulkanGpuTimer::FrameSubmitted(int FrameIndex)
+{
+	if (!IsSupported()) {
+		return;
+	}
+
+	m_pending[FrameIndex] = true;
+}
+
+
+void VulkanGpuTimer::CollectResults(int FrameIndex)
+{
+	if (!IsSupported() || !m_pending[FrameIndex] || m_stats.empty()) {
+		return;
+	}
+
+	m_pending[FrameIndex] = false;
+
+	int NumPasses = (int)m_stats.size();
+
+	// A (timestamp, availability) pair per query
+	std::vector<u64> Results(NumPasses * 2 * 2);
+
+	// Without VK_QUERY_RESULT_WAIT_BIT unavailable queries return VK_NOT_READY instead of blocking
+	VkResult res = vkGetQueryPoolResults(m_device, m_queryPool, GetQuery(FrameIndex, 0, false), NumPasses * 2,
+										 Results.size() * sizeof(u64), Results.data(), 2 * sizeof(u64),
+										 VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+	if ((res != VK_SUCCESS) && (res != VK_NOT_READY)) {
+		CHECK_VK_RESULT(res, "vkGetQueryPoolResults\n");
+	}
+
+	for (int Pass = 0; Pass < NumPasses; Pass++) {
+		u64 Begin = Results[Pass * 4];
+		u64 BeginAvailable = Results[Pass * 4 + 1];
+		u64 End = Results[Pass * 4 + 2];
+		u64 EndAvailable = Results[Pass * 4 + 3];
+
+		if (!BeginAvailable || !EndAvailable) {
+			continue;
+		}
+
+		u64 Ticks = (End - Begin) & m_validBitsMask;
+		double Time = (double)Ticks * m_period / 1000000.0;
+
+		GpuPassStats& Stats = m_stats[Pass];
+
+		if (Stats.NumSamples == 0) {
+			Stats.MinTime = Time;
+			Stats.MaxTime = Time;
+		} else {
+			Stats.MinTime = std::min(Stats.MinTime, Time);
+			Stats.MaxTime = std::max(Stats.MaxTime, Time);
+		}
+
+		Stats.TotalTime += Time;
+		Stats.NumSamples++;
+	}
+}
+
+
+void VulkanGpuTimer::CollectAllResults()
+{
+	for (int i = 0; i < m_numFrames; i++) {
+		CollectResults(i);
+	}
+}
+
+
+void VulkanGpuTimer::PrintStats() const
+{
+	if (!IsSupported()) {
+		return;
+	}
+
+	printf("GPU time per pass (ms):\n");
+	printf("    %-20s %8s %8s %8s %8s\n", "pass", "samples", "avg", "min", "max");
+
+	for (int i = 0; i < (int)m_stats.size(); i++) {
+		const GpuPassStats& Stats = m_stats[i];
+
+		if (Stats.NumSamples == 0) {
+			printf("    %-20s %8d\n", Stats.Name.c_str(), 0);
+			continue;
+		}
+
+		printf("    %-20s %8d %8.3f %8.3f %8.3f\n", Stats.Name.c_str(), Stats.NumSamples,
+			   Stats.TotalTime / Stats.NumSamples, Stats.MinTime, Stats.MaxTime);
+	}
+}
+
+}
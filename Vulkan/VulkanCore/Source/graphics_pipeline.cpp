@@ -21,6 +21,7 @@
 #include "ogldev_util.h"
 #include "ogldev_vulkan_util.h"
 #include "ogldev_vulkan_graphics_pipeline.h"
+#include "ogldev_vulkan_model.h"
 
 namespace OgldevVK {
 
@@ -30,12 +31,101 @@ GraphicsPipeline::GraphicsPipeline(VkDevice Device, GLFWwindow* pWindow, VkRende
 								   int NumImages,
 								   std::vector<BufferAndMemory>& UniformBuffers,
 								   int UniformDataSize,
-								   bool DepthEnabled)
+								   bool DepthEnabled,
+								   const UniformRingBuffer* pUniformRing,
+								   VulkanPipelineCache* pPipelineCache,
+								   VkExtent2D HeadlessExtent)
 {
 	m_device = Device;
+	m_dynamicUniforms = (pUniformRing != NULL);
+	m_pPipelineCache = pPipelineCache;
+
+	MeshBindings Bindings;
 
 	if (pMesh) {
-		CreateDescriptorSets(pMesh, NumImages, UniformBuffers, UniformDataSize);
+		Bindings.VB = pMesh->m_vb.m_buffer;
+		Bindings.VBSize = pMesh->m_vertexBufferSize;
+
+		if (pMesh->m_pTex) {
+			Bindings.Textures.push_back(pMesh->m_pTex);
+		}
+	}
+
+	Init(pWindow, RenderPass, vs, fs, pMesh ? &Bindings : NULL, NumImages, UniformBuffers, UniformDataSize,
+		 DepthEnabled, pUniformRing, HeadlessExtent);
+}
+
+
+GraphicsPipeline::GraphicsPipeline(VkDevice Device, GLFWwindow* pWindow, VkRenderPass RenderPass,
+								   VkShaderModule vs, VkShaderModule fs,
+								   const VulkanModel& Model,
+								   int NumImages,
+								   std::vector<BufferAndMemory>& UniformBuffers,
+								   int UniformDataSize,
+								   bool DepthEnabled,
+								   const UniformRingBuffer* pUniformRing,
+								   VulkanPipelineCache* pPipelineCache,
+								   VkExtent2D HeadlessExtent)
+{
+	m_device = Device;
+	m_dynamicUniforms = (pUniformRing != NULL);
+	m_pPipelineCache = pPipelineCache;
+
+	MeshBindings Bindings;
+	Bindings.VB = Model.GetVertexBuffer().m_buffer;
+	Bindings.VBSize = Model.GetVertexBufferSize();
+	Bindings.Textures = Model.GetTextures();
+	Bindings.DrawData = Model.GetDrawDataBuffer().m_buffer;
+	Bindings.DrawDataSize = Model.GetDrawDataBufferSize();
+	Bindings.pBindless = Model.GetBindlessTextures();
+
+	Init(pWindow, RenderPass, vs, fs, &Bindings, NumImages, UniformBuffers, UniformDataSize,
+		 DepthEnabled, pUniformRing, HeadlessExtent);
+}
+
+
+void GraphicsPipeline::Init(GLFWwindow* pWindow, VkRenderPass RenderPass, VkShaderModule vs, VkShaderModule fs,
+							const MeshBindings* pBindings, int NumImages, std::vector<BufferAndMemory>& UniformBuffers,
+							int UniformDataSize, bool DepthEnabled, const UniformRingBuffer* pUniformRing,
+							VkExtent2D HeadlessExtent)
+{
+	if (pBindings) {
+		CreateDescriptorSets(*pBindings, NumImages, UniformBuffers, UniformDataSize, pUniformRing);
+	}
+
+	int WindowWidth = (int)HeadlessExtent.width;
+	int WindowHeight = (int)HeadlessExtent.height;
+
+	if (pWindow) {
+		glfwGetWindowSize(pWindow, &WindowWidth, &WindowHeight);
+	}
+
+	bool HasDescriptorSet = pBindings && pBindings->VB;
+
+	m_pBindless = HasDescriptorSet ? pBindings->pBindless : NULL;
+
+	GraphicsPipelineDesc Desc;
+	Desc.vs = vs;
+	Desc.fs = fs;
+	Desc.RenderPass = RenderPass;
+	Desc.Width = (u32)WindowWidth;
+	Desc.Height = (u32)WindowHeight;
+	Desc.DepthEnabled = DepthEnabled;
+	Desc.HasDescriptorSet = HasDescriptorSet;
+
+	if (HasDescriptorSet) {
+		Desc.HasUniforms = (UniformBuffers.size() > 0) || pUniformRing;
+		Desc.DynamicUniforms = m_dynamicUniforms;
+		Desc.NumTextures = (u32)pBindings->Textures.size();
+		Desc.HasDrawData = (pBindings->DrawData != VK_NULL_HANDLE);
+		Desc.BindlessSetLayout = m_pBindless ? m_pBindless->GetSetLayout() : VK_NULL_HANDLE;
+	}
+
+	// Our descriptor set layout is identical to the one the shared pipeline
+	// layout was created with so the descriptor sets are compatible with it
+	if (m_pPipelineCache && m_pPipelineCache->Find(Desc, m_pipeline, m_pipelineLayout)) {
+		printf("Graphics pipeline reused\n");
+		return;
 	}
 
 	VkPipelineShaderStageCreateInfo ShaderStageCreateInfo[2] = {
@@ -63,9 +153,6 @@ GraphicsPipeline::GraphicsPipeline(VkDevice Device, GLFWwindow* pWindow, VkRende
 		.primitiveRestartEnable = VK_FALSE
 	};
 
-	int WindowWidth, WindowHeight;
-	glfwGetWindowSize(pWindow, &WindowWidth, &WindowHeight);
-
 	VkViewport VP = {
 		.x = 0.0f,
 		.y = 0.0f,
@@ -139,9 +226,14 @@ GraphicsPipeline::GraphicsPipeline(VkDevice Device, GLFWwindow* pWindow, VkRende
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO
 	};
 
-	if (pMesh && pMesh->m_vb.m_buffer) {
-		LayoutInfo.setLayoutCount = 1;
-		LayoutInfo.pSetLayouts = &m_descriptorSetLayout;
+	VkDescriptorSetLayout SetLayouts[] = {
+		m_descriptorSetLayout,
+		m_pBindless ? m_pBindless->GetSetLayout() : VK_NULL_HANDLE
+	};
+
+	if (HasDescriptorSet) {
+		LayoutInfo.setLayoutCount = m_pBindless ? 2 : 1;
+		LayoutInfo.pSetLayouts = SetLayouts;
 	} else {
 		LayoutInfo.setLayoutCount = 0;
 		LayoutInfo.pSetLayouts = NULL;
@@ -168,8 +260,13 @@ GraphicsPipeline::GraphicsPipeline(VkDevice Device, GLFWwindow* pWindow, VkRende
 		.basePipelineIndex = -1
 	};
 
-	res = vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &PipelineInfo, NULL, &m_pipeline);
-	CHECK_VK_RESULT(res, "vkCreateGraphicsPipelines\n");
+	if (m_pPipelineCache) {
+		// The registry of the cache owns the pipeline and the layout from now on
+		m_pipeline = m_pPipelineCache->CreatePipeline(Desc, PipelineInfo);
+	} else {
+		res = vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &PipelineInfo, NULL, &m_pipeline);
+		CHECK_VK_RESULT(res, "vkCreateGraphicsPipelines\n");
+	}
 
 	printf("Graphics pipeline created\n");
 }
@@ -177,13 +274,16 @@ GraphicsPipeline::GraphicsPipeline(VkDevice Device, GLFWwindow* pWindow, VkRende
 GraphicsPipeline::~GraphicsPipeline()
 {
 	vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, NULL);
-	vkDestroyPipelineLayout(m_device, m_pipelineLayout, NULL);
 	vkDestroyDescriptorPool(m_device, m_descriptorPool, NULL);
-	vkDestroyPipeline(m_device, m_pipeline, NULL);
+
+	if (!m_pPipelineCache) {
+		vkDestroyPipelineLayout(m_device, m_pipelineLayout, NULL);
+		vkDestroyPipeline(m_device, m_pipeline, NULL);
+	}
 }
 
 
-void GraphicsPipeline::Bind(VkCommandBuffer CmdBuf, int ImageIndex)
+void GraphicsPipeline::Bind(VkCommandBuffer CmdBuf, int ImageIndex, u32 DynamicOffset)
 {
 	vkCmdBindPipeline(CmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
 
@@ -192,34 +292,55 @@ void GraphicsPipeline::Bind(VkCommandBuffer CmdBuf, int ImageIndex)
 								0,  // firstSet
 								1,  // descriptorSetCount
 								&m_descriptorSets[ImageIndex], 
-								0,	// dynamicOffsetCount
-								NULL);	// pDynamicOffsets
+								m_dynamicUniforms ? 1 : 0,	// dynamicOffsetCount
+								m_dynamicUniforms ? &DynamicOffset : NULL);	// pDynamicOffsets
 	}	
+
+	if (m_pBindless) {
+		m_pBindless->Bind(CmdBuf, m_pipelineLayout);
+	}
 }
 
 
-void GraphicsPipeline::CreateDescriptorSets(const SimpleMesh* pMesh, int NumImages,
+void GraphicsPipeline::CreateDescriptorSets(const MeshBindings& Bindings, int NumImages,
 											std::vector<BufferAndMemory>& UniformBuffers, 
-											int UniformDataSize)
+											int UniformDataSize,
+											const UniformRingBuffer* pUniformRing)
 {
-	CreateDescriptorPool(NumImages);
+	bool HasUniforms = (UniformBuffers.size() > 0) || pUniformRing;
+
+	CreateDescriptorPool(Bindings, NumImages, HasUniforms);
 
-	CreateDescriptorSetLayout(UniformBuffers, UniformDataSize, pMesh->m_pTex);
+	CreateDescriptorSetLayout(Bindings, HasUniforms);
 
 	AllocateDescriptorSets(NumImages);
 
-	UpdateDescriptorSets(pMesh, NumImages, UniformBuffers, UniformDataSize);
+	UpdateDescriptorSets(Bindings, NumImages, UniformBuffers, UniformDataSize, pUniformRing);
 }
 
 
-void GraphicsPipeline::CreateDescriptorPool(int NumImages)
+void GraphicsPipeline::CreateDescriptorPool(const MeshBindings& Bindings, int NumImages, bool HasUniforms)
 {
+	std::vector<VkDescriptorPoolSize> PoolSizes;
+
+	u32 NumStorageBuffers = (Bindings.DrawData != VK_NULL_HANDLE) ? 2 : 1;
+	PoolSizes.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, NumStorageBuffers * NumImages });
+
+	if (HasUniforms) {
+		VkDescriptorType UniformType = m_dynamicUniforms ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		PoolSizes.push_back({ UniformType, (u32)NumImages });
+	}
+
+	if (Bindings.Textures.size() > 0) {
+		PoolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, (u32)(Bindings.Textures.size() * NumImages) });
+	}
+
 	VkDescriptorPoolCreateInfo PoolInfo = {
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
 		.flags = 0,
 		.maxSets = (u32)NumImages,
-		.poolSizeCount = 0,
-		.pPoolSizes = NULL
+		.poolSizeCount = (u32)PoolSizes.size(),
+		.pPoolSizes = PoolSizes.data()
 	};
 
 	VkResult res = vkCreateDescriptorPool(m_device, &PoolInfo, NULL, &m_descriptorPool);
@@ -228,8 +349,7 @@ void GraphicsPipeline::CreateDescriptorPool(int NumImages)
 }
 
 
-void GraphicsPipeline::CreateDescriptorSetLayout(std::vector<BufferAndMemory>& UniformBuffers, 
-												 int UniformDataSize, VulkanTexture* pTex)
+void GraphicsPipeline::CreateDescriptorSetLayout(const MeshBindings& Bindings, bool HasUniforms)
 {
 	std::vector<VkDescriptorSetLayoutBinding> LayoutBindings;
 
@@ -244,7 +364,7 @@ void GraphicsPipeline::CreateDescriptorSetLayout(std::vector<BufferAndMemory>& U
 	
 	VkDescriptorSetLayoutBinding VertexShaderLayoutBinding_Uniform = {
 		.binding = 1,
-		.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+		.descriptorType = m_dynamicUniforms ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 		.descriptorCount = 1,
 		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
 	};
@@ -252,18 +372,29 @@ void GraphicsPipeline::CreateDescriptorSetLayout(std::vector<BufferAndMemory>& U
 	VkDescriptorSetLayoutBinding FragmentShaderLayoutBinding = {
 		.binding = 2,
 		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-		.descriptorCount = 1,
+		.descriptorCount = (u32)Bindings.Textures.size(),
 		.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
 	};
 
-	if (UniformBuffers.size() > 0) {
+	VkDescriptorSetLayoutBinding VertexShaderLayoutBinding_DrawData = {
+		.binding = 3,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+	};
+
+	if (HasUniforms) {
 		LayoutBindings.push_back(VertexShaderLayoutBinding_Uniform);
 	}
 	
-	if (pTex) { 
+	if (Bindings.Textures.size() > 0) { 
 		LayoutBindings.push_back(FragmentShaderLayoutBinding);
 	}
 
+	if (Bindings.DrawData) {
+		LayoutBindings.push_back(VertexShaderLayoutBinding_DrawData);
+	}
+
 	VkDescriptorSetLayoutCreateInfo LayoutInfo = {
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
 		.pNext = NULL,
@@ -296,24 +427,39 @@ void GraphicsPipeline::AllocateDescriptorSets(int NumImages)
 }
 
 
-void GraphicsPipeline::UpdateDescriptorSets(const SimpleMesh* pMesh, int NumImages,
+void GraphicsPipeline::UpdateDescriptorSets(const MeshBindings& Bindings, int NumImages,
 											std::vector<BufferAndMemory>& UniformBuffers, 
-											int UniformDataSize)
+											int UniformDataSize,
+											const UniformRingBuffer* pUniformRing)
 {
 	VkDescriptorBufferInfo BufferInfo_VB = {
-		.buffer = pMesh->m_vb.m_buffer,
+		.buffer = Bindings.VB,
 		.offset = 0,
-		.range = pMesh->m_vertexBufferSize,  // can also be VK_WHOLE_SIZE
+		.range = Bindings.VBSize,  // can also be VK_WHOLE_SIZE
 	};
 	
-	VkDescriptorImageInfo ImageInfo;
+	std::vector<VkDescriptorImageInfo> ImageInfos(Bindings.Textures.size());
 	
-	if (pMesh->m_pTex) {
-		ImageInfo.sampler = pMesh->m_pTex->m_sampler;
-		ImageInfo.imageView = pMesh->m_pTex->m_view;
-		ImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	for (int i = 0; i < Bindings.Textures.size(); i++) {
+		ImageInfos[i].sampler = Bindings.Textures[i]->m_sampler;
+		ImageInfos[i].imageView = Bindings.Textures[i]->m_view;
+		ImageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 	}
+
+	VkDescriptorBufferInfo BufferInfo_DrawData = {
+		.buffer = Bindings.DrawData,
+		.offset = 0,
+		.range = Bindings.DrawDataSize,
+	};
 	
+	// With a ring buffer all the sets point to the same buffer and the
+	// frame/draw is selected by the dynamic offset in Bind()
+	VkDescriptorBufferInfo BufferInfo_Ring = {
+		.buffer = pUniformRing ? pUniformRing->GetBuffer() : VK_NULL_HANDLE,
+		.offset = 0,
+		.range = (VkDeviceSize)UniformDataSize,
+	};
+
 	std::vector<VkWriteDescriptorSet> WriteDescriptorSet;
 
 	for (size_t i = 0; i < NumImages; i++) {
@@ -330,7 +476,19 @@ void GraphicsPipeline::UpdateDescriptorSets(const SimpleMesh* pMesh, int NumImag
 			}
 		);
 
-		if (UniformBuffers.size() > 0) {
+		if (pUniformRing) {
+			WriteDescriptorSet.push_back(
+				VkWriteDescriptorSet{
+					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+					.dstSet = m_descriptorSets[i],
+					.dstBinding = 1,
+					.dstArrayElement = 0,
+					.descriptorCount = 1,
+					.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+					.pBufferInfo = &BufferInfo_Ring
+				}
+			);
+		} else if (UniformBuffers.size() > 0) {
 			VkDescriptorBufferInfo BufferInfo_Uniform = {
 				.buffer = UniformBuffers[i].m_buffer,
 				.offset = 0,
@@ -350,16 +508,30 @@ void GraphicsPipeline::UpdateDescriptorSets(const SimpleMesh* pMesh, int NumImag
 			);
 		}
 		
-		if (pMesh->m_pTex) {
+		if (ImageInfos.size() > 0) {
 			WriteDescriptorSet.push_back(
 				VkWriteDescriptorSet{
 					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
 					.dstSet = m_descriptorSets[i],
 					.dstBinding = 2,
 					.dstArrayElement = 0,
-					.descriptorCount = 1,
+					.descriptorCount = (u32)ImageInfos.size(),
 					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-					.pImageInfo = &ImageInfo
+					.pImageInfo = ImageInfos.data()
+				}
+			);
+		}
+
+		if (Bindings.DrawData) {
+			WriteDescriptorSet.push_back(
+				VkWriteDescriptorSet{
+					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+					.dstSet = m_descriptorSets[i],
+					.dstBinding = 3,
+					.dstArrayElement = 0,
+					.descriptorCount = 1,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+					.pBufferInfo = &BufferInfo_DrawData
 				}
 			);
 		}
@@ -0,0 +1,335 @@
+/*
+		Copyright 2024 Etay Meiri
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "3rdparty/stb_image.h"
+
+#include "ogldev_util.h"
+#include "ogldev_vulkan_util.h"
+#include "ogldev_vulkan_model.h"
+
+namespace OgldevVK {
+
+static std::string GetTexturePath(const std::string& Dir, const aiString& Path)
+{
+	std::string p(Path.data);
+
+	if (p == "C:\\\\") {
+		p = "";
+	} else if (p.substr(0, 2) == ".\\") {
+		p = p.substr(2, p.size() - 2);
+	}
+
+	return Dir + "/" + p;
+}
+
+
+bool VulkanModel::LoadModel(VulkanCore& VkCore, const char* pFilename)
+{
+	return LoadModel(VkCore, pFilename, ASSIMP_LOAD_FLAGS);
+}
+
+
+bool VulkanModel::LoadModel(VulkanCore& VkCore, const char* pFilename, int AssimpFlags)
+{
+	Assimp::Importer Importer;
+
+	const aiScene* pScene = Importer.ReadFile(pFilename, AssimpFlags);
+
+	if (!pScene) {
+		printf("Error parsing '%s': '%s'\n", pFilename, Importer.GetErrorString());
+		return false;
+	}
+
+	if (!m_pBindless && (pScene->mNumMaterials > MAX_MODEL_TEXTURES)) {
+		printf("'%s' has %d materials - only %d are supported\n", pFilename, pScene->mNumMaterials, MAX_MODEL_TEXTURES);
+		return false;
+	}
+
+	m_meshes.resize(pScene->mNumMeshes);
+
+	u32 NumVertices = 0;
+	u32 NumIndices = 0;
+
+	CountVerticesAndIndices(pScene, NumVertices, NumIndices);
+
+	if (NumIndices == 0) {
+		printf("'%s' doesn't contain any triangles\n", pFilename);
+		return false;
+	}
+
+	std::vector<Vertex> Vertices;
+	std::vector<u32> Indices;
+	Vertices.reserve(NumVertices);
+	Indices.reserve(NumIndices);
+
+	for (u32 i = 0; i < pScene->mNumMeshes; i++) {
+		InitSingleMesh(pScene->mMeshes[i], Vertices, Indices);
+	}
+
+	if (!InitMaterials(VkCore, pScene, pFilename)) {
+		return false;
+	}
+
+	m_multiDrawIndirect = VkCore.IsMultiDrawIndirectSupported();
+
+	CreateBuffers(VkCore, Vertices, Indices);
+
+	printf("Model '%s' loaded: %d vertices, %d indices, %d draws, %d materials\n", pFilename,
+		   NumVertices, NumIndices, (int)m_meshes.size(), pScene->mNumMaterials);
+
+	return true;
+}
+
+
+void VulkanModel::CountVerticesAndIndices(const aiScene* pScene, u32& NumVertices, u32& NumIndices)
+{
+	for (u32 i = 0; i < m_meshes.size(); i++) {
+		m_meshes[i].MaterialIndex = pScene->mMeshes[i]->mMaterialIndex;
+		m_meshes[i].NumIndices = pScene->mMeshes[i]->mNumFaces * 3;
+		m_meshes[i].BaseVertex = NumVertices;
+		m_meshes[i].BaseIndex = NumIndices;
+
+		NumVertices += pScene->mMeshes[i]->mNumVertices;
+		NumIndices += m_meshes[i].NumIndices;
+	}
+}
+
+
+void VulkanModel::InitSingleMesh(const aiMesh* paiMesh, std::vector<Vertex>& Vertices, std::vector<u32>& Indices)
+{
+	const aiVector3D Zero3D(0.0f, 0.0f, 0.0f);
+	const aiVector3D Up(0.0f, 1.0f, 0.0f);
+
+	for (u32 i = 0; i < paiMesh->mNumVertices; i++) {
+		const aiVector3D& Pos = paiMesh->mVertices[i];
+		const aiVector3D& Normal = paiMesh->mNormals ? paiMesh->mNormals[i] : Up;
+		const aiVector3D& TexCoord = paiMesh->HasTextureCoords(0) ? paiMesh->mTextureCoords[0][i] : Zero3D;
+
+		Vertex v = {
+			.Position = { Pos.x, Pos.y, Pos.z },
+			.TexCoords = { TexCoord.x, TexCoord.y },
+			.Normal = { Normal.x, Normal.y, Normal.z }
+		};
+
+		Vertices.push_back(v);
+	}
+
+	// The indices are relative to the sub-mesh. The BaseVertex of the draw is added by the GPU.
+	for (u32 i = 0; i < paiMesh->mNumFaces; i++) {
+		const aiFace& Face = paiMesh->mFaces[i];
+		Indices.push_back(Face.mIndices[0]);
+		Indices.push_back(Face.mIndices[1]);
+		Indices.push_back(Face.mIndices[2]);
+	}
+}
+
+
+bool VulkanModel::InitMaterials(VulkanCore& VkCore, const aiScene* pScene, const std::string& Filename)
+{
+	std::string Dir = GetDirFromFilename(Filename);
+
+	u32 White = 0xffffffff;
+	m_pDefaultTexture = new VulkanTexture;
+	VkCore.CreateTextureFromPixels(*m_pDefaultTexture, &White, 1, 1, false);
+
+	std::vector<VulkanTexture*> MaterialTextures(pScene->mNumMaterials, m_pDefaultTexture);
+
+	for (u32 i = 0; i < pScene->mNumMaterials; i++) {
+		VulkanTexture* pTex = LoadDiffuseTexture(VkCore, pScene, Dir, i);
+
+		if (pTex) {
+			MaterialTextures[i] = pTex;
+			m_loadedTextures.push_back(pTex);
+		}
+	}
+
+	// All the textures were recorded into the batches of the uploader
+	VkCore.GetUploader()->WaitAll();
+
+	if (m_pBindless) {
+		// The default texture gets a single slot which is shared by all the materials without a texture
+		u32 DefaultIndex = m_pBindless->AddTexture(*m_pDefaultTexture);
+
+		m_materialTextureIndices.resize(pScene->mNumMaterials);
+
+		for (u32 i = 0; i < pScene->mNumMaterials; i++) {
+			if (MaterialTextures[i] == m_pDefaultTexture) {
+				m_materialTextureIndices[i] = DefaultIndex;
+			} else {
+				m_materialTextureIndices[i] = m_pBindless->AddTexture(*MaterialTextures[i]);
+			}
+		}
+	} else {
+		m_textures.resize(MAX_MODEL_TEXTURES, m_pDefaultTexture);
+
+		for (u32 i = 0; i < pScene->mNumMaterials; i++) {
+			m_textures[i] = MaterialTextures[i];
+		}
+	}
+
+	return true;
+}
+
+
+VulkanTexture* VulkanModel::LoadDiffuseTexture(VulkanCore& VkCore, const aiScene* pScene, const std::string& Dir, int MaterialIndex)
+{
+	const aiMaterial* pMaterial = pScene->mMaterials[MaterialIndex];
+
+	if (pMaterial->GetTextureCount(aiTextureType_DIFFUSE) == 0) {
+		return NULL;
+	}
+
+	aiString Path;
+
+	if (pMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &Path, NULL, NULL, NULL, NULL, NULL) != AI_SUCCESS) {
+		return NULL;
+	}
+
+	const aiTexture* paiTexture = pScene->GetEmbeddedTexture(Path.C_Str());
+
+	if (!paiTexture) {
+		std::string FullPath = GetTexturePath(Dir, Path);
+
+		// CreateTexture exits on failure but a missing texture shouldn't prevent the model from loading
+		FILE* f = fopen(FullPath.c_str(), "rb");
+
+		if (!f) {
+			printf("Cannot find texture '%s'\n", FullPath.c_str());
+			return NULL;
+		}
+
+		fclose(f);
+
+		VulkanTexture* pTex = new VulkanTexture;
+		VkCore.CreateTexture(FullPath.c_str(), *pTex, false);
+		return pTex;
+	}
+
+	// Compressed embedded textures (mHeight == 0) are stored in their file format
+	if (paiTexture->mHeight != 0) {
+		printf("Uncompressed embedded texture '%s' is not supported\n", Path.C_Str());
+		return NULL;
+	}
+
+	int Width = 0;
+	int Height = 0;
+	int Channels = 0;
+
+	stbi_uc* pPixels = stbi_load_from_memory((const stbi_uc*)paiTexture->pcData, paiTexture->mWidth,
+											 &Width, &Height, &Channels, STBI_rgb_alpha);
+
+	if (!pPixels) {
+		printf("Error loading embedded texture '%s'\n", Path.C_Str());
+		return NULL;
+	}
+
+	VulkanTexture* pTex = new VulkanTexture;
+	VkCore.CreateTextureFromPixels(*pTex, pPixels, Width, Height, false);
+
+	stbi_image_free(pPixels);
+
+	return pTex;
+}
+
+
+void VulkanModel::CreateBuffers(VulkanCore& VkCore, const std::vector<Vertex>& Vertices, const std::vector<u32>& Indices)
+{
+	std::vector<VkDrawIndexedIndirectCommand> Commands(m_meshes.size());
+	std::vector<DrawData> Draws(m_meshes.size());
+
+	for (u32 i = 0; i < m_meshes.size(); i++) {
+		Commands[i] = {
+			.indexCount = m_meshes[i].NumIndices,
+			.instanceCount = 1,
+			.firstIndex = m_meshes[i].BaseIndex,
+			.vertexOffset = (int)m_meshes[i].BaseVertex,
+			.firstInstance = i		// index into the per-draw data
+		};
+
+		Draws[i].MaterialIndex = m_meshes[i].MaterialIndex;
+		Draws[i].TextureIndex = m_pBindless ? m_materialTextureIndices[m_meshes[i].MaterialIndex] : 0;
+	}
+
+	m_vertexBufferSize = sizeof(Vertex) * Vertices.size();
+	m_drawDataBufferSize = sizeof(DrawData) * Draws.size();
+
+	// Record all the uploads into the current batch and wait once
+	bool WaitForUpload = false;
+
+	m_vb = VkCore.CreateVertexBuffer(Vertices.data(), m_vertexBufferSize, WaitForUpload);
+
+	m_ib = VkCore.CreateDeviceLocalBuffer(Indices.data(), sizeof(u32) * Indices.size(),
+										  VK_BUFFER_USAGE_INDEX_BUFFER_BIT, WaitForUpload);
+
+	m_indirectBuffer = VkCore.CreateDeviceLocalBuffer(Commands.data(), sizeof(Commands[0]) * Commands.size(),
+													  VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, WaitForUpload);
+
+	m_drawDataBuffer = VkCore.CreateDeviceLocalBuffer(Draws.data(), m_drawDataBufferSize,
+													  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, WaitForUpload);
+
+	VkCore.GetUploader()->WaitAll();
+}
+
+
+void VulkanModel::RecordCommandBuffer(VkCommandBuffer CmdBuf) const
+{
+	vkCmdBindIndexBuffer(CmdBuf, m_ib.m_buffer, 0, VK_INDEX_TYPE_UINT32);
+
+	if (m_multiDrawIndirect) {
+		vkCmdDrawIndexedIndirect(CmdBuf, m_indirectBuffer.m_buffer, 0, (u32)m_meshes.size(),
+								 sizeof(VkDrawIndexedIndirectCommand));
+	} else {
+		// Same draws without the multiDrawIndirect and drawIndirectFirstInstance features
+		for (u32 i = 0; i < m_meshes.size(); i++) {
+			vkCmdDrawIndexed(CmdBuf, m_meshes[i].NumIndices, 1, m_meshes[i].BaseIndex,
+							 (int)m_meshes[i].BaseVertex, i);
+		}
+	}
+}
+
+
+void VulkanModel::Destroy(VkDevice Device)
+{
+	m_vb.Destroy(Device);
+	m_ib.Destroy(Device);
+	m_indirectBuffer.Destroy(Device);
+	m_drawDataBuffer.Destroy(Device);
+
+	for (int i = 0; i < m_loadedTextures.size(); i++) {
+		m_loadedTextures[i]->Destroy(Device);
+		delete m_loadedTextures[i];
+	}
+
+	if (m_pDefaultTexture) {
+		m_pDefaultTexture->Destroy(Device);
+		delete m_pDefaultTexture;
+	}
+
+	m_loadedTextures.clear();
+	m_textures.clear();
+	m_materialTextureIndices.clear();
+	m_meshes.clear();
+	m_pDefaultTexture = NULL;
+}
+
+}
@@ -0,0 +1,198 @@
+/*
+		Copyright 2024 Etay Meiri
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <algorithm>
+
+#include "ogldev_vulkan_util.h"
+#include "ogldev_vulkan_parallel_recorder.h"
+
+namespace OgldevVK {
+
+VulkanParallelRecorder::~VulkanParallelRecorder()
+{
+	Destroy();
+}
+
+
+void VulkanParallelRecorder::Init(VkDevice Device, u32 QueueFamily, int NumThreads, int NumFrames)
+{
+	m_device = Device;
+	m_numThreads = std::max(NumThreads, 1);
+	m_numFrames = NumFrames;
+
+	int NumCmdBufs = m_numFrames * m_numThreads;
+	m_cmdPools.resize(NumCmdBufs);
+	m_cmdBufs.resize(NumCmdBufs);
+
+	// The pools are reset as a whole every frame so the command buffers are transient
+	VkCommandPoolCreateInfo PoolCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.pNext = NULL,
+		.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+		.queueFamilyIndex = QueueFamily
+	};
+
+	for (int i = 0; i < NumCmdBufs; i++) {
+		VkResult res = vkCreateCommandPool(m_device, &PoolCreateInfo, NULL, &m_cmdPools[i]);
+		CHECK_VK_RESULT(res, "vkCreateCommandPool\n");
+
+		VkCommandBufferAllocateInfo AllocInfo = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.pNext = NULL,
+			.commandPool = m_cmdPools[i],
+			.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+			.commandBufferCount = 1
+		};
+
+		res = vkAllocateCommandBuffers(m_device, &AllocInfo, &m_cmdBufs[i]);
+		CHECK_VK_RESULT(res, "vkAllocateCommandBuffers\n");
+	}
+
+	m_quit = false;
+
+	for (int i = 1; i < m_numThreads; i++) {
+		m_threads.push_back(std::thread(&VulkanParallelRecorder::WorkerThread, this, i));
+	}
+
+	printf("Parallel recorder created with %d threads\n", m_numThreads);
+}
+
+
+void VulkanParallelRecorder::Destroy()
+{
+	if (m_threads.size() > 0) {
+		{
+			std::lock_guard<std::mutex> Lock(m_mutex);
+			m_quit = true;
+		}
+
+		m_startCond.notify_all();
+
+		for (int i = 0; i < (int)m_threads.size(); i++) {
+			m_threads[i].join();
+		}
+
+		m_threads.clear();
+	}
+
+	// Destroying a pool frees its command buffers
+	for (int i = 0; i < (int)m_cmdPools.size(); i++) {
+		vkDestroyCommandPool(m_device, m_cmdPools[i], NULL);
+	}
+
+	m_cmdPools.clear();
+	m_cmdBufs.clear();
+}
+
+
+void VulkanParallelRecorder::Record(int FrameIndex, VkRenderPass RenderPass, VkFramebuffer Framebuffer, int NumDraws,
+									const RecordCallback& Callback)
+{
+	{
+		std::lock_guard<std::mutex> Lock(m_mutex);
+		m_frameIndex = FrameIndex;
+		m_renderPass = RenderPass;
+		m_framebuffer = Framebuffer;
+		m_numDraws = NumDraws;
+		m_pCallback = &Callback;
+		m_numBusy = m_numThreads - 1;
+		m_job++;
+	}
+
+	m_startCond.notify_all();
+
+	RecordRange(0);
+
+	std::unique_lock<std::mutex> Lock(m_mutex);
+	m_doneCond.wait(Lock, [this] { return m_numBusy == 0; });
+}
+
+
+void VulkanParallelRecorder::ExecuteCommands(VkCommandBuffer PrimaryCmdBuf, int FrameIndex) const
+{
+	vkCmdExecuteCommands(PrimaryCmdBuf, m_numThreads, &m_cmdBufs[FrameIndex * m_numThreads]);
+}
+
+
+void VulkanParallelRecorder::WorkerThread(int ThreadIndex)
+{
+	u64 LastJob = 0;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> Lock(m_mutex);
+			m_startCond.wait(Lock, [&] { return m_quit || (m_job != LastJob); });
+
+			if (m_quit) {
+				return;
+			}
+
+			LastJob = m_job;
+		}
+
+		RecordRange(ThreadIndex);
+
+		{
+			std::lock_guard<std::mutex> Lock(m_mutex);
+			m_numBusy--;
+		}
+
+		m_doneCond.notify_one();
+	}
+}
+
+
+void VulkanParallelRecorder::RecordRange(int ThreadIndex)
+{
+	int DrawsPerThread = (m_numDraws + m_numThreads - 1) / m_numThreads;
+	int Start = std::min(ThreadIndex * DrawsPerThread, m_numDraws);
+	int End = std::min(Start + DrawsPerThread, m_numDraws);
+
+	int Index = m_frameIndex * m_numThreads + ThreadIndex;
+
+	VkResult res = vkResetCommandPool(m_device, m_cmdPools[Index], 0);
+	CHECK_VK_RESULT(res, "vkResetCommandPool\n");
+
+	VkCommandBufferInheritanceInfo InheritanceInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+		.pNext = NULL,
+		.renderPass = m_renderPass,
+		.subpass = 0,
+		.framebuffer = m_framebuffer
+	};
+
+	VkCommandBufferBeginInfo BeginInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = NULL,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+		.pInheritanceInfo = &InheritanceInfo
+	};
+
+	res = vkBeginCommandBuffer(m_cmdBufs[Index], &BeginInfo);
+	CHECK_VK_RESULT(res, "vkBeginCommandBuffer\n");
+
+	// A thread without draws still ends up with a valid (empty) command buffer
+	if (Start < End) {
+		(*m_pCallback)(m_cmdBufs[Index], ThreadIndex, Start, End);
+	}
+
+	res = vkEndCommandBuffer(m_cmdBufs[Index]);
+	CHECK_VK_RESULT(res, "vkEndCommandBuffer\n");
+}
+
+}
@@ -0,0 +1,260 @@
+/*
+		Copyright 2024 Etay Meiri
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <chrono>
+
+#include "ogldev_vulkan_util.h"
+#include "ogldev_vulkan_pipeline_cache.h"
+
+namespace OgldevVK {
+
+// Layout of the header that the driver puts at the start of the cache data (VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+struct PipelineCacheHeaderOne {
+	u32 HeaderSize;
+	u32 HeaderVersion;
+	u32 VendorID;
+	u32 DeviceID;
+	u8 PipelineCacheUUID[VK_UUID_SIZE];
+};
+
+
+static double GetTimeSecs()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+size_t VulkanPipelineCache::DescHash::operator()(const GraphicsPipelineDesc& Desc) const
+{
+	// 64 bit FNV-1a
+	const u8* p = (const u8*)&Desc;
+	u64 Hash = 14695981039346656037ULL;
+
+	for (size_t i = 0; i < sizeof(Desc); i++) {
+		Hash ^= p[i];
+		Hash *= 1099511628211ULL;
+	}
+
+	return (size_t)Hash;
+}
+
+
+bool VulkanPipelineCache::DescEqual::operator()(const GraphicsPipelineDesc& a, const GraphicsPipelineDesc& b) const
+{
+	return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+
+void VulkanPipelineCache::Init(VkDevice Device, const VkPhysicalDeviceProperties& DevProps, const char* pFilename)
+{
+	m_device = Device;
+	m_devProps = DevProps;
+	m_filename = pFilename;
+
+	std::vector<char> Data;
+
+	m_stats.LoadedFromDisk = LoadFile(Data);
+
+	VkPipelineCacheCreateInfo CacheCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.initialDataSize = m_stats.LoadedFromDisk ? Data.size() : 0,
+		.pInitialData = m_stats.LoadedFromDisk ? Data.data() : NULL
+	};
+
+	VkResult res = vkCreatePipelineCache(m_device, &CacheCreateInfo, NULL, &m_cache);
+	CHECK_VK_RESULT(res, "vkCreatePipelineCache\n");
+
+	if (m_stats.LoadedFromDisk) {
+		printf("Pipeline cache loaded from '%s' (%d bytes)\n", pFilename, (int)Data.size());
+	} else {
+		printf("Pipeline cache created empty\n");
+	}
+}
+
+
+// A missing file or a file from another device or driver is not an error - the cache starts empty
+bool VulkanPipelineCache::LoadFile(std::vector<char>& Data) const
+{
+	FILE* f = fopen(m_filename.c_str(), "rb");
+
+	if (!f) {
+		return false;
+	}
+
+	fseek(f, 0, SEEK_END);
+	long Size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	bool Success = (Size >= (long)sizeof(PipelineCacheHeaderOne));
+
+	if (Success) {
+		Data.resize(Size);
+		Success = (fread(Data.data(), Size, 1, f) == 1);
+	}
+
+	fclose(f);
+
+	if (!Success) {
+		printf("Pipeline cache '%s' is truncated - ignoring it\n", m_filename.c_str());
+		return false;
+	}
+
+	PipelineCacheHeaderOne Header;
+	memcpy(&Header, Data.data(), sizeof(Header));
+
+	if ((Header.HeaderVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) ||
+		(Header.HeaderSize < sizeof(PipelineCacheHeaderOne)) ||
+		(Header.VendorID != m_devProps.vendorID) ||
+		(Header.DeviceID != m_devProps.deviceID) ||
+		(memcmp(Header.PipelineCacheUUID, m_devProps.pipelineCacheUUID, VK_UUID_SIZE) != 0)) {
+		printf("Pipeline cache '%s' was created by another device or driver - ignoring it\n", m_filename.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+
+void VulkanPipelineCache::Save()
+{
+	size_t Size = 0;
+	VkResult res = vkGetPipelineCacheData(m_device, m_cache, &Size, NULL);
+	CHECK_VK_RESULT(res, "vkGetPipelineCacheData\n");
+
+	std::vector<char> Data(Size);
+	res = vkGetPipelineCacheData(m_device, m_cache, &Size, Data.data());
+	CHECK_VK_RESULT(res, "vkGetPipelineCacheData\n");
+
+	FILE* f = fopen(m_filename.c_str(), "wb");
+
+	if (!f) {
+		printf("Warning: cannot write the pipeline cache '%s'\n", m_filename.c_str());
+		return;
+	}
+
+	fwrite(Data.data(), 1, Size, f);
+	fclose(f);
+
+	printf("Pipeline cache saved to '%s' (%d bytes)\n", m_filename.c_str(), (int)Size);
+}
+
+
+void VulkanPipelineCache::Destroy()
+{
+	if (m_cache == VK_NULL_HANDLE) {
+		return;
+	}
+
+	PrintStats();
+
+	Save();
+
+	for (auto it = m_registry.begin(); it != m_registry.end(); it++) {
+		vkDestroyPipeline(m_device, it->second.Pipeline, NULL);
+		vkDestroyPipelineLayout(m_device, it->second.Layout, NULL);
+	}
+
+	m_registry.clear();
+
+	for (int i = 0; i < (int)m_retired.size(); i++) {
+		vkDestroyPipeline(m_device, m_retired[i].Pipeline, NULL);
+		vkDestroyPipelineLayout(m_device, m_retired[i].Layout, NULL);
+	}
+
+	m_retired.clear();
+
+	vkDestroyPipelineCache(m_device, m_cache, NULL);
+	m_cache = VK_NULL_HANDLE;
+}
+
+
+bool VulkanPipelineCache::Find(const GraphicsPipelineDesc& Desc, VkPipeline& Pipeline, VkPipelineLayout& Layout)
+{
+	auto it = m_registry.find(Desc);
+
+	if (it == m_registry.end()) {
+		return false;
+	}
+
+	Pipeline = it->second.Pipeline;
+	Layout = it->second.Layout;
+
+	m_stats.NumRegistryHits++;
+
+	return true;
+}
+
+
+VkPipeline VulkanPipelineCache::CreatePipeline(const GraphicsPipelineDesc& Desc, const VkGraphicsPipelineCreateInfo& PipelineInfo)
+{
+	double StartTime = GetTimeSecs();
+
+	VkPipeline Pipeline = VK_NULL_HANDLE;
+	VkResult res = vkCreateGraphicsPipelines(m_device, m_cache, 1, &PipelineInfo, NULL, &Pipeline);
+	CHECK_VK_RESULT(res, "vkCreateGraphicsPipelines\n");
+
+	m_stats.CreateTime += GetTimeSecs() - StartTime;
+	m_stats.NumPipelinesCreated++;
+
+	Entry& e = m_registry[Desc];
+	e.Pipeline = Pipeline;
+	e.Layout = PipelineInfo.layout;
+
+	return Pipeline;
+}
+
+
+template<typename Pred>
+void VulkanPipelineCache::RetireEntries(Pred ShouldRetire)
+{
+	auto it = m_registry.begin();
+
+	while (it != m_registry.end()) {
+		if (ShouldRetire(it->first)) {
+			m_retired.push_back(it->second);
+			it = m_registry.erase(it);
+		} else {
+			it++;
+		}
+	}
+}
+
+
+void VulkanPipelineCache::ReleaseShaderModule(VkShaderModule Module)
+{
+	RetireEntries([Module](const GraphicsPipelineDesc& Desc) { return (Desc.vs == Module) || (Desc.fs == Module); });
+}
+
+
+void VulkanPipelineCache::ReleaseRenderPass(VkRenderPass RenderPass)
+{
+	RetireEntries([RenderPass](const GraphicsPipelineDesc& Desc) { return Desc.RenderPass == RenderPass; });
+}
+
+
+void VulkanPipelineCache::PrintStats() const
+{
+	printf("Pipeline cache (%s): %d pipelines created in %.2f ms, %d registry hits\n",
+		   m_stats.LoadedFromDisk ? "warm" : "cold", m_stats.NumPipelinesCreated,
+		   m_stats.CreateTime * 1000.0, m_stats.NumRegistryHits);
+}
+
+}
@@ -16,6 +16,8 @@
 	along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <chrono>
+
 #include <vulkan/vulkan.h>
 
 #include "ogldev_vulkan_util.h"
@@ -25,7 +27,14 @@
 namespace OgldevVK {
 
 
-void VulkanQueue::Init(VkDevice Device, VkSwapchainKHR SwapChain, u32 QueueFamily, u32 QueueIndex)
+static double GetTimeSecs()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void VulkanQueue::Init(VkDevice Device, VkSwapchainKHR SwapChain, u32 QueueFamily, u32 QueueIndex,
+					   int NumImages, int NumFramesInFlight)
 {
 	m_device = Device;
 	m_swapChain = SwapChain;
@@ -34,21 +43,57 @@ void VulkanQueue::Init(VkDevice Device, VkSwapchainKHR SwapChain, u32 QueueFamil
 
 	printf("Queue acquired\n");
 
-	CreateSemaphores();
+	CreateSyncObjects(NumImages, NumFramesInFlight);
 }
 
 
 void VulkanQueue::Destroy()
 {
-	vkDestroySemaphore(m_device, m_presentCompleteSem, NULL);
-	vkDestroySemaphore(m_device, m_renderCompleteSem, NULL);
+	WaitIdle();
+
+	for (int i = 0; i < (int)m_frames.size(); i++) {
+		vkDestroySemaphore(m_device, m_frames[i].PresentCompleteSem, NULL);
+		vkDestroyFence(m_device, m_frames[i].InFlightFence, NULL);
+	}
+
+	for (int i = 0; i < (int)m_renderCompleteSems.size(); i++) {
+		vkDestroySemaphore(m_device, m_renderCompleteSems[i], NULL);
+	}
+
+	m_frames.clear();
+	m_renderCompleteSems.clear();
+	m_imageFences.clear();
 }
 
 
-void VulkanQueue::CreateSemaphores()
+void VulkanQueue::CreateSyncObjects(int NumImages, int NumFramesInFlight)
 {
-	m_presentCompleteSem = CreateSemaphore(m_device);
-	m_renderCompleteSem = CreateSemaphore(m_device);
+	// More frames than images doesn't buy anything - we would wait on the image fences anyway
+	if (NumFramesInFlight > NumImages) {
+		NumFramesInFlight = NumImages;
+	}
+
+	if (NumFramesInFlight < 1) {
+		NumFramesInFlight = 1;
+	}
+
+	m_frames.resize(NumFramesInFlight);
+
+	for (int i = 0; i < NumFramesInFlight; i++) {
+		m_frames[i].PresentCompleteSem = CreateSemaphore(m_device);
+		// Created signaled so the first wait on every slot returns immediately
+		m_frames[i].InFlightFence = CreateFence(m_device, true);
+	}
+
+	m_renderCompleteSems.resize(NumImages);
+
+	for (int i = 0; i < NumImages; i++) {
+		m_renderCompleteSems[i] = CreateSemaphore(m_device);
+	}
+
+	m_imageFences.resize(NumImages, VK_NULL_HANDLE);
+
+	printf("%d frames in flight\n", NumFramesInFlight);
 }
 
 
@@ -58,11 +103,45 @@ void VulkanQueue::WaitIdle()
 }
 
 
+void VulkanQueue::WaitForFence(VkFence Fence)
+{
+	double Start = GetTimeSecs();
+
+	VkResult res = vkWaitForFences(m_device, 1, &Fence, VK_TRUE, UINT64_MAX);
+	CHECK_VK_RESULT(res, "vkWaitForFences\n");
+
+	m_stats.FenceWaitTime += GetTimeSecs() - Start;
+}
+
+
 u32 VulkanQueue::AcquireNextImage()
 {
+	FrameSync& Frame = m_frames[m_frameIndex];
+
+	// Wait until the GPU is done with the frame that used this slot last time
+	WaitForFence(Frame.InFlightFence);
+
 	u32 ImageIndex = 0;
-	VkResult res = vkAcquireNextImageKHR(m_device, m_swapChain, UINT64_MAX, m_presentCompleteSem, NULL, &ImageIndex);
-	CHECK_VK_RESULT(res, "vkAcquireNextImageKHR\n");
+
+	if (m_swapChain == VK_NULL_HANDLE) {
+		ImageIndex = m_nextImageIndex;
+		m_nextImageIndex = (m_nextImageIndex + 1) % (u32)m_imageFences.size();
+	} else {
+		VkResult res = vkAcquireNextImageKHR(m_device, m_swapChain, UINT64_MAX, Frame.PresentCompleteSem, NULL, &ImageIndex);
+		CHECK_VK_RESULT(res, "vkAcquireNextImageKHR\n");
+	}
+
+	// The image can be returned before the frame that rendered into it has completed
+	// (when there are more images than frames in flight, or the images come out of order)
+	VkFence ImageFence = m_imageFences[ImageIndex];
+
+	if ((ImageFence != VK_NULL_HANDLE) && (ImageFence != Frame.InFlightFence)) {
+		WaitForFence(ImageFence);
+	}
+
+	m_imageFences[ImageIndex] = Frame.InFlightFence;
+	m_imageIndex = ImageIndex;
+
 	return ImageIndex;
 }
 
@@ -88,41 +167,61 @@ void VulkanQueue::SubmitSync(VkCommandBuffer CmbBuf)
 
 void VulkanQueue::SubmitAsync(VkCommandBuffer CmbBuf)
 {
+	FrameSync& Frame = m_frames[m_frameIndex];
+
 	VkPipelineStageFlags waitFlags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
+	// Headless - there is no presentation engine to synchronize with
+	u32 NumSemaphores = (m_swapChain != VK_NULL_HANDLE) ? 1 : 0;
+
 	VkSubmitInfo SubmitInfo = {
 		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
 		.pNext = NULL,
-		.waitSemaphoreCount = 1,
-		.pWaitSemaphores = &m_presentCompleteSem,
+		.waitSemaphoreCount = NumSemaphores,
+		.pWaitSemaphores = &Frame.PresentCompleteSem,
 		.pWaitDstStageMask = &waitFlags,
 		.commandBufferCount = 1,
 		.pCommandBuffers = &CmbBuf,
-		.signalSemaphoreCount = 1,				
-		.pSignalSemaphores = &m_renderCompleteSem		
+		.signalSemaphoreCount = NumSemaphores,
+		.pSignalSemaphores = &m_renderCompleteSems[m_imageIndex]
 	};
 
-	VkResult res = vkQueueSubmit(m_queue, 1, &SubmitInfo, NULL);
+	// Only reset the fence right before the submission that signals it
+	VkResult res = vkResetFences(m_device, 1, &Frame.InFlightFence);
+	CHECK_VK_RESULT(res, "vkResetFences\n");
+
+	res = vkQueueSubmit(m_queue, 1, &SubmitInfo, Frame.InFlightFence);
 	CHECK_VK_RESULT(res, "vkQueueSubmit\n");
 }
 
 
 void VulkanQueue::Present(u32 ImageIndex)
 {
-	VkPresentInfoKHR PresentInfo = {
-		.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-		.pNext = NULL,
-		.waitSemaphoreCount = 1,
-		.pWaitSemaphores = &m_renderCompleteSem,
-		.swapchainCount = 1,
-		.pSwapchains = &m_swapChain,
-		.pImageIndices = &ImageIndex
-	};
-
-	VkResult res = vkQueuePresentKHR(m_queue, &PresentInfo);
-	CHECK_VK_RESULT(res, "vkQueuePresentKHR\n");
-
-	WaitIdle();	// TODO: looks like a workaround but we're getting error messages without it
+	if (m_swapChain != VK_NULL_HANDLE) {
+		VkPresentInfoKHR PresentInfo = {
+			.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+			.pNext = NULL,
+			.waitSemaphoreCount = 1,
+			.pWaitSemaphores = &m_renderCompleteSems[ImageIndex],
+			.swapchainCount = 1,
+			.pSwapchains = &m_swapChain,
+			.pImageIndices = &ImageIndex
+		};
+
+		VkResult res = vkQueuePresentKHR(m_queue, &PresentInfo);
+		CHECK_VK_RESULT(res, "vkQueuePresentKHR\n");
+	}
+
+	m_frameIndex = (m_frameIndex + 1) % (int)m_frames.size();
+
+	double Now = GetTimeSecs();
+
+	if (m_lastPresentTime > 0.0) {
+		m_stats.FrameTime += Now - m_lastPresentTime;
+		m_stats.NumFrames++;
+	}
+
+	m_lastPresentTime = Now;
 }
 
 }
\ No newline at end of file
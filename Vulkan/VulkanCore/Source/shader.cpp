@@ -17,6 +17,8 @@
 */
 
 #include <stdio.h>
+#include <string.h>
+#include <chrono>
 #ifdef _WIN64
 #include <direct.h>
 #endif
@@ -34,20 +36,30 @@
 
 namespace OgldevVK {
 
-struct Shader
-{
-	std::vector<u32> SPIRV;
-	VkShaderModule ShaderModule = NULL;
-
-	void Initialize(glslang_program_t* program)
-	{
-		size_t program_size = glslang_program_SPIRV_get_size(program);
-		SPIRV.resize(program_size);
-		glslang_program_SPIRV_get(program, SPIRV.data());
-	}
+#define SHADER_CACHE_MAGIC   0x48435053		// 'SPCH'
+#define SHADER_CACHE_VERSION 1				// bump when the compile options or glslang change
+
+//
+// Cache file layout: ShaderCacheHeader followed by CodeSize bytes of SPIR-V.
+// The cache of 'foo.vert' is 'foo.vert.spvcache'. There is no #include support
+// so the source and the compile options fully determine the output of the
+// preprocessor and hashing them lets a warm run skip glslang entirely.
+//
+struct ShaderCacheHeader {
+	u32 Magic = SHADER_CACHE_MAGIC;
+	u32 Version = SHADER_CACHE_VERSION;
+	u64 Hash = 0;
+	u32 CodeSize = 0;
+	u32 Padding = 0;
 };
 
 
+static double GetTimeMs()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
 static void PrintShaderSource(const char* text)
 {
 	int line = 1;
@@ -71,7 +83,7 @@ static void PrintShaderSource(const char* text)
 }
 
 
-static bool CompileShader(VkDevice Device, glslang_stage_t Stage, const char* pShaderCode, Shader& ShaderModule)
+static glslang_input_t GetCompileOptions(glslang_stage_t Stage, const char* pShaderCode)
 {
 	glslang_input_t input = {
 		.language = GLSLANG_SOURCE_GLSL,
@@ -89,6 +101,54 @@ static bool CompileShader(VkDevice Device, glslang_stage_t Stage, const char* pS
 		.resource = glslang_default_resource()
 	};
 
+	return input;
+}
+
+
+// 64 bit FNV-1a
+static u64 HashBytes(u64 Hash, const void* pData, size_t Size)
+{
+	const u8* p = (const u8*)pData;
+
+	for (size_t i = 0; i < Size; i++) {
+		Hash ^= p[i];
+		Hash *= 1099511628211ULL;
+	}
+
+	return Hash;
+}
+
+
+static u64 CalcShaderHash(const glslang_input_t& Input)
+{
+	// Everything that affects the generated code
+	int Options[] = {
+		SHADER_CACHE_VERSION,
+		(int)Input.language,
+		(int)Input.stage,
+		(int)Input.client,
+		(int)Input.client_version,
+		(int)Input.target_language,
+		(int)Input.target_language_version,
+		Input.default_version,
+		(int)Input.default_profile,
+		(int)Input.force_default_version_and_profile,
+		(int)Input.forward_compatible,
+		(int)Input.messages
+	};
+
+	u64 Hash = 14695981039346656037ULL;
+	Hash = HashBytes(Hash, Options, sizeof(Options));
+	Hash = HashBytes(Hash, Input.code, strlen(Input.code));
+
+	return Hash;
+}
+
+
+static bool CompileShader(glslang_stage_t Stage, const char* pShaderCode, std::vector<u32>& SPIRV)
+{
+	glslang_input_t input = GetCompileOptions(Stage, pShaderCode);
+
 	glslang_shader_t* shader = glslang_shader_create(&input);
 
 	if (!glslang_shader_preprocess(shader, &input))	{
@@ -119,7 +179,9 @@ static bool CompileShader(VkDevice Device, glslang_stage_t Stage, const char* pS
 
 	glslang_program_SPIRV_generate(program, Stage);
 
-	ShaderModule.Initialize(program);
+	size_t program_size = glslang_program_SPIRV_get_size(program);
+	SPIRV.resize(program_size);
+	glslang_program_SPIRV_get(program, SPIRV.data());
 
 	const char* spirv_messages = glslang_program_SPIRV_get_messages(program);
 
@@ -127,21 +189,76 @@ static bool CompileShader(VkDevice Device, glslang_stage_t Stage, const char* pS
 		fprintf(stderr, "SPIR-V message: '%s'", spirv_messages);
 	}
 
+	glslang_program_delete(program);
+	glslang_shader_delete(shader);
+
+	bool ret = SPIRV.size() > 0;
+
+	return ret;
+}
+
+
+static VkShaderModule CreateShaderModule(VkDevice Device, const std::vector<u32>& SPIRV)
+{
 	VkShaderModuleCreateInfo shaderCreateInfo = {
 		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-		.codeSize = ShaderModule.SPIRV.size() * sizeof(uint32_t),
-		.pCode = (const uint32_t*)ShaderModule.SPIRV.data()
+		.codeSize = SPIRV.size() * sizeof(uint32_t),
+		.pCode = (const uint32_t*)SPIRV.data()
 	};
 
-	VkResult res = vkCreateShaderModule(Device, &shaderCreateInfo, NULL, &ShaderModule.ShaderModule);
+	VkShaderModule ShaderModule = NULL;
+	VkResult res = vkCreateShaderModule(Device, &shaderCreateInfo, NULL, &ShaderModule);
 	CHECK_VK_RESULT(res, "vkCreateShaderModule\n");
 
-	glslang_program_delete(program);
-	glslang_shader_delete(shader);
+	return ShaderModule;
+}
 
-	bool ret = ShaderModule.SPIRV.size() > 0;
 
-	return ret;
+// A missing, stale or corrupted cache file is not an error - the shader is simply recompiled
+static bool LoadShaderCache(const char* pCacheFilename, u64 Hash, std::vector<u32>& SPIRV)
+{
+	FILE* f = fopen(pCacheFilename, "rb");
+
+	if (!f) {
+		return false;
+	}
+
+	ShaderCacheHeader Header;
+
+	bool Success = (fread(&Header, sizeof(Header), 1, f) == 1) &&
+				   (Header.Magic == SHADER_CACHE_MAGIC) &&
+				   (Header.Version == SHADER_CACHE_VERSION) &&
+				   (Header.Hash == Hash) &&
+				   (Header.CodeSize > 0) && (Header.CodeSize % sizeof(u32) == 0);
+
+	if (Success) {
+		SPIRV.resize(Header.CodeSize / sizeof(u32));
+		Success = (fread(SPIRV.data(), Header.CodeSize, 1, f) == 1);
+	}
+
+	fclose(f);
+
+	return Success;
+}
+
+
+static void SaveShaderCache(const char* pCacheFilename, u64 Hash, const std::vector<u32>& SPIRV)
+{
+	FILE* f = fopen(pCacheFilename, "wb");
+
+	if (!f) {
+		printf("Warning: cannot write the shader cache '%s'\n", pCacheFilename);
+		return;
+	}
+
+	ShaderCacheHeader Header;
+	Header.Hash = Hash;
+	Header.CodeSize = (u32)(SPIRV.size() * sizeof(u32));
+
+	fwrite(&Header, sizeof(Header), 1, f);
+	fwrite(SPIRV.data(), Header.CodeSize, 1, f);
+
+	fclose(f);
 }
 
 
@@ -180,47 +297,88 @@ static glslang_stage_t ShaderStageFromFilename(const char* pFilename)
 }
 
 
-VkShaderModule CreateShaderModuleFromText(VkDevice Device, const char* pFilename)
+static bool CompileShaderFileCached(const char* pFilename, std::vector<u32>& SPIRV, bool& CacheHit)
 {
 	std::string Source;
 
-	char CurWorkDir[256];
+	if (!ReadFile(pFilename, Source)) {
+		char CurWorkDir[256];
 #ifdef _WIN64
-	_getcwd(&CurWorkDir[0], ARRAY_SIZE_IN_ELEMENTS(CurWorkDir));
+		_getcwd(&CurWorkDir[0], ARRAY_SIZE_IN_ELEMENTS(CurWorkDir));
 #else
-	getcwd(&CurWorkDir[0], ARRAY_SIZE_IN_ELEMENTS(CurWorkDir));
+		getcwd(&CurWorkDir[0], ARRAY_SIZE_IN_ELEMENTS(CurWorkDir));
 #endif
-
-	if (!ReadFile(pFilename, Source)) {
 		printf("Current work dir: %s\n", CurWorkDir);
 
 		assert(0);
+		return false;
 	}
 
-	Shader ShaderModule;
-
 	glslang_stage_t ShaderStage = ShaderStageFromFilename(pFilename);
 
-	VkShaderModule ret = NULL;
+	glslang_input_t Input = GetCompileOptions(ShaderStage, Source.c_str());
+	u64 Hash = CalcShaderHash(Input);
+
+	std::string CacheFilename = string(pFilename) + ".spvcache";
+
+	CacheHit = LoadShaderCache(CacheFilename.c_str(), Hash, SPIRV);
+
+	if (CacheHit) {
+		return true;
+	}
 
 	glslang_initialize_process();
 
-	bool Success = CompileShader(Device, ShaderStage, Source.c_str(), ShaderModule);	
+	bool Success = CompileShader(ShaderStage, Source.c_str(), SPIRV);
+
+	glslang_finalize_process();
 
 	if (Success) {
-		printf("Created shader from text file '%s\\%s'\n", CurWorkDir, pFilename);
-		ret = ShaderModule.ShaderModule;
+		SaveShaderCache(CacheFilename.c_str(), Hash, SPIRV);
+
 		std::string BinaryFilename = string(pFilename) + ".spv";
-		WriteBinaryFile(BinaryFilename.c_str(), ShaderModule.SPIRV.data(), 
-						(int)ShaderModule.SPIRV.size() * sizeof(uint32_t));
+		WriteBinaryFile(BinaryFilename.c_str(), SPIRV.data(), (int)SPIRV.size() * sizeof(uint32_t));
 	}
 
-	glslang_finalize_process();
+	return Success;
+}
+
+
+VkShaderModule CreateShaderModuleFromText(VkDevice Device, const char* pFilename)
+{
+	double StartTime = GetTimeMs();
+
+	std::vector<u32> SPIRV;
+	bool CacheHit = false;
+
+	if (!CompileShaderFileCached(pFilename, SPIRV, CacheHit)) {
+		return NULL;
+	}
+
+	VkShaderModule ret = CreateShaderModule(Device, SPIRV);
+
+	printf("Created shader from text file '%s' (%s, %.2f ms)\n", pFilename,
+		   CacheHit ? "SPIR-V cache" : "compiled", GetTimeMs() - StartTime);
 
 	return ret;
 }
 
 
+bool PrecompileShader(const char* pFilename)
+{
+	std::vector<u32> SPIRV;
+	bool CacheHit = false;
+
+	bool Success = CompileShaderFileCached(pFilename, SPIRV, CacheHit);
+
+	if (Success) {
+		printf("%s: %s\n", pFilename, CacheHit ? "up to date" : "compiled");
+	}
+
+	return Success;
+}
+
+
 VkShaderModule CreateShaderModuleFromBinary(VkDevice Device, const char* pFilename)
 {
 	int codeSize = 0;
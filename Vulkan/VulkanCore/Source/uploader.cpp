@@ -0,0 +1,557 @@
+/*
+		Copyright 2024 Etay Meiri
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ogldev_util.h"
+#include "ogldev_vulkan_util.h"
+#include "ogldev_vulkan_wrapper.h"
+#include "ogldev_vulkan_uploader.h"
+
+namespace OgldevVK {
+
+// Every way the uploaded buffers are read - vertex/index/uniform/storage buffers
+// and the indirect draw commands of vkCmdDrawIndexedIndirect
+static const VkAccessFlags BUFFER_READ_ACCESS = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+												VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+static const VkPipelineStageFlags BUFFER_READ_STAGES = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+													   VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+
+
+void VulkanUploader::Init(VkDevice Device, u32 GraphicsQueueFamily, u32 TransferQueueFamily,
+						  VkBuffer StagingBuffer, void* pStagingMem, VkDeviceSize StagingSize)
+{
+	if (!pStagingMem) {
+		OGLDEV_ERROR0("The staging buffer of the uploader must be mapped\n");
+		exit(1);
+	}
+
+	m_device = Device;
+	m_graphicsQueueFamily = GraphicsQueueFamily;
+	m_transferQueueFamily = TransferQueueFamily;
+	m_stagingBuffer = StagingBuffer;
+	m_pStagingMem = (u8*)pStagingMem;
+	m_ringSize = StagingSize;
+
+	vkGetDeviceQueue(m_device, m_graphicsQueueFamily, 0, &m_graphicsQueue);
+	vkGetDeviceQueue(m_device, m_transferQueueFamily, 0, &m_transferQueue);
+
+	m_transferCmdPool = CreateCommandPool(m_transferQueueFamily);
+
+	if (HasDedicatedTransferQueue()) {
+		m_graphicsCmdPool = CreateCommandPool(m_graphicsQueueFamily);
+	}
+
+	for (int i = 0; i < NUM_UPLOAD_BATCHES; i++) {
+		Batch& B = m_batches[i];
+
+		VkCommandBufferAllocateInfo CmdBufAllocInfo = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.pNext = NULL,
+			.commandPool = m_transferCmdPool,
+			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1
+		};
+
+		VkResult res = vkAllocateCommandBuffers(m_device, &CmdBufAllocInfo, &B.TransferCmdBuf);
+		CHECK_VK_RESULT(res, "vkAllocateCommandBuffers\n");
+
+		if (HasDedicatedTransferQueue()) {
+			CmdBufAllocInfo.commandPool = m_graphicsCmdPool;
+			res = vkAllocateCommandBuffers(m_device, &CmdBufAllocInfo, &B.GraphicsCmdBuf);
+			CHECK_VK_RESULT(res, "vkAllocateCommandBuffers\n");
+
+			B.TransferDoneSem = CreateSemaphore(m_device);
+		}
+
+		B.Fence = CreateFence(m_device, false);
+	}
+
+	printf("Uploader created: %d MB staging ring, %s\n", (int)(m_ringSize / (1024 * 1024)),
+		   HasDedicatedTransferQueue() ? "dedicated transfer queue" : "graphics queue");
+}
+
+
+VkCommandPool VulkanUploader::CreateCommandPool(u32 QueueFamily)
+{
+	VkCommandPoolCreateInfo CmdPoolCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.pNext = NULL,
+		.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		.queueFamilyIndex = QueueFamily
+	};
+
+	VkCommandPool CmdPool = VK_NULL_HANDLE;
+	VkResult res = vkCreateCommandPool(m_device, &CmdPoolCreateInfo, NULL, &CmdPool);
+	CHECK_VK_RESULT(res, "vkCreateCommandPool\n");
+
+	return CmdPool;
+}
+
+
+void VulkanUploader::Destroy()
+{
+	if (m_device == VK_NULL_HANDLE) {
+		return;
+	}
+
+	WaitAll();
+
+	for (int i = 0; i < NUM_UPLOAD_BATCHES; i++) {
+		vkDestroyFence(m_device, m_batches[i].Fence, NULL);
+
+		if (m_batches[i].TransferDoneSem) {
+			vkDestroySemaphore(m_device, m_batches[i].TransferDoneSem, NULL);
+		}
+	}
+
+	// Also frees the command buffers
+	vkDestroyCommandPool(m_device, m_transferCmdPool, NULL);
+
+	if (m_graphicsCmdPool) {
+		vkDestroyCommandPool(m_device, m_graphicsCmdPool, NULL);
+	}
+
+	m_device = VK_NULL_HANDLE;
+}
+
+
+VulkanUploader::Batch& VulkanUploader::BeginRecording()
+{
+	Batch& B = m_batches[m_curBatch];
+
+	if (B.State == BATCH_STATE_RECORDING) {
+		return B;
+	}
+
+	// Flush retires the slot before it starts recording into it
+	BeginCommandBuffer(B.TransferCmdBuf, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+	if (HasDedicatedTransferQueue()) {
+		BeginCommandBuffer(B.GraphicsCmdBuf, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	}
+
+	B.State = BATCH_STATE_RECORDING;
+	B.Id = m_nextBatchId;
+	B.StagingUsed = 0;
+	B.HasBufferCopies = false;
+
+	return B;
+}
+
+
+bool VulkanUploader::TryAllocStaging(VkDeviceSize Size, VkDeviceSize Alignment, VkDeviceSize& Offset)
+{
+	if (m_used == 0) {
+		m_head = 0;
+		m_tail = 0;
+	}
+
+	VkDeviceSize Start = (m_head + Alignment - 1) / Alignment * Alignment;
+	VkDeviceSize Cost = 0;
+
+	if ((m_used == 0) || (m_head > m_tail)) {
+		// The free space is [head, end of the ring) and [0, tail)
+		if (Start + Size <= m_ringSize) {
+			Offset = Start;
+			Cost = Start - m_head + Size;
+		} else if (Size <= m_tail) {
+			// Wrap around - the end of the ring is wasted until the batch completes
+			Offset = 0;
+			Cost = m_ringSize - m_head + Size;
+		} else {
+			return false;
+		}
+	} else {
+		// The free space is [head, tail)
+		if (Start + Size <= m_tail) {
+			Offset = Start;
+			Cost = Start - m_head + Size;
+		} else {
+			return false;
+		}
+	}
+
+	m_head = Offset + Size;
+	m_used += Cost;
+
+	// The cost is charged to the batch that records the copy which
+	// may be a new one if AllocStaging had to flush
+	m_batches[m_curBatch].StagingUsed += Cost;
+
+	return true;
+}
+
+
+u8* VulkanUploader::AllocStaging(VkDeviceSize Size, VkDeviceSize Alignment, VkDeviceSize& Offset)
+{
+	if (Size > m_ringSize) {
+		OGLDEV_ERROR("Staging allocation of %lld bytes is larger than the ring (%lld bytes)\n",
+					 (long long)Size, (long long)m_ringSize);
+		exit(1);
+	}
+
+	// Make sure the batch which is charged for the memory is recording
+	BeginRecording();
+
+	while (!TryAllocStaging(Size, Alignment, Offset)) {
+		if (m_batches[m_curBatch].StagingUsed > 0) {
+			// Submit the copies recorded so far so the GPU starts consuming the ring
+			Flush();
+			BeginRecording();
+		} else if (!RetireOldest()) {
+			OGLDEV_ERROR("Cannot allocate %lld bytes from the staging ring\n", (long long)Size);
+			exit(1);
+		}
+	}
+
+	return m_pStagingMem + Offset;
+}
+
+
+u64 VulkanUploader::UploadBuffer(VkBuffer Dst, const void* pData, VkDeviceSize Size)
+{
+	// Large buffers are split so the GPU can start copying while the ring is refilled
+	const VkDeviceSize MaxChunkSize = m_ringSize / 4;
+
+	VkDeviceSize DstOffset = 0;
+
+	while (DstOffset < Size) {
+		VkDeviceSize ChunkSize = Size - DstOffset;
+
+		if (ChunkSize > MaxChunkSize) {
+			ChunkSize = MaxChunkSize;
+		}
+
+		VkDeviceSize SrcOffset = 0;
+		u8* pMem = AllocStaging(ChunkSize, 16, SrcOffset);
+		memcpy(pMem, (const u8*)pData + DstOffset, ChunkSize);
+
+		Batch& B = m_batches[m_curBatch];
+
+		VkBufferCopy BufferCopy = {
+			.srcOffset = SrcOffset,
+			.dstOffset = DstOffset,
+			.size = ChunkSize
+		};
+
+		vkCmdCopyBuffer(B.TransferCmdBuf, m_stagingBuffer, Dst, 1, &BufferCopy);
+
+		B.HasBufferCopies = true;
+
+		DstOffset += ChunkSize;
+	}
+
+	Batch& B = BeginRecording();
+
+	if (HasDedicatedTransferQueue()) {
+		ReleaseBuffer(B, Dst);
+	}
+
+	return B.Id;
+}
+
+
+u64 VulkanUploader::UploadImage(VkImage Dst, u32 Width, u32 Height, VkFormat Format, const void* pPixels)
+{
+	int BytesPerPixel = GetBytesPerTexFormat(Format);
+
+	VkDeviceSize RowPitch = (VkDeviceSize)Width * BytesPerPixel;
+
+	// The buffer offset of a copy must be a multiple of both the texel size and 4
+	VkDeviceSize Alignment = BytesPerPixel * 4;
+
+	// Large images are copied a few rows at a time
+	u32 RowsPerChunk = (u32)((m_ringSize / 4) / RowPitch);
+
+	if (RowsPerChunk == 0) {
+		RowsPerChunk = 1;
+	}
+
+	for (u32 y = 0; y < Height; y += RowsPerChunk) {
+		u32 NumRows = (Height - y < RowsPerChunk) ? (Height - y) : RowsPerChunk;
+		VkDeviceSize ChunkSize = RowPitch * NumRows;
+
+		VkDeviceSize SrcOffset = 0;
+		u8* pMem = AllocStaging(ChunkSize, Alignment, SrcOffset);
+		memcpy(pMem, (const u8*)pPixels + y * RowPitch, ChunkSize);
+
+		Batch& B = m_batches[m_curBatch];
+
+		if (y == 0) {
+			ImageMemBarrier(B.TransferCmdBuf, Dst, Format,
+							VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		}
+
+		VkBufferImageCopy BufferImageCopy = {
+			.bufferOffset = SrcOffset,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource = VkImageSubresourceLayers {
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.mipLevel = 0,
+				.baseArrayLayer = 0,
+				.layerCount = 1
+			},
+			.imageOffset = VkOffset3D {.x = 0, .y = (int)y, .z = 0 },
+			.imageExtent = VkExtent3D {.width = Width, .height = NumRows, .depth = 1 }
+		};
+
+		vkCmdCopyBufferToImage(B.TransferCmdBuf, m_stagingBuffer, Dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+							   1, &BufferImageCopy);
+	}
+
+	Batch& B = BeginRecording();
+
+	if (HasDedicatedTransferQueue()) {
+		ReleaseImage(B, Dst);
+	} else {
+		ImageMemBarrier(B.TransferCmdBuf, Dst, Format,
+						VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+
+	return B.Id;
+}
+
+
+// Queue family ownership transfer - the release half is recorded on the transfer
+// queue and the matching acquire half on the graphics queue
+void VulkanUploader::ReleaseBuffer(Batch& B, VkBuffer Buffer)
+{
+	VkBufferMemoryBarrier Barrier = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.pNext = NULL,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = 0,
+		.srcQueueFamilyIndex = m_transferQueueFamily,
+		.dstQueueFamilyIndex = m_graphicsQueueFamily,
+		.buffer = Buffer,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE
+	};
+
+	vkCmdPipelineBarrier(B.TransferCmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+						 0, 0, NULL, 1, &Barrier, 0, NULL);
+
+	Barrier.srcAccessMask = 0;
+	Barrier.dstAccessMask = BUFFER_READ_ACCESS;
+
+	vkCmdPipelineBarrier(B.GraphicsCmdBuf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, BUFFER_READ_STAGES,
+						 0, 0, NULL, 1, &Barrier, 0, NULL);
+}
+
+
+void VulkanUploader::ReleaseImage(Batch& B, VkImage Image)
+{
+	VkImageMemoryBarrier Barrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.pNext = NULL,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = 0,
+		.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		.srcQueueFamilyIndex = m_transferQueueFamily,
+		.dstQueueFamilyIndex = m_graphicsQueueFamily,
+		.image = Image,
+		.subresourceRange = VkImageSubresourceRange {
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.baseMipLevel = 0,
+			.levelCount = 1,
+			.baseArrayLayer = 0,
+			.layerCount = 1
+		}
+	};
+
+	vkCmdPipelineBarrier(B.TransferCmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+						 0, 0, NULL, 0, NULL, 1, &Barrier);
+
+	Barrier.srcAccessMask = 0;
+	Barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(B.GraphicsCmdBuf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+						 0, 0, NULL, 0, NULL, 1, &Barrier);
+}
+
+
+u64 VulkanUploader::Flush()
+{
+	Batch& B = m_batches[m_curBatch];
+
+	if ((B.State != BATCH_STATE_RECORDING) || (B.StagingUsed == 0)) {
+		return m_lastSubmittedId;
+	}
+
+	if (B.HasBufferCopies && !HasDedicatedTransferQueue()) {
+		// Later submissions on the same queue are ordered after this barrier
+		VkMemoryBarrier Barrier = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.pNext = NULL,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = BUFFER_READ_ACCESS
+		};
+
+		vkCmdPipelineBarrier(B.TransferCmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, BUFFER_READ_STAGES,
+							 0, 1, &Barrier, 0, NULL, 0, NULL);
+	}
+
+	VkResult res = vkEndCommandBuffer(B.TransferCmdBuf);
+	CHECK_VK_RESULT(res, "vkEndCommandBuffer\n");
+
+	res = vkResetFences(m_device, 1, &B.Fence);
+	CHECK_VK_RESULT(res, "vkResetFences\n");
+
+	VkSubmitInfo SubmitInfo = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = NULL,
+		.waitSemaphoreCount = 0,
+		.pWaitSemaphores = NULL,
+		.pWaitDstStageMask = NULL,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &B.TransferCmdBuf,
+		.signalSemaphoreCount = 0,
+		.pSignalSemaphores = NULL
+	};
+
+	if (HasDedicatedTransferQueue()) {
+		res = vkEndCommandBuffer(B.GraphicsCmdBuf);
+		CHECK_VK_RESULT(res, "vkEndCommandBuffer\n");
+
+		SubmitInfo.signalSemaphoreCount = 1;
+		SubmitInfo.pSignalSemaphores = &B.TransferDoneSem;
+
+		res = vkQueueSubmit(m_transferQueue, 1, &SubmitInfo, VK_NULL_HANDLE);
+		CHECK_VK_RESULT(res, "vkQueueSubmit\n");
+
+		VkPipelineStageFlags WaitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+		VkSubmitInfo AcquireSubmitInfo = {
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.pNext = NULL,
+			.waitSemaphoreCount = 1,
+			.pWaitSemaphores = &B.TransferDoneSem,
+			.pWaitDstStageMask = &WaitStage,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &B.GraphicsCmdBuf,
+			.signalSemaphoreCount = 0,
+			.pSignalSemaphores = NULL
+		};
+
+		res = vkQueueSubmit(m_graphicsQueue, 1, &AcquireSubmitInfo, B.Fence);
+		CHECK_VK_RESULT(res, "vkQueueSubmit\n");
+	} else {
+		res = vkQueueSubmit(m_transferQueue, 1, &SubmitInfo, B.Fence);
+		CHECK_VK_RESULT(res, "vkQueueSubmit\n");
+	}
+
+	B.State = BATCH_STATE_SUBMITTED;
+	m_lastSubmittedId = B.Id;
+	m_nextBatchId++;
+	m_numSubmissions++;
+
+	// The next slot is the oldest batch in flight if all the slots are in use
+	m_curBatch = (m_curBatch + 1) % NUM_UPLOAD_BATCHES;
+
+	Batch& Next = m_batches[m_curBatch];
+
+	if (Next.State == BATCH_STATE_SUBMITTED) {
+		res = vkWaitForFences(m_device, 1, &Next.Fence, VK_TRUE, UINT64_MAX);
+		CHECK_VK_RESULT(res, "vkWaitForFences\n");
+		Retire(Next);
+	}
+
+	return m_lastSubmittedId;
+}
+
+
+void VulkanUploader::Retire(Batch& B)
+{
+	m_tail = (m_tail + B.StagingUsed) % m_ringSize;
+	m_used -= B.StagingUsed;
+	m_lastCompletedId = B.Id;
+
+	B.State = BATCH_STATE_FREE;
+	B.StagingUsed = 0;
+}
+
+
+// The batches are submitted in order starting after the current slot
+bool VulkanUploader::RetireOldest()
+{
+	for (int i = 1; i < NUM_UPLOAD_BATCHES; i++) {
+		Batch& B = m_batches[(m_curBatch + i) % NUM_UPLOAD_BATCHES];
+
+		if (B.State == BATCH_STATE_SUBMITTED) {
+			VkResult res = vkWaitForFences(m_device, 1, &B.Fence, VK_TRUE, UINT64_MAX);
+			CHECK_VK_RESULT(res, "vkWaitForFences\n");
+			Retire(B);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+void VulkanUploader::RetireCompleted()
+{
+	for (int i = 1; i < NUM_UPLOAD_BATCHES; i++) {
+		Batch& B = m_batches[(m_curBatch + i) % NUM_UPLOAD_BATCHES];
+
+		if (B.State != BATCH_STATE_SUBMITTED) {
+			continue;
+		}
+
+		// Keep the ring in order - stop at the first batch which is still running
+		if (vkGetFenceStatus(m_device, B.Fence) != VK_SUCCESS) {
+			break;
+		}
+
+		Retire(B);
+	}
+}
+
+
+bool VulkanUploader::IsComplete(u64 BatchId)
+{
+	RetireCompleted();
+
+	return BatchId <= m_lastCompletedId;
+}
+
+
+void VulkanUploader::Wait(u64 BatchId)
+{
+	if (BatchId > m_lastSubmittedId) {
+		Flush();
+	}
+
+	while ((m_lastCompletedId < BatchId) && RetireOldest()) {
+	}
+}
+
+
+void VulkanUploader::WaitAll()
+{
+	Flush();
+
+	Wait(m_lastSubmittedId);
+}
+
+}
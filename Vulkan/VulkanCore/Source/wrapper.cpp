@@ -50,6 +50,21 @@ VkSemaphore CreateSemaphore(VkDevice Device)
 }
 
 
+VkFence CreateFence(VkDevice Device, bool Signaled)
+{
+	VkFenceCreateInfo CreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+		.pNext = NULL,
+		.flags = Signaled ? (VkFenceCreateFlags)VK_FENCE_CREATE_SIGNALED_BIT : 0
+	};
+
+	VkFence Fence;
+	VkResult Res = vkCreateFence(Device, &CreateInfo, NULL, &Fence);
+	CHECK_VK_RESULT(Res, "vkCreateFence");
+	return Fence;
+}
+
+
 // Copied from the "3D Graphics Rendering Cookbook"
 void ImageMemBarrier(VkCommandBuffer CmdBuf, VkImage Image, VkFormat Format,
 					 VkImageLayout OldLayout, VkImageLayout NewLayout)